@@ -1,324 +1,312 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
-#include <tinyexpr.h>
-#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#include "uqexpr.h"
+#include "uqexpr_server.h"
 
 #define INVALID_COMMAND_LINE_ERROR 4
 #define FILE_DOES_NOT_OPEN_ERROR 7
-#define INVALID_VARIABLES_ERROR 12
-#define DUPLICATE_VARIABLES_ERROR 6
-#define FORMAT_BUFFER_SIZE 20
-#define LOOP_COMMAS 3
-#define MAX_VARIABLE_LENGTH 22
 #define DEFAULT_SIG_FIGS 3
 #define LINE_BUFFER 500
-#define THIRD_INDEX 3
-#define FOURTH_INDEX 4
-#define FIFTH_INDEX 5
-#define LOOP_LENGTH 6
-
-/* Represents the collection of non-loop variables where each index corresponds
- * to one variable
- *
- * char** names: array of strings with name of variable
- * double* values: array of variable values
- * int size: number of entries in variables (includes variables that have been
- * transformed to loops) int converted: number of variables that have been
- * converted to loops
- */
-typedef struct {
-    char** names;
-    double* values;
-    int size;
-    int converted;
-} Variables;
-
-/* Represents the collection of loops where each index corresponds to one loop
- *
- * char** names: array of strings with names of loops
- * double* currentValue: array of the current value of the loop variable
- * double* startingValue: array of the value the loop will start at if looped
- * double* increment: array of amount by which currentValue will increase by
- * when looped double* finalValue: array of values by which current will not
- * exceed if looped
- */
-typedef struct {
-    char** names;
-    double* currentValue;
-    double* startingValue;
-    double* increment;
-    double* endValue;
-    int size;
-} Loops;
+#define OUTPUT_OPTION_LENGTH 9
+#define MATH_OPTION_LENGTH 7
+#define PRECISION_OPTION_LENGTH 12
+#define PROFILE_OPTION_LENGTH 10
+#define ENGINE_OPTION_LENGTH 9
+#define CROSSCHECK_OPTION_LENGTH 13
+#define DEFAULT_CROSSCHECK_ULPS 4
+#define DEFAULT_PROFILE_ROWS 10
+#define MAX_PROFILE_ROWS 1000000
+#define PROFILE_TEXT_WIDTH 40
+#define PERCENT 100.0
+#define COMPILED_EXTENSION ".uqc"
+#define STATS_BUFFER 1024
+#define NUMBER_BUFFER 24
+#define DECIMAL_BASE 10
+#define NANOSECONDS_PER_SECOND 1000000000LL
+#define NANOSECONDS_PER_MICROSECOND 1000LL
+#define NANOSECONDS_PER_MILLISECOND 1000000LL
+#define MILLISECOND_DECIMALS 3
+#define KILOBYTE 1024LL
+#define MAX_MEMORY_BYTES (1LL << 50)
+#define MAX_TIME_LIMIT (1LL << 40)
+#define MAX_JOBS 1024
+#define JOB_OUTPUT_LIMIT 16777216
+#define SPILL_BUFFER 65536
+#define OUT_EXTENSION ".out"
 
 /* Represents information found from the command line
  *
- * char* fileName: string of the name of a file to read if given
+ * char* fileName: string of the name of a file to read if given, the first
+ * of inputFiles
+ * char** inputFiles: names of the input files in the order they were given
+ * int numberFiles: number of input files
+ * int jobs: number of files run at once given with --jobs or 0
+ * int splitOutput: 1 if --split-output was given
  * char** variableStrings: array of strings that have been identified following
  * --define on the command line char** loopsStrings: array of loopables that
  * have been identified following --loopable on the command line
+ * char* columnsFile: name of the CSV/TSV file following --columns or NULL
+ * char* evalExpression: expression following --eval or NULL
+ * int outputMode: UQ_OUTPUT_TEXT, UQ_OUTPUT_TSV or UQ_OUTPUT_BINARY from
+ * --output=, -1 until the command line has been read
+ * int math: UQ_MATH_EXACT or UQ_MATH_FAST from --math=, -1 until the command
+ * line has been read
+ * int precision: UQ_PRECISION_DOUBLE or UQ_PRECISION_FLOAT from --precision=,
+ * -1 until the command line has been read
+ * int engine: UQ_ENGINE_TREE or UQ_ENGINE_VECTOR from --engine=, -1 until the
+ * command line has been read
+ * char* serveSocket: socket path following --serve or NULL
+ * char* connectSocket: socket path following --connect or NULL
+ * char* restoreFile: snapshot path following --restore or NULL
+ * char* compileSource: script path following --compile or NULL
+ * char* compileOutput: image path following -o or NULL
+ * char* aotSource: script path following --aot or NULL
+ * int verify: 1 if --verify was given
+ * int stats: 1 if --stats was given
+ * int profileRows: number of lines --profile reports, 0 if not profiling
+ * char* traceFile: trace path following --trace or NULL
+ * long long maxMemory: bytes given to --max-memory or 0 if not limited
+ * long long progress: @loop iterations between reports given with --progress
+ * or 0
+ * long long timeLimit: milliseconds a @loop may run for given with
+ * --time-limit or 0
+ * long long crosscheck: ulps results may differ by given with --crosscheck or
+ * -1 if not checking
  */
 typedef struct {
     char* fileName;
+    char** inputFiles;
+    int numberFiles;
+    int jobs;
+    int splitOutput;
     char** variableStrings;
     char** loopsStrings;
+    char* columnsFile;
+    char* evalExpression;
+    int outputMode;
+    int math;
+    int precision;
+    int engine;
+    char* serveSocket;
+    char* connectSocket;
+    char* restoreFile;
+    char* compileSource;
+    char* compileOutput;
+    char* aotSource;
+    int verify;
+    int stats;
+    int profileRows;
+    char* traceFile;
+    long long maxMemory;
+    long long progress;
+    long long timeLimit;
+    long long crosscheck;
 } Information;
 
-int decode_loops_strings(Loops*, Information*, const int*, Variables*);
-int extend_loops(Loops*, Variables*, char*, char*, char*, char*, int*);
-int reallocate_loops(Loops*, char*, double, double, double);
-int decode_variable_strings(Variables*, Information*, const int*);
-int extend_variables(Variables*, char*, char*, int*);
+/* The cost of one line of a file run with --profile
+ *
+ * int lineNumber: line number in the file, starting from 1
+ * char* text: the line without its newline
+ * long long nanoseconds: wall time spent executing the line
+ * long long evaluations: values the line evaluated
+ * long long loopIterations: @loop iterations the line ran
+ * long long outputBytes: bytes of output and errors the line produced
+ */
+typedef struct {
+    int lineNumber;
+    char* text;
+    long long nanoseconds;
+    long long evaluations;
+    long long loopIterations;
+    long long outputBytes;
+} ProfileLine;
+
+/* One input file of a run over several files
+ *
+ * const char* fileName: file to run
+ * struct FileQueue* queue: the run the file belongs to
+ * char* output: results waiting to be written to stdout in argument order
+ * size_t outputLength: number of bytes in output
+ * size_t outputCapacity: number of bytes allocated for output
+ * FILE* spill: temporary file holding the results that followed output once
+ * the run held JOB_OUTPUT_LIMIT bytes in memory, or NULL
+ * int streaming: 1 once every file before this one has been written, so its
+ * results are written to stdout as they arrive
+ * char* errors: errors waiting to be written to stderr in argument order
+ * size_t errorsLength: number of bytes in errors
+ * size_t errorsCapacity: number of bytes allocated for errors
+ * FILE* outFile: <file>.out the results are written to with --split-output,
+ * otherwise NULL
+ * int result: 0, UQ_SCRIPT_ERROR if a .uqc file is not a compiled script or
+ * UQ_STATEMENT_ERROR if the file's context could not be created
+ * int done: 1 once the file has been run
+ * UqStats stats: counters of the file's work with --stats or --profile
+ * UqTrace* trace: trace of the worker thread running the file, or NULL
+ */
+typedef struct {
+    const char* fileName;
+    struct FileQueue* queue;
+    char* output;
+    size_t outputLength;
+    size_t outputCapacity;
+    FILE* spill;
+    int streaming;
+    char* errors;
+    size_t errorsLength;
+    size_t errorsCapacity;
+    FILE* outFile;
+    int result;
+    int done;
+    UqStats stats;
+    UqTrace* trace;
+} FileJob;
+
+/* The files of a run over several files, taken in order by the worker threads
+ *
+ * FileJob* jobs: one job for each input file
+ * int numberJobs: number of jobs
+ * int next: index of the next job to be taken
+ * const UqContext* base: context holding the command line definitions, cloned
+ * for each file
+ * int text: 1 if each file's results are framed by the banner and closing
+ * message
+ * size_t buffered: bytes of results held in memory by all the jobs
+ * int stats: 1 if the work of each file is counted for --stats
+ * int traced: 1 if each worker thread records a trace for --trace
+ * int profileRows: number of lines of each file to report for --profile, or
+ * 0 if the files are not profiled
+ * pthread_mutex_t lock: guards next, done, cloning base and the held results
+ * pthread_cond_t finished: signalled whenever a job is done
+ */
+typedef struct FileQueue {
+    FileJob* jobs;
+    int numberJobs;
+    int next;
+    const UqContext* base;
+    int text;
+    size_t buffered;
+    int stats;
+    int traced;
+    int profileRows;
+    pthread_mutex_t lock;
+    pthread_cond_t finished;
+} FileQueue;
+
+/* Counters of the run's work, read by the SIGUSR1 handler while they are being
+ * updated
+ */
+static UqStats runStats;
+
+/* Monotonic time in nanoseconds at which the run started
+ */
+static long long runStart;
+
+/* Spans of the run recorded for --trace, or NULL if it is not traced, and the
+ * file they are written to at exit
+ */
+static UqTrace* runTrace;
+static FILE* runTraceFile;
+
+/* Traces of the worker threads of a run over several files, written with
+ * runTrace at exit
+ */
+static UqTrace* runWorkerTraces[MAX_JOBS];
+static int runNumberWorkerTraces;
+
+/* Files of a run over several files whose counters are not yet in runStats,
+ * added to them when the SIGUSR1 handler reports
+ */
+static FileJob* runJobs;
+static int runNumberJobs;
+
+/* Background check of results against tinyexpr made for --crosscheck, or NULL
+ * if results are not checked
+ */
+static UqCrosscheck* runCrosscheck;
+
 int download_sig_figs(int, int, int*, char**);
 int download_loops(int, int, int*, Information*, char**);
 int download_variable(int, int, int*, Information*, char**);
-int range_new_loop(Variables*, Loops*, char*, double, double, double, int*);
-int range_allocate_loop(Loops*, char*, double, double, double, int*);
-int print_variables(Variables*, Loops*, int*);
+int download_option(int, int, char**, char**);
+int download_output(char*, int*);
+int download_math(char*, int*);
+int download_precision(char*, int*);
+int download_engine(char*, int*);
+int download_crosscheck(char*, long long*);
+int download_profile(char*, int*);
+int download_memory(char*, long long*);
+int download_jobs(int, int, int*, char**);
+int download_progress(int, int, long long*, char**);
+int download_time_limit(int, int, long long*, char**);
+long long stats_now(void);
+void stats_add(UqStats*, const UqStats*);
 
 /* decode_loop_strings()
  *
  * Processes array of loopable strings that are stored in the Information
- * struct. Function extracts each component, ensuring the format is valid and
- * stores valid loopable variables in the Loops struct. Also checks and returns
- * error if duplicates are found
+ * struct, adding each valid loopable variable to the context. Also checks and
+ * returns error if duplicates are found
  *
- * Loops* loops: Pointer to the loops struct that will be populated by valid
- * loopables Information* information: Pointer to the information struct that
- * has loopable strings from the initial command line const int* numberLoops:
+ * UqContext* context: context the loop variables are added to
+ * Information* information: Pointer to the information struct that has
+ * loopable strings from the initial command line const int* numberLoops:
  * Pointer to the number of loops that were stored in the information struct
- * Variables* variables: Pointer to the Variables struct which is used to check
- * for duplicates
  *
  * Returns: 0 if all loops are valid
- * Returns: INVALID_VARIABLES_ERROR if loop string format is invalid
- * Returns: DUPLICATE_VARIABLES_ERROR if a loop variable name is already defined
- * as another loop or variable
+ * Returns: UQ_INVALID_VARIABLES_ERROR if loop string format is invalid
+ * Returns: UQ_DUPLICATE_VARIABLES_ERROR if a loop variable name is already
+ * defined as another loop or variable
  */
-int decode_loops_strings(Loops* loops, Information* information,
-        const int* numberLoops, Variables* variables)
+int decode_loops_strings(
+        UqContext* context, Information* information, const int* numberLoops)
 {
-    loops->names = (char**)malloc(sizeof(char*));
-    loops->currentValue = (double*)malloc(sizeof(double));
-    loops->startingValue = (double*)malloc(sizeof(double));
-    loops->increment = (double*)malloc(sizeof(double));
-    loops->endValue = (double*)malloc(sizeof(double));
-    loops->size = 0;
     int duplicated = 0;
     for (int i = 0; i < *numberLoops; i++) {
-        int countEquals = 0;
-        if (information->loopsStrings[i] != NULL) {
-            for (int m = 0; m < (int)strlen(information->loopsStrings[i]);
-                    m++) {
-                if (information->loopsStrings[i][m] == ',') {
-                    countEquals++;
-                }
-            }
-        }
-        if (countEquals != LOOP_COMMAS) {
-            return INVALID_VARIABLES_ERROR;
-        }
-        char* name = strtok(information->loopsStrings[i], ",");
-        char* startingValueString = strtok(NULL, ",");
-        char* incrementString = strtok(NULL, ",");
-        char* endValueString = strtok(NULL, ",");
-        int result = extend_loops(loops, variables, name, startingValueString,
-                incrementString, endValueString, &duplicated);
-        if (result != 0) {
+        int result = uq_loopable(context, information->loopsStrings[i]);
+        if (result == UQ_DUPLICATE_VARIABLES_ERROR) {
+            duplicated = 1;
+        } else if (result != 0) {
             return result;
         }
     }
     if (duplicated) {
-        return DUPLICATE_VARIABLES_ERROR;
-    }
-    return 0;
-}
-
-/* Extends the Loops struct by adding a new loop by validating the loopString
- * structure. Checks if variable name ahs already been used and if valid will
- * append new loop to Loops structure.
- *
- * Loops* loops: Pointer to the Loops struct that if valid will have loop added
- * to Variables* variables: pointer to the Variables struct, used to determine
- * if duplicate name char* name: name of the loop char* startingValueString:
- * String of the starting value of the loop char* incrementString: String of the
- * increment of the loop char* endValueString: String of the end value of the
- * loop int* duplicated: pointer to integer that flags if a duplicate name is
- * being used
- *
- * Returns: 0 upon success of INVALID_VARIABLES_ERROR if loop form is invalid
- */
-int extend_loops(Loops* loops, Variables* variables, char* name,
-        char* startingValueString, char* incrementString, char* endValueString,
-        int* duplicated)
-{
-    if (name == NULL || startingValueString == NULL || incrementString == NULL
-            || endValueString == NULL) {
-        return INVALID_VARIABLES_ERROR;
-    }
-    int nameLength = strlen(name);
-    if (nameLength < 1 || nameLength > MAX_VARIABLE_LENGTH) {
-        return INVALID_VARIABLES_ERROR;
-    }
-    for (int k = 0; k < nameLength; k++) {
-        if (!isalpha((unsigned char)name[k])) {
-            return INVALID_VARIABLES_ERROR;
-        }
-    }
-    char* tempExcess;
-    double startValue, increment, endValue;
-    startValue = strtod(startingValueString, &tempExcess);
-    if (*tempExcess != '\0' || strlen(startingValueString) == 0) {
-        return INVALID_VARIABLES_ERROR;
+        return UQ_DUPLICATE_VARIABLES_ERROR;
     }
-    increment = strtod(incrementString, &tempExcess);
-    if (*tempExcess != '\0' || strlen(incrementString) == 0) {
-        return INVALID_VARIABLES_ERROR;
-    }
-    endValue = strtod(endValueString, &tempExcess);
-    if (*tempExcess != '\0' || strlen(endValueString) == 0) {
-        return INVALID_VARIABLES_ERROR;
-    }
-    if ((startValue < endValue && increment < 0)
-            || (startValue > endValue && increment > 0) || (increment == 0)) {
-        return INVALID_VARIABLES_ERROR;
-    }
-    for (int j = 0; j < loops->size; j++) {
-        if (!strcmp(loops->names[j], name)) {
-            *duplicated = 1;
-        }
-    }
-    for (int j = 0; j < variables->size; j++) {
-        if (!strcmp(variables->names[j], name)) {
-            *duplicated = 1;
-        }
-    }
-    reallocate_loops(loops, name, startValue, increment, endValue);
-    return 0;
-}
-
-/* Expands the Loops struct by reallocating memory to add a new entry
- *
- * Loops* loops: Pointer to the loops struct to be updated
- * char* name: Name of the loop variable
- * double startValue: start value of the loop variable
- * double increment: increment of the loop variable
- * double endValue: end value of the loop variable
- *
- * Return: 0 upon success
- */
-int reallocate_loops(Loops* loops, char* name, double startValue,
-        double increment, double endValue)
-{
-    loops->size++;
-    loops->names = (char**)realloc(
-            (void*)loops->names, (loops->size) * sizeof(char*));
-    loops->currentValue = (double*)realloc(
-            (void*)loops->currentValue, (loops->size) * sizeof(double));
-    loops->startingValue = (double*)realloc(
-            (void*)loops->startingValue, (loops->size) * sizeof(double));
-    loops->increment = (double*)realloc(
-            (void*)loops->increment, (loops->size) * sizeof(double));
-    loops->endValue = (double*)realloc(
-            (void*)loops->endValue, (loops->size) * sizeof(double));
-    loops->names[loops->size - 1] = strdup(name);
-    loops->currentValue[loops->size - 1] = startValue;
-    loops->startingValue[loops->size - 1] = startValue;
-    loops->increment[loops->size - 1] = increment;
-    loops->endValue[loops->size - 1] = endValue;
     return 0;
 }
 
-/* Parses variable strings from Information struct and if valid stores them in
- * Variables struct, able to detect duplicate and invalid variables.
+/* Parses variable strings from Information struct and if valid adds them to
+ * the context, able to detect duplicate and invalid variables.
  *
- * Variables* variables: Pointer to Variables struct where valid variables will
- * be stored Information* information: Pointer to the information struct which
- * contains the variable strings const int* numberVariables: Pointer to number
- * of variable strings to be processed
+ * UqContext* context: context the variables are added to
+ * Information* information: Pointer to the information struct which contains
+ * the variable strings const int* numberVariables: Pointer to number of
+ * variable strings to be processed
  *
- * Returns: 0 on success, INVALID_VARIABLES_ERROR for an invalid variable and
- * DUPLICATE_VARIABLES_ERROR if duplicate variables are observed.
+ * Returns: 0 on success, UQ_INVALID_VARIABLES_ERROR for an invalid variable
+ * and UQ_DUPLICATE_VARIABLES_ERROR if duplicate variables are observed.
  */
-int decode_variable_strings(Variables* variables, Information* information,
+int decode_variable_strings(UqContext* context, Information* information,
         const int* numberVariables)
 {
-    variables->size = 0;
-    variables->converted = 0;
-    variables->names = (char**)malloc(sizeof(char*));
-    variables->values = (double*)malloc(sizeof(double));
     int duplicated = 0;
     for (int i = 0; i < *numberVariables; i++) {
-        int countEquals = 0;
-        if (information->variableStrings[i] != NULL) {
-            for (int m = 0; m < (int)strlen(information->variableStrings[i]);
-                    m++) {
-                if (information->variableStrings[i][m] == '=') {
-                    countEquals++;
-                }
-            }
-        }
-        if (countEquals != 1) {
-            return INVALID_VARIABLES_ERROR;
-        }
-        char* key = strtok(information->variableStrings[i], "=");
-        char* valueString = strtok(NULL, "=");
-        int result = extend_variables(variables, key, valueString, &duplicated);
-        if (result != 0) {
+        int result = uq_define(context, information->variableStrings[i]);
+        if (result == UQ_DUPLICATE_VARIABLES_ERROR) {
+            duplicated = 1;
+        } else if (result != 0) {
             return result;
         }
     }
     if (duplicated) {
-        return DUPLICATE_VARIABLES_ERROR;
-    }
-    return 0;
-}
-
-/*Checks validity of variable name and its value e.g. making sure name consists
- * of alphabetic characters and is appropriately sized, if valid appends to
- * Variables struct. Also able to detect duplicate variables
- *
- * Variables* variables: Pointer to Variables struct where valid variables are
- * stored char* key: Name of variable to be added char* valueString: String of
- * the value of the variable int* duplicated: Pointer to integer that flags if a
- * duplicate variable has been detected
- *
- * returns: 0 if success else INVALID_VARIABLES_ERROR if variable is invalid.
- */
-int extend_variables(
-        Variables* variables, char* key, char* valueString, int* duplicated)
-{
-    if (key == NULL || valueString == NULL) {
-        return INVALID_VARIABLES_ERROR;
-    }
-    int keyLength = strlen(key);
-    if (keyLength < 1 || keyLength > MAX_VARIABLE_LENGTH) {
-        return INVALID_VARIABLES_ERROR;
-    }
-    for (int k = 0; k < keyLength; k++) {
-        if (!isalpha((unsigned char)key[k])) {
-            return INVALID_VARIABLES_ERROR;
-        }
-    }
-    char* tempExcess;
-    double value = strtod(valueString, &tempExcess);
-    if (key != NULL && *tempExcess == '\0' && strlen(valueString) > 0) {
-        for (int j = 0; j < variables->size; j++) {
-            if (!strcmp(variables->names[j], key)) {
-                *duplicated = 1;
-            }
-        }
-        variables->size++;
-        variables->names = (char**)realloc(
-                (void*)variables->names, (variables->size) * sizeof(char*));
-        variables->values = (double*)realloc(
-                (void*)variables->values, (variables->size) * sizeof(double));
-        variables->names[variables->size - 1] = strdup(key);
-        variables->values[variables->size - 1] = value;
-    } else {
-        return INVALID_VARIABLES_ERROR;
+        return UQ_DUPLICATE_VARIABLES_ERROR;
     }
     return 0;
 }
@@ -367,24 +355,271 @@ int download_command_line(int numberArguments, char** arguments, int* sigFigs,
                 return result;
             }
             i++;
-        } else if (i + 1 == numberArguments && strcmp(arguments[i], "")
+        } else if (!(strcmp(arguments[i], "--columns"))) {
+            int result = download_option(
+                    i, numberArguments, &(information->columnsFile), arguments);
+            if (result != 0) {
+                return result;
+            }
+            i++;
+        } else if (!(strncmp(
+                           arguments[i], "--output=", OUTPUT_OPTION_LENGTH))) {
+            int result = download_output(arguments[i] + OUTPUT_OPTION_LENGTH,
+                    &(information->outputMode));
+            if (result != 0) {
+                return result;
+            }
+        } else if (!(strncmp(arguments[i], "--math=", MATH_OPTION_LENGTH))) {
+            int result = download_math(
+                    arguments[i] + MATH_OPTION_LENGTH, &(information->math));
+            if (result != 0) {
+                return result;
+            }
+        } else if (!(strncmp(arguments[i], "--precision=",
+                           PRECISION_OPTION_LENGTH))) {
+            int result
+                    = download_precision(arguments[i] + PRECISION_OPTION_LENGTH,
+                            &(information->precision));
+            if (result != 0) {
+                return result;
+            }
+        } else if (!(strncmp(
+                           arguments[i], "--engine=", ENGINE_OPTION_LENGTH))) {
+            int result = download_engine(arguments[i] + ENGINE_OPTION_LENGTH,
+                    &(information->engine));
+            if (result != 0) {
+                return result;
+            }
+        } else if (!(strncmp(arguments[i], "--crosscheck",
+                           CROSSCHECK_OPTION_LENGTH - 1))) {
+            int result = download_crosscheck(
+                    arguments[i], &(information->crosscheck));
+            if (result != 0) {
+                return result;
+            }
+        } else if (!(strcmp(arguments[i], "--serve"))) {
+            int result = download_option(
+                    i, numberArguments, &(information->serveSocket), arguments);
+            if (result != 0) {
+                return result;
+            }
+            i++;
+        } else if (!(strcmp(arguments[i], "--connect"))) {
+            int result = download_option(i, numberArguments,
+                    &(information->connectSocket), arguments);
+            if (result != 0) {
+                return result;
+            }
+            i++;
+        } else if (!(strcmp(arguments[i], "--restore"))) {
+            int result = download_option(i, numberArguments,
+                    &(information->restoreFile), arguments);
+            if (result != 0) {
+                return result;
+            }
+            i++;
+        } else if (!(strcmp(arguments[i], "--compile"))) {
+            int result = download_option(i, numberArguments,
+                    &(information->compileSource), arguments);
+            if (result != 0) {
+                return result;
+            }
+            i++;
+        } else if (!(strcmp(arguments[i], "-o"))) {
+            int result = download_option(i, numberArguments,
+                    &(information->compileOutput), arguments);
+            if (result != 0) {
+                return result;
+            }
+            i++;
+        } else if (!(strcmp(arguments[i], "--aot"))) {
+            int result = download_option(
+                    i, numberArguments, &(information->aotSource), arguments);
+            if (result != 0) {
+                return result;
+            }
+            i++;
+        } else if (!(strcmp(arguments[i], "--verify"))
+                && !information->verify) {
+            information->verify = 1;
+        } else if (!(strcmp(arguments[i], "--stats")) && !information->stats) {
+            information->stats = 1;
+        } else if (!(strncmp(arguments[i], "--profile",
+                           PROFILE_OPTION_LENGTH - 1))) {
+            int result = download_profile(
+                    arguments[i], &(information->profileRows));
+            if (result != 0) {
+                return result;
+            }
+        } else if (!(strcmp(arguments[i], "--trace"))) {
+            int result = download_option(
+                    i, numberArguments, &(information->traceFile), arguments);
+            if (result != 0) {
+                return result;
+            }
+            i++;
+        } else if (!(strcmp(arguments[i], "--max-memory"))
+                && i + 1 < numberArguments) {
+            int result = download_memory(
+                    arguments[i + 1], &(information->maxMemory));
+            if (result != 0) {
+                return result;
+            }
+            i++;
+        } else if (!(strcmp(arguments[i], "--eval"))) {
+            int result = download_option(i, numberArguments,
+                    &(information->evalExpression), arguments);
+            if (result != 0) {
+                return result;
+            }
+            i++;
+        } else if (!(strcmp(arguments[i], "--jobs"))) {
+            int result = download_jobs(
+                    i, numberArguments, &(information->jobs), arguments);
+            if (result != 0) {
+                return result;
+            }
+            i++;
+        } else if (!(strcmp(arguments[i], "--time-limit"))) {
+            int result = download_time_limit(
+                    i, numberArguments, &(information->timeLimit), arguments);
+            if (result != 0) {
+                return result;
+            }
+            i++;
+        } else if (!(strcmp(arguments[i], "--progress"))) {
+            int result = download_progress(
+                    i, numberArguments, &(information->progress), arguments);
+            if (result != 0) {
+                return result;
+            }
+            i++;
+        } else if (!(strcmp(arguments[i], "--split-output"))) {
+            if (information->splitOutput) {
+                return INVALID_COMMAND_LINE_ERROR;
+            }
+            information->splitOutput = 1;
+        } else if (strcmp(arguments[i], "")
                 && (strlen(arguments[i]) < 2
                         || ('-' != arguments[i][0]
                                 && '-' != arguments[i][1]))) {
             int length = strlen(arguments[i]);
-            if (length > 0) {
+            if (information->numberFiles == 0) {
                 information->fileName
                         = (char*)realloc((void*)information->fileName,
                                 (length + 1) * sizeof(char));
                 strcpy(information->fileName, arguments[i]);
             }
+            information->numberFiles++;
+            information->inputFiles = (char**)realloc(
+                    (void*)information->inputFiles,
+                    information->numberFiles * sizeof(char*));
+            information->inputFiles[information->numberFiles - 1]
+                    = arguments[i];
         } else {
             return INVALID_COMMAND_LINE_ERROR;
         }
     }
-    if (*sigFigs == 0) {
+    if ((information->columnsFile == NULL)
+                    != (information->evalExpression == NULL)
+            || (information->columnsFile != NULL
+                    && strcmp(information->fileName, ""))) {
+        return INVALID_COMMAND_LINE_ERROR;
+    }
+    if (information->serveSocket != NULL
+            && (information->columnsFile != NULL
+                    || information->connectSocket != NULL
+                    || strcmp(information->fileName, ""))) {
+        return INVALID_COMMAND_LINE_ERROR;
+    }
+    if (information->connectSocket != NULL
+            && (information->columnsFile != NULL || *numberVariables != 0
+                    || *numberLoops != 0 || *sigFigs != 0
+                    || information->outputMode != -1 || information->math != -1
+                    || information->precision != -1
+                    || information->engine != -1
+                    || information->restoreFile != NULL)) {
+        return INVALID_COMMAND_LINE_ERROR;
+    }
+    if ((information->compileSource == NULL)
+                    != (information->compileOutput == NULL)
+            || (information->compileSource != NULL
+                    && (information->columnsFile != NULL
+                            || information->serveSocket != NULL
+                            || information->connectSocket != NULL
+                            || information->restoreFile != NULL
+                            || *numberVariables != 0 || *numberLoops != 0
+                            || *sigFigs != 0 || information->outputMode != -1
+                            || information->math != -1
+                            || information->precision != -1
+                            || information->engine != -1
+                            || strcmp(information->fileName, "")))) {
+        return INVALID_COMMAND_LINE_ERROR;
+    }
+    if ((information->verify && information->aotSource == NULL)
+            || (information->aotSource != NULL
+                    && (information->columnsFile != NULL
+                            || information->serveSocket != NULL
+                            || information->connectSocket != NULL
+                            || information->compileSource != NULL
+                            || strcmp(information->fileName, "")))) {
+        return INVALID_COMMAND_LINE_ERROR;
+    }
+    if ((information->maxMemory || information->progress
+                || information->timeLimit || information->crosscheck != -1)
+            && (information->connectSocket != NULL
+                    || information->compileSource != NULL)) {
+        return INVALID_COMMAND_LINE_ERROR;
+    }
+    if ((information->stats || information->traceFile != NULL)
+            && (information->serveSocket != NULL
+                    || information->connectSocket != NULL
+                    || information->compileSource != NULL)) {
+        return INVALID_COMMAND_LINE_ERROR;
+    }
+    if ((information->numberFiles > 1 || information->splitOutput)
+            && (information->columnsFile != NULL
+                    || information->serveSocket != NULL
+                    || information->connectSocket != NULL
+                    || information->compileSource != NULL
+                    || information->aotSource != NULL)) {
+        return INVALID_COMMAND_LINE_ERROR;
+    }
+    int compiled = 0;
+    int extension = strlen(COMPILED_EXTENSION);
+    for (int i = 0; i < information->numberFiles; i++) {
+        int length = strlen(information->inputFiles[i]);
+        if (length > extension
+                && !strcmp(information->inputFiles[i] + length - extension,
+                        COMPILED_EXTENSION)) {
+            compiled = 1;
+        }
+    }
+    if (information->profileRows
+            && (!strcmp(information->fileName, "")
+                    || information->serveSocket != NULL
+                    || information->connectSocket != NULL || compiled)) {
+        return INVALID_COMMAND_LINE_ERROR;
+    }
+    if (information->precision == UQ_PRECISION_FLOAT
+            && *sigFigs > UQ_FLOAT_SIG_FIGS) {
+        return INVALID_COMMAND_LINE_ERROR;
+    }
+    if (*sigFigs == 0 && information->restoreFile == NULL) {
         *sigFigs = DEFAULT_SIG_FIGS;
     }
+    if (information->outputMode == -1) {
+        information->outputMode = UQ_OUTPUT_TEXT;
+    }
+    if (information->math == -1) {
+        information->math = UQ_MATH_EXACT;
+    }
+    if (information->precision == -1) {
+        information->precision = UQ_PRECISION_DOUBLE;
+    }
+    if (information->engine == -1) {
+        information->engine = UQ_ENGINE_TREE;
+    }
 
     return 0;
 }
@@ -472,943 +707,487 @@ int download_variable(int i, int numberArguments, int* numberVariables,
     return 0;
 }
 
-/* Determines if file can be opened
+/* Parses and validates an option from the command line that takes a single
+ * string argument and may only be given once
  *
- * Information* information: pointer to information struct which contains file
- * name
+ * int i: index of string with the option
+ * int numberArguments: number of strings on command line
+ * char** option: pointer to where the argument will be stored, NULL if the
+ * option has not been seen yet char** arguments: command line strings
  *
- * Returns 0 if success otherwise FILE_DOES_NOT_OPEN_ERROR
+ * Returns 0 on success or INVALID_COMMAND_LINE_ERROR if format is invalid
  */
-int check_open_file(Information* information)
+int download_option(
+        int i, int numberArguments, char** option, char** arguments)
 {
-    FILE* file = fopen(information->fileName, "r");
-    if (file == NULL) {
-        return FILE_DOES_NOT_OPEN_ERROR;
+    if (i + 1 == numberArguments || *option != NULL
+            || !strcmp(arguments[i + 1], "")) {
+        return INVALID_COMMAND_LINE_ERROR;
     }
-    fclose(file);
+    *option = arguments[i + 1];
     return 0;
 }
 
-/* Parses a string expression from file or live command file and if valid
- * initialises a new loop
+/* Parses and validates the mode given with --output= on the command line
  *
- * char* expression A string to be determined if valid loop
- * Variables* variables A pointer to variables struct to determine if variable
- * name already exists Loops* loops: A pointer to Loops struct that holds loop
- * data int* sigFigs: A pointer to integer of number of sig figs to print for
- * doubles
+ * char* mode: the text following --output=
+ * int* outputMode: pointer to where the mode will be stored, -1 if --output=
+ * has not been seen yet
  *
- * Returns 0 if success otherwise INVALID_VARIABLES_ERROR if expression is
- * invalid
+ * Returns 0 on success or INVALID_COMMAND_LINE_ERROR if the mode is unknown or
+ * already given
  */
-int range(char* expression, Variables* variables, Loops* loops, int* sigFigs)
+int download_output(char* mode, int* outputMode)
 {
-    int countEquals = 0;
-    for (int m = 0; m < (int)strlen(expression); m++) {
-        if (expression[m] == ',') {
-            countEquals++;
-        }
-    }
-    if (countEquals != LOOP_COMMAS) {
-        return INVALID_VARIABLES_ERROR;
-    }
-    char* name = strtok(expression, ",");
-    char* startingValueString = strtok(NULL, ",");
-    char* incrementString = strtok(NULL, ",");
-    char* endValueString = strtok(NULL, ",");
-    if (name == NULL || startingValueString == NULL || incrementString == NULL
-            || endValueString == NULL) {
-        return INVALID_VARIABLES_ERROR;
-    }
-    int nameLength = strlen(name);
-    if (nameLength < 1 || nameLength > MAX_VARIABLE_LENGTH) {
-        return INVALID_VARIABLES_ERROR;
-    }
-    for (int k = 0; k < nameLength; k++) {
-        if (!isalpha((unsigned char)name[k])) {
-            return INVALID_VARIABLES_ERROR;
-        }
-    }
-    char* tempExcess;
-    double startValue, increment, endValue;
-    startValue = strtod(startingValueString, &tempExcess);
-    if (*tempExcess != '\0' || strlen(startingValueString) == 0) {
-        return INVALID_VARIABLES_ERROR;
-    }
-    increment = strtod(incrementString, &tempExcess);
-    if (*tempExcess != '\0' || strlen(incrementString) == 0) {
-        return INVALID_VARIABLES_ERROR;
-    }
-    endValue = strtod(endValueString, &tempExcess);
-    if (*tempExcess != '\n' || strlen(endValueString) == 0) {
-        return INVALID_VARIABLES_ERROR;
+    if (*outputMode != -1) {
+        return INVALID_COMMAND_LINE_ERROR;
     }
-    if ((startValue < endValue && increment < 0)
-            || (startValue > endValue && increment > 0) || (increment == 0)) {
-        return INVALID_VARIABLES_ERROR;
+    if (!strcmp(mode, "text")) {
+        *outputMode = UQ_OUTPUT_TEXT;
+    } else if (!strcmp(mode, "tsv")) {
+        *outputMode = UQ_OUTPUT_TSV;
+    } else if (!strcmp(mode, "binary")) {
+        *outputMode = UQ_OUTPUT_BINARY;
+    } else {
+        return INVALID_COMMAND_LINE_ERROR;
     }
-    range_new_loop(
-            variables, loops, name, startValue, increment, endValue, sigFigs);
     return 0;
 }
 
-/* Checks whether loop with given name already exists and updates it otherwise
- * calls for allocation of memory for new loop variable
- *
- * Variables* variables: A pointer to Variables struct that holds variables
- * Loops* loops: A pointer to Loops struct that holds loops
- * double startValue: Starting value of new loop
- * double increment: Incremement of new loop
- * double endvalue: End value of new loop
- * int* sigFigs: Pointer to int telling how many sig figs doubles should be
- * printed with
- *
- * Return 0 if success
+/* Parses and validates the mode given with --math= on the command line
+ *
+ * char* mode: the text following --math=
+ * int* math: pointer to where the mode will be stored, -1 if --math= has not
+ * been seen yet
+ *
+ * Returns 0 on success or INVALID_COMMAND_LINE_ERROR if the mode is unknown or
+ * already given
  */
-int range_new_loop(Variables* variables, Loops* loops, char* name,
-        double startValue, double increment, double endValue, int* sigFigs)
+int download_math(char* mode, int* math)
 {
-    for (int j = 0; j < loops->size; j++) {
-        if (!strcmp(loops->names[j], name)) {
-            loops->currentValue[j] = startValue;
-            loops->startingValue[j] = startValue;
-            loops->increment[j] = increment;
-            loops->endValue[j] = endValue;
-            char format[FORMAT_BUFFER_SIZE];
-            snprintf(format, sizeof(format), "%%.%dg", sigFigs[0]);
-            // REF: Inspired by
-            // REF: https://www.geeksforgeeks.org/snprintf-c-library/
-            printf("%s = ", loops->names[j]);
-            printf(format, loops->currentValue[j]);
-            printf(" (");
-            printf(format, loops->startingValue[j]);
-            printf(", ");
-            printf(format, loops->increment[j]);
-            printf(", ");
-            printf(format, loops->endValue[j]);
-            printf(")\n");
-            return 0;
-        }
+    if (*math != -1) {
+        return INVALID_COMMAND_LINE_ERROR;
     }
-    for (int j = 0; j < variables->size; j++) {
-        if (!strcmp(variables->names[j], name)) {
-            variables->names[j] = " ";
-            variables->converted++;
-            break;
-        }
+    if (!strcmp(mode, "exact")) {
+        *math = UQ_MATH_EXACT;
+    } else if (!strcmp(mode, "fast")) {
+        *math = UQ_MATH_FAST;
+    } else {
+        return INVALID_COMMAND_LINE_ERROR;
     }
-    range_allocate_loop(loops, name, startValue, increment, endValue, sigFigs);
     return 0;
 }
 
-/* Allocates memory for new loop and initialises it with provided details
+/* Parses and validates the precision given with --precision= on the command
+ * line
  *
- * Loops* loops: Pointer to Loops struct where new loop will be added
- * char* name: name of new loop
- * double startValue: starting value of new loop
- * double increment: increment of new loop
- * double endValue: end value of new loop
- * int* sigFigs: pointer to integer telling how many sig figs doubles should be
- * printed to
+ * char* mode: the text following --precision=
+ * int* precision: pointer to where the precision will be stored, -1 if
+ * --precision= has not been seen yet
  *
- * Returns 0
+ * Returns 0 on success or INVALID_COMMAND_LINE_ERROR if the precision is
+ * unknown or already given
  */
-int range_allocate_loop(Loops* loops, char* name, double startValue,
-        double increment, double endValue, int* sigFigs)
+int download_precision(char* mode, int* precision)
 {
-    loops->size++;
-    loops->names = (char**)realloc(
-            (void*)loops->names, (loops->size) * sizeof(char*));
-    loops->currentValue = (double*)realloc(
-            (void*)loops->currentValue, (loops->size) * sizeof(double));
-    loops->startingValue = (double*)realloc(
-            (void*)loops->startingValue, (loops->size) * sizeof(double));
-    loops->increment = (double*)realloc(
-            loops->increment, (loops->size) * sizeof(double));
-    loops->endValue = (double*)realloc(
-            (void*)loops->endValue, (loops->size) * sizeof(double));
-    loops->names[loops->size - 1] = strdup(name);
-    loops->currentValue[loops->size - 1] = startValue;
-    loops->startingValue[loops->size - 1] = startValue;
-    loops->increment[loops->size - 1] = increment;
-    loops->endValue[loops->size - 1] = endValue;
-    char format[FORMAT_BUFFER_SIZE];
-    snprintf(format, sizeof(format), "%%.%dg", sigFigs[0]);
-    printf("%s = ", loops->names[loops->size - 1]);
-    printf(format, loops->currentValue[loops->size - 1]);
-    printf(" (");
-    printf(format, loops->startingValue[loops->size - 1]);
-    printf(", ");
-    printf(format, loops->increment[loops->size - 1]);
-    printf(", ");
-    printf(format, loops->endValue[loops->size - 1]);
-    printf(")\n");
+    if (*precision != -1) {
+        return INVALID_COMMAND_LINE_ERROR;
+    }
+    if (!strcmp(mode, "double")) {
+        *precision = UQ_PRECISION_DOUBLE;
+    } else if (!strcmp(mode, "float")) {
+        *precision = UQ_PRECISION_FLOAT;
+    } else {
+        return INVALID_COMMAND_LINE_ERROR;
+    }
     return 0;
 }
 
-/* Prints result of expression evaluation with current loop variable's value
+/* Parses and validates the engine given with --engine= on the command line
+ *
+ * char* mode: the text following --engine=
+ * int* engine: pointer to where the engine will be stored, -1 if --engine=
+ * has not been seen yet
  *
- * double value: evaluated expression
- * int* sig_figs: pointer to number of sig figs to display doubles with
- * int loopVarIndex Index of the loop variable whose name and current value
- * should be printed Loops* loops: Pointer to the loops struct which contains
- * loops
+ * Returns 0 on success or INVALID_COMMAND_LINE_ERROR if the engine is unknown
+ * or already given
  */
-int loop_expression_print(
-        double value, int* sigFigs, int loopVarIndex, Loops* loops)
+int download_engine(char* mode, int* engine)
 {
-    char format[FORMAT_BUFFER_SIZE];
-    snprintf(format, sizeof(format), "%%.%dg", sigFigs[0]);
-    printf("Result = ");
-    printf(format, value);
-    printf(" when %s = ", loops->names[loopVarIndex]);
-    printf(format, loops->currentValue[loopVarIndex]);
-    printf("\n");
+    if (*engine != -1) {
+        return INVALID_COMMAND_LINE_ERROR;
+    }
+    if (!strcmp(mode, "tree")) {
+        *engine = UQ_ENGINE_TREE;
+    } else if (!strcmp(mode, "vector")) {
+        *engine = UQ_ENGINE_VECTOR;
+    } else {
+        return INVALID_COMMAND_LINE_ERROR;
+    }
     return 0;
 }
 
-/* Evaluates expression for @loop calls
+/* Parses and validates --crosscheck or --crosscheck=ulps on the command line
  *
- * Loops* loops: Pointer to loops which contains loops
- * Variables* variables: Pointer the variables struct which contains address of
- * variables to be overridden if necessary char* expression A string
- * representation of maths expression to be converted int loopVarIndex: index of
- * loop variable used in expression int* sigFigs: Pointere to number of sig figs
- * to display doubles
+ * char* option: the whole option
+ * long long* crosscheck: pointer to where the number of ulps results may
+ * differ by will be stored, -1 if --crosscheck has not been seen yet
  *
- * returns 1 if successful or 1 if error
+ * Returns 0 on success or INVALID_COMMAND_LINE_ERROR if the option is invalid
+ * or already given
  */
-int loop_expression(Loops* loops, Variables* variables, char* expression,
-        int loopVarIndex, int* sigFigs)
+int download_crosscheck(char* option, long long* crosscheck)
 {
-    te_variable tevars[variables->size + loops->size];
-    double values[variables->size + loops->size];
-    int index = 0;
-    for (int i = 0; i < loops->size; i++) {
-        if (strcmp(loops->names[i], " ") != 0) {
-            (values[index]) = (loops->currentValue[i]);
-            te_variable var = {.name = loops->names[i],
-                    .address = &(values[index]),
-                    .type = TE_VARIABLE,
-                    .context = NULL};
-            tevars[index] = var;
-            (index)++;
-        }
+    if (*crosscheck != -1) {
+        return INVALID_COMMAND_LINE_ERROR;
     }
-    for (int i = 0; i < variables->size; i++) {
-        if (strcmp(variables->names[i], " ") != 0) {
-            values[index] = (variables->values[i]);
-            te_variable var = {.name = variables->names[i],
-                    .address = &(values[index]),
-                    .type = TE_VARIABLE,
-                    .context = NULL};
-            tevars[index] = var;
-            (index)++;
-        }
+    if (!strcmp(option, "--crosscheck")) {
+        *crosscheck = DEFAULT_CROSSCHECK_ULPS;
+        return 0;
     }
-    int repetitions = 1
-            + (int)floor((loops->endValue[loopVarIndex]
-                                 - loops->startingValue[loopVarIndex])
-                    / loops->increment[loopVarIndex]);
-    for (int i = 0; i < repetitions; i++) {
-        loops->currentValue[loopVarIndex] = loops->startingValue[loopVarIndex]
-                + i * loops->increment[loopVarIndex];
-        values[loopVarIndex] = loops->currentValue[loopVarIndex];
-        int errPos;
-        te_expr* expr = te_compile(expression, tevars, index, &errPos);
-        if (expr) {
-            double value = te_eval(expr);
-            loop_expression_print(value, sigFigs, loopVarIndex, loops);
-            te_free(expr);
-        } else {
-            return 1;
-        }
+    if (strncmp(option, "--crosscheck=", CROSSCHECK_OPTION_LENGTH)) {
+        return INVALID_COMMAND_LINE_ERROR;
+    }
+    char* end;
+    long long ulps
+            = strtoll(option + CROSSCHECK_OPTION_LENGTH, &end, DECIMAL_BASE);
+    if (*end != '\0' || end == option + CROSSCHECK_OPTION_LENGTH || ulps < 0) {
+        return INVALID_COMMAND_LINE_ERROR;
     }
+    *crosscheck = ulps;
     return 0;
 }
 
-/* Sets up assigment for given variable or loop in @loop by cehcking if variable
- * exists if it doesnt it creates it
+/* Parses and validates --profile or --profile=rows on the command line
  *
- * char* expressionVariable: name of varaible to be made or found
- * int* varaibleIndex: A pointer to the index of the variable to be found or
- * created int* loopIndex: A pointer to index of loop to be found Variables*
- * varaibles: A pointer to variables struct that contains varaibles Loops*
- * loops: A pointer to loops struct that contains loops
+ * char* option: the whole option
+ * int* profileRows: pointer to where the number of lines to report will be
+ * stored, 0 if --profile has not been seen yet
  *
- * Return 0 if successful or 1 if expressionVariable is empty
+ * Returns 0 on success or INVALID_COMMAND_LINE_ERROR if the option is invalid
+ * or already given
  */
-int loop_assignment_setup(char* expressionVariable, int* variableIndex,
-        int* loopIndex, Variables* variables, Loops* loops)
+int download_profile(char* option, int* profileRows)
 {
-    if (!strcmp(" ", expressionVariable)) {
-        return 1;
+    if (*profileRows != 0) {
+        return INVALID_COMMAND_LINE_ERROR;
     }
-    for (int i = 0; i < variables->size; i++) {
-        if (!strcmp(expressionVariable, variables->names[i])) {
-            *variableIndex = i;
-            break;
-        }
+    if (!strcmp(option, "--profile")) {
+        *profileRows = DEFAULT_PROFILE_ROWS;
+        return 0;
     }
-    for (int i = 0; i < loops->size; i++) {
-        if (!strcmp(expressionVariable, loops->names[i])) {
-            *loopIndex = i;
-            break;
-        }
+    if (strncmp(option, "--profile=", PROFILE_OPTION_LENGTH)) {
+        return INVALID_COMMAND_LINE_ERROR;
     }
-    if (*variableIndex == -1 && *loopIndex == -1) {
-        variables->size++;
-        variables->names = (char**)realloc(
-                (void*)variables->names, (variables->size) * sizeof(char*));
-        variables->values = (double*)realloc(
-                (void*)variables->values, (variables->size) * sizeof(double));
-        variables->names[variables->size - 1] = strdup(expressionVariable);
-        variables->values[variables->size - 1] = 0;
-        *variableIndex = variables->size - 1;
+    char* end;
+    long rows = strtol(option + PROFILE_OPTION_LENGTH, &end, DECIMAL_BASE);
+    if (*end != '\0' || end == option + PROFILE_OPTION_LENGTH || rows < 1
+            || rows > MAX_PROFILE_ROWS) {
+        return INVALID_COMMAND_LINE_ERROR;
     }
+    *profileRows = (int)rows;
     return 0;
 }
 
-/* prints result of assignment in loop for variable or loop
- *
- * double value: Computed value thats assigned
- * Loops* loops: Pointer to loop struct that contains loops
- * char* expressionVariable: Name of varaible or loop which is being assigned
- * Variables* variables: Pointer to variables struct which contains variables
- * int loopIndex: index of loop where assignment takes place or -1 if not in
- * loop int variableIndex: index of variables where assignment takes place or -1
- * if not in variables int* sigFigs: pointer to number sig figs to print doubles
- * to int loopVarIndex: Index of the loop variable being iterated over int i:
- * Current iteration of loop
- *
- * Returns 0 when successful
+/* Parses and validates the number of files to run at once following --jobs
+ *
+ * int i: index of string with the option
+ * int numberArguments: number of strings on command line
+ * int* jobs: pointer to where the number will be stored, 0 if --jobs has not
+ * been seen yet
+ * char** arguments: command line strings
+ *
+ * Returns 0 on success or INVALID_COMMAND_LINE_ERROR if the number is missing,
+ * outside 1..MAX_JOBS or --jobs was already given
  */
-int loop_print_assignment(double value, Loops* loops, char* expressionVariable,
-        Variables* variables, int loopIndex, int variableIndex, int* sigFigs,
-        int loopVarIndex, int i)
+int download_jobs(int i, int numberArguments, int* jobs, char** arguments)
 {
-    if (variableIndex == -1) {
-        loops->currentValue[loopIndex] = value;
-    } else {
-        variables->values[variableIndex] = value;
-    }
-    char format[FORMAT_BUFFER_SIZE];
-    snprintf(format, sizeof(format), "%%.%dg", sigFigs[0]);
-    printf("%s = ", expressionVariable);
-    printf(format, value);
-    printf(" when %s = ", loops->names[loopVarIndex]);
-    printf(format,
-            loops->startingValue[loopVarIndex]
-                    + i * loops->increment[loopVarIndex]);
-    printf("\n");
+    if (i + 1 == numberArguments || *jobs != 0) {
+        return INVALID_COMMAND_LINE_ERROR;
+    }
+    char* end;
+    long number = strtol(arguments[i + 1], &end, DECIMAL_BASE);
+    if (*end != '\0' || end == arguments[i + 1] || number < 1
+            || number > MAX_JOBS) {
+        return INVALID_COMMAND_LINE_ERROR;
+    }
+    *jobs = (int)number;
     return 0;
 }
 
-/* Executes the assignment within a loop evaluating expression and assigning its
- * variable to a variable or loop
- *
- * Variables* variables: A pointer to Variables struct containing the variabvles
- * int* sig_figs: Pointer to integer of how many sig figs to print doubles to
- * int loopIndex: Index of the loop where the assignment is occuring
- * int variableIndex: The index of variable to be assigned or -1 if its a loop
- * char* expressionVariable: Name of variable or loop beibng assigned
- * Loops* loops: Pointer to loops struct that contains loops
- * int loopVarIndex Index of the loop variable being iterated over
- * char* expressionExpression The expression to be evaluated and assigned
- *
- * Returns 0 if successful or 1 if error
+/* Parses and validates the number of @loop iterations between progress
+ * reports following --progress
+ *
+ * int i: index of string with the option
+ * int numberArguments: number of strings on command line
+ * long long* progress: pointer to where the number will be stored, 0 if
+ * --progress has not been seen yet
+ * char** arguments: command line strings
+ *
+ * Returns 0 on success or INVALID_COMMAND_LINE_ERROR if the number is missing,
+ * less than 1 or --progress was already given
  */
-int loop_assignment(Variables* variables, int* sigFigs, int loopIndex,
-        int variableIndex, char* expressionVariable, Loops* loops,
-        int loopVarIndex, char* expressionExpression)
+int download_progress(
+        int i, int numberArguments, long long* progress, char** arguments)
 {
-    int repetitions = 1
-            + (int)floor((loops->endValue[loopVarIndex]
-                                 - loops->startingValue[loopVarIndex])
-                    / loops->increment[loopVarIndex]);
-    for (int i = 0; i < repetitions; i++) {
-        loops->currentValue[loopVarIndex] = loops->startingValue[loopVarIndex]
-                + i * loops->increment[loopVarIndex];
-        te_variable tevars[variables->size + loops->size];
-        double values[variables->size + loops->size];
-        int index = 0;
-        for (int i = 0; i < loops->size; i++) {
-            if (strcmp(loops->names[i], " ") != 0) {
-                values[index] = loops->currentValue[i];
-                te_variable var = {.name = loops->names[i],
-                        .address = &(values[index]),
-                        .type = TE_VARIABLE,
-                        .context = NULL};
-                tevars[index] = var;
-                index++;
-            }
-        }
-        for (int i = 0; i < variables->size; i++) {
-            if (strcmp(variables->names[i], " ") != 0) {
-                values[index] = variables->values[i];
-                te_variable var = {.name = variables->names[i],
-                        .address = &(values[index]),
-                        .type = TE_VARIABLE,
-                        .context = NULL};
-                tevars[index] = var;
-                index++;
-            }
-        }
-        int errPos;
-        te_expr* expr
-                = te_compile(expressionExpression, tevars, index, &errPos);
-        if (expr) {
-            double value = te_eval(expr);
-            loop_print_assignment(value, loops, expressionVariable, variables,
-                    loopIndex, variableIndex, sigFigs, loopVarIndex, i);
-            te_free(expr);
-        } else {
-            return 1;
-        }
+    if (i + 1 == numberArguments || *progress != 0) {
+        return INVALID_COMMAND_LINE_ERROR;
+    }
+    char* end;
+    long long number = strtoll(arguments[i + 1], &end, DECIMAL_BASE);
+    if (*end != '\0' || end == arguments[i + 1] || number < 1) {
+        return INVALID_COMMAND_LINE_ERROR;
     }
+    *progress = number;
     return 0;
 }
 
-/* Processes a @loop command executing a loop with expression or assigning a
- * variable / loop with a value
+/* Parses and validates the number of milliseconds following --time-limit
  *
- * char* line: the string representation of the entire loop command
- * Variables* variables: Pointer to variables struct that contains variables
- * Loops* loops: Pointer to loops struct that contains loops
- * int* sigFigs: Pointer to number of sig figs to print doubles to
+ * int i: index of string with the option
+ * int numberArguments: number of strings on command line
+ * long long* timeLimit: pointer to where the number will be stored, 0 if
+ * --time-limit has not been seen yet
+ * char** arguments: command line strings
  *
- * Return 0 uf succesyk or 1 if there is error in syntax
+ * Returns 0 on success or INVALID_COMMAND_LINE_ERROR if the number is missing,
+ * outside 1..MAX_TIME_LIMIT or --time-limit was already given
  */
-int loop(char* line, Variables* variables, Loops* loops, int* sigFigs)
+int download_time_limit(
+        int i, int numberArguments, long long* timeLimit, char** arguments)
 {
-    strtok(line, " ");
-    char* variableName = strtok(NULL, " ");
-    char* expression = strtok(NULL, "");
-    int loopVarIndex = -1;
-    for (int i = 0; i < loops->size; i++) {
-        if (!strcmp(loops->names[i], variableName)) {
-            loopVarIndex = i;
-            loops->currentValue[i] = loops->startingValue[i];
-        }
-    }
-    if (loopVarIndex == -1) {
-        return 1;
+    if (i + 1 == numberArguments || *timeLimit != 0) {
+        return INVALID_COMMAND_LINE_ERROR;
     }
-    int numberEquals = 0;
-    for (int i = 0; i < (int)strlen(expression); i++) {
-        if (expression[i] == '=') {
-            numberEquals++;
-        }
-    }
-    if (numberEquals == 0) {
-        int result = loop_expression(
-                loops, variables, expression, loopVarIndex, sigFigs);
-        if (result != 0) {
-            return result;
-        }
-    } else if (numberEquals == 1) {
-        char* expressionVariable = strtok(expression, "=");
-        char* expressionExpression = strtok(NULL, "");
-        expressionVariable = strtok(expressionVariable, " ");
-        int variableIndex = -1;
-        int loopIndex = -1;
-        int result = loop_assignment_setup(expressionVariable, &variableIndex,
-                &loopIndex, variables, loops);
-        if (result != 0) {
-            return result;
-        }
-        result = loop_assignment(variables, sigFigs, loopIndex, variableIndex,
-                expressionVariable, loops, loopVarIndex, expressionExpression);
-        if (result != 0) {
-            return result;
-        }
-    } else {
-        return 1;
+    char* end;
+    long long number = strtoll(arguments[i + 1], &end, DECIMAL_BASE);
+    if (*end != '\0' || end == arguments[i + 1] || number < 1
+            || number > MAX_TIME_LIMIT) {
+        return INVALID_COMMAND_LINE_ERROR;
     }
+    *timeLimit = number;
     return 0;
 }
 
-/* Detects and process a @range or @print in given line, executing appriopriuate
- * operatio9n
+/* Parses and validates the size following --max-memory, a number of bytes
+ * optionally followed by k, m or g for kibibytes, mebibytes or gibibytes
  *
- * char* line: The string containing the command to process
- * Variable* variable: A pointer to the Variables struct containing variables
- * Loops* loops: A pointer to the loop stsruct containing loops
- * int* sig_figs: Pointer to integer dezxceibing number of sig figs to display
- * doubles
+ * char* size: the size as given on the command line
+ * long long* maxMemory: pointer to where the number of bytes will be stored, 0
+ * if --max-memory has not been seen yet
  *
- * Returns 0 if succesful else 1
+ * Returns 0 on success or INVALID_COMMAND_LINE_ERROR if the size is invalid or
+ * --max-memory was already given
  */
-int detect_range_print(
-        char* line, Variables* variables, Loops* loops, int* sigFigs)
+int download_memory(char* size, long long* maxMemory)
 {
-    char* testString = strdup(line);
-    int testStart = 0;
-    int testEnd = strlen(testString);
-    while (isspace(testString[testStart]) && testStart < testEnd) {
-        testStart++;
-    }
-    while (isspace(testString[testEnd]) && testEnd > testStart) {
-        testEnd--;
-    }
-    memmove(testString, testString + testStart, testEnd - testStart + 1);
-    // REF: Inspired by https://www.geeksforgeeks.org/memmove-in-cc/
-    if (!strcmp(testString, "@print\n")) {
-        print_variables(variables, loops, sigFigs);
-        free(testString);
-        return 1;
-    }
-    int spaceCounter = 0;
-    for (int i = 0; i < (int)strlen(testString); i++) {
-        if (testString[i] == ' ') {
-            spaceCounter++;
-        }
+    if (*maxMemory != 0 || size[0] < '0' || size[0] > '9') {
+        return INVALID_COMMAND_LINE_ERROR;
     }
-    char* rangeTest = strtok(testString, " ");
-    char* rangeExpression = strtok(NULL, " ");
-    if (!strcmp(rangeTest, "@range") && spaceCounter == 1 && line[0] == '@') {
-        int res = range(rangeExpression, variables, loops, sigFigs);
-        if (res != 0) {
-            fprintf(stderr,
-                    "Error in command, expression or assignment "
-                    "operation\n");
+    char* end;
+    long long bytes = strtoll(size, &end, DECIMAL_BASE);
+    const char* units = "kmg";
+    const char* unit = (*end != '\0') ? strchr(units, *end | ' ') : NULL;
+    if (unit != NULL && end[1] == '\0') {
+        for (const char* u = units; u <= unit; u++) {
+            bytes = (bytes > MAX_MEMORY_BYTES) ? bytes : bytes * KILOBYTE;
         }
-        free(testString);
-        return 1;
+    } else if (*end != '\0') {
+        return INVALID_COMMAND_LINE_ERROR;
     }
-    free(testString);
-    return 0;
-}
-
-/* Detects and procces a loop command on given line executing necessary
- * operations if valid loop command is found
- *
- * char* line: the String containing the command to process
- * Variables* variables: A pointer to the variables struct which contains
- * variables Loops* loops: A pointer to the loops struct which contains loops
- * int* sigFigs: pointer to integer describing number of sig figs to print
- * doubles to
- *
- * Return 0 if succesful otherwise 1
- */
-int detect_loops(char* line, Variables* variables, Loops* loops, int* sigFigs)
-{
-    char* testString = strdup(line);
-    if ((int)strlen(testString) > LOOP_LENGTH && testString[0] == '@'
-            && testString[1] == 'l' && testString[2] == 'o'
-            && testString[THIRD_INDEX] == 'o' && testString[FOURTH_INDEX] == 'p'
-            && testString[FIFTH_INDEX] == ' '
-            && isalpha(testString[LOOP_LENGTH])) {
-        int res = loop(testString, variables, loops, sigFigs);
-        if (res != 0) {
-            fprintf(stderr,
-                    "Error in command, expression or assignment "
-                    "operation\n");
-        }
-        free(testString);
-        return 1;
+    if (bytes < 1 || bytes > MAX_MEMORY_BYTES) {
+        return INVALID_COMMAND_LINE_ERROR;
     }
-    free(testString);
+    *maxMemory = bytes;
     return 0;
 }
 
-/* Assigns a value to variable or loop and prints the result
+/* Determines if file can be opened
  *
- * char* variableName: the name of the variable or loop to be assigned the value
- * int* finished: A pointer to an integer that will be set to 1 once assignment
- * is complete Variables* variables: Pointer to variables struct that contains
- * variables Loops* loops: Pointer to loops struct that contains loops int*
- * sigFigs: Pointer to integer describing number of sig figs to print doubles to
- * double value: The value to be assigned to the variabl;e or loop
+ * const char* fileName: name of the file
  *
- * Return 0
+ * Returns 0 if success otherwise FILE_DOES_NOT_OPEN_ERROR
  */
-int download_assignment_print(char* variableName, int* finished,
-        Variables* variables, Loops* loops, int* sigFigs, double value)
+int check_open_file(const char* fileName)
 {
-    for (int i = 0; i < variables->size; i++) {
-        if (strcmp(variableName, variables->names[i]) == 0) {
-            variables->values[i] = value;
-            char format[FORMAT_BUFFER_SIZE];
-            snprintf(format, sizeof(format), "%%.%dg", sigFigs[0]);
-            printf("%s = ", variables->names[i]);
-            printf(format, variables->values[i]);
-            printf("\n");
-            *finished = 1;
-            break;
-        }
-    }
-    for (int i = 0; i < loops->size; i++) {
-        if (strcmp(variableName, loops->names[i]) == 0) {
-            loops->currentValue[i] = value;
-            char format[FORMAT_BUFFER_SIZE];
-            snprintf(format, sizeof(format), "%%.%dg", sigFigs[0]);
-            printf("%s = ", loops->names[i]);
-            printf(format, loops->currentValue[i]);
-            printf("\n");
-            *finished = 1;
-            break;
-        }
+    FILE* file = fopen(fileName, "r");
+    if (file == NULL) {
+        return FILE_DOES_NOT_OPEN_ERROR;
     }
+    fclose(file);
     return 0;
 }
 
-/* Assigns a value to a variable and prints the result
- *
- * Variables* variables: Pointer to variables struct which contains variables
- * char* variablename: Name of varaible or loop to be assigned
- * int* sigFigs: number of sig figs to print doubles to
- * double value: The value to be assigned to the varaible or loop
- *
- * Returns 0
- */
-int download_allocate_variable(
-        Variables* variables, char* variableName, int* sigFigs, double value)
-{
-    variables->size++;
-    variables->names = (char**)realloc(
-            (void*)variables->names, variables->size * sizeof(char*));
-    variables->values = (double*)realloc(
-            (void*)variables->values, variables->size * sizeof(double));
-    variables->names[variables->size - 1] = strdup(variableName);
-    variables->values[variables->size - 1] = value;
-    char format[FORMAT_BUFFER_SIZE];
-    snprintf(format, sizeof(format), "%%.%dg", sigFigs[0]);
-    printf("%s = ", variables->names[variables->size - 1]);
-    printf(format, variables->values[variables->size - 1]);
-    printf("\n");
-    return 0;
-}
-
-/* Evaluated an expression and assigns its result to a variable or loop
- *
- * Loops* loops: A pointer to loops struct which contains in loops
- * Variables* variable: A pointer to variables struct which contains variables
- * char* expression: A string containing the expression to be evaluated
- * char* variableName: The same of the variatable to which the expression's
- * result will be assigned
- *
- * Return 0 if succesful else 1
- */
-int download_assignment(Loops* loops, Variables* variables, char* expression,
-        char* variableName, int* sigFigs)
-{
-    te_variable tevars[variables->size + loops->size];
-    double values[variables->size + loops->size];
-    int index = 0;
-    for (int i = 0; i < variables->size; i++) {
-        if (strcmp(variables->names[i], " ") != 0) {
-            values[index] = variables->values[i];
-            te_variable var = {.name = variables->names[i],
-                    .address = &(values[index]),
-                    .type = TE_VARIABLE,
-                    .context = NULL};
-            tevars[index] = var;
-            index++;
-        }
-    }
-    for (int i = 0; i < loops->size; i++) {
-        if (strcmp(loops->names[i], " ") != 0) {
-            values[index] = loops->currentValue[i];
-            te_variable var = {.name = loops->names[i],
-                    .address = &(values[index]),
-                    .type = TE_VARIABLE,
-                    .context = NULL};
-            tevars[index] = var;
-            index++;
-        }
-    }
-    int errPos;
-    te_expr* expr = te_compile(expression, tevars, index, &errPos);
-    int finished = 0;
-    if (expr) {
-        double value = te_eval(expr);
-        te_free(expr);
-        download_assignment_print(
-                variableName, &finished, variables, loops, sigFigs, value);
-        if (!finished) {
-            download_allocate_variable(variables, variableName, sigFigs, value);
-        }
-    } else {
-        fprintf(stderr,
-                "Error in command, expression or assignment "
-                "operation\n");
-        return 1;
-    }
-    return 0;
-}
 
-/* Evaluated a mathematical expression using current values of varaibles and
- * loops
+/* Reads a whole line of input as getline() does, however long it is,
+ * recording the time it takes as a read span when the run is traced
  *
- * Variables* variables: Pointer to variables struct whyich contains varaibles
- * Loops* loops: Pointer to loops struct which contains loops
- * char* line: A string representation of expression to be evaluated
- * int* sigFigs: pointer to Number of signifciant figures to print double to
+ * char** line: pointer to the buffer to read into, NULL to start, grown as
+ * needed and freed by the caller
+ * size_t* size: pointer to the number of bytes in the buffer, 0 to start
+ * FILE* file: file to read from
+ * UqTrace* trace: trace of the calling thread, or NULL if it is not traced
  *
- * return 0
+ * Returns the line or NULL once there is no more input
  */
-int download_expression(
-        Variables* variables, Loops* loops, char* line, int* sigFigs)
+char* read_line(char** line, size_t* size, FILE* file, UqTrace* trace)
 {
-    te_variable tevars[variables->size + loops->size];
-    double values[variables->size + loops->size];
-    int index = 0;
-    for (int i = 0; i < variables->size; i++) {
-        if (strcmp(variables->names[i], " ") != 0) {
-            values[index] = variables->values[i];
-            te_variable var = {.name = variables->names[i],
-                    .address = &(values[index]),
-                    .type = TE_VARIABLE,
-                    .context = NULL};
-            tevars[index] = var;
-            index++;
-        }
-    }
-    for (int i = 0; i < loops->size; i++) {
-        if (strcmp(loops->names[i], " ") != 0) {
-            values[index] = loops->currentValue[i];
-            te_variable var = {.name = loops->names[i],
-                    .address = &(values[index]),
-                    .type = TE_VARIABLE,
-                    .context = NULL};
-            tevars[index] = var;
-            index++;
-        }
-    }
-    int errPos;
-    te_expr* expr = te_compile(line, tevars, index, &errPos);
-    if (expr) {
-        double res = te_eval(expr);
-        char format[FORMAT_BUFFER_SIZE];
-        snprintf(format, sizeof(format), "%%.%dg", sigFigs[0]);
-        printf("Result = ");
-        printf(format, res);
-        printf("\n");
-        te_free(expr);
-    } else {
-        fprintf(stderr,
-                "Error in command, expression or assignment "
-                "operation\n");
+    long long start = (trace != NULL) ? stats_now() : 0;
+    ssize_t length = getline(line, size, file);
+    if (trace != NULL) {
+        uq_trace_span(trace, "read", start, stats_now());
     }
-    return 0;
+    return (length < 0) ? NULL : *line;
 }
 
-/* Counts number of equals and # chaarcters in a line to disregard comments and
- * determine validity
+/* Reads one line from the live command line and executes it
  *
- * char* line A string representration of input to analyse
- * int* numberEquals: A pointer that stores number of equals signs
+ * UqContext* context: context the line is executed in
  *
- * Return 0 if succesful, 1 if line has a comment
+ * Return 0, or 1 once there is no more input
  */
-int download_setup(char* line, int* numberEquals)
+int download_live_command_line(UqContext* context)
 {
-    int length = strlen(line);
-    for (int i = 0; i < length; i++) {
-        if (line[i] == '=') {
-            (*numberEquals)++;
-        }
-    }
-    int numberHash = 0;
-    for (int i = 0; i < length; i++) {
-        if (line[i] == '#') {
-            numberHash++;
-        }
-    }
-    if (numberHash > 0) {
+    char* line = NULL;
+    size_t size = 0;
+    if (read_line(&line, &size, stdin, runTrace) == NULL) {
+        free((void*)line);
         return 1;
     }
+    uq_execute(context, line);
+    free((void*)line);
     return 0;
 }
 
-/* Checks if given variable name is valid
- *
- * char* variableName: String representation of name of variable to check
+/* Compares two profiled lines for qsort(), costliest first
  *
- * Return 0 if valid, else 1
+ * Returns a negative number, 0 or a positive number as a took more, the same or
+ * less time than b
  */
-int download_assignment_check_valid(char* variableName)
+int profile_compare(const void* a, const void* b)
 {
-    int length = strlen(variableName);
-    int check = 0;
-    for (int i = 0; i < length; i++) {
-        if (!isalpha((unsigned char)variableName[i])) {
-            check = 1;
-        }
-    }
-    if (strlen(variableName) < 1
-            || strlen(variableName) > MAX_VARIABLE_LENGTH) {
-        check = 1;
-    }
-    if (check) {
-        fprintf(stderr,
-                "Error in command, expression or assignment "
-                "operation\n");
-        return 1;
+    const ProfileLine* first = (const ProfileLine*)a;
+    const ProfileLine* second = (const ProfileLine*)b;
+    if (first->nanoseconds != second->nanoseconds) {
+        return (first->nanoseconds < second->nanoseconds) ? 1 : -1;
     }
-    return 0;
+    return first->lineNumber - second->lineNumber;
 }
 
-/* Processes and executes a live command line by reading from command line
- * detecting special command and handling variable assignments or expressions
+/* Writes the costliest lines of a profiled file, most expensive first, with
+ * the average time per iteration of @loop lines
  *
- * Variables* varaibles: A pointer to variable struct which contains variables
- * Loops* loops: A pointer to loops struct which contains loops
- * int* sigFigs: Pointer to number of sig figs to print doubles to
- *
- * Return 0
+ * ProfileLine* lines: every line of the file, sorted in place
+ * int numberLines: number of lines
+ * int rows: maximum number of lines to report
+ * FILE* report: file the report is written to
  */
-int download_live_command_line(Variables* variables, Loops* loops, int* sigFigs)
+void profile_report(
+        ProfileLine* lines, int numberLines, int rows, FILE* report)
 {
-    char line[LINE_BUFFER];
-    if (fgets(line, sizeof(line), stdin) != NULL) {
-        int numberEquals = 0;
-        int result = download_setup(line, &numberEquals);
-        if (result != 0) {
-            return 0;
-        }
-        result = detect_range_print(line, variables, loops, sigFigs);
-        if (result != 0) {
-            return 0;
+    long long total = 0;
+    for (int i = 0; i < numberLines; i++) {
+        total += lines[i].nanoseconds;
+    }
+    qsort(lines, numberLines, sizeof(ProfileLine), profile_compare);
+    rows = (rows < numberLines) ? rows : numberLines;
+    fprintf(report,
+            "uqexpr profile: %d lines in %.3f ms, top %d by time\n"
+            "%6s %11s %6s %10s %10s %10s %11s  %s\n",
+            numberLines, (double)total / NANOSECONDS_PER_MILLISECOND, rows,
+            "line", "time ms", "share", "evals", "iters", "output", "us/iter",
+            "text");
+    for (int i = 0; i < rows; i++) {
+        ProfileLine* line = &(lines[i]);
+        char perIteration[NUMBER_BUFFER] = "-";
+        if (line->loopIterations > 0) {
+            snprintf(perIteration, sizeof(perIteration), "%.3f",
+                    (double)line->nanoseconds / line->loopIterations
+                            / NANOSECONDS_PER_MICROSECOND);
         }
-        result = detect_loops(line, variables, loops, sigFigs);
-        if (result != 0) {
-            return 0;
-        }
-        if (numberEquals == 1) {
-            char* variableName = strtok(line, "=");
-            char* expression = strtok(NULL, "=");
-            int start = 0;
-            int end = strlen(variableName) - 1;
-            while (isspace(variableName[start]) && start < end) {
-                start++;
-            }
-            while (isspace(variableName[end]) && end > start) {
-                end--;
-            }
-            memmove(variableName, variableName + start, end - start + 1);
-            variableName[end - start + 1] = '\0';
-            int result = download_assignment_check_valid(variableName);
-            if (result != 0) {
-                return 0;
-            }
-            result = download_assignment(
-                    loops, variables, expression, variableName, sigFigs);
-            if (result != 0) {
-                return 0;
-            }
-        } else if (numberEquals == 0) {
-            download_expression(variables, loops, line, sigFigs);
-        }
-    } else {
-        return 1;
+        int length = strlen(line->text);
+        fprintf(report,
+                "%6d %11.3f %5.1f%% %10lld %10lld %10lld %11s  %.*s%s\n",
+                line->lineNumber,
+                (double)line->nanoseconds / NANOSECONDS_PER_MILLISECOND,
+                total ? PERCENT * line->nanoseconds / total : 0.0,
+                line->evaluations, line->loopIterations, line->outputBytes,
+                perIteration, PROFILE_TEXT_WIDTH, line->text,
+                (length > PROFILE_TEXT_WIDTH) ? "..." : "");
     }
-    return 0;
 }
 
-/* Executes @print command printing all defined variables and loop variables
+/* Reads a file executing each line as download_file() does, measuring the
+ * wall time, evaluations, @loop iterations and output of every line, and
+ * reports the costliest lines once the file is finished
  *
- * Variables* variables: A pointer to variable struct which contains variables
- * Loops* loops: A pointer to loops struct which contains loops
- * int* sigFigs: A pointer to number of sig figs to print doubles to
+ * FILE* file: file to read
+ * int rows: number of lines to report
+ * UqContext* context: context the lines are executed in
+ * UqStats* stats: counters the context's work is added to
+ * UqTrace* trace: trace of the calling thread, or NULL if it is not traced
+ * FILE* report: file the report is written to
  *
- * Return 0
+ * return 0
  */
-int print_variables(Variables* variables, Loops* loops, int* sigFigs)
+int profile_file(FILE* file, int rows, UqContext* context, UqStats* stats,
+        UqTrace* trace, FILE* report)
 {
-    if (variables->size - variables->converted == 0) {
-        printf("No variables were defined.\n");
-    } else {
-        printf("Variables:\n");
-        for (int j = 0; j < variables->size; j++) {
-            if (strcmp(variables->names[j], " ")) {
-                char format[FORMAT_BUFFER_SIZE];
-                snprintf(format, sizeof(format), "%%.%dg", sigFigs[0]);
-                printf("%s = ", variables->names[j]);
-                printf(format, variables->values[j]);
-                printf("\n");
-            }
-        }
-    }
-    if (loops->size == 0) {
-        printf("No loop variables were defined.\n");
-    } else {
-        printf("Loop variables:\n");
-        for (int j = 0; j < loops->size; j++) {
-            char format[FORMAT_BUFFER_SIZE];
-            snprintf(format, sizeof(format), "%%.%dg", sigFigs[0]);
-            printf("%s = ", loops->names[j]);
-            printf(format, loops->currentValue[j]);
-            printf(" (");
-            printf(format, loops->startingValue[j]);
-            printf(", ");
-            printf(format, loops->increment[j]);
-            printf(", ");
-            printf(format, loops->endValue[j]);
-            printf(")\n");
-        }
-    }
+    char* line = NULL;
+    size_t size = 0;
+    ProfileLine* lines = (ProfileLine*)malloc(sizeof(ProfileLine));
+    int numberLines = 0;
+    uq_set_stats(context, stats);
+    while (read_line(&line, &size, file, trace) != NULL) {
+        UqStats before = *stats;
+        long long start = stats_now();
+        uq_execute(context, line);
+        long long end = stats_now();
+        numberLines++;
+        lines = (ProfileLine*)realloc(
+                (void*)lines, numberLines * sizeof(ProfileLine));
+        ProfileLine* profile = &(lines[numberLines - 1]);
+        line[strcspn(line, "\r\n")] = '\0';
+        profile->lineNumber = numberLines;
+        profile->text = strdup(line);
+        profile->nanoseconds = end - start;
+        profile->evaluations = stats->evaluations - before.evaluations;
+        profile->loopIterations
+                = stats->loopIterations - before.loopIterations;
+        profile->outputBytes = stats->outputBytes - before.outputBytes;
+    }
+    free((void*)line);
+    fflush(stdout);
+    profile_report(lines, numberLines, rows, report);
+    for (int i = 0; i < numberLines; i++) {
+        free((void*)lines[i].text);
+    }
+    free((void*)lines);
     return 0;
 }
 
-/* Reads a file processing each line interpreting it as commands or for
- * executing variable assignments, expressions, range printing or loop detection
- * etc
+/* Reads a file executing each line as a command, assignment or expression
  *
  * Information* information: A pointer to information struct that contains file
- * name Variables* variables: A pointer to variables struct which contains
- * variables Loops* loops: A pointer to loops struct which contains loops int*
- * sigFigs: A pointer to number of sig figs to print doubles to
+ * name UqContext* context: context the lines are executed in
  *
  * return 0
  */
-int download_file(Information* information, Variables* variables, Loops* loops,
-        int* sigFigs)
+int download_file(Information* information, UqContext* context)
 {
     FILE* file = fopen(information->fileName, "r");
-    char line[LINE_BUFFER];
-    while (fgets(line, sizeof(line), file) != NULL) {
-        int numberEquals = 0;
-        int result = download_setup(line, &numberEquals);
-        if (result != 0) {
-            continue;
-        }
-        result = detect_range_print(line, variables, loops, sigFigs);
-        if (result != 0) {
-            continue;
-        }
-        result = detect_loops(line, variables, loops, sigFigs);
-        if (result != 0) {
-            continue;
-        }
-        if (numberEquals == 1) {
-            char* variableName = strtok(line, "=");
-            char* expression = strtok(NULL, "=");
-            int start = 0;
-            int end = strlen(variableName) - 1;
-            while (isspace(variableName[start]) && start < end) {
-                start++;
-            }
-            while (isspace(variableName[end]) && end > start) {
-                end--;
-            }
-            memmove(variableName, variableName + start, end - start + 1);
-            variableName[end - start + 1] = '\0';
-            int result = download_assignment_check_valid(variableName);
-            if (result != 0) {
-                continue;
-            }
-            result = download_assignment(
-                    loops, variables, expression, variableName, sigFigs);
-            if (result != 0) {
-                continue;
-            }
-        } else if (numberEquals == 0) {
-            download_expression(variables, loops, line, sigFigs);
-        }
-        memset(line, 0, sizeof(line));
-    }
+    if (information->profileRows > 0) {
+        profile_file(file, information->profileRows, context, &runStats,
+                runTrace, stderr);
+        fclose(file);
+        return 0;
+    }
+    char* line = NULL;
+    size_t size = 0;
+    while (read_line(&line, &size, file, runTrace) != NULL) {
+        uq_execute(context, line);
+    }
+    free((void*)line);
     fclose(file);
     return 0;
 }
@@ -1419,41 +1198,23 @@ int download_file(Information* information, Variables* variables, Loops* loops,
  * Information* information: a structure containing file names, variable styring
  * and loop strings from the command line int* numberVariables: a pointer to
  * number of variables from command line int* numberLoops: a pointer to number
- * of loops from command line Variables* variables: A poointer to variables
- * struct which contains variables Loops* loops: A pointer to loops struct which
- * contains loops
+ * of loops from command line UqContext* context: context holding the variables
+ * and loops
  *
  * Returns 0
  */
 int free_memory(int* sigFigs, Information* information, int* numberVariables,
-        int* numberLoops, Variables* variables, Loops* loops)
+        int* numberLoops, UqContext* context)
 {
     free((void*)sigFigs);
     free((void*)information->fileName);
+    free((void*)information->inputFiles);
     free((void*)information->variableStrings);
     free((void*)information->loopsStrings);
     free((void*)information);
     free((void*)numberVariables);
     free((void*)numberLoops);
-    for (int i = 0; i < variables->size; i++) {
-        if (variables->names[i]) {
-            free((void*)variables->names[i]);
-        }
-    }
-    free((void*)variables->names);
-    free((void*)variables->values);
-    free((void*)variables);
-    for (int i = 0; i < loops->size; i++) {
-        if (loops->names[i]) {
-            free((void*)loops->names[i]);
-        }
-    }
-    free((void*)loops->names);
-    free((void*)loops->startingValue);
-    free((void*)loops->currentValue);
-    free((void*)loops->increment);
-    free((void*)loops->endValue);
-    free((void*)loops);
+    uq_destroy(context);
     return 0;
 }
 
@@ -1467,121 +1228,852 @@ int free_memory(int* sigFigs, Information* information, int* numberVariables,
  * strings from command line and file name int* numberVariables: A pointer to
  * integer tracking number of variables on initial command line int*
  * numberLoops: Pointer to int tracking numbver of loops on initial command line
- * Variables* variabvles: Popinter to variables struct which contains varaibles
- * Loops* loops: Pointer to loops struct which contains loops
+ * UqContext* context: context the variables and loops are added to
  *
  * Return 0 if success, INVALID_COMMAND_LINE_ERROR if commandline is invalid
  * format, FILE_DOES_NOT_EXOST if inoput file is provided but cannot be
- * openeing, INVALID_VARIABLES_ERROR if invalid variables are encountered and
- * DUPLICATE_VARIABLES_ERROR if duplicate variable names are used on command
- * line
+ * openeing, UQ_INVALID_VARIABLES_ERROR if invalid variables are encountered
+ * , UQ_DUPLICATE_VARIABLES_ERROR if duplicate variable names are used on
+ * command line, UQ_SNAPSHOT_ERROR if the --restore snapshot cannot be
+ * restored and UQ_CROSSCHECK_ERROR if the --crosscheck cannot be started
  */
 int run_initial_command_line(int argc, char* argv[], int* sigFigs,
         Information* information, int* numberVariables, int* numberLoops,
-        Variables* variables, Loops* loops)
+        UqContext* context)
 {
     int result = download_command_line(
             argc, argv, sigFigs, information, numberVariables, numberLoops);
     if (result == INVALID_COMMAND_LINE_ERROR) {
         free_memory(sigFigs, information, numberVariables, numberLoops,
-                variables, loops);
+                context);
         fprintf(stderr,
                 "Usage: ./uqexpr [--loopable string] [--define string] "
-                "[--significantfigures 2..8] [inputfilename]\n");
+                "[--significantfigures 2..8] [--output=text|tsv|binary] "
+                "[--math=exact|fast] [--precision=double|float] "
+                "[--engine=tree|vector] [--crosscheck[=ulps]] "
+                "[--columns datafile --eval expression] [--serve socket | "
+                "--connect socket] [--restore snapshot] "
+                "[--compile script -o image] [--aot script [--verify]] "
+                "[--stats] [--profile[=rows]] [--trace tracefile] "
+                "[--max-memory bytes[k|m|g]] [--progress n] "
+                "[--time-limit ms] [--jobs n] [--split-output] "
+                "[inputfilename ...]\n");
         return INVALID_COMMAND_LINE_ERROR;
     }
-    if (information->fileName != NULL && strcmp(information->fileName, "")) {
-        result = check_open_file(information);
+    for (int i = 0; i < information->numberFiles; i++) {
+        result = check_open_file(information->inputFiles[i]);
         if (result == FILE_DOES_NOT_OPEN_ERROR) {
             fprintf(stderr, "uqexpr: can't open file \"%s\" for reading\n",
-                    information->fileName);
+                    information->inputFiles[i]);
             free_memory(sigFigs, information, numberVariables, numberLoops,
-                    variables, loops);
+                    context);
             return FILE_DOES_NOT_OPEN_ERROR;
         }
     }
-    result = decode_variable_strings(variables, information, numberVariables);
-    int resultTwo
-            = decode_loops_strings(loops, information, numberLoops, variables);
-    if (result == INVALID_VARIABLES_ERROR
-            || resultTwo == INVALID_VARIABLES_ERROR) {
+    char* checkFile = information->columnsFile;
+    if (information->compileSource != NULL) {
+        checkFile = information->compileSource;
+    } else if (information->aotSource != NULL) {
+        checkFile = information->aotSource;
+    }
+    if (checkFile != NULL) {
+        FILE* file = fopen(checkFile, "r");
+        if (file == NULL) {
+            fprintf(stderr, "uqexpr: can't open file \"%s\" for reading\n",
+                    checkFile);
+            free_memory(sigFigs, information, numberVariables, numberLoops,
+                    context);
+            return FILE_DOES_NOT_OPEN_ERROR;
+        }
+        fclose(file);
+    }
+    if (information->traceFile != NULL) {
+        runTraceFile = fopen(information->traceFile, "w");
+        if (runTraceFile == NULL) {
+            fprintf(stderr, "uqexpr: can't open file \"%s\" for writing\n",
+                    information->traceFile);
+            free_memory(sigFigs, information, numberVariables, numberLoops,
+                    context);
+            return FILE_DOES_NOT_OPEN_ERROR;
+        }
+    }
+    if (information->restoreFile != NULL) {
+        result = uq_restore(context, information->restoreFile);
+        if (result == UQ_SNAPSHOT_ERROR) {
+            fprintf(stderr, "uqexpr: can't restore snapshot \"%s\"\n",
+                    information->restoreFile);
+            free_memory(sigFigs, information, numberVariables, numberLoops,
+                    context);
+            return UQ_SNAPSHOT_ERROR;
+        }
+    }
+    if (*sigFigs != 0) {
+        uq_set_sig_figs(context, *sigFigs);
+    }
+    uq_set_output_mode(context, information->outputMode);
+    uq_set_math(context, information->math);
+    uq_set_precision(context, information->precision);
+    uq_set_memory_limit(context, information->maxMemory);
+    uq_set_progress(context, information->progress);
+    uq_set_time_limit(context, information->timeLimit);
+    uq_set_engine(context, information->engine);
+    result = decode_variable_strings(context, information, numberVariables);
+    int resultTwo = decode_loops_strings(context, information, numberLoops);
+    if (result == UQ_INVALID_VARIABLES_ERROR
+            || resultTwo == UQ_INVALID_VARIABLES_ERROR) {
         free_memory(sigFigs, information, numberVariables, numberLoops,
-                variables, loops);
+                context);
         fprintf(stderr, "uqexpr: invalid variable(s) were found\n");
-        return INVALID_VARIABLES_ERROR;
+        return UQ_INVALID_VARIABLES_ERROR;
     }
-    if (result == DUPLICATE_VARIABLES_ERROR
-            || resultTwo == DUPLICATE_VARIABLES_ERROR) {
+    if (result == UQ_DUPLICATE_VARIABLES_ERROR
+            || resultTwo == UQ_DUPLICATE_VARIABLES_ERROR) {
         free_memory(sigFigs, information, numberVariables, numberLoops,
-                variables, loops);
+                context);
         fprintf(stderr, "uqexpr: one or more variables are duplicated\n");
-        return DUPLICATE_VARIABLES_ERROR;
+        return UQ_DUPLICATE_VARIABLES_ERROR;
+    }
+    if (information->crosscheck != -1) {
+        runCrosscheck = uq_crosscheck_create(information->crosscheck, stderr);
+        if (runCrosscheck == NULL) {
+            free_memory(sigFigs, information, numberVariables, numberLoops,
+                    context);
+            fprintf(stderr, "uqexpr: can't start the crosscheck\n");
+            return UQ_CROSSCHECK_ERROR;
+        }
+        uq_set_crosscheck(context, runCrosscheck);
     }
     return 0;
 }
 
+/* Prints the welcome banner listing the variables and loop variables defined
+ * on the command line
+ *
+ * UqContext* context: context holding the variables and loops
+ *
+ * Return 0
+ */
+int print_banner(UqContext* context)
+{
+    printf("Welcome to uqexpr!\nWritten by s4809233.\n");
+    uq_print(context);
+    return 0;
+}
+
 /* Manages reading a file or user input in live command line, for both computes
  * expressions, completes assignments and runs special functions like @range,
  * @loops, @print
  *
- * Variables* variables: A pointer to variables struct which contains variables
+ * UqContext* context: context the input is executed in
  * int* sigFigs: A pointer to integer which determines number of sig figs to
- * print doubles to Loops* loops: A pointer to loops struct which contains loops
- * Information* information: Pointer to Information struct which contains file
- * name, and variable and loop strings from command line int* numberVariables:
- * pointer to number of variables detected on command line initially int*
- * numberLoops: pointer to number of loops detected on command line initially
- *
- * Return 0
+ * print doubles to Information* information: Pointer to Information struct
+ * which contains file name, and variable and loop strings from command line
+ * int* numberVariables: pointer to number of variables detected on command
+ * line initially int* numberLoops: pointer to number of loops detected on
+ * command line initially
+ *
+ * In the tsv and binary output modes the banner, prompt and closing message
+ * are left out so that stdout holds only the @loop rows. An input file ending
+ * in .uqc is run as a compiled script and an --aot script as native code
+ *
+ * Return 0 or UQ_SCRIPT_ERROR if a .uqc input file is not a compiled script
+ * or --verify found native results that differ from the interpreter
  */
-int run_program(Variables* variables, int* sigFigs, Loops* loops,
-        Information* information, int* numberVariables, int* numberLoops)
+int run_program(UqContext* context, int* sigFigs, Information* information,
+        int* numberVariables, int* numberLoops)
 {
-    printf("Welcome to uqexpr!\nWritten by s4809233.\n");
-    if (variables->size == 0) {
-        printf("No variables were defined.\n");
+    int text = information->outputMode == UQ_OUTPUT_TEXT;
+    if (text) {
+        print_banner(context);
+    }
+    int result = 0;
+    int length = strlen(information->fileName);
+    int extension = strlen(COMPILED_EXTENSION);
+    if (information->aotSource != NULL) {
+        result = uq_run_native(
+                context, information->aotSource, information->verify);
+    } else if (length > extension
+            && !strcmp(information->fileName + length - extension,
+                    COMPILED_EXTENSION)) {
+        result = uq_run_compiled(context, information->fileName);
+        if (result != 0) {
+            fprintf(stderr, "uqexpr: \"%s\" is not a compiled script\n",
+                    information->fileName);
+        }
+    } else if (strcmp(information->fileName, "")) {
+        download_file(information, context);
     } else {
-        printf("Variables:\n");
-        char format[FORMAT_BUFFER_SIZE];
-        snprintf(format, sizeof(format), "%%.%dg", sigFigs[0]);
-        for (int i = 0; i < variables->size; i++) {
-            printf("%s = ", variables->names[i]);
-            printf(format, variables->values[i]);
-            printf("\n");
+        if (text) {
+            printf("Please enter your expressions and assignment "
+                   "operations.\n");
+        }
+        int tracker = 0;
+        while (tracker == 0) {
+            tracker = download_live_command_line(context);
+        }
+    }
+    if (text) {
+        printf("Thank you for using uqexpr.\n");
+    }
+    free_memory(sigFigs, information, numberVariables, numberLoops, context);
+    return result;
+}
+
+/* Appends bytes to a growable buffer
+ *
+ * char** buffer: pointer to the buffer, reallocated as needed
+ * size_t* length: pointer to the number of bytes in the buffer
+ * size_t* capacity: pointer to the number of bytes allocated
+ * const char* text: bytes to append
+ * size_t count: number of bytes to append
+ *
+ * Returns 0
+ */
+int job_append(char** buffer, size_t* length, size_t* capacity,
+        const char* text, size_t count)
+{
+    if (*length + count > *capacity) {
+        while (*length + count > *capacity) {
+            *capacity = (*capacity == 0) ? LINE_BUFFER : *capacity * 2;
         }
+        *buffer = (char*)realloc((void*)*buffer, *capacity);
     }
-    if (loops->size == 0) {
-        printf("No loop variables were defined.\n");
+    memcpy(*buffer + *length, text, count);
+    *length += count;
+    return 0;
+}
+
+/* Receives the output of one file's context. Results go straight to the
+ * file's .out file with --split-output, straight to stdout once the files
+ * before it have been written, and are otherwise held until then, in a
+ * temporary file once the run holds JOB_OUTPUT_LIMIT bytes in memory. Errors,
+ * including --progress reports, go straight to stderr once the files before
+ * it have been written and are held until then
+ *
+ * void* data: the FileJob
+ * int stream: UQ_STREAM_OUTPUT or UQ_STREAM_ERROR
+ * const char* text: output bytes
+ * size_t length: number of bytes in text
+ */
+void job_output(void* data, int stream, const char* text, size_t length)
+{
+    FileJob* job = (FileJob*)data;
+    FileQueue* queue = job->queue;
+    if (stream == UQ_STREAM_ERROR) {
+        pthread_mutex_lock(&(queue->lock));
+        if (job->streaming) {
+            pthread_mutex_unlock(&(queue->lock));
+            fflush(stdout);
+            fwrite(text, 1, length, stderr);
+            return;
+        }
+        job_append(&(job->errors), &(job->errorsLength),
+                &(job->errorsCapacity), text, length);
+        pthread_mutex_unlock(&(queue->lock));
+        return;
+    }
+    if (job->outFile != NULL) {
+        fwrite(text, 1, length, job->outFile);
+        return;
+    }
+    pthread_mutex_lock(&(queue->lock));
+    if (job->streaming) {
+        pthread_mutex_unlock(&(queue->lock));
+        fwrite(text, 1, length, stdout);
+        return;
+    }
+    if (job->spill == NULL && queue->buffered + length > JOB_OUTPUT_LIMIT) {
+        job->spill = tmpfile();
+    }
+    if (job->spill != NULL) {
+        fwrite(text, 1, length, job->spill);
     } else {
-        printf("Loop variables:\n");
-        char format[FORMAT_BUFFER_SIZE];
-        snprintf(format, sizeof(format), "%%.%dg", sigFigs[0]);
-        for (int i = 0; i < loops->size; i++) {
-            printf("%s = ", loops->names[i]);
-            printf(format, loops->currentValue[i]);
-            printf(" (");
-            printf(format, loops->startingValue[i]);
-            printf(", ");
-            printf(format, loops->increment[i]);
-            printf(", ");
-            printf(format, loops->endValue[i]);
-            printf(")\n");
+        job_append(&(job->output), &(job->outputLength),
+                &(job->outputCapacity), text, length);
+        queue->buffered += length;
+    }
+    pthread_mutex_unlock(&(queue->lock));
+}
+
+/* Writes the results and errors a file has held to stdout and stderr and
+ * lets the rest be written as they arrive. Called with the queue's lock held
+ * once every file before it has been written
+ *
+ * FileJob* job: the file whose turn it is
+ */
+void job_release(FileJob* job)
+{
+    if (job->outputLength > 0) {
+        fwrite(job->output, 1, job->outputLength, stdout);
+        job->queue->buffered -= job->outputLength;
+        free((void*)job->output);
+        job->output = NULL;
+        job->outputLength = 0;
+        job->outputCapacity = 0;
+    }
+    if (job->spill != NULL) {
+        char buffer[SPILL_BUFFER];
+        size_t count;
+        rewind(job->spill);
+        while ((count = fread(buffer, 1, sizeof(buffer), job->spill)) > 0) {
+            fwrite(buffer, 1, count, stdout);
         }
+        fclose(job->spill);
+        job->spill = NULL;
     }
-    if (strcmp(information->fileName, "")) {
-        download_file(information, variables, loops, sigFigs);
+    if (job->errorsLength > 0) {
+        fflush(stdout);
+        fwrite(job->errors, 1, job->errorsLength, stderr);
+        job->errorsLength = 0;
+    }
+    job->streaming = 1;
+}
+
+/* Runs one input file in its own context, producing the same output as
+ * running the file on its own
+ *
+ * FileJob* job: the file to run
+ * UqContext* context: context cloned from the command line definitions
+ * int text: 1 if the results are framed by the banner and closing message
+ *
+ * Returns 0 or UQ_SCRIPT_ERROR if a .uqc file is not a compiled script
+ */
+int job_run(FileJob* job, UqContext* context, int text)
+{
+    FileQueue* queue = job->queue;
+    uq_set_output(context, job_output, job);
+    if (text) {
+        const char* banner = "Welcome to uqexpr!\nWritten by s4809233.\n";
+        job_output(job, UQ_STREAM_OUTPUT, banner, strlen(banner));
+        uq_print(context);
+    }
+    int result = 0;
+    int length = strlen(job->fileName);
+    int extension = strlen(COMPILED_EXTENSION);
+    if (length > extension
+            && !strcmp(job->fileName + length - extension,
+                    COMPILED_EXTENSION)) {
+        result = uq_run_compiled(context, job->fileName);
+        if (result != 0) {
+            char message[LINE_BUFFER];
+            snprintf(message, sizeof(message),
+                    "uqexpr: \"%s\" is not a compiled script\n",
+                    job->fileName);
+            job_output(job, UQ_STREAM_ERROR, message, strlen(message));
+        }
+    } else if (queue->profileRows > 0) {
+        FILE* file = fopen(job->fileName, "r");
+        char* report = NULL;
+        size_t reportLength = 0;
+        FILE* reportFile = open_memstream(&report, &reportLength);
+        if (file != NULL && reportFile != NULL) {
+            profile_file(file, queue->profileRows, context, &(job->stats),
+                    job->trace, reportFile);
+        }
+        if (reportFile != NULL) {
+            fclose(reportFile);
+            job_output(job, UQ_STREAM_ERROR, report, reportLength);
+        }
+        free((void*)report);
+        if (file != NULL) {
+            fclose(file);
+        }
     } else {
-        printf("Please enter your expressions and assignment "
-               "operations.\n");
-        int tracker = 0;
-        while (tracker == 0) {
-            tracker = download_live_command_line(variables, loops, sigFigs);
+        FILE* file = fopen(job->fileName, "r");
+        char* line = NULL;
+        size_t size = 0;
+        while (file != NULL
+                && read_line(&line, &size, file, job->trace) != NULL) {
+            uq_execute(context, line);
+        }
+        free((void*)line);
+        if (file != NULL) {
+            fclose(file);
         }
     }
-    printf("Thank you for using uqexpr.\n");
-    free_memory(sigFigs, information, numberVariables, numberLoops, variables,
-            loops);
-    return 0;
+    uq_set_output(context, NULL, NULL);
+    if (text) {
+        const char* closing = "Thank you for using uqexpr.\n";
+        job_output(job, UQ_STREAM_OUTPUT, closing, strlen(closing));
+    }
+    return result;
+}
+
+/* Takes files from the queue in order and runs each in a context cloned from
+ * the command line definitions until none are left. With --stats each file's
+ * work is counted in its own job, and with --trace each worker records its
+ * own trace, since neither may be shared between threads
+ *
+ * void* data: the FileQueue
+ *
+ * Returns NULL
+ */
+void* file_worker(void* data)
+{
+    FileQueue* queue = (FileQueue*)data;
+    pthread_mutex_lock(&(queue->lock));
+    UqTrace* trace = NULL;
+    if (queue->traced && runNumberWorkerTraces < MAX_JOBS) {
+        trace = uq_trace_create();
+        runWorkerTraces[runNumberWorkerTraces] = trace;
+        runNumberWorkerTraces++;
+    }
+    while (queue->next < queue->numberJobs) {
+        FileJob* job = &(queue->jobs[queue->next]);
+        queue->next++;
+        UqContext* context = uq_clone(queue->base);
+        job->trace = trace;
+        pthread_mutex_unlock(&(queue->lock));
+        if (context != NULL) {
+            uq_set_trace(context, trace);
+            if (queue->stats) {
+                uq_set_stats(context, &(job->stats));
+            }
+        }
+        job->result = (context != NULL)
+                ? job_run(job, context, queue->text)
+                : UQ_STATEMENT_ERROR;
+        uq_destroy(context);
+        pthread_mutex_lock(&(queue->lock));
+        job->done = 1;
+        pthread_cond_broadcast(&(queue->finished));
+    }
+    pthread_mutex_unlock(&(queue->lock));
+    return NULL;
+}
+
+/* Runs several input files at once, each on a worker thread in its own
+ * context cloned from the --define and --loopable definitions, so that no
+ * file sees another's assignments. At most --jobs files run at a time, by
+ * default one per online processor. Each file's results are written to
+ * stdout in the order the files were given, those of the earliest unfinished
+ * file as they are produced, or to <file>.out with --split-output, and its
+ * errors to stderr in the same order once it has finished
+ *
+ * UqContext* context: context holding the command line definitions
+ * int* sigFigs: A pointer to integer which determines number of sig figs to
+ * print doubles to Information* information: Pointer to Information struct
+ * which contains the input files int* numberVariables: pointer to number of
+ * variables detected on command line initially int* numberLoops: pointer to
+ * number of loops detected on command line initially
+ *
+ * Return 0, FILE_DOES_NOT_OPEN_ERROR if a .out file cannot be written, or the
+ * first error any file's run returned
+ */
+int run_files(UqContext* context, int* sigFigs, Information* information,
+        int* numberVariables, int* numberLoops)
+{
+    FileQueue queue;
+    queue.numberJobs = information->numberFiles;
+    queue.jobs = (FileJob*)calloc(queue.numberJobs, sizeof(FileJob));
+    queue.next = 0;
+    queue.base = context;
+    queue.text = information->outputMode == UQ_OUTPUT_TEXT;
+    queue.buffered = 0;
+    queue.stats = information->stats;
+    queue.traced = runTraceFile != NULL;
+    queue.profileRows = information->profileRows;
+    int result = 0;
+    for (int i = 0; i < queue.numberJobs; i++) {
+        FileJob* job = &(queue.jobs[i]);
+        job->fileName = information->inputFiles[i];
+        job->queue = &queue;
+        if (information->splitOutput) {
+            char* outName = (char*)malloc(
+                    strlen(job->fileName) + strlen(OUT_EXTENSION) + 1);
+            sprintf(outName, "%s%s", job->fileName, OUT_EXTENSION);
+            job->outFile = fopen(outName, "w");
+            if (job->outFile == NULL) {
+                fprintf(stderr, "uqexpr: can't open file \"%s\" for writing\n",
+                        outName);
+                result = FILE_DOES_NOT_OPEN_ERROR;
+            }
+            free((void*)outName);
+        }
+    }
+    int numberThreads = information->jobs;
+    if (numberThreads == 0) {
+        long processors = sysconf(_SC_NPROCESSORS_ONLN);
+        numberThreads = (processors < 1) ? 1
+                : (processors > MAX_JOBS) ? MAX_JOBS
+                                          : (int)processors;
+    }
+    if (numberThreads > queue.numberJobs) {
+        numberThreads = queue.numberJobs;
+    }
+    pthread_t* threads = (pthread_t*)malloc(numberThreads * sizeof(pthread_t));
+    int started = 0;
+    if (result == 0) {
+        if (queue.stats) {
+            runJobs = queue.jobs;
+            runNumberJobs = queue.numberJobs;
+        }
+        pthread_mutex_init(&(queue.lock), NULL);
+        pthread_cond_init(&(queue.finished), NULL);
+        while (started < numberThreads
+                && pthread_create(&(threads[started]), NULL, file_worker,
+                           &queue)
+                        == 0) {
+            started++;
+        }
+        if (started == 0) {
+            file_worker(&queue);
+        }
+        for (int i = 0; i < queue.numberJobs; i++) {
+            FileJob* job = &(queue.jobs[i]);
+            pthread_mutex_lock(&(queue.lock));
+            job_release(job);
+            while (!job->done) {
+                pthread_cond_wait(&(queue.finished), &(queue.lock));
+            }
+            pthread_mutex_unlock(&(queue.lock));
+            fflush(stdout);
+            if (job->errorsLength > 0) {
+                fwrite(job->errors, 1, job->errorsLength, stderr);
+            }
+            if (result == 0) {
+                result = job->result;
+            }
+        }
+        for (int i = 0; i < started; i++) {
+            pthread_join(threads[i], NULL);
+        }
+        runNumberJobs = 0;
+        runJobs = NULL;
+        for (int i = 0; i < queue.numberJobs && queue.stats; i++) {
+            stats_add(&runStats, &(queue.jobs[i].stats));
+        }
+        pthread_cond_destroy(&(queue.finished));
+        pthread_mutex_destroy(&(queue.lock));
+    }
+    for (int i = 0; i < queue.numberJobs; i++) {
+        if (queue.jobs[i].outFile != NULL) {
+            fclose(queue.jobs[i].outFile);
+        }
+        if (queue.jobs[i].spill != NULL) {
+            fclose(queue.jobs[i].spill);
+        }
+        free((void*)queue.jobs[i].output);
+        free((void*)queue.jobs[i].errors);
+    }
+    free((void*)threads);
+    free((void*)queue.jobs);
+    free_memory(sigFigs, information, numberVariables, numberLoops, context);
+    return result;
+}
+
+/* Runs the --columns batch mode, evaluating the --eval expression over every
+ * row of the columns file without the interactive banner
+ *
+ * UqContext* context: context holding the --define and --loopable variables
+ * int* sigFigs: A pointer to integer which determines number of sig figs to
+ * print doubles to Information* information: Pointer to Information struct
+ * which contains the columns file name and expression int* numberVariables:
+ * pointer to number of variables detected on command line initially int*
+ * numberLoops: pointer to number of loops detected on command line initially
+ *
+ * Return 0 if successful or UQ_INVALID_EXPRESSION_ERROR if the expression is
+ * invalid
+ */
+int run_columns(UqContext* context, int* sigFigs, Information* information,
+        int* numberVariables, int* numberLoops)
+{
+    FILE* file = fopen(information->columnsFile, "r");
+    int result = uq_columns(context, file, information->evalExpression);
+    fclose(file);
+    free_memory(sigFigs, information, numberVariables, numberLoops, context);
+    return result;
+}
+
+/* Runs --compile, writing the compiled image of a script to the -o file
+ *
+ * UqContext* context: unused context, freed on return
+ * int* sigFigs: A pointer to integer which determines number of sig figs to
+ * print doubles to Information* information: Pointer to Information struct
+ * which contains the script and image paths int* numberVariables: pointer to
+ * number of variables detected on command line initially int* numberLoops:
+ * pointer to number of loops detected on command line initially
+ *
+ * Return 0 or UQ_SCRIPT_ERROR if the image cannot be written
+ */
+int run_compile(UqContext* context, int* sigFigs, Information* information,
+        int* numberVariables, int* numberLoops)
+{
+    int result = uq_compile_script(
+            information->compileSource, information->compileOutput);
+    if (result != 0) {
+        fprintf(stderr, "uqexpr: can't compile \"%s\" to \"%s\"\n",
+                information->compileSource, information->compileOutput);
+    }
+    free_memory(sigFigs, information, numberVariables, numberLoops, context);
+    return result;
+}
+
+/* Runs the --serve daemon, serving sessions that start with the variables and
+ * loop variables given on the command line and share one compile cache. The
+ * variables are shared rather than copied into each session and any session
+ * may replace them for all with @publish. Sessions are served one statement at
+ * a time on one thread, so --time-limit is what stops one session's long
+ * @loop from holding up the others
+ *
+ * UqContext* context: context every session is copied from
+ * int* sigFigs: A pointer to integer which determines number of sig figs to
+ * print doubles to Information* information: Pointer to Information struct
+ * which contains the socket path int* numberVariables: pointer to number of
+ * variables detected on command line initially int* numberLoops: pointer to
+ * number of loops detected on command line initially
+ *
+ * Return 0 once stopped or UQ_SOCKET_ERROR if the socket cannot be used
+ */
+int run_server(UqContext* context, int* sigFigs, Information* information,
+        int* numberVariables, int* numberLoops)
+{
+    UqCache* cache = uq_cache_create();
+    uq_set_cache(context, cache);
+    int result = uq_share(context);
+    if (result == 0) {
+        result = uq_serve(information->serveSocket, context);
+    }
+    free_memory(sigFigs, information, numberVariables, numberLoops, context);
+    uq_cache_destroy(cache);
+    return result;
+}
+
+/* Runs the --connect client shim, relaying the input file or the live command
+ * line through a running --serve daemon
+ *
+ * UqContext* context: unused context, freed on return
+ * int* sigFigs: A pointer to integer which determines number of sig figs to
+ * print doubles to Information* information: Pointer to Information struct
+ * which contains the socket path and file name int* numberVariables: pointer
+ * to number of variables detected on command line initially int* numberLoops:
+ * pointer to number of loops detected on command line initially
+ *
+ * Return 0 or UQ_SOCKET_ERROR if the daemon cannot be reached
+ */
+int run_client(UqContext* context, int* sigFigs, Information* information,
+        int* numberVariables, int* numberLoops)
+{
+    int live = !strcmp(information->fileName, "");
+    int input = live ? STDIN_FILENO : open(information->fileName, O_RDONLY);
+    int result = uq_connect(information->connectSocket, input, live);
+    if (!live) {
+        close(input);
+    }
+    free_memory(sigFigs, information, numberVariables, numberLoops, context);
+    return result;
+}
+
+/* Reads the monotonic clock
+ *
+ * Returns the time in nanoseconds
+ */
+long long stats_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * NANOSECONDS_PER_SECOND + now.tv_nsec;
+}
+
+/* Adds one set of counters to another. Memory held is summed, and so is the
+ * peak, which is therefore an upper bound when the counters were kept by
+ * contexts running at the same time. Only reads and writes memory, so it may
+ * be called from the SIGUSR1 handler
+ *
+ * UqStats* total: counters added to
+ * const UqStats* stats: counters to add
+ */
+void stats_add(UqStats* total, const UqStats* stats)
+{
+    total->linesRead += stats->linesRead;
+    total->bytesRead += stats->bytesRead;
+    total->compiles += stats->compiles;
+    total->compileNanoseconds += stats->compileNanoseconds;
+    total->evaluations += stats->evaluations;
+    total->loopIterations += stats->loopIterations;
+    total->outputBytes += stats->outputBytes;
+    total->outputNanoseconds += stats->outputNanoseconds;
+    for (int kind = 0; kind < UQ_MEMORY_KINDS; kind++) {
+        total->memoryBytes[kind] += stats->memoryBytes[kind];
+        total->memoryPeak[kind] += stats->memoryPeak[kind];
+    }
+}
+
+/* Appends text to a buffer using only async-signal-safe operations, cutting it
+ * short if the buffer is full
+ *
+ * char* buffer: buffer of STATS_BUFFER bytes
+ * size_t* length: pointer to the number of bytes in buffer
+ * const char* text: nul terminated text to append
+ */
+void stats_append(char* buffer, size_t* length, const char* text)
+{
+    while (*text != '\0' && *length < STATS_BUFFER) {
+        buffer[(*length)++] = *text++;
+    }
+}
+
+/* Appends a non-negative number to a buffer using only async-signal-safe
+ * operations
+ *
+ * char* buffer: buffer of STATS_BUFFER bytes
+ * size_t* length: pointer to the number of bytes in buffer
+ * long long number: number to append
+ * int width: minimum number of digits, padded with leading zeros
+ */
+void stats_append_number(
+        char* buffer, size_t* length, long long number, int width)
+{
+    char digits[NUMBER_BUFFER];
+    int count = 0;
+    do {
+        digits[count++] = '0' + number % DECIMAL_BASE;
+        number /= DECIMAL_BASE;
+    } while ((number > 0 || count < width) && count < NUMBER_BUFFER);
+    while (count > 0 && *length < STATS_BUFFER) {
+        buffer[(*length)++] = digits[--count];
+    }
+}
+
+/* Appends a time in nanoseconds to a buffer as milliseconds to three decimal
+ * places using only async-signal-safe operations
+ *
+ * char* buffer: buffer of STATS_BUFFER bytes
+ * size_t* length: pointer to the number of bytes in buffer
+ * long long nanoseconds: time to append
+ */
+void stats_append_milliseconds(
+        char* buffer, size_t* length, long long nanoseconds)
+{
+    stats_append_number(
+            buffer, length, nanoseconds / NANOSECONDS_PER_MILLISECOND, 1);
+    stats_append(buffer, length, ".");
+    stats_append_number(buffer, length,
+            nanoseconds % NANOSECONDS_PER_MILLISECOND
+                    / NANOSECONDS_PER_MICROSECOND,
+            MILLISECOND_DECIMALS);
+    stats_append(buffer, length, " ms");
+}
+
+/* Writes the counters of the run so far to stderr. Only async-signal-safe
+ * errno is left as it was so that the interrupted code does not see write()'s
+ * errno is left as it was so that the interrupted code does not see the
+ * errno of write()
+ *
+ * int signalNumber: SIGUSR1 when called as a handler, 0 otherwise
+ */
+void stats_report(int signalNumber)
+{
+    int savedErrno = errno;
+    char buffer[STATS_BUFFER];
+    size_t length = 0;
+    UqStats stats = runStats;
+    for (int i = 0; i < runNumberJobs; i++) {
+        stats_add(&stats, &(runJobs[i].stats));
+    }
+    stats_append(buffer, &length,
+            signalNumber ? "uqexpr stats so far:\n" : "uqexpr stats:\n");
+    stats_append(buffer, &length, "  elapsed          ");
+    stats_append_milliseconds(buffer, &length, stats_now() - runStart);
+    stats_append(buffer, &length, "\n  lines read       ");
+    stats_append_number(buffer, &length, stats.linesRead, 1);
+    stats_append(buffer, &length, "\n  bytes read       ");
+    stats_append_number(buffer, &length, stats.bytesRead, 1);
+    stats_append(buffer, &length, "\n  compiles         ");
+    stats_append_number(buffer, &length, stats.compiles, 1);
+    stats_append(buffer, &length, " in ");
+    stats_append_milliseconds(buffer, &length, stats.compileNanoseconds);
+    stats_append(buffer, &length, "\n  evaluations      ");
+    stats_append_number(buffer, &length, stats.evaluations, 1);
+    stats_append(buffer, &length, "\n  loop iterations  ");
+    stats_append_number(buffer, &length, stats.loopIterations, 1);
+    stats_append(buffer, &length, "\n  output bytes     ");
+    stats_append_number(buffer, &length, stats.outputBytes, 1);
+    stats_append(buffer, &length, " in ");
+    stats_append_milliseconds(buffer, &length, stats.outputNanoseconds);
+    stats_append(buffer, &length, "\n  memory bytes     now / peak");
+    const char* kinds[UQ_MEMORY_KINDS] = {"\n    symbols        ",
+            "\n    names          ", "\n    expressions    ",
+            "\n    buffers        "};
+    for (int kind = 0; kind < UQ_MEMORY_KINDS; kind++) {
+        stats_append(buffer, &length, kinds[kind]);
+        stats_append_number(buffer, &length, stats.memoryBytes[kind], 1);
+        stats_append(buffer, &length, " / ");
+        stats_append_number(buffer, &length, stats.memoryPeak[kind], 1);
+    }
+    stats_append(buffer, &length, "\n");
+    size_t written = 0;
+    while (written < length) {
+        ssize_t result
+                = write(STDERR_FILENO, buffer + written, length - written);
+        if (result <= 0) {
+            break;
+        }
+        written += result;
+    }
+    errno = savedErrno;
+}
+
+/* Starts counting the work of a context for --stats, writing the counters so
+ * far to stderr whenever SIGUSR1 is received
+ *
+ * UqContext* context: context whose work is counted
+ */
+void stats_start(UqContext* context)
+{
+    runStart = stats_now();
+    uq_set_stats(context, &runStats);
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = stats_report;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &action, NULL);
+}
+
+/* Starts recording spans of the work of a context for --trace
+ *
+ * UqContext* context: context whose work is traced
+ */
+void trace_start(UqContext* context)
+{
+    runTrace = uq_trace_create();
+    uq_set_trace(context, runTrace);
+}
+
+/* Writes the spans recorded for --trace, those of the main thread and of any
+ * worker threads, to the trace file and closes it
+ *
+ * Returns 0 or UQ_TRACE_ERROR if the trace could not be written
+ */
+int trace_finish(void)
+{
+    int result = UQ_TRACE_ERROR;
+    UqTrace* traces[MAX_JOBS + 1];
+    int numberTraces = 0;
+    for (int i = -1; i < runNumberWorkerTraces; i++) {
+        UqTrace* trace = (i < 0) ? runTrace : runWorkerTraces[i];
+        if (trace != NULL) {
+            traces[numberTraces] = trace;
+            numberTraces++;
+        }
+    }
+    if (runTrace != NULL) {
+        result = uq_trace_write(traces, numberTraces, runTraceFile);
+    }
+    if (fclose(runTraceFile) != 0) {
+        result = UQ_TRACE_ERROR;
+    }
+    if (result != 0) {
+        fprintf(stderr, "uqexpr: can't write trace file\n");
+    }
+    uq_trace_destroy(runTrace);
+    runTrace = NULL;
+    for (int i = 0; i < runNumberWorkerTraces; i++) {
+        uq_trace_destroy(runWorkerTraces[i]);
+    }
+    runNumberWorkerTraces = 0;
+    return result;
 }
 
 /* Initialises memory, processes command line arguments and calls functions
@@ -1597,19 +2089,83 @@ int main(int argc, char* argv[])
     int* sigFigs = (int*)malloc(sizeof(int));
     int* numberVariables = (int*)malloc(sizeof(int));
     int* numberLoops = (int*)malloc(sizeof(int));
-    Variables* variables = (Variables*)malloc(sizeof(Variables));
-    Loops* loops = (Loops*)malloc(sizeof(Loops));
+    UqContext* context = uq_create();
     Information* information = (Information*)malloc(sizeof(Information));
     information->fileName = (char*)malloc(sizeof(char));
+    information->inputFiles = (char**)malloc(sizeof(char*));
+    information->numberFiles = 0;
+    information->jobs = 0;
+    information->splitOutput = 0;
     information->variableStrings = (char**)malloc(sizeof(char*));
     information->loopsStrings = (char**)malloc(sizeof(char*));
+    information->columnsFile = NULL;
+    information->evalExpression = NULL;
+    information->outputMode = -1;
+    information->math = -1;
+    information->precision = -1;
+    information->engine = -1;
+    information->serveSocket = NULL;
+    information->connectSocket = NULL;
+    information->restoreFile = NULL;
+    information->compileSource = NULL;
+    information->compileOutput = NULL;
+    information->aotSource = NULL;
+    information->verify = 0;
+    information->stats = 0;
+    information->profileRows = 0;
+    information->traceFile = NULL;
+    information->maxMemory = 0;
+    information->progress = 0;
+    information->timeLimit = 0;
+    information->crosscheck = -1;
     int result = run_initial_command_line(argc, argv, sigFigs, information,
-            numberVariables, numberLoops, variables, loops);
+            numberVariables, numberLoops, context);
     if (result != 0) {
         return result;
     }
-    result = run_program(variables, sigFigs, loops, information,
-            numberVariables, numberLoops);
+    int stats = information->stats;
+    if (stats) {
+        stats_start(context);
+    }
+    if (runTraceFile != NULL) {
+        trace_start(context);
+    }
+    if (information->compileSource != NULL) {
+        result = run_compile(context, sigFigs, information, numberVariables,
+                numberLoops);
+    } else if (information->serveSocket != NULL) {
+        result = run_server(context, sigFigs, information, numberVariables,
+                numberLoops);
+    } else if (information->connectSocket != NULL) {
+        result = run_client(context, sigFigs, information, numberVariables,
+                numberLoops);
+    } else if (information->columnsFile != NULL) {
+        result = run_columns(context, sigFigs, information, numberVariables,
+                numberLoops);
+    } else if (information->numberFiles > 1 || information->splitOutput) {
+        result = run_files(context, sigFigs, information, numberVariables,
+                numberLoops);
+    } else {
+        result = run_program(context, sigFigs, information, numberVariables,
+                numberLoops);
+    }
+    if (runCrosscheck != NULL) {
+        fflush(stdout);
+        int checkResult = uq_crosscheck_destroy(runCrosscheck);
+        if (result == 0) {
+            result = checkResult;
+        }
+    }
+    if (stats) {
+        fflush(stdout);
+        stats_report(0);
+    }
+    if (runTraceFile != NULL) {
+        int traceResult = trace_finish();
+        if (result == 0) {
+            result = traceResult;
+        }
+    }
     if (result != 0) {
         return result;
     }
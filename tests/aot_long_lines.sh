@@ -0,0 +1,38 @@
+#!/bin/sh
+# Builds native code with --aot --verify for a script whose statements are
+# far longer than a line buffer. The generated code must be built and its
+# results must match the interpreter's.
+#
+# Usage: tests/aot_long_lines.sh [path to uqexpr]
+
+UQEXPR=${1:-./uqexpr}
+DIRECTORY=$(mktemp -d)
+trap 'rm -rf "$DIRECTORY"' EXIT
+SCRIPT="$DIRECTORY/long.txt"
+awk 'BEGIN {
+    print "a = 0.5"
+    product = "exp(a)"
+    for (i = 1; i < 200; i++) { product = product "*sin(a)+exp(a)" }
+    print "y = " product
+    nested = "a"
+    for (i = 0; i < 400; i++) { nested = "cos(a+(" nested "))" }
+    print nested
+}' > "$SCRIPT"
+EXPECTED=$("$UQEXPR" "$SCRIPT" 2>&1)
+ACTUAL=$("$UQEXPR" --aot "$SCRIPT" --verify 2>&1)
+STATUS=$?
+if [ $STATUS -ne 0 ]; then
+    echo "FAIL: uqexpr exited with status $STATUS"
+    echo "$ACTUAL" | head -n 8
+    exit 1
+fi
+if [ ! -f "$SCRIPT.aot.so" ] || [ ! -f "$SCRIPT.aot.sum" ]; then
+    echo "FAIL: no native code was built"
+    exit 1
+fi
+if [ "$ACTUAL" != "$EXPECTED" ]; then
+    echo "FAIL: native results differ from the interpreter"
+    echo "$ACTUAL" | head -n 8
+    exit 1
+fi
+echo "PASS"
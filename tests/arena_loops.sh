@@ -0,0 +1,53 @@
+#!/bin/sh
+# Runs 300 @loop statements with where clauses, each larger than the last, so
+# every statement and predicate is compiled into the arena and released when
+# its loop ends. The rows must be right, the arena must be reused rather than
+# grow with the number of loops, and the same rows must be printed when
+# --max-memory keeps the arena from growing at all.
+#
+# Usage: tests/arena_loops.sh [path to uqexpr]
+
+UQEXPR=${1:-./uqexpr}
+DIRECTORY=$(mktemp -d)
+trap 'rm -rf "$DIRECTORY"' EXIT
+awk 'BEGIN {
+    for (k = 1; k <= 300; k++) {
+        sum = "i"
+        for (t = 0; t < k; t++) { sum = sum "+1" }
+        print "@loop i " sum " where i-1"
+    }
+}' > "$DIRECTORY/script.txt"
+awk 'BEGIN {
+    for (k = 1; k <= 300; k++) {
+        print "Result = " (k + 2) " when i = 2"
+        print "Result = " (k + 3) " when i = 3"
+    }
+}' > "$DIRECTORY/expected.txt"
+
+run() {
+    "$UQEXPR" --loopable i,1,1,3 --stats "$@" "$DIRECTORY/script.txt" \
+            > "$DIRECTORY/output.txt" 2> "$DIRECTORY/stats.txt"
+    STATUS=$?
+    if [ $STATUS -ne 0 ]; then
+        echo "FAIL: uqexpr $* exited with status $STATUS"
+        exit 1
+    fi
+    grep "^Result" "$DIRECTORY/output.txt" > "$DIRECTORY/rows.txt"
+    if ! cmp -s "$DIRECTORY/rows.txt" "$DIRECTORY/expected.txt"; then
+        echo "FAIL: wrong rows with uqexpr $*"
+        diff "$DIRECTORY/expected.txt" "$DIRECTORY/rows.txt" | head -n 5
+        exit 1
+    fi
+    EXPRESSIONS=$(awk '$1 == "expressions" { print $2 " " $4 }' \
+            "$DIRECTORY/stats.txt")
+    NOW=${EXPRESSIONS% *}
+    PEAK=${EXPRESSIONS#* }
+    if [ "$NOW" != 0 ] || [ -z "$PEAK" ] || [ "$PEAK" -gt 32768 ]; then
+        echo "FAIL: expressions memory $EXPRESSIONS with uqexpr $*"
+        exit 1
+    fi
+}
+
+run
+run --max-memory 1k
+echo "PASS"
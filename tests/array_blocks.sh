@@ -0,0 +1,48 @@
+#!/bin/sh
+# Evaluates array expressions element-wise with both engines, over arrays
+# small enough to check by hand and over one spanning many blocks. Both
+# engines must print the same rows, and arrays of different lengths or a
+# malformed list must be errors.
+#
+# Usage: tests/array_blocks.sh [path to uqexpr]
+
+UQEXPR=${1:-./uqexpr}
+DIRECTORY=$(mktemp -d)
+trap 'rm -rf "$DIRECTORY"' EXIT
+cat > "$DIRECTORY/script.txt" << 'EOF2'
+@array r,0,0.5,2
+@array v [1,2,3,4,5]
+r*v-r
+@array u [1,2]
+r+u
+@array z [1,,2]
+@array big,1,1,10000
+big*big-2*big+1
+EOF2
+
+for ENGINE in tree vector; do
+    "$UQEXPR" --engine=$ENGINE "$DIRECTORY/script.txt" \
+            > "$DIRECTORY/$ENGINE.txt" 2> "$DIRECTORY/$ENGINE.err"
+    if [ "$(grep -c "^Error" "$DIRECTORY/$ENGINE.err")" != 2 ]; then
+        echo "FAIL: expected 2 errors with --engine=$ENGINE"
+        exit 1
+    fi
+done
+if ! cmp -s "$DIRECTORY/tree.txt" "$DIRECTORY/vector.txt"; then
+    echo "FAIL: the engines printed different rows"
+    exit 1
+fi
+if ! grep -q "^Result = \[0, 0.5, 2, 4.5, 8\]$" "$DIRECTORY/vector.txt"; then
+    echo "FAIL: wrong element-wise result"
+    exit 1
+fi
+SQUARES=$(awk 'BEGIN {
+    printf "Result = [0"
+    for (i = 2; i <= 10000; i++) { printf ", %.3g", (i - 1) * (i - 1) }
+    print "]"
+}')
+if ! grep -qxF "$SQUARES" "$DIRECTORY/vector.txt"; then
+    echo "FAIL: wrong result over many blocks"
+    exit 1
+fi
+echo "PASS"
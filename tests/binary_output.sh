@@ -0,0 +1,67 @@
+#!/bin/sh
+# Runs a script mixing assignments, scalar results, commands and @loop with
+# --output=binary, directly and compiled. stdout must parse as nothing but
+# UQXB records, and the rest of the output must be on stderr.
+#
+# Usage: tests/binary_output.sh [path to uqexpr]
+
+UQEXPR=${1:-./uqexpr}
+DIRECTORY=$(mktemp -d)
+trap 'rm -rf "$DIRECTORY"' EXIT
+SCRIPT="$DIRECTORY/mixed.txt"
+printf 'x = 2\nx*3\n@loop i x*i\n@print\nt = 0\n@loop i t = i+x\nx+1\n' \
+        > "$SCRIPT"
+
+# Prints the number of records and rows in a UQXB stream, or "bad" followed
+# by the offset of the first byte that is not part of a record
+parse() {
+    od -An -v -tu1 "$1" | awk '
+    { for (i = 1; i <= NF; i++) { byte[n++] = $i } }
+    function integer(at, size,    value, k) {
+        value = 0
+        for (k = size - 1; k >= 0; k--) { value = value * 256 + byte[at + k] }
+        return value
+    }
+    END {
+        at = 0; records = 0; rows = 0
+        while (at < n) {
+            if (at + 20 > n || byte[at] != 85 || byte[at + 1] != 81 \
+                    || byte[at + 2] != 88 || byte[at + 3] != 66 \
+                    || integer(at + 4, 4) != 1 || integer(at + 8, 4) != 2) {
+                print "bad", at; exit
+            }
+            count = integer(at + 12, 8)
+            at += 20
+            at += 4 + integer(at, 4)
+            at += 4 + integer(at, 4)
+            at += count * 16
+            records++; rows += count
+        }
+        if (at != n) { print "bad", at; exit }
+        print records, rows
+    }'
+}
+
+check() {
+    if ! "$UQEXPR" --loopable i,1,1,50 --output=binary "$2" \
+            > "$DIRECTORY/out" 2> "$DIRECTORY/err"; then
+        echo "FAIL: $1 exited with an error"
+        exit 1
+    fi
+    PARSED=$(parse "$DIRECTORY/out")
+    if [ "$PARSED" != "2 100" ]; then
+        echo "FAIL: stdout of $1 is not two UQXB records: $PARSED"
+        exit 1
+    fi
+    for TEXT in "x = 2" "Result = 6" "Loop variables:" "Result = 3"; do
+        if ! grep -q "^$TEXT" "$DIRECTORY/err"; then
+            echo "FAIL: $1 did not write \"$TEXT\" to stderr"
+            exit 1
+        fi
+    done
+}
+
+check "the script" "$SCRIPT"
+"$UQEXPR" --compile "$SCRIPT" -o "$DIRECTORY/mixed.uqc"
+check "the compiled script" "$DIRECTORY/mixed.uqc"
+echo "PASS"
@@ -0,0 +1,42 @@
+#!/bin/sh
+# Evaluates an expression over every row of CSV and TSV files with --columns
+# and --eval. Each row must be echoed with its result in the file's own
+# delimiter, including rows past the first block, a missing or non-numeric
+# cell must give nan, and an unknown column must be an error.
+#
+# Usage: tests/columns_batch.sh [path to uqexpr]
+
+UQEXPR=${1:-./uqexpr}
+DIRECTORY=$(mktemp -d)
+trap 'rm -rf "$DIRECTORY"' EXIT
+printf 'a,b\n1,2\n3,x\n5\n' > "$DIRECTORY/small.csv"
+printf 'a\tb\n1\t2\n3\t4\n' > "$DIRECTORY/small.tsv"
+awk 'BEGIN {
+    print "x,y"
+    for (i = 1; i <= 10000; i++) { print i "," (3 * i) }
+}' > "$DIRECTORY/large.csv"
+
+check() {
+    EXPECTED=$1
+    shift
+    OUTPUT=$("$UQEXPR" "$@")
+    if [ "$OUTPUT" != "$EXPECTED" ]; then
+        echo "FAIL: unexpected output from uqexpr $*"
+        echo "$OUTPUT" | head -n 5
+        exit 1
+    fi
+}
+
+check "$(printf 'a,b,Result\n1,2,3\n3,x,nan\n5,,nan')" \
+        --columns "$DIRECTORY/small.csv" --eval 'a*b+1'
+check "$(printf 'a\tb\tResult\n1\t2\t3\n3\t4\t13')" \
+        --columns "$DIRECTORY/small.tsv" --eval 'a*b+1'
+check "$(awk -F, 'NR == 1 { print $0 ",Result"; next }
+        { print $0 "," ($2 / $1) }' "$DIRECTORY/large.csv")" \
+        --columns "$DIRECTORY/large.csv" --eval 'y/x'
+if "$UQEXPR" --columns "$DIRECTORY/small.csv" --eval 'a*q' \
+        > /dev/null 2>&1; then
+    echo "FAIL: an unknown column was not an error"
+    exit 1
+fi
+echo "PASS"
@@ -0,0 +1,53 @@
+#!/bin/sh
+# Compiles a script with --compile, then changes the source to hold
+# statements longer than a line buffer. Running the image must rebuild it
+# from the new source and give the same output as the interpreter.
+#
+# Usage: tests/compile_image.sh [path to uqexpr]
+
+UQEXPR=${1:-./uqexpr}
+DIRECTORY=$(mktemp -d)
+trap 'rm -rf "$DIRECTORY"' EXIT
+SCRIPT="$DIRECTORY/script.txt"
+IMAGE="$DIRECTORY/script.uqc"
+printf 'x = 2\nx*3\n' > "$SCRIPT"
+if ! "$UQEXPR" --compile "$SCRIPT" -o "$IMAGE"; then
+    echo "FAIL: --compile failed"
+    exit 1
+fi
+BEFORE=$("$UQEXPR" "$IMAGE" 2>&1)
+case "$BEFORE" in
+*"Result = 6"*)
+    ;;
+*)
+    echo "FAIL: the image did not run the script"
+    exit 1
+    ;;
+esac
+
+awk 'BEGIN {
+    printf "\351 = 3\n"
+    sum = "x"
+    for (i = 1; i < 600; i++) { sum = sum "+x" }
+    print "x = 2"
+    print "y = " sum
+    print "@loop \351 2"
+    print "y/x"
+}' > "$SCRIPT"
+EXPECTED=$("$UQEXPR" "$SCRIPT" 2>&1)
+ACTUAL=$("$UQEXPR" "$IMAGE" 2>&1)
+if [ "$ACTUAL" != "$EXPECTED" ]; then
+    echo "FAIL: the rebuilt image differs from the interpreter"
+    echo "$ACTUAL" | head -n 8
+    exit 1
+fi
+case "$ACTUAL" in
+*"y = 1.2e+03"*"Result = 600"*)
+    echo "PASS"
+    ;;
+*)
+    echo "FAIL: unexpected output"
+    echo "$ACTUAL" | head -n 8
+    exit 1
+    ;;
+esac
@@ -0,0 +1,34 @@
+#!/bin/sh
+# Runs expressions nested far deeper than tinyexpr can recurse with
+# --crosscheck, which must leave them unchecked rather than crash.
+#
+# Usage: tests/crosscheck_deep.sh [path to uqexpr]
+
+UQEXPR=${1:-./uqexpr}
+SCRIPT=$(mktemp)
+trap 'rm -f "$SCRIPT"' EXIT
+awk 'BEGIN {
+    n = 50000
+    left = ""; right = ""
+    for (i = 0; i < n; i++) { left = left "("; right = right ")" }
+    print "x = 2"
+    print left "x" right
+    print "y = " left "1" right
+}' > "$SCRIPT"
+
+OUTPUT=$("$UQEXPR" --crosscheck "$SCRIPT" 2>&1)
+STATUS=$?
+if [ $STATUS -ne 0 ]; then
+    echo "FAIL: uqexpr exited with status $STATUS"
+    exit 1
+fi
+case "$OUTPUT" in
+*"0 differed by more than 4 ulp, 2 unchecked"*)
+    echo "PASS"
+    ;;
+*)
+    echo "FAIL: unexpected crosscheck summary"
+    echo "$OUTPUT" | tail -n 2
+    exit 1
+    ;;
+esac
@@ -0,0 +1,25 @@
+#!/bin/sh
+# Makes --crosscheck report a divergence for an assignment, whose expression
+# carries the space after "=" and the line's newline. The report must quote
+# the statement trimmed, on one line.
+#
+# Usage: tests/crosscheck_report.sh [path to uqexpr]
+
+UQEXPR=${1:-./uqexpr}
+SCRIPT=$(mktemp)
+trap 'rm -f "$SCRIPT"' EXIT
+printf 'a = exp(0.7)*sin(0.7)   \n' > "$SCRIPT"
+
+OUTPUT=$("$UQEXPR" --engine=vector --precision=float --crosscheck=0 \
+        "$SCRIPT" 2>&1 >/dev/null)
+REPORT=$(echo "$OUTPUT" | head -n 1)
+case "$REPORT" in
+"uqexpr crosscheck: \"exp(0.7)*sin(0.7)\" gave "*" with tinyexpr, "*)
+    echo "PASS"
+    ;;
+*)
+    echo "FAIL: unexpected report"
+    echo "$OUTPUT" | head -n 2
+    exit 1
+    ;;
+esac
@@ -0,0 +1,44 @@
+#!/bin/sh
+# Runs @loop statements with where and every clauses over a loop variable.
+# Only the rows kept by both clauses may be printed, an assignment must still
+# take every iteration into account, and an empty where or an every of 0
+# must be errors.
+#
+# Usage: tests/loop_clauses.sh [path to uqexpr]
+
+UQEXPR=${1:-./uqexpr}
+DIRECTORY=$(mktemp -d)
+trap 'rm -rf "$DIRECTORY"' EXIT
+cat > "$DIRECTORY/script.txt" << 'EOF2'
+x = 0
+@loop i i*i where i-3 every 2
+@loop i x = x + i every 3
+x
+@loop i i every 0
+@loop i i where
+EOF2
+cat > "$DIRECTORY/expected.txt" << 'EOF2'
+Result = 25 when i = 5
+Result = 49 when i = 7
+Result = 81 when i = 9
+x = 1 when i = 1
+x = 10 when i = 4
+x = 28 when i = 7
+x = 55 when i = 10
+Result = 55
+EOF2
+
+"$UQEXPR" --loopable i,1,1,10 "$DIRECTORY/script.txt" \
+        > "$DIRECTORY/output.txt" 2> "$DIRECTORY/errors.txt"
+grep -e "^Result" -e "^x = [0-9]* when" "$DIRECTORY/output.txt" \
+        > "$DIRECTORY/rows.txt"
+if ! cmp -s "$DIRECTORY/rows.txt" "$DIRECTORY/expected.txt"; then
+    echo "FAIL: unexpected rows"
+    diff "$DIRECTORY/expected.txt" "$DIRECTORY/rows.txt"
+    exit 1
+fi
+if [ "$(grep -c "^Error" "$DIRECTORY/errors.txt")" != 2 ]; then
+    echo "FAIL: malformed clauses were not reported as errors"
+    exit 1
+fi
+echo "PASS"
@@ -0,0 +1,47 @@
+#!/bin/sh
+# Samples a sum of a uniform and a normal distribution with @montecarlo. The
+# same seed must give the same report, in the same run and in another one,
+# a different seed a different report, and the mean must be close to the
+# exact 1.5, while a sample count of 0 is refused.
+#
+# Usage: tests/montecarlo_seed.sh [path to uqexpr]
+
+UQEXPR=${1:-./uqexpr}
+SCRIPT=$(mktemp)
+trap 'rm -f "$SCRIPT"' EXIT
+STATEMENT='@montecarlo 200000 a+b with a uniform(0,1), b normal(1,2)'
+{
+    echo "$STATEMENT seed 7"
+    echo "$STATEMENT seed 7"
+    echo "$STATEMENT seed 8"
+    echo "@montecarlo 0 a with a uniform(0,1)"
+} > "$SCRIPT"
+
+run() {
+    "$UQEXPR" --significantfigures 8 "$SCRIPT" 2> /dev/null \
+            | grep -e "^Mean" -e "^Min"
+}
+
+FIRST=$(run)
+SECOND=$(run)
+ERRORS=$("$UQEXPR" "$SCRIPT" 2>&1 > /dev/null | grep -c "^Error")
+if [ "$FIRST" != "$SECOND" ]; then
+    echo "FAIL: the same seed gave different reports in different runs"
+    exit 1
+fi
+REPORTS=$(echo "$FIRST" | awk '
+    NR % 2 == 1 { mean[NR] = $3 + 0 }
+    { report[int((NR - 1) / 2)] = report[int((NR - 1) / 2)] $0 }
+    END {
+        if (NR != 6) { print "count"; exit }
+        if (report[0] != report[1]) { print "repeat"; exit }
+        if (report[0] == report[2]) { print "seed"; exit }
+        if (mean[1] < 1.49 || mean[1] > 1.51) { print "mean"; exit }
+        print "ok"
+    }')
+if [ "$REPORTS" != "ok" ] || [ "$ERRORS" != 1 ]; then
+    echo "FAIL: unexpected reports ($REPORTS, $ERRORS errors)"
+    echo "$FIRST"
+    exit 1
+fi
+echo "PASS"
@@ -0,0 +1,40 @@
+#!/bin/sh
+# Runs two files on two worker threads with --stats, --trace, --profile and
+# --progress, which must count the work of both files, trace every worker
+# and report each file's progress and profile.
+#
+# Usage: tests/multi_file_stats.sh [path to uqexpr]
+
+UQEXPR=${1:-./uqexpr}
+DIRECTORY=$(mktemp -d)
+trap 'rm -rf "$DIRECTORY"' EXIT
+printf 'x = 2\nx*3\n@loop i x*i\n' > "$DIRECTORY/a.txt"
+printf 'y = 4\n@loop i y+i\n' > "$DIRECTORY/b.txt"
+"$UQEXPR" --loopable i,1,1,3000 --jobs 2 --stats --progress 1500 \
+        --trace "$DIRECTORY/trace.json" --profile=2 "$DIRECTORY/a.txt" \
+        "$DIRECTORY/b.txt" > "$DIRECTORY/out" 2> "$DIRECTORY/err"
+STATUS=$?
+if [ $STATUS -ne 0 ]; then
+    echo "FAIL: uqexpr exited with status $STATUS"
+    cat "$DIRECTORY/err"
+    exit 1
+fi
+fail() {
+    echo "FAIL: $1"
+    cat "$DIRECTORY/err"
+    exit 1
+}
+grep -q "loop iterations  6000$" "$DIRECTORY/err" \
+        || fail "the stats do not count both files"
+[ "$(grep -c "^uqexpr profile: " "$DIRECTORY/err")" = 2 ] \
+        || fail "each file was not profiled"
+[ "$(grep -c "3000 of 3000 iterations" "$DIRECTORY/err")" = 2 ] \
+        || fail "each file's progress was not reported"
+THREADS=$(grep -o '"tid":[0-9]*' "$DIRECTORY/trace.json" | sort -u | wc -l)
+[ "$THREADS" -ge 2 ] \
+        || fail "the worker threads were not traced"
+grep -q '"name":"read"' "$DIRECTORY/trace.json" \
+        || fail "the worker threads' reads were not traced"
+[ "$(grep -c "^Result" "$DIRECTORY/out")" = 6001 ] \
+        || fail "unexpected results"
+echo "PASS"
@@ -0,0 +1,44 @@
+#!/bin/sh
+# Runs a script whose statements are far longer than a line buffer, both
+# directly and compiled with --compile, which must give the same results as
+# one statement per line.
+#
+# Usage: tests/script_long_lines.sh [path to uqexpr]
+
+UQEXPR=${1:-./uqexpr}
+DIRECTORY=$(mktemp -d)
+trap 'rm -rf "$DIRECTORY"' EXIT
+SCRIPT="$DIRECTORY/long.txt"
+awk 'BEGIN {
+    sum = "1"
+    for (i = 1; i < 1000; i++) { sum = sum "+1" }
+    print sum
+    left = ""; right = ""
+    for (i = 0; i < 2000; i++) { left = left "("; right = right ")" }
+    print "x = " left "4e5" right
+    nested = "a"
+    for (i = 0; i < 300; i++) { nested = "a+(" nested ")" }
+    print "a = 1"
+    print nested
+}' > "$SCRIPT"
+EXPECTED="Result = 1e+03
+x = 4e+05
+a = 1
+Result = 301"
+
+check() {
+    RESULTS=$(echo "$2" | grep -e "^Result" -e "^x =" -e "^a =")
+    if [ "$RESULTS" != "$EXPECTED" ]; then
+        echo "FAIL: $1 gave"
+        echo "$RESULTS" | head -n 5
+        exit 1
+    fi
+}
+
+check "the script" "$("$UQEXPR" "$SCRIPT" 2>&1)"
+if ! "$UQEXPR" --compile "$SCRIPT" -o "$DIRECTORY/long.uqc"; then
+    echo "FAIL: --compile failed"
+    exit 1
+fi
+check "the compiled script" "$("$UQEXPR" "$DIRECTORY/long.uqc" 2>&1)"
+echo "PASS"
@@ -0,0 +1,73 @@
+#!/bin/sh
+# Starts a server, connects one client that stays open, and has a second
+# client assign a variable and @publish it. The open session must see the new
+# variable from its next statement, a later session must start with it, and
+# an assignment made by one session must not leak into another.
+#
+# Usage: tests/server_publish.sh [path to uqexpr]
+
+UQEXPR=${1:-./uqexpr}
+DIRECTORY=$(mktemp -d)
+SOCKET="$DIRECTORY/socket"
+SERVER=
+EARLY=
+cleanup() {
+    exec 3>&-
+    for PROCESS in $EARLY $SERVER; do
+        kill "$PROCESS" 2> /dev/null
+        wait "$PROCESS" 2> /dev/null
+    done
+    rm -rf "$DIRECTORY"
+}
+trap cleanup EXIT
+"$UQEXPR" --define a=2 --serve "$SOCKET" &
+SERVER=$!
+for TRY in 1 2 3 4 5 6 7 8 9 10; do
+    [ -S "$SOCKET" ] && break
+    sleep 0.2
+done
+
+mkfifo "$DIRECTORY/early.in"
+timeout 20 "$UQEXPR" --connect "$SOCKET" < "$DIRECTORY/early.in" \
+        > "$DIRECTORY/early.out" 2>&1 &
+EARLY=$!
+exec 3> "$DIRECTORY/early.in"
+printf 'a\n' >&3
+sleep 0.3
+
+printf 'b = 5\n@publish\n' | timeout 10 "$UQEXPR" --connect "$SOCKET" \
+        > /dev/null
+OVERLAY=$(printf 'a = 7\na*b\n' | timeout 10 "$UQEXPR" --connect "$SOCKET")
+LATER=$(printf 'a*b\n' | timeout 10 "$UQEXPR" --connect "$SOCKET")
+printf 'b*a\n' >&3
+exec 3>&-
+if ! wait "$EARLY"; then
+    echo "FAIL: the open session did not finish"
+    exit 1
+fi
+EARLY=
+
+case "$OVERLAY" in
+*"Result = 35"*)
+    ;;
+*)
+    echo "FAIL: a session's own assignment did not hide the published base"
+    exit 1
+    ;;
+esac
+case "$LATER" in
+*"b = 5"*"Result = 10"*)
+    ;;
+*)
+    echo "FAIL: a later session did not start with the published variable"
+    echo "$LATER"
+    exit 1
+    ;;
+esac
+if ! grep -q "Result = 2$" "$DIRECTORY/early.out" \
+        || ! grep -q "Result = 10$" "$DIRECTORY/early.out"; then
+    echo "FAIL: the open session did not see the published variable"
+    cat "$DIRECTORY/early.out"
+    exit 1
+fi
+echo "PASS"
@@ -0,0 +1,56 @@
+#!/bin/sh
+# Starts a server with --time-limit, has one client run a @loop that would
+# take days, then checks that a second client is still served: the loop must
+# be stopped at the limit, and both sessions must see the right output.
+#
+# Usage: tests/server_time_limit.sh [path to uqexpr]
+
+UQEXPR=${1:-./uqexpr}
+DIRECTORY=$(mktemp -d)
+SOCKET="$DIRECTORY/socket"
+SERVER=
+cleanup() {
+    if [ -n "$SERVER" ]; then
+        kill "$SERVER" 2> /dev/null
+        wait "$SERVER" 2> /dev/null
+    fi
+    rm -rf "$DIRECTORY"
+}
+trap cleanup EXIT
+"$UQEXPR" --loopable i,1,1,1e15 --define a=2 --time-limit 300 \
+        --serve "$SOCKET" &
+SERVER=$!
+for TRY in 1 2 3 4 5 6 7 8 9 10; do
+    [ -S "$SOCKET" ] && break
+    sleep 0.2
+done
+
+printf '@loop i i*a\na+1\n' > "$DIRECTORY/slow.txt"
+printf 'a*3\n' > "$DIRECTORY/fast.txt"
+timeout 20 "$UQEXPR" --connect "$SOCKET" < "$DIRECTORY/slow.txt" \
+        > /dev/null 2> "$DIRECTORY/slow.err" &
+SLOW=$!
+sleep 0.1
+if ! FAST=$(timeout 20 "$UQEXPR" --connect "$SOCKET" \
+        < "$DIRECTORY/fast.txt"); then
+    echo "FAIL: the second session was not served"
+    exit 1
+fi
+if ! wait "$SLOW"; then
+    echo "FAIL: the first session did not finish"
+    exit 1
+fi
+case "$FAST" in
+*"Result = 6"*)
+    ;;
+*)
+    echo "FAIL: the second session got the wrong output"
+    exit 1
+    ;;
+esac
+if ! grep -q "stopped at its time limit" "$DIRECTORY/slow.err"; then
+    echo "FAIL: the @loop was not stopped at the time limit"
+    cat "$DIRECTORY/slow.err"
+    exit 1
+fi
+echo "PASS"
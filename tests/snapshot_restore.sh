@@ -0,0 +1,56 @@
+#!/bin/sh
+# Saves a session with @save and restores it with --restore: the variables,
+# loop variables, arrays and significant figures must come back exactly,
+# while a snapshot that clashes with --define or is cut short is refused.
+#
+# Usage: tests/snapshot_restore.sh [path to uqexpr]
+
+UQEXPR=${1:-./uqexpr}
+DIRECTORY=$(mktemp -d)
+trap 'rm -rf "$DIRECTORY"' EXIT
+SNAPSHOT="$DIRECTORY/session.img"
+printf 'x = 1/3\n@array v [1,2,3]\ny = x*3\n@save %s\n' "$SNAPSHOT" \
+        > "$DIRECTORY/save.txt"
+"$UQEXPR" --loopable i,1,2,5 --significantfigures 4 "$DIRECTORY/save.txt" \
+        > /dev/null
+STATUS=$?
+if [ $STATUS -ne 0 ] || [ ! -s "$SNAPSHOT" ]; then
+    echo "FAIL: @save exited with status $STATUS"
+    exit 1
+fi
+
+cat > "$DIRECTORY/expected.txt" << 'EOF'
+Variables:
+x = 0.3333
+y = 1
+Loop variables:
+i = 1 (1, 2, 5)
+Array variables:
+v = [1, 2, 3]
+Please enter your expressions and assignment operations.
+Result = 1.333
+Result = 0.3333 when i = 1
+Result = 1 when i = 3
+Result = 1.667 when i = 5
+Result = [2, 4, 6]
+EOF
+printf 'x+y\n@loop i i*x\nv*2\n' | "$UQEXPR" --restore "$SNAPSHOT" 2>&1 \
+        | sed '1,2d;$d' > "$DIRECTORY/output.txt"
+if ! cmp -s "$DIRECTORY/output.txt" "$DIRECTORY/expected.txt"; then
+    echo "FAIL: restored session differs"
+    diff "$DIRECTORY/expected.txt" "$DIRECTORY/output.txt"
+    exit 1
+fi
+
+"$UQEXPR" --define x=1 --restore "$SNAPSHOT" < /dev/null > /dev/null 2>&1
+if [ $? -eq 0 ]; then
+    echo "FAIL: a snapshot clashing with --define was restored"
+    exit 1
+fi
+head -c 40 "$SNAPSHOT" > "$DIRECTORY/short.img"
+"$UQEXPR" --restore "$DIRECTORY/short.img" < /dev/null > /dev/null 2>&1
+if [ $? -eq 0 ]; then
+    echo "FAIL: a truncated snapshot was restored"
+    exit 1
+fi
+echo "PASS"
@@ -0,0 +1,33 @@
+#!/bin/sh
+# Finds a root and a minimum over a loop variable's range with @solve and
+# @minimize. The loop variable must be left at the value found, and left
+# untouched by a @solve that has no root in the range, which is an error.
+#
+# Usage: tests/solve_range.sh [path to uqexpr]
+
+UQEXPR=${1:-./uqexpr}
+DIRECTORY=$(mktemp -d)
+trap 'rm -rf "$DIRECTORY"' EXIT
+printf '@solve x x*x-2\nx\n@minimize x (x-1.5)^2+3\n@solve x x*x+1\nx\n' \
+        > "$DIRECTORY/script.txt"
+cat > "$DIRECTORY/expected.txt" << 'EOF2'
+Root found when x = 1.4142136 (11 evaluations)
+Result = 1.4142136
+Minimum = 3 when x = 1.5 (37 evaluations)
+Result = 1.5
+EOF2
+
+"$UQEXPR" --significantfigures 8 --loopable x,0,1,4 "$DIRECTORY/script.txt" \
+        > "$DIRECTORY/output.txt" 2> "$DIRECTORY/errors.txt"
+grep -e "^Root" -e "^Minimum" -e "^Result" "$DIRECTORY/output.txt" \
+        > "$DIRECTORY/results.txt"
+if ! cmp -s "$DIRECTORY/results.txt" "$DIRECTORY/expected.txt"; then
+    echo "FAIL: unexpected results"
+    diff "$DIRECTORY/expected.txt" "$DIRECTORY/results.txt"
+    exit 1
+fi
+if [ "$(grep -c "^Error" "$DIRECTORY/errors.txt")" != 1 ]; then
+    echo "FAIL: a @solve without a root was not reported as an error"
+    exit 1
+fi
+echo "PASS"
@@ -0,0 +1,28 @@
+#!/bin/sh
+# Runs a file with --stats, once on its own and once with a second file on
+# worker threads. Lines and bytes read must match the input files exactly,
+# without the @print the banner runs.
+#
+# Usage: tests/stats_counts.sh [path to uqexpr]
+
+UQEXPR=${1:-./uqexpr}
+DIRECTORY=$(mktemp -d)
+trap 'rm -rf "$DIRECTORY"' EXIT
+printf 'x = 2\ny = 3\nx+y\n@print\nx*y\n' > "$DIRECTORY/a.txt"
+printf 'z = 4\nz/2\n' > "$DIRECTORY/b.txt"
+
+check() {
+    STATS=$("$UQEXPR" --stats "$@" 2>&1 >/dev/null)
+    LINES=$(cat "$@" | wc -l)
+    BYTES=$(cat "$@" | wc -c)
+    if ! echo "$STATS" | grep -q "lines read  *$LINES$" \
+            || ! echo "$STATS" | grep -q "bytes read  *$BYTES$"; then
+        echo "FAIL: expected $LINES lines and $BYTES bytes read, got"
+        echo "$STATS" | grep "read"
+        exit 1
+    fi
+}
+
+check "$DIRECTORY/a.txt"
+check "$DIRECTORY/a.txt" "$DIRECTORY/b.txt"
+echo "PASS"
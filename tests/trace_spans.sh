@@ -0,0 +1,24 @@
+#!/bin/sh
+# Traces a short script with --trace and checks that the trace holds a span
+# for every phase: read, lex, compile, evaluate, format, write and statement,
+# plus @loop chunks.
+#
+# Usage: tests/trace_spans.sh [path to uqexpr]
+
+UQEXPR=${1:-./uqexpr}
+DIRECTORY=$(mktemp -d)
+trap 'rm -rf "$DIRECTORY"' EXIT
+printf 'x = 2\n# comment\nx*3\n@loop i x*i\n' > "$DIRECTORY/script.txt"
+if ! "$UQEXPR" --loopable i,1,1,100 --trace "$DIRECTORY/trace.json" \
+        "$DIRECTORY/script.txt" > /dev/null; then
+    echo "FAIL: uqexpr exited with an error"
+    exit 1
+fi
+for NAME in read lex compile evaluate format write statement @loop; do
+    if ! grep -q "\"name\":\"$NAME\",\"cat\":\"uqexpr\",\"ph\":\"X\"" \
+            "$DIRECTORY/trace.json"; then
+        echo "FAIL: no $NAME span in the trace"
+        exit 1
+    fi
+done
+echo "PASS"
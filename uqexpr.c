@@ -0,0 +1,9542 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <tinyexpr.h>
+#include <math.h>
+#include <float.h>
+#include <sched.h>
+#include <time.h>
+#include <stdint.h>
+#include <limits.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <sys/syscall.h>
+#include "uqexpr.h"
+
+#define FORMAT_BUFFER_SIZE 20
+#define LOOP_COMMAS 3
+#define MAX_VARIABLE_LENGTH 22
+#define DEFAULT_SIG_FIGS 3
+#define THIRD_INDEX 3
+#define FOURTH_INDEX 4
+#define FIFTH_INDEX 5
+#define LOOP_LENGTH 6
+#define SOLVE_LENGTH 7
+#define MINIMIZE_LENGTH 10
+#define SOLVE_SEGMENTS 32
+#define SOLVE_MAX_ITERATIONS 100
+#define SOLVE_TOLERANCE 1e-12
+#define GOLDEN_SECTION 0.3819660112501051
+#define MONTECARLO_LENGTH 12
+#define MONTECARLO_UNIFORM 0
+#define MONTECARLO_NORMAL 1
+#define MONTECARLO_BLOCK 16384
+#define MONTECARLO_MAX_THREADS 64
+#define MONTECARLO_MAX_SAMPLES (1LL << 28)
+#define MONTECARLO_QUANTILES 7
+#define PHILOX_ROUNDS 10
+#define PHILOX_M0 0xD2511F53U
+#define PHILOX_M1 0xCD9E8D57U
+#define PHILOX_W0 0x9E3779B9U
+#define PHILOX_W1 0xBB67AE85U
+#define PHILOX_WORD_BITS 32
+#define PHILOX_DOUBLE_SHIFT 11
+#define PHILOX_UNIT 0x1p-53
+#define MATH_TWO_PI 6.28318530717958647693
+#define ARRAY_LENGTH 7
+#define VECTOR_BLOCK 256
+#define VECTOR_ALIGNMENT 64
+#define VECTOR_MAX_ARITY 3
+#define VECTOR_CONSTANT 0
+#define VECTOR_SCALAR 1
+#define VECTOR_ARRAY 2
+#define VECTOR_NEGATE 3
+#define VECTOR_ADD 4
+#define VECTOR_SUBTRACT 5
+#define VECTOR_MULTIPLY 6
+#define VECTOR_DIVIDE 7
+#define VECTOR_CALL 8
+#define VECTOR_SIN 9
+#define VECTOR_COS 10
+#define VECTOR_EXP 11
+#define VECTOR_LN 12
+#define VECTOR_LOG10 13
+#define VECTOR_POW 14
+#define PROBE_FIRST 3.0
+#define PROBE_SECOND 5.0
+#define PROBE_THIRD (-0.75)
+#define MATH_ROUND 6755399441055744.0
+#define MATH_LOG2E 1.44269504088896340736
+#define MATH_LN2_HIGH 6.93147180369123816490e-01
+#define MATH_LN2_LOW 1.90821492927058770002e-10
+#define MATH_INV_LN10 4.34294481903251827651e-01
+#define MATH_EXP_HIGH 710.0
+#define MATH_EXP_LOW (-746.0)
+#define MATH_EXPONENT_BIAS 1023
+#define MATH_MANTISSA_BITS 52
+#define MATH_SIGN_SHIFT 62
+#define MATH_MANTISSA_MASK 0x000FFFFFFFFFFFFFULL
+#define MATH_EXPONENT_MASK 0x7FFULL
+#define MATH_ONE_BITS 0x3FF0000000000000ULL
+#define MATH_INTEGER_BITS 0x4330000000000000ULL
+#define MATH_INTEGER_OFFSET 4503599627370496.0
+#define MATH_SUBNORMAL_SCALE 18014398509481984.0
+#define MATH_SUBNORMAL_BITS 54
+#define MATH_SQRT2 1.41421356237309504880
+#define MATH_TWO_OVER_PI 6.36619772367581382433e-01
+#define MATH_PIO2_1 1.57079632673412561417e+00
+#define MATH_PIO2_2 6.07710050630396597660e-11
+#define MATH_PIO2_3 2.02226624871116645580e-21
+#define MATH_PIO2_3T 8.47842766036889956997e-32
+#define MATH_TRIG_LIMIT 1.0e6
+#define MATH_POW_LIMIT 16.0
+#define TE_TYPE_MASK 0x1F
+#define TE_ARITY_MASK 0x7
+#define TE_CONSTANT_TYPE 1
+#define COLUMN_BLOCK_ROWS 4096
+#define OUTPUT_BUFFER_SIZE 65536
+#define BINARY_VERSION 1
+#define BINARY_COLUMNS 2
+#define BYTE_BITS 8
+#define BYTE_MASK 0xFF
+#define PRINT_BUFFER_SIZE 256
+#define MAX_SIG_FIGS 17
+#define CACHE_SIZE 1024
+#define FNV_OFFSET 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+#define SNAPSHOT_MAGIC "UQSNAPSH"
+#define SNAPSHOT_MAGIC_LENGTH 8
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_BYTE_ORDER 0x01020304
+#define SNAPSHOT_LOOP_FIELDS 4
+#define SAVE_LENGTH 6
+#define SCRIPT_MAGIC "UQCSCRPT"
+#define SCRIPT_MAGIC_LENGTH 8
+#define SCRIPT_VERSION 3
+#define SCRIPT_STACK_VALUES 256
+#define SCRIPT_TEXT 0
+#define SCRIPT_EXPRESSION 1
+#define SCRIPT_ASSIGNMENT 2
+#define SCRIPT_LOOP_EXPRESSION 3
+#define SCRIPT_LOOP_ASSIGNMENT 4
+#define SCRIPT_CONSTANT 0
+#define SCRIPT_SYMBOL 1
+#define SCRIPT_CALL 2
+#define SCRIPT_FUNCTIONS 30
+#define SCRIPT_BUILTINS 24
+#define SCRIPT_INDEX_SIZE 64
+#define NATIVE_READ_BUFFER 65536
+#define NATIVE_ARGUMENTS 9
+#define NANOSECONDS_PER_SECOND 1000000000LL
+#define NANOSECONDS_PER_MICROSECOND 1000LL
+#define TRACE_INITIAL_EVENTS 4096
+#define TRACE_MAX_EVENTS 4194304
+#define TRACE_LOOP_CHUNK 4096
+#define LOOP_MAX_REPETITIONS (1LL << 53)
+#define DEADLINE_STRIDE 1024
+#define NANOSECONDS_PER_MILLISECOND 1000000LL
+#define LOOP_BLOCK_ROWS 4096
+#define DECIMAL_BASE 10
+#define VARIABLE_BYTES (sizeof(char*) + sizeof(double))
+#define LOOP_BYTES (sizeof(char*) + 4 * sizeof(double))
+#define ARRAY_BYTES (sizeof(char*) + sizeof(double*) + sizeof(int))
+#define ARRAY_MAX_ELEMENTS (1LL << 28)
+#define INDEX_MIN_CAPACITY 16
+#define ARENA_MIN_BYTES 4096
+#define EXPRESSION_MAX_RECURSION 256
+#define EXPRESSION_DEEP 64
+#define EXPRESSION_WALK_FRAMES 64
+#define PARSE_OPERATORS 8
+#define PARSE_ADD 0
+#define PARSE_SUBTRACT 1
+#define PARSE_NEGATE 6
+#define PARSE_COMMA 7
+#define PARSE_SYMBOLS "+-*/^%"
+#define PARSE_INDEX_MIN 8
+#define PARSE_BINARY 0
+#define PARSE_PREFIX 1
+#define PARSE_GROUP 2
+#define PARSE_CALL 3
+#define PARSE_TOKEN_END 0
+#define PARSE_TOKEN_ERROR 1
+#define PARSE_TOKEN_NUMBER 2
+#define PARSE_TOKEN_VARIABLE 3
+#define PARSE_TOKEN_FUNCTION 4
+#define PARSE_TOKEN_INFIX 5
+#define PARSE_TOKEN_OPEN 6
+#define PARSE_TOKEN_CLOSE 7
+#define PARSE_TOKEN_SEPARATOR 8
+#define CROSSCHECK_RECORD_ROWS 4096
+#define CROSSCHECK_MAX_PENDING (1LL << 20)
+
+/* Work counters cost one NULL check each while no UqStats is attached to a
+ * context, and nothing at all when built with -DUQ_NO_STATS
+ */
+#ifdef UQ_NO_STATS
+#define STATS_ENABLED(context) 0
+#else
+#define STATS_ENABLED(context) ((context)->stats != NULL)
+#endif
+#define STATS_ADD(context, counter, amount) \
+    do { \
+        if (STATS_ENABLED(context)) { \
+            (context)->stats->counter += (amount); \
+        } \
+    } while (0)
+
+/* Spans are recorded while a UqTrace is attached to a context and is not
+ * quiet, and never when built with -DUQ_NO_TRACE
+ */
+#ifdef UQ_NO_TRACE
+#define TRACE_ATTACHED(context) 0
+#else
+#define TRACE_ATTACHED(context) ((context)->trace != NULL)
+#endif
+#define TRACE_ENABLED(context) \
+    (TRACE_ATTACHED(context) && !(context)->trace->quiet)
+
+/* The math kernels are built for AVX-512, AVX2 and baseline x86-64 and the
+ * best one for the CPU is picked when the program loads. Other compilers and
+ * targets get the baseline build only
+ */
+#if defined(__x86_64__) && defined(__has_attribute)
+#if __has_attribute(target_clones)
+#define MATH_DISPATCH \
+    __attribute__((target_clones("avx512f", "avx2", "default")))
+#endif
+#endif
+#ifndef MATH_DISPATCH
+#define MATH_DISPATCH
+#endif
+
+/* An open addressing hash index over an array of names, mapping each name to
+ * its position. Names are indexed lazily: a lookup first indexes any names
+ * appended since the last one, so only removing names or reusing positions
+ * needs name_index_reset()
+ *
+ * int* positions: capacity slots each holding a position or -1 if empty
+ * int capacity: number of slots, zero or a power of two
+ * int indexed: number of names from the start of the array indexed so far
+ */
+typedef struct {
+    int* positions;
+    int capacity;
+    int indexed;
+} NameIndex;
+
+/* Represents the collection of non-loop variables where each index corresponds
+ * to one variable
+ *
+ * char** names: array of strings with name of variable
+ * double* values: array of variable values
+ * int size: number of entries in variables (includes variables that have been
+ * transformed to loops) int converted: number of variables that have been
+ * converted to loops
+ * char** arrayNames: array of strings with names of array variables
+ * double** arrayValues: array of contiguous, VECTOR_ALIGNMENT aligned element
+ * storage for each array variable int* arrayLengths: number of elements in
+ * each array variable int arraySize: number of array variables
+ * long long nameBytes: bytes held by the names of the variables and arrays
+ * long long elements: number of elements held by all the array variables
+ * NameIndex index: index of names
+ * NameIndex arrayIndex: index of arrayNames
+ */
+typedef struct {
+    char** names;
+    double* values;
+    int size;
+    int converted;
+    char** arrayNames;
+    double** arrayValues;
+    int* arrayLengths;
+    int arraySize;
+    long long nameBytes;
+    long long elements;
+    NameIndex index;
+    NameIndex arrayIndex;
+} Variables;
+
+/* Represents one operation of a compiled expression flattened into postfix
+ * order
+ *
+ * int opcode: one of the VECTOR_* operations
+ * int arity: number of arguments taken by a VECTOR_CALL or math kernel
+ * operation
+ * double value: value pushed by a VECTOR_CONSTANT operation
+ * const double* address: address read by a VECTOR_SCALAR operation
+ * int array: index of the array variable read by a VECTOR_ARRAY operation
+ * const void* function: function applied by a VECTOR_CALL operation
+ */
+typedef struct {
+    int opcode;
+    int arity;
+    double value;
+    const double* address;
+    int array;
+    const void* function;
+} VectorInstruction;
+
+/* Represents a compiled expression that is evaluated a block of VECTOR_BLOCK
+ * elements at a time rather than one element at a time
+ *
+ * VectorInstruction* instructions: array of operations in evaluation order
+ * int size: number of operations
+ * int depth: maximum number of blocks held on the evaluation stack
+ * int usesArrays: 1 if any operation reads an array variable otherwise 0
+ */
+typedef struct {
+    VectorInstruction* instructions;
+    int size;
+    int depth;
+    int usesArrays;
+} VectorProgram;
+
+/* State of flattening an expression into a VectorProgram
+ *
+ * VectorProgram* program: program being built, with room for every node
+ * double* slots: addresses array variables were bound to when compiling
+ * const int* arrays: index of the array variable each slot stands for, or
+ * NULL if slot k stands for array k
+ * int numberSlots: number of entries in slots
+ * int math: UQ_MATH_FAST to use math kernels for the functions that have
+ * them or UQ_MATH_EXACT to call the C library for every element
+ * int depth: current depth of the evaluation stack
+ */
+typedef struct {
+    VectorProgram* program;
+    double* slots;
+    const int* arrays;
+    int numberSlots;
+    int math;
+    int depth;
+} VectorEmitter;
+
+/* The bindings of the names one expression refers to, each bound to the
+ * storage of the variable or loop variable it names rather than to a copy
+ *
+ * te_variable* tevars: one binding for each distinct name that is defined
+ * int count: number of bindings in tevars
+ * double* slots: one NaN slot for each array variable referred to
+ * int* arrays: index of the array variable each slot stands for
+ * int numberSlots: number of slots
+ */
+typedef struct {
+    te_variable* tevars;
+    int count;
+    double* slots;
+    int* arrays;
+    int numberSlots;
+} Bindings;
+
+/* A variable a @montecarlo statement draws from a distribution
+ *
+ * const char* name: name the expression refers to it by
+ * int kind: MONTECARLO_UNIFORM or MONTECARLO_NORMAL
+ * double first: lower bound of a uniform or mean of a normal
+ * double second: upper bound of a uniform or standard deviation of a normal
+ */
+typedef struct {
+    const char* name;
+    int kind;
+    double first;
+    double second;
+} Distribution;
+
+/* A @montecarlo statement being evaluated, shared by the threads that take
+ * its blocks of samples in turn
+ *
+ * const VectorProgram* program: the expression with distribution k read from
+ * array k
+ * const Distribution* distributions: the variables drawn for each sample
+ * int numberDistributions: number of distributions
+ * uint64_t seed: key of the random streams
+ * long long samples: number of samples
+ * long long numberBlocks: number of blocks of MONTECARLO_BLOCK samples
+ * long long next: next block to be taken
+ * int precision: UQ_PRECISION_DOUBLE or UQ_PRECISION_FLOAT
+ * double* results: one result for each sample
+ */
+typedef struct {
+    const VectorProgram* program;
+    const Distribution* distributions;
+    int numberDistributions;
+    uint64_t seed;
+    long long samples;
+    long long numberBlocks;
+    long long next;
+    int precision;
+    double* results;
+} MonteCarloRun;
+
+/* A position reached while walking a compiled expression without recursion
+ *
+ * const te_expr* node: node being visited
+ * int next: index of the next child of node to visit
+ */
+typedef struct {
+    const te_expr* node;
+    int next;
+} ExpressionFrame;
+
+/* A name tinyexpr resolves itself when it is not bound as a variable, with
+ * the function or value tinyexpr gives it
+ *
+ * const char* name: the name
+ * int type: TE_FUNCTION0 to TE_FUNCTION7 with TE_FLAG_PURE for a function, or
+ * TE_CONSTANT_TYPE for a function of no arguments, which is always folded
+ * const void* function: the function tinyexpr calls
+ * double value: the value of a TE_CONSTANT_TYPE name
+ */
+typedef struct {
+    const char* name;
+    int type;
+    const void* function;
+    double value;
+} ParseBuiltin;
+
+/* The functions tinyexpr builds expressions from, recovered by compiling
+ * probes with te_compile() so that parsed trees call exactly the same ones
+ *
+ * ParseBuiltin builtins[]: one entry for each of scriptBuiltins
+ * const void* operators[]: the function of each PARSE_ operator
+ */
+typedef struct {
+    ParseBuiltin builtins[SCRIPT_BUILTINS];
+    const void* operators[PARSE_OPERATORS];
+} ParseGrammar;
+
+/* One node of an expression being parsed. Nodes are kept in a pool until the
+ * tree is laid out, with the children of a node in consecutive entries of
+ * the parser's children
+ *
+ * int type: tinyexpr type of the node
+ * double value: value of a constant
+ * const void* pointer: address a variable is bound to or function called
+ * void* context: context passed to a closure
+ * int child: index in children of the first child
+ * int depth: number of levels in the subtree rooted at the node
+ * size_t bytes: bytes the subtree takes once laid out
+ */
+typedef struct {
+    int type;
+    double value;
+    const void* pointer;
+    void* context;
+    int child;
+    int depth;
+    size_t bytes;
+} ParseNode;
+
+/* An operator waiting on the parser's operator stack
+ *
+ * int kind: PARSE_BINARY, PARSE_PREFIX, PARSE_GROUP or PARSE_CALL
+ * int precedence: binding strength of a PARSE_BINARY operator
+ * int type: tinyexpr type of the node the operator makes
+ * const void* function: function of the node the operator makes
+ * void* context: context of a closure
+ * int arguments: number of arguments of a PARSE_CALL begun so far
+ */
+typedef struct {
+    int kind;
+    int precedence;
+    int type;
+    const void* function;
+    void* context;
+    int arguments;
+} ParseOperator;
+
+/* State of parsing one expression
+ *
+ * const char* next: next character to be read
+ * const te_variable* variables: bindings names are looked up in first
+ * int* table: open addressing index of variables, -1 for an empty entry, or
+ * NULL if there are too few variables to be worth one
+ * int tableSize: number of entries in table, a power of two
+ * const ParseGrammar* grammar: functions of the operators and builtins
+ * int token: PARSE_TOKEN_ kind of the token last read
+ * int type: tinyexpr type of a PARSE_TOKEN_FUNCTION token
+ * double value: value of a PARSE_TOKEN_NUMBER token
+ * const void* pointer: address or function of the token
+ * void* context: context of a closure token
+ * int operator: PARSE_ operator of a PARSE_TOKEN_INFIX token
+ * ParseNode* nodes: pool of nodes
+ * int numberNodes: number of nodes in the pool
+ * int* children: children of the nodes in the pool
+ * int numberChildren: number of entries used in children
+ * int* operands: stack of the nodes of finished operands
+ * int numberOperands: number of operands on the stack
+ * ParseOperator* operators: stack of operators waiting for their operands
+ * int numberOperators: number of operators on the stack
+ */
+typedef struct {
+    const char* next;
+    const te_variable* variables;
+    int* table;
+    int tableSize;
+    const ParseGrammar* grammar;
+    int token;
+    int type;
+    double value;
+    const void* pointer;
+    void* context;
+    int operator;
+    ParseNode* nodes;
+    int numberNodes;
+    int* children;
+    int numberChildren;
+    int* operands;
+    int numberOperands;
+    ParseOperator* operators;
+    int numberOperators;
+} ExpressionParser;
+
+/* Represents the collection of loops where each index corresponds to one loop
+ *
+ * char** names: array of strings with names of loops
+ * double* currentValue: array of the current value of the loop variable
+ * double* startingValue: array of the value the loop will start at if looped
+ * double* increment: array of amount by which currentValue will increase by
+ * when looped double* finalValue: array of values by which current will not
+ * exceed if looped
+ * long long nameBytes: bytes held by the names of the loops
+ * NameIndex index: index of names
+ */
+typedef struct {
+    char** names;
+    double* currentValue;
+    double* startingValue;
+    double* increment;
+    double* endValue;
+    int size;
+    long long nameBytes;
+    NameIndex index;
+} Loops;
+
+/* The optional clauses of a @loop
+ *
+ * char* predicate: expression following where, rows are printed only where it
+ * is greater than zero, or NULL if there is no where clause
+ * long long every: number following every, only the first of each that many
+ * iterations is printed, or 1 if there is no every clause
+ */
+typedef struct {
+    char* predicate;
+    long long every;
+} LoopClauses;
+
+/* Represents one compiled expression kept in a UqCache. The expression is
+ * compiled against values rather than against the caller's bindings, so it
+ * stays valid after the caller returns
+ *
+ * char* key: the expression followed by the name of every binding, each nul
+ * terminated, or NULL if the entry is empty
+ * size_t keyLength: number of bytes in key
+ * te_expr* expr: compiled expression
+ * double* values: one value for each binding, read by expr
+ * int numberValues: number of bindings
+ * long long bytes: bytes held by the key, values and tree of the entry
+ */
+typedef struct {
+    char* key;
+    size_t keyLength;
+    te_expr* expr;
+    double* values;
+    int numberValues;
+    long long bytes;
+} CacheEntry;
+
+/* A direct-mapped cache of compiled expressions shared by any number of
+ * contexts, indexed by an FNV-1a hash of the entry key
+ *
+ * CacheEntry entries[]: CACHE_SIZE entries
+ * long hits: number of lookups answered from the cache
+ * long misses: number of lookups that had to compile
+ */
+struct UqCache {
+    CacheEntry entries[CACHE_SIZE];
+    long hits;
+    long misses;
+};
+
+/* One span of a trace
+ *
+ * const char* name: phase the span covers, a string literal
+ * long long start: monotonic clock time the span began at in nanoseconds
+ * long long duration: length of the span in nanoseconds
+ * long long first: index of the first @loop iteration or row in the span or
+ * -1 if the span is not a chunk of iterations or rows
+ * long long count: number of iterations or rows in the span or -1
+ */
+typedef struct {
+    const char* name;
+    long long start;
+    long long duration;
+    long long first;
+    long long count;
+} TraceEvent;
+
+/* Spans recorded by one thread. Only the thread using the contexts a trace is
+ * attached to appends to it, so events are added without locks or atomics
+ *
+ * TraceEvent* events: recorded spans in the order they ended
+ * size_t size: number of spans recorded
+ * size_t capacity: number of spans events has room for
+ * long long dropped: spans not recorded because TRACE_MAX_EVENTS was reached
+ * long long thread: kernel thread id of the thread that created the trace
+ * long long origin: monotonic clock time the trace was created at
+ * int quiet: nonzero while inside a @loop or a block of rows, whose individual
+ * compiles, evaluations and formatting are covered by chunk spans instead
+ * long long chunkStart: time the current chunk of iterations began at
+ * long long chunkFirst: index of the first iteration of the current chunk
+ * long long chunkCount: number of iterations in the current chunk so far
+ */
+struct UqTrace {
+    TraceEvent* events;
+    size_t size;
+    size_t capacity;
+    long long dropped;
+    long long thread;
+    long long origin;
+    int quiet;
+    long long chunkStart;
+    long long chunkFirst;
+    long long chunkCount;
+};
+
+/* The values one statement was evaluated at and the results it gave, queued
+ * for a UqCrosscheck to evaluate again with tinyexpr
+ *
+ * char* text: the expression of the statement
+ * char** names: name of each binding
+ * const double** addresses: storage each scalar binding reads, NULL for an
+ * array variable
+ * int* arrays: index of the array variable each binding stands for or -1
+ * int count: number of bindings
+ * int engine: UQ_ENGINE_ that produced the results
+ * double* values: the value of every binding for each row, row by row
+ * double* results: the result of each row
+ * int rows: number of rows recorded
+ * int capacity: number of rows values and results have room for
+ * int unchecked: 1 if the statement nests too deeply for tinyexpr to compile
+ * or evaluate without overflowing its stack, so its rows are only counted
+ * struct CheckRecord* next: record queued after this one
+ */
+typedef struct CheckRecord {
+    char* text;
+    char** names;
+    const double** addresses;
+    int* arrays;
+    int count;
+    int engine;
+    double* values;
+    double* results;
+    int rows;
+    int capacity;
+    int unchecked;
+    struct CheckRecord* next;
+} CheckRecord;
+
+/* A background thread comparing the results of statements with tinyexpr's.
+ * Contexts queue records under the lock and never wait for them to be
+ * checked; records that would take the queue past CROSSCHECK_MAX_PENDING
+ * rows are dropped instead
+ *
+ * pthread_mutex_t lock: guards every field below thread
+ * pthread_cond_t queued: signalled when a record is queued or closing is set
+ * pthread_t thread: the thread checking records
+ * CheckRecord* head: oldest queued record or NULL
+ * CheckRecord* tail: newest queued record or NULL
+ * long long pending: rows queued and not yet checked
+ * int closing: 1 once the thread should stop after the queue is empty
+ * long long ulps: largest difference in units in the last place accepted
+ * FILE* report: file divergences and the summary are written to
+ * long long checked: rows checked so far
+ * long long diverged: rows whose results differed by more than ulps
+ * long long skipped: rows left unchecked because the queue was full or the
+ * statement nests too deeply for tinyexpr
+ */
+struct UqCrosscheck {
+    pthread_mutex_t lock;
+    pthread_cond_t queued;
+    pthread_t thread;
+    CheckRecord* head;
+    CheckRecord* tail;
+    long long pending;
+    int closing;
+    long long ulps;
+    FILE* report;
+    long long checked;
+    long long diverged;
+    long long skipped;
+};
+
+/* An immutable snapshot of scalar variables shared by every context attached
+ * to a BaseSlot. A snapshot is never modified after it is published and is
+ * freed when the last reference to it is released
+ *
+ * char** names: array of variable names
+ * double* values: array of variable values
+ * int size: number of variables
+ * int references: number of contexts and slots holding the snapshot
+ * NameIndex index: index of names, complete when the snapshot is published so
+ * that lookups never write to it
+ */
+typedef struct {
+    char** names;
+    double* values;
+    int size;
+    int references;
+    NameIndex index;
+} SharedBase;
+
+/* The publication point for a SharedBase. Readers pin the current snapshot
+ * without locking; a publisher swaps in a new snapshot with an atomic
+ * exchange and waits only for readers that are part way through pinning
+ * before dropping its reference to the old one, so readers never wait
+ *
+ * SharedBase* current: the most recently published snapshot
+ * int readers: number of readers part way through pinning current
+ * int references: number of contexts attached to the slot
+ */
+typedef struct {
+    SharedBase* current;
+    int readers;
+    int references;
+} BaseSlot;
+
+/* The header at the start of a snapshot image written by @save. Every offset
+ * is from the start of the image, so the image can be mapped anywhere and
+ * read in place. At valuesOffset are the variable values followed by the
+ * current, starting, increment and end values of every loop; at arraysOffset
+ * one SnapshotArray per array followed by the elements; at namesOffset one
+ * uint64 offset per variable, loop and array name followed by the nul
+ * terminated names. Images are in the byte order of the machine that wrote
+ * them
+ *
+ * char magic[]: SNAPSHOT_MAGIC
+ * uint32_t version: SNAPSHOT_VERSION
+ * uint32_t byteOrder: SNAPSHOT_BYTE_ORDER as written by the saving machine
+ * uint32_t sigFigs: significant figures setting
+ * uint32_t numberVariables: number of variables
+ * uint32_t numberLoops: number of loop variables
+ * uint32_t numberArrays: number of array variables
+ * uint64_t valuesOffset: offset of the variable and loop values
+ * uint64_t arraysOffset: offset of the array descriptions
+ * uint64_t namesOffset: offset of the name offsets
+ * uint64_t size: size of the whole image in bytes
+ */
+typedef struct {
+    char magic[SNAPSHOT_MAGIC_LENGTH];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t sigFigs;
+    uint32_t numberVariables;
+    uint32_t numberLoops;
+    uint32_t numberArrays;
+    uint64_t valuesOffset;
+    uint64_t arraysOffset;
+    uint64_t namesOffset;
+    uint64_t size;
+} SnapshotHeader;
+
+/* Describes one array variable of a snapshot image
+ *
+ * uint64_t offset: offset of the first element from the start of the image
+ * uint64_t length: number of elements
+ */
+typedef struct {
+    uint64_t offset;
+    uint64_t length;
+} SnapshotArray;
+
+/* The header at the start of a compiled script image written by
+ * uq_compile_script(). Every offset is from the start of the image, so the
+ * image can be mapped anywhere and run in place. The sections are arrays of
+ * ScriptStatement, ScriptInstruction, uint32 symbol references and
+ * ScriptSymbol followed by the nul terminated statement texts, symbol names and
+ * source path. Images are in the byte order of the machine that wrote them
+ *
+ * char magic[]: SCRIPT_MAGIC
+ * uint32_t version: SCRIPT_VERSION
+ * uint32_t byteOrder: SNAPSHOT_BYTE_ORDER as written by the compiling machine
+ * uint64_t hash: FNV-1a hash of the source the image was compiled from
+ * uint32_t numberStatements: number of statements, one per source line
+ * uint32_t numberInstructions: number of instructions of all statements
+ * uint32_t numberReferences: number of symbol references of all statements
+ * uint32_t numberSymbols: number of distinct names used by the script
+ * uint32_t numberFunctions: SCRIPT_FUNCTIONS of the compiling program
+ * uint64_t statementsOffset: offset of the statements
+ * uint64_t instructionsOffset: offset of the instructions
+ * uint64_t referencesOffset: offset of the symbol references
+ * uint64_t symbolsOffset: offset of the symbols
+ * uint64_t sourceOffset: offset of the absolute path of the source
+ * uint64_t size: size of the whole image in bytes
+ */
+typedef struct {
+    char magic[SCRIPT_MAGIC_LENGTH];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t hash;
+    uint32_t numberStatements;
+    uint32_t numberInstructions;
+    uint32_t numberReferences;
+    uint32_t numberSymbols;
+    uint32_t numberFunctions;
+    uint32_t reserved;
+    uint64_t statementsOffset;
+    uint64_t instructionsOffset;
+    uint64_t referencesOffset;
+    uint64_t symbolsOffset;
+    uint64_t sourceOffset;
+    uint64_t size;
+} ScriptHeader;
+
+/* One line of a compiled script. Lines that are not plain expressions,
+ * assignments or @loop commands, or that reference names that are not scalars
+ * when they run, are executed from their text
+ *
+ * uint32_t kind: SCRIPT_TEXT, SCRIPT_EXPRESSION, SCRIPT_ASSIGNMENT,
+ * SCRIPT_LOOP_EXPRESSION or SCRIPT_LOOP_ASSIGNMENT
+ * uint32_t target: symbol assigned to by an assignment
+ * uint64_t text: offset of the nul terminated text of the line
+ * uint32_t firstInstruction: index of the first instruction
+ * uint32_t numberInstructions: number of instructions in postfix order
+ * uint32_t firstReference: index of the first symbol reference
+ * uint32_t numberReferences: number of distinct names the line uses
+ * uint32_t depth: maximum depth of the evaluation stack
+ * uint32_t loop: symbol of the loop variable of a @loop
+ */
+typedef struct {
+    uint32_t kind;
+    uint32_t target;
+    uint64_t text;
+    uint32_t firstInstruction;
+    uint32_t numberInstructions;
+    uint32_t firstReference;
+    uint32_t numberReferences;
+    uint32_t depth;
+    uint32_t loop;
+} ScriptStatement;
+
+/* One operation of a compiled statement
+ *
+ * uint32_t opcode: SCRIPT_CONSTANT, SCRIPT_SYMBOL or SCRIPT_CALL
+ * uint32_t operand: symbol pushed by SCRIPT_SYMBOL or the index into
+ * scriptProbes of the function applied by SCRIPT_CALL
+ * double value: value pushed by SCRIPT_CONSTANT
+ */
+typedef struct {
+    uint32_t opcode;
+    uint32_t operand;
+    double value;
+} ScriptInstruction;
+
+/* A name used by a compiled script
+ *
+ * uint64_t name: offset of the nul terminated name
+ * uint32_t builtin: 1 if the name is a tinyexpr builtin, which must not be
+ * defined when the script runs, or 0 if it must be a scalar variable
+ * uint32_t reserved: padding, zero
+ */
+typedef struct {
+    uint64_t name;
+    uint32_t builtin;
+    uint32_t reserved;
+} ScriptSymbol;
+
+/* A compiled script being built in memory before it is written out
+ *
+ * ScriptStatement* statements: statements so far, text holding an index into
+ * texts until the image is written
+ * int numberStatements: number of statements
+ * ScriptInstruction* instructions: instructions of every statement
+ * int numberInstructions: number of instructions
+ * uint32_t* references: symbol references of every statement
+ * int numberReferences: number of symbol references
+ * char** names: name of every symbol
+ * uint32_t* builtins: builtin flag of every symbol
+ * int numberSymbols: number of symbols
+ * int* index: open addressing hash table of symbol indexes, -1 when empty
+ * int indexSize: number of entries in index, a power of two
+ * char** texts: text of every statement
+ * UqContext* context: context whose grammar expressions are compiled with
+ */
+typedef struct {
+    ScriptStatement* statements;
+    int numberStatements;
+    ScriptInstruction* instructions;
+    int numberInstructions;
+    uint32_t* references;
+    int numberReferences;
+    char** names;
+    uint32_t* builtins;
+    int numberSymbols;
+    int* index;
+    int indexSize;
+    char** texts;
+    UqContext* context;
+} ScriptBuilder;
+
+/* The state of script_emit() while it flattens an expression
+ *
+ * ScriptBuilder* builder: script being built
+ * const double* slots: addresses the statement's names were bound to
+ * const int* symbols: symbol of the name bound to each slot
+ * int numberSlots: number of entries in slots
+ * const void** functions: functions found by script_functions()
+ * int depth: current depth of the evaluation stack
+ * int maximum: maximum depth reached so far
+ */
+typedef struct {
+    ScriptBuilder* builder;
+    const double* slots;
+    const int* symbols;
+    int numberSlots;
+    const void** functions;
+    int depth;
+    int maximum;
+} ScriptEmitter;
+
+/* Evaluates one compiled statement natively, given the value of every symbol
+ * and the functions found by script_functions()
+ */
+typedef double (*ScriptNative)(const double*, const void* const*);
+
+/* The state of a compiled script while it runs
+ *
+ * int* hints: the variable index each symbol was last found at
+ * double* symbolValues: current value of each symbol
+ * const void* functions[]: functions found by script_functions()
+ * int arities[]: argument counts found by script_functions()
+ * ScriptNative const* natives: native code for each statement, NULL entries
+ * or a NULL table meaning the bytecode is interpreted
+ * int verify: 1 if native results are checked against the interpreter
+ * int mismatches: number of native results that differed
+ */
+typedef struct {
+    int* hints;
+    double* symbolValues;
+    const void* functions[SCRIPT_FUNCTIONS];
+    int arities[SCRIPT_FUNCTIONS];
+    ScriptNative const* natives;
+    int verify;
+    int mismatches;
+} ScriptRun;
+
+/* Expressions whose root is each function a compiled script may call. The
+ * position of an expression is the operand a SCRIPT_CALL stores, so that the
+ * image holds no addresses; the function pointers are recovered by compiling
+ * the expressions when a script is compiled or run
+ */
+static const char* const scriptProbes[SCRIPT_FUNCTIONS] = {"-x", "x+y", "x-y",
+        "x*y", "x/y", "x^y", "x%y", "x,y", "abs(x)", "acos(x)", "asin(x)",
+        "atan(x)", "atan2(x,y)", "ceil(x)", "cos(x)", "cosh(x)", "exp(x)",
+        "fac(x)", "floor(x)", "ln(x)", "log(x)", "log10(x)", "ncr(x,y)",
+        "npr(x,y)", "pow(x,y)", "sin(x)", "sinh(x)", "sqrt(x)", "tan(x)",
+        "tanh(x)"};
+
+/* Names tinyexpr resolves itself when they are not bound as variables
+ */
+static const char* const scriptBuiltins[SCRIPT_BUILTINS] = {"abs", "acos",
+        "asin", "atan", "atan2", "ceil", "cos", "cosh", "e", "exp", "fac",
+        "floor", "ln", "log", "log10", "ncr", "npr", "pi", "pow", "sin", "sinh",
+        "sqrt", "tan", "tanh"};
+
+/* Expressions te_compile() turns into a node calling the function of each
+ * PARSE_ operator, in the order of PARSE_SYMBOLS followed by negation and
+ * the comma operator
+ */
+static const char* const parseProbes[PARSE_OPERATORS]
+        = {"x+y", "x-y", "x*y", "x/y", "x^y", "x%y", "-x", "x,y"};
+
+/* How tightly each PARSE_ operator binds, as tinyexpr's grammar nests them
+ */
+static const int parsePrecedence[PARSE_OPERATORS] = {1, 1, 2, 2, 3, 2, 0, 0};
+
+/* Represents one evaluation session
+ *
+ * Variables variables: the variables and array variables of the session
+ * Loops loops: the loop variables of the session
+ * int sigFigs: number of significant figures to print doubles to
+ * int outputMode: UQ_OUTPUT_TEXT, UQ_OUTPUT_TSV or UQ_OUTPUT_BINARY
+ * int math: UQ_MATH_EXACT or UQ_MATH_FAST, how vector programs evaluate
+ * transcendental functions
+ * int precision: UQ_PRECISION_DOUBLE or UQ_PRECISION_FLOAT, the precision
+ * vector programs are evaluated in
+ * UqOutputFunction output: function output is passed to
+ * void* outputData: pointer passed to output
+ * char* buffer: OUTPUT_BUFFER_SIZE bytes of output waiting to be passed on
+ * size_t bufferLength: number of bytes waiting in buffer
+ * int errors: number of errors reported so far
+ * UqCache* cache: compiled expression cache or NULL if compiles are not cached
+ * BaseSlot* slot: shared base the context is attached to or NULL
+ * SharedBase* base: snapshot of slot pinned by the context or NULL; variables
+ * holds the context's own assignments, which hide base variables of the same
+ * name
+ * UqStats* stats: counters work is added to or NULL if it is not counted
+ * UqTrace* trace: buffer spans are recorded in or NULL if it is not traced
+ * long long memory[]: bytes held by the context in each UQ_MEMORY_ kind,
+ * counting cache entries it added less those it evicted
+ * long long memoryLimit: bytes the context tries to stay within or 0
+ * long long progress: @loop iterations between progress reports or 0
+ * char* arena: block that expressions compiled outside the cache are copied
+ * into, nodes in depth-first order, and released from in the reverse of the
+ * order they were compiled
+ * size_t arenaSize: number of bytes in arena
+ * size_t arenaUsed: number of bytes of arena holding expressions
+ * ParseGrammar grammar: functions expressions are parsed into, recovered the
+ * first time the context parses one
+ * int grammarReady: 1 once grammar has been recovered, otherwise 0
+ * int engine: UQ_ENGINE_TREE or UQ_ENGINE_VECTOR, how scalar statements and
+ * @loop are evaluated
+ * UqCrosscheck* crosscheck: crosscheck statements are queued on or NULL
+ * CheckRecord* checking: record of the statement being evaluated for
+ * crosscheck or NULL
+ * int interrupted: 1 once uq_interrupt() has asked the running statement to
+ * stop, until the statement reports it
+ * long long timeLimit: nanoseconds a @loop may run for or 0
+ * long long deadline: CLOCK_MONOTONIC time the running statement must stop
+ * by, or 0
+ */
+struct UqContext {
+    Variables variables;
+    Loops loops;
+    int sigFigs;
+    int outputMode;
+    int math;
+    int precision;
+    UqOutputFunction output;
+    void* outputData;
+    char* buffer;
+    size_t bufferLength;
+    int errors;
+    UqCache* cache;
+    BaseSlot* slot;
+    SharedBase* base;
+    UqStats* stats;
+    UqTrace* trace;
+    long long memory[UQ_MEMORY_KINDS];
+    long long memoryLimit;
+    long long progress;
+    char* arena;
+    size_t arenaSize;
+    size_t arenaUsed;
+    ParseGrammar grammar;
+    int grammarReady;
+    int engine;
+    UqCrosscheck* crosscheck;
+    CheckRecord* checking;
+    int interrupted;
+    long long timeLimit;
+    long long deadline;
+};
+
+static int reallocate_loops(Loops*, char*, double, double, double);
+static int range_new_loop(UqContext*, char*, double, double, double);
+static int range_allocate_loop(UqContext*, char*, double, double, double);
+static int print_variables(UqContext*);
+static te_expr* compile_cached(
+        UqContext*, const char*, te_variable*, int, int*);
+static te_expr* compile_uncached(
+        UqContext*, const char*, te_variable*, int, long long);
+static void compile_release(UqContext*, te_expr*, int);
+static void arena_release(UqContext*, te_expr*);
+static int expression_walk(
+        const te_expr*, int (*)(const te_expr*, void*), void*);
+static double expression_eval(const te_expr*);
+static int evaluate_quietly(UqContext*, const char*, double*);
+static VectorProgram* engine_prepare(
+        UqContext*, const te_expr*, VectorProgram*);
+static double engine_evaluate(
+        UqContext*, const te_expr*, const VectorProgram*);
+static int vector_precision(const UqContext*);
+static int vector_compile(
+        const te_expr*, VectorProgram*, double*, const int*, int, int);
+static int vector_free(VectorProgram*);
+static double* vector_allocate(int);
+static int vector_evaluate(const VectorProgram*, double**, int, double*, int);
+
+/* Writes output to stdout and errors to stderr, used when no output function
+ * has been set
+ *
+ * void* data: unused
+ * int stream: UQ_STREAM_OUTPUT or UQ_STREAM_ERROR
+ * const char* text: bytes to write
+ * size_t length: number of bytes to write
+ */
+static void default_output(
+        void* data, int stream, const char* text, size_t length)
+{
+    (void)data;
+    fwrite(text, 1, length, (stream == UQ_STREAM_ERROR) ? stderr : stdout);
+}
+
+/* Reads the monotonic clock
+ *
+ * Returns the time in nanoseconds
+ */
+static long long clock_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * NANOSECONDS_PER_SECOND + now.tv_nsec;
+}
+
+/* Reads the monotonic clock if a context is counting or tracing its work
+ *
+ * const UqContext* context: context whose work is timed
+ *
+ * Returns the time in nanoseconds or 0 if the context is not timing its work
+ */
+static long long work_clock(const UqContext* context)
+{
+    if (!STATS_ENABLED(context) && !TRACE_ENABLED(context)) {
+        return 0;
+    }
+    return clock_now();
+}
+
+/* Appends a span to a trace, growing its buffer up to TRACE_MAX_EVENTS
+ *
+ * UqTrace* trace: trace to record in
+ * const char* name: phase the span covers, a string literal
+ * long long start: time the span began at in nanoseconds
+ * long long end: time the span ended at in nanoseconds
+ * long long first: first iteration or row of a chunk or -1
+ * long long count: number of iterations or rows in a chunk or -1
+ */
+static void trace_record(UqTrace* trace, const char* name, long long start,
+        long long end, long long first, long long count)
+{
+    if (trace->size == trace->capacity) {
+        size_t capacity = trace->capacity * 2;
+        TraceEvent* events = (capacity <= TRACE_MAX_EVENTS)
+                ? (TraceEvent*)realloc(
+                        trace->events, capacity * sizeof(TraceEvent))
+                : NULL;
+        if (events == NULL) {
+            trace->dropped++;
+            return;
+        }
+        trace->events = events;
+        trace->capacity = capacity;
+    }
+    TraceEvent event = {.name = name,
+            .start = start,
+            .duration = end - start,
+            .first = first,
+            .count = count};
+    trace->events[trace->size++] = event;
+}
+
+/* Records a span of a context's work that began at a time read with
+ * work_clock()
+ *
+ * UqContext* context: context the work was done in
+ * const char* name: phase the span covers, a string literal
+ * long long start: time returned by work_clock() when the work began
+ */
+static void trace_span(UqContext* context, const char* name, long long start)
+{
+    if (start != 0 && TRACE_ENABLED(context)) {
+        trace_record(context->trace, name, start, clock_now(), -1, -1);
+    }
+}
+
+/* Starts or stops recording a context's work as chunks instead of individual
+ * spans. Calls nest
+ *
+ * UqContext* context: context entering or leaving a @loop or block of rows
+ * int quiet: 1 on entering and 0 on leaving
+ */
+static void trace_quiet(UqContext* context, int quiet)
+{
+    if (TRACE_ATTACHED(context)) {
+        context->trace->quiet += quiet ? 1 : -1;
+    }
+}
+
+/* Begins recording the iterations of a @loop as chunks of TRACE_LOOP_CHUNK
+ * iterations
+ *
+ * UqContext* context: context running the loop
+ */
+static void trace_loop_begin(UqContext* context)
+{
+    if (TRACE_ATTACHED(context)) {
+        trace_quiet(context, 1);
+        context->trace->chunkFirst = 0;
+        context->trace->chunkCount = 0;
+        context->trace->chunkStart = clock_now();
+    }
+}
+
+/* Counts an iteration of a @loop, recording a chunk once it holds
+ * TRACE_LOOP_CHUNK iterations
+ *
+ * UqContext* context: context running the loop
+ */
+static void trace_loop_step(UqContext* context)
+{
+    if (TRACE_ATTACHED(context)
+            && ++context->trace->chunkCount == TRACE_LOOP_CHUNK) {
+        UqTrace* trace = context->trace;
+        long long now = clock_now();
+        trace_record(trace, "@loop", trace->chunkStart, now,
+                trace->chunkFirst, trace->chunkCount);
+        trace->chunkFirst += trace->chunkCount;
+        trace->chunkCount = 0;
+        trace->chunkStart = now;
+    }
+}
+
+/* Ends recording the iterations of a @loop, recording the last partial chunk
+ *
+ * UqContext* context: context that ran the loop
+ */
+static void trace_loop_end(UqContext* context)
+{
+    if (TRACE_ATTACHED(context)) {
+        UqTrace* trace = context->trace;
+        if (trace->chunkCount > 0) {
+            trace_record(trace, "@loop", trace->chunkStart, clock_now(),
+                    trace->chunkFirst, trace->chunkCount);
+        }
+        trace->chunkCount = 0;
+        trace_quiet(context, 0);
+    }
+}
+
+/* Adds to the bytes a context holds of one kind, updating the current and peak
+ * bytes of any UqStats attached to it
+ *
+ * UqContext* context: context holding the memory
+ * int kind: UQ_MEMORY_SYMBOLS, UQ_MEMORY_NAMES, UQ_MEMORY_EXPRESSIONS or
+ * UQ_MEMORY_BUFFERS
+ * long long bytes: bytes allocated, or negative for bytes freed
+ */
+static void memory_add(UqContext* context, int kind, long long bytes)
+{
+    context->memory[kind] += bytes;
+    if (STATS_ENABLED(context)) {
+        UqStats* stats = context->stats;
+        stats->memoryBytes[kind] += bytes;
+        if (stats->memoryBytes[kind] > stats->memoryPeak[kind]) {
+            stats->memoryPeak[kind] = stats->memoryBytes[kind];
+        }
+    }
+}
+
+/* Brings the symbol table and name bytes of a context up to date with the
+ * sizes of its variables, loops, arrays and name indexes
+ *
+ * UqContext* context: context to update
+ */
+static void memory_sync(UqContext* context)
+{
+    const Variables* variables = &(context->variables);
+    const Loops* loops = &(context->loops);
+    long long symbols = variables->size * VARIABLE_BYTES
+            + loops->size * LOOP_BYTES + variables->arraySize * ARRAY_BYTES
+            + variables->elements * sizeof(double)
+            + (variables->index.capacity + variables->arrayIndex.capacity
+                      + loops->index.capacity)
+                    * sizeof(int);
+    memory_add(context, UQ_MEMORY_SYMBOLS,
+            symbols - context->memory[UQ_MEMORY_SYMBOLS]);
+    memory_add(context, UQ_MEMORY_NAMES,
+            variables->nameBytes + loops->nameBytes
+                    - context->memory[UQ_MEMORY_NAMES]);
+}
+
+/* Checks whether a context holds more than its memory limit
+ *
+ * UqContext* context: context to check
+ *
+ * Returns 1 if the context has a limit and is over it, otherwise 0
+ */
+static int memory_over(UqContext* context)
+{
+    if (context->memoryLimit == 0) {
+        return 0;
+    }
+    memory_sync(context);
+    long long total = 0;
+    for (int kind = 0; kind < UQ_MEMORY_KINDS; kind++) {
+        total += context->memory[kind];
+    }
+    return total > context->memoryLimit;
+}
+
+/* Passes output of a context to its output function, counting the bytes and
+ * the time the function takes
+ *
+ * UqContext* context: context the output belongs to
+ * int stream: UQ_STREAM_OUTPUT or UQ_STREAM_ERROR
+ * const char* text: bytes to pass on
+ * size_t length: number of bytes in text
+ */
+static void uq_emit(
+        UqContext* context, int stream, const char* text, size_t length)
+{
+    long long start = (STATS_ENABLED(context) || TRACE_ATTACHED(context))
+            ? clock_now()
+            : 0;
+    context->output(context->outputData, stream, text, length);
+    STATS_ADD(context, outputBytes, length);
+    if (start != 0) {
+        long long end = clock_now();
+        STATS_ADD(context, outputNanoseconds, end - start);
+        if (TRACE_ATTACHED(context)) {
+            trace_record(context->trace, "write", start, end, -1, -1);
+        }
+    }
+}
+
+/* Passes any buffered output of a context on to its output function
+ *
+ * UqContext* context: context whose output should be flushed
+ *
+ * Returns 0
+ */
+static int uq_flush(UqContext* context)
+{
+    if (context->bufferLength > 0) {
+        uq_emit(context, UQ_STREAM_OUTPUT, context->buffer,
+                context->bufferLength);
+        context->bufferLength = 0;
+    }
+    return 0;
+}
+
+/* Appends bytes to the output buffer of a context, flushing it when full or
+ * when the context is over its memory limit
+ *
+ * UqContext* context: context to write to
+ * const void* bytes: bytes to write
+ * size_t length: number of bytes to write
+ *
+ * Returns 0
+ */
+static int uq_write(UqContext* context, const void* bytes, size_t length)
+{
+    if (context->bufferLength + length > OUTPUT_BUFFER_SIZE
+            || (context->bufferLength > 0 && memory_over(context))) {
+        uq_flush(context);
+        if (length > OUTPUT_BUFFER_SIZE) {
+            uq_emit(context, UQ_STREAM_OUTPUT, (const char*)bytes, length);
+            return 0;
+        }
+    }
+    memcpy(context->buffer + context->bufferLength, bytes, length);
+    context->bufferLength += length;
+    return 0;
+}
+
+/* Writes text output of a context. In the binary output mode stdout must hold
+ * only UQXB records, so the text goes to the error stream instead, after the
+ * records buffered before it
+ *
+ * UqContext* context: context to write to
+ * const char* text: text to write
+ * size_t length: number of bytes in text
+ *
+ * Returns 0
+ */
+static int uq_text(UqContext* context, const char* text, size_t length)
+{
+    if (context->outputMode != UQ_OUTPUT_BINARY) {
+        return uq_write(context, text, length);
+    }
+    uq_flush(context);
+    uq_emit(context, UQ_STREAM_ERROR, text, length);
+    return 0;
+}
+
+/* Formats text as printf() does and writes it with uq_text()
+ *
+ * UqContext* context: context to write to
+ * const char* format: printf() format string followed by its arguments
+ *
+ * Returns 0
+ */
+static int uq_printf(UqContext* context, const char* format, ...)
+{
+    char text[PRINT_BUFFER_SIZE];
+    long long start = TRACE_ENABLED(context) ? clock_now() : 0;
+    va_list arguments;
+    va_start(arguments, format);
+    int length = vsnprintf(text, sizeof(text), format, arguments);
+    va_end(arguments);
+    trace_span(context, "format", start);
+    if (length < (int)sizeof(text)) {
+        return uq_text(context, text, length);
+    }
+    char* longText = (char*)malloc(length + 1);
+    va_start(arguments, format);
+    vsnprintf(longText, length + 1, format, arguments);
+    va_end(arguments);
+    uq_text(context, longText, length);
+    free((void*)longText);
+    return 0;
+}
+
+/* Reports that a command, expression or assignment could not be carried out
+ *
+ * UqContext* context: context the error occurred in
+ *
+ * Returns 0
+ */
+static int command_error(UqContext* context)
+{
+    const char* message = "Error in command, expression or assignment "
+                          "operation\n";
+    uq_flush(context);
+    uq_emit(context, UQ_STREAM_ERROR, message, strlen(message));
+    context->errors++;
+    return 0;
+}
+
+/* Reports a statement that uq_interrupt() stopped as an error, so that the
+ * next statement runs normally
+ *
+ * UqContext* context: context the statement ran in
+ *
+ * Returns 1 if the statement was interrupted, otherwise 0
+ */
+static int statement_interrupted(UqContext* context)
+{
+    context->deadline = 0;
+    if (!context->interrupted) {
+        return 0;
+    }
+    context->interrupted = 0;
+    command_error(context);
+    return 1;
+}
+
+/* Starts the time limit of a statement, if the context has one
+ *
+ * UqContext* context: context about to run a statement
+ */
+static void statement_begin(UqContext* context)
+{
+    context->deadline
+            = (context->timeLimit > 0) ? clock_now() + context->timeLimit : 0;
+}
+
+/* Computes the 64 bit FNV-1a hash of a run of bytes
+ *
+ * const char* bytes: bytes to hash
+ * size_t length: number of bytes
+ * unsigned long long hash: hash of any bytes before these, FNV_OFFSET to start
+ *
+ * Returns the hash
+ */
+static unsigned long long hash_bytes(
+        const char* bytes, size_t length, unsigned long long hash)
+{
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (unsigned char)bytes[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+/* Empties a name index, freeing its slots. The names are indexed again by the
+ * next lookup
+ *
+ * NameIndex* index: index to empty
+ */
+static void name_index_reset(NameIndex* index)
+{
+    free((void*)index->positions);
+    index->positions = NULL;
+    index->capacity = 0;
+    index->indexed = 0;
+}
+
+/* Brings a name index up to date with the names appended to its array,
+ * growing and rebuilding it when it would become more than half full or when
+ * names it had indexed have been removed
+ *
+ * NameIndex* index: index to update
+ * char** names: names the index covers
+ * int size: number of names
+ */
+static void name_index_sync(NameIndex* index, char** names, int size)
+{
+    if (index->indexed == size) {
+        return;
+    }
+    if (index->indexed > size || 2 * size > index->capacity) {
+        while (2 * size > index->capacity) {
+            index->capacity = (index->capacity == 0) ? INDEX_MIN_CAPACITY
+                                                     : 2 * index->capacity;
+        }
+        index->positions = (int*)realloc(
+                (void*)index->positions, index->capacity * sizeof(int));
+        memset(index->positions, -1, index->capacity * sizeof(int));
+        index->indexed = 0;
+    }
+    int mask = index->capacity - 1;
+    for (int i = index->indexed; i < size; i++) {
+        int slot = hash_bytes(names[i], strlen(names[i]), FNV_OFFSET) & mask;
+        while (index->positions[slot] != -1) {
+            slot = (slot + 1) & mask;
+        }
+        index->positions[slot] = i;
+    }
+    index->indexed = size;
+}
+
+/* Finds a name given by its first bytes. Positions are indexed in order, so
+ * the first of several equal names is found
+ *
+ * NameIndex* index: index of names
+ * char** names: names to search
+ * int size: number of names
+ * const char* name: start of the name to look for
+ * size_t length: number of bytes in the name
+ *
+ * Returns the position of the name or -1 if it is not found
+ */
+static int name_lookup(NameIndex* index, char** names, int size,
+        const char* name, size_t length)
+{
+    name_index_sync(index, names, size);
+    if (index->capacity == 0) {
+        return -1;
+    }
+    int mask = index->capacity - 1;
+    int slot = hash_bytes(name, length, FNV_OFFSET) & mask;
+    while (index->positions[slot] != -1) {
+        int i = index->positions[slot];
+        if (!strncmp(names[i], name, length) && names[i][length] == '\0') {
+            return i;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return -1;
+}
+
+/* Finds a variable by name
+ *
+ * NameIndex* index: index of names
+ * char** names: names to search
+ * int size: number of names
+ * const char* name: name to look for
+ *
+ * Returns the index of the name or -1 if it is not found
+ */
+static int name_find(
+        NameIndex* index, char** names, int size, const char* name)
+{
+    return name_lookup(index, names, size, name, strlen(name));
+}
+
+/* Drops a reference to a shared base snapshot, freeing it if it was the last
+ *
+ * SharedBase* base: snapshot to release, may be NULL
+ */
+static void base_release(SharedBase* base)
+{
+    if (base == NULL
+            || __atomic_sub_fetch(&(base->references), 1, __ATOMIC_SEQ_CST)
+                    > 0) {
+        return;
+    }
+    for (int i = 0; i < base->size; i++) {
+        free((void*)base->names[i]);
+    }
+    free((void*)base->names);
+    free((void*)base->values);
+    name_index_reset(&(base->index));
+    free((void*)base);
+}
+
+/* Pins the snapshot currently published in a context's slot, releasing the
+ * one pinned before. Called at the start of each statement so that a newly
+ * published base is seen from the next statement on
+ *
+ * UqContext* context: context to update
+ *
+ * Returns 0
+ */
+static int base_refresh(UqContext* context)
+{
+    BaseSlot* slot = context->slot;
+    if (slot == NULL
+            || __atomic_load_n(&(slot->current), __ATOMIC_SEQ_CST)
+                    == context->base) {
+        return 0;
+    }
+    __atomic_add_fetch(&(slot->readers), 1, __ATOMIC_SEQ_CST);
+    SharedBase* base = __atomic_load_n(&(slot->current), __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&(base->references), 1, __ATOMIC_SEQ_CST);
+    __atomic_sub_fetch(&(slot->readers), 1, __ATOMIC_SEQ_CST);
+    base_release(context->base);
+    context->base = base;
+    return 0;
+}
+
+/* Finds a variable of the pinned base that is not hidden by one of the
+ * context's own variables or loop variables
+ *
+ * UqContext* context: context to search
+ * const char* name: name to look for
+ *
+ * Returns the index of the base variable or -1 if there is none
+ */
+static int base_find(UqContext* context, const char* name)
+{
+    Variables* variables = &(context->variables);
+    Loops* loops = &(context->loops);
+    SharedBase* base = context->base;
+    if (base == NULL
+            || name_find(&(variables->index), variables->names,
+                       variables->size, name)
+                    != -1
+            || name_find(&(loops->index), loops->names, loops->size, name)
+                    != -1) {
+        return -1;
+    }
+    return name_find(&(base->index), base->names, base->size, name);
+}
+
+/* Creates a snapshot of every scalar variable visible to a context: the
+ * visible variables of its base followed by its own variables
+ *
+ * UqContext* context: context whose variables are copied
+ *
+ * Returns the new snapshot holding one reference
+ */
+static SharedBase* base_snapshot(UqContext* context)
+{
+    Variables* variables = &(context->variables);
+    int baseSize = (context->base != NULL) ? context->base->size : 0;
+    SharedBase* base = (SharedBase*)malloc(sizeof(SharedBase));
+    base->names = (char**)malloc((baseSize + variables->size + 1)
+            * sizeof(char*));
+    base->values = (double*)malloc((baseSize + variables->size + 1)
+            * sizeof(double));
+    base->size = 0;
+    base->references = 1;
+    memset(&(base->index), 0, sizeof(NameIndex));
+    for (int i = 0; i < baseSize; i++) {
+        if (base_find(context, context->base->names[i]) == i) {
+            base->names[base->size] = strdup(context->base->names[i]);
+            base->values[base->size] = context->base->values[i];
+            base->size++;
+        }
+    }
+    for (int i = 0; i < variables->size; i++) {
+        if (strcmp(variables->names[i], " ") != 0) {
+            base->names[base->size] = strdup(variables->names[i]);
+            base->values[base->size] = variables->values[i];
+            base->size++;
+        }
+    }
+    name_index_sync(&(base->index), base->names, base->size);
+    return base;
+}
+
+/* Atomically publishes a snapshot of a context's visible scalar variables as
+ * the new base of its slot, after which the context's own variables are
+ * dropped in favour of it. Other contexts attached to the slot see it from
+ * their next statement; their own assignments still hide it
+ *
+ * UqContext* context: context attached to a slot
+ *
+ * Returns 0 or 1 if the context is not attached to a slot
+ */
+static int base_publish(UqContext* context)
+{
+    BaseSlot* slot = context->slot;
+    if (slot == NULL) {
+        return 1;
+    }
+    SharedBase* base = base_snapshot(context);
+    SharedBase* old
+            = __atomic_exchange_n(&(slot->current), base, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&(slot->readers), __ATOMIC_SEQ_CST) != 0) {
+        sched_yield();
+    }
+    base_release(old);
+    base_refresh(context);
+    Variables* variables = &(context->variables);
+    for (int i = 0; i < variables->size; i++) {
+        variables->nameBytes -= strlen(variables->names[i]) + 1;
+        free((void*)variables->names[i]);
+    }
+    variables->size = 0;
+    variables->converted = 0;
+    name_index_reset(&(variables->index));
+    memory_sync(context);
+    return 0;
+}
+
+/* Binds every scalar variable visible to a context, copying their values so
+ * that evaluating cannot change the context. Variables of the base come first,
+ * in the order they were defined and with the context's own value if it has
+ * one, followed by the context's other variables
+ *
+ * UqContext* context: context holding the variables
+ * te_variable* tevars: array of tinyexpr bindings to fill in, with room for
+ * scalar_capacity() bindings
+ * double* values: array with room for scalar_capacity() values
+ *
+ * Returns the number of bindings added to tevars
+ */
+static int bind_scalars(UqContext* context, te_variable* tevars, double* values)
+{
+    Variables* variables = &(context->variables);
+    SharedBase* base = context->base;
+    int index = 0;
+    Loops* loops = &(context->loops);
+    for (int i = 0; base != NULL && i < base->size; i++) {
+        if (name_find(&(loops->index), loops->names, loops->size,
+                    base->names[i])
+                != -1) {
+            continue;
+        }
+        int j = name_find(&(variables->index), variables->names,
+                variables->size, base->names[i]);
+        values[index] = (j != -1) ? variables->values[j] : base->values[i];
+        te_variable var = {.name = base->names[i],
+                .address = &(values[index]),
+                .type = TE_VARIABLE,
+                .context = NULL};
+        tevars[index] = var;
+        index++;
+    }
+    for (int i = 0; i < variables->size; i++) {
+        if (strcmp(variables->names[i], " ") != 0
+                && (base == NULL
+                        || name_find(&(base->index), base->names, base->size,
+                                   variables->names[i])
+                                == -1)) {
+            values[index] = variables->values[i];
+            te_variable var = {.name = variables->names[i],
+                    .address = &(values[index]),
+                    .type = TE_VARIABLE,
+                    .context = NULL};
+            tevars[index] = var;
+            index++;
+        }
+    }
+    return index;
+}
+
+/* Returns the most scalar variables bind_scalars() can bind for a context
+ *
+ * UqContext* context: context holding the variables
+ */
+static int scalar_capacity(UqContext* context)
+{
+    return context->variables.size
+            + ((context->base != NULL) ? context->base->size : 0);
+}
+
+/* Finds the next name in an expression the way tinyexpr splits it into
+ * tokens, skipping numbers so that an exponent such as the e of 1e5 is not
+ * taken for a name
+ *
+ * const char* text: remainder of the expression
+ * size_t* length: pointer to where the length of the name will be stored
+ *
+ * Returns the start of the name or NULL if there are no more names
+ */
+static const char* expression_name(const char* text, size_t* length)
+{
+    while (*text != '\0') {
+        if (isdigit((unsigned char)*text) || *text == '.') {
+            char* end;
+            strtod(text, &end);
+            text = (end > text) ? end : text + 1;
+        } else if (*text >= 'a' && *text <= 'z') {
+            const char* start = text;
+            while ((*text >= 'a' && *text <= 'z')
+                    || isdigit((unsigned char)*text) || *text == '_') {
+                text++;
+            }
+            *length = text - start;
+            return start;
+        } else {
+            text++;
+        }
+    }
+    return NULL;
+}
+
+/* Binds the names an expression refers to, looking each one up once in the
+ * name indexes so that the cost follows the expression rather than the number
+ * of variables. A variable of the context hides a loop variable of the same
+ * name, which hides a variable of the base. Names that are not defined are
+ * left for tinyexpr to resolve as builtins. The bindings read the context's
+ * own storage, so they stay valid until a variable or loop is added
+ *
+ * UqContext* context: context holding the variables, loops and arrays
+ * const char* expression: expression to bind
+ * int arrays: 1 to bind array variables to NaN slots, 0 to leave them unbound
+ * Bindings* bindings: bindings to fill in, freed with bindings_free()
+ */
+static void bind_referenced(UqContext* context, const char* expression,
+        int arrays, Bindings* bindings)
+{
+    Variables* variables = &(context->variables);
+    Loops* loops = &(context->loops);
+    SharedBase* base = context->base;
+    size_t length;
+    int capacity = 1;
+    for (const char* name = expression_name(expression, &length); name != NULL;
+            name = expression_name(name + length, &length)) {
+        capacity++;
+    }
+    bindings->tevars = (te_variable*)malloc(capacity * sizeof(te_variable));
+    bindings->count = 0;
+    bindings->slots = (double*)malloc(capacity * sizeof(double));
+    bindings->arrays = (int*)malloc(capacity * sizeof(int));
+    bindings->numberSlots = 0;
+    for (const char* name = expression_name(expression, &length); name != NULL;
+            name = expression_name(name + length, &length)) {
+        const char* bound = NULL;
+        const double* address = NULL;
+        int i = name_lookup(&(variables->index), variables->names,
+                variables->size, name, length);
+        int k = -1;
+        if (i != -1) {
+            bound = variables->names[i];
+            address = &(variables->values[i]);
+        } else if ((i = name_lookup(&(loops->index), loops->names,
+                            loops->size, name, length))
+                != -1) {
+            bound = loops->names[i];
+            address = &(loops->currentValue[i]);
+        } else if (base != NULL
+                && (i = name_lookup(&(base->index), base->names, base->size,
+                            name, length))
+                        != -1) {
+            bound = base->names[i];
+            address = &(base->values[i]);
+        } else if (arrays
+                && (k = name_lookup(&(variables->arrayIndex),
+                            variables->arrayNames, variables->arraySize, name,
+                            length))
+                        != -1) {
+            bound = variables->arrayNames[k];
+        }
+        int seen = (bound == NULL);
+        for (int j = 0; j < bindings->count && !seen; j++) {
+            seen = (bindings->tevars[j].name == bound);
+        }
+        if (seen) {
+            continue;
+        }
+        if (k != -1) {
+            address = &(bindings->slots[bindings->numberSlots]);
+            bindings->slots[bindings->numberSlots] = NAN;
+            bindings->arrays[bindings->numberSlots] = k;
+            bindings->numberSlots++;
+        }
+        te_variable var = {.name = bound,
+                .address = address,
+                .type = TE_VARIABLE,
+                .context = NULL};
+        bindings->tevars[bindings->count] = var;
+        bindings->count++;
+    }
+}
+
+/* Frees the bindings made by bind_referenced()
+ *
+ * Bindings* bindings: bindings to free
+ */
+static void bindings_free(Bindings* bindings)
+{
+    free((void*)bindings->tevars);
+    free((void*)bindings->slots);
+    free((void*)bindings->arrays);
+}
+
+/* Frees a crosscheck record and everything it holds
+ *
+ * CheckRecord* record: record to free, may be NULL
+ */
+static void crosscheck_free(CheckRecord* record)
+{
+    if (record == NULL) {
+        return;
+    }
+    for (int k = 0; k < record->count; k++) {
+        free((void*)record->names[k]);
+    }
+    free((void*)record->names);
+    free((void*)record->addresses);
+    free((void*)record->arrays);
+    free((void*)record->values);
+    free((void*)record->results);
+    free((void*)record->text);
+    free((void*)record);
+}
+
+/* Creates an empty crosscheck record for a statement
+ *
+ * const char* text: the expression of the statement
+ * int count: number of bindings
+ * int engine: UQ_ENGINE_ that evaluates the statement
+ *
+ * Returns the record, with the names, addresses and arrays of its bindings
+ * left for the caller to fill in
+ */
+static CheckRecord* crosscheck_record(const char* text, int count, int engine)
+{
+    CheckRecord* record = (CheckRecord*)malloc(sizeof(CheckRecord));
+    record->text = strdup(text);
+    record->names = (char**)malloc((count + 1) * sizeof(char*));
+    record->addresses
+            = (const double**)malloc((count + 1) * sizeof(const double*));
+    record->arrays = (int*)malloc((count + 1) * sizeof(int));
+    record->count = count;
+    record->engine = engine;
+    record->values = NULL;
+    record->results = NULL;
+    record->rows = 0;
+    record->capacity = 0;
+    record->unchecked = 0;
+    record->next = NULL;
+    return record;
+}
+
+/* Works out how deeply the parentheses of an expression nest, which is how
+ * deeply te_compile() recurses to parse it
+ *
+ * const char* text: the expression
+ *
+ * Returns the greatest number of parentheses open at once
+ */
+static int crosscheck_nesting(const char* text)
+{
+    int depth = 0;
+    int deepest = 0;
+    for (; *text != '\0'; text++) {
+        if (*text == '(') {
+            depth++;
+            if (depth > deepest) {
+                deepest = depth;
+            }
+        } else if (*text == ')' && depth > 0) {
+            depth--;
+        }
+    }
+    return deepest;
+}
+
+/* Starts recording a statement for the crosscheck attached to a context, if
+ * there is one. A statement tinyexpr's recursive parser or evaluator could
+ * not handle without overflowing the crosscheck thread's stack, because it is
+ * marked EXPRESSION_DEEP or its parentheses nest more than
+ * EXPRESSION_MAX_RECURSION deep, is recorded as unchecked
+ *
+ * UqContext* context: context evaluating the statement
+ * const char* text: the expression of the statement
+ * const Bindings* bindings: bindings the expression was compiled against
+ * const te_expr* expr: the compiled expression
+ */
+static void crosscheck_begin(UqContext* context, const char* text,
+        const Bindings* bindings, const te_expr* expr)
+{
+    if (context->crosscheck == NULL) {
+        return;
+    }
+    crosscheck_free(context->checking);
+    CheckRecord* record
+            = crosscheck_record(text, bindings->count, context->engine);
+    record->unchecked = (expr->type & EXPRESSION_DEEP)
+            || crosscheck_nesting(text) > EXPRESSION_MAX_RECURSION;
+    for (int k = 0; k < bindings->count; k++) {
+        const te_variable* var = &(bindings->tevars[k]);
+        record->names[k] = strdup(var->name);
+        record->addresses[k] = (const double*)var->address;
+        record->arrays[k] = -1;
+        for (int s = 0; s < bindings->numberSlots; s++) {
+            if (var->address == &(bindings->slots[s])) {
+                record->addresses[k] = NULL;
+                record->arrays[k] = bindings->arrays[s];
+            }
+        }
+    }
+    context->checking = record;
+}
+
+/* Passes a record to the crosscheck thread, or drops it if the queue is full
+ *
+ * UqCrosscheck* check: crosscheck to queue the record on
+ * CheckRecord* record: record to queue, owned by the crosscheck afterwards
+ */
+static void crosscheck_submit(UqCrosscheck* check, CheckRecord* record)
+{
+    pthread_mutex_lock(&(check->lock));
+    if (record->unchecked
+            || check->pending + record->rows > CROSSCHECK_MAX_PENDING) {
+        check->skipped += record->rows;
+        pthread_mutex_unlock(&(check->lock));
+        crosscheck_free(record);
+        return;
+    }
+    if (check->tail == NULL) {
+        check->head = record;
+    } else {
+        check->tail->next = record;
+    }
+    check->tail = record;
+    check->pending += record->rows;
+    pthread_cond_signal(&(check->queued));
+    pthread_mutex_unlock(&(check->lock));
+}
+
+/* Makes room for one more row in the record of the statement a context is
+ * evaluating, queueing the record and starting another for the same
+ * statement once it holds CROSSCHECK_RECORD_ROWS rows
+ *
+ * UqContext* context: context evaluating the statement
+ *
+ * Returns the record to add the row to
+ */
+static CheckRecord* crosscheck_room(UqContext* context)
+{
+    CheckRecord* record = context->checking;
+    if (record->rows == CROSSCHECK_RECORD_ROWS) {
+        CheckRecord* next = crosscheck_record(
+                record->text, record->count, record->engine);
+        next->unchecked = record->unchecked;
+        for (int k = 0; k < record->count; k++) {
+            next->names[k] = strdup(record->names[k]);
+            next->addresses[k] = record->addresses[k];
+            next->arrays[k] = record->arrays[k];
+        }
+        crosscheck_submit(context->crosscheck, record);
+        context->checking = next;
+        record = next;
+    }
+    if (!record->unchecked && record->rows == record->capacity) {
+        record->capacity = (record->capacity == 0) ? 1 : record->capacity * 2;
+        record->values = (double*)realloc((void*)record->values,
+                record->capacity * (record->count + 1) * sizeof(double));
+        record->results = (double*)realloc(
+                (void*)record->results, record->capacity * sizeof(double));
+    }
+    return record;
+}
+
+/* Records the result of one evaluation of the statement a context is
+ * evaluating, with the current values of the variables it refers to
+ *
+ * UqContext* context: context evaluating the statement
+ * double result: the result
+ */
+static void crosscheck_row(UqContext* context, double result)
+{
+    if (context->checking == NULL) {
+        return;
+    }
+    CheckRecord* record = crosscheck_room(context);
+    if (record->unchecked) {
+        record->rows++;
+        return;
+    }
+    double* values = record->values + (size_t)record->rows * record->count;
+    for (int k = 0; k < record->count; k++) {
+        values[k] = (record->addresses[k] != NULL) ? *record->addresses[k]
+                                                   : NAN;
+    }
+    record->results[record->rows] = result;
+    record->rows++;
+}
+
+/* Records the results of a statement evaluated element-wise over arrays,
+ * with the elements of the arrays and the values of the variables it refers
+ * to. Array statements are always evaluated by the vector engine
+ *
+ * UqContext* context: context evaluating the statement
+ * const double* elements: the results
+ * int length: number of results
+ */
+static void crosscheck_array(
+        UqContext* context, const double* elements, int length)
+{
+    if (context->checking == NULL) {
+        return;
+    }
+    double** arrayValues = context->variables.arrayValues;
+    context->checking->engine = UQ_ENGINE_VECTOR;
+    for (int j = 0; j < length; j++) {
+        CheckRecord* record = crosscheck_room(context);
+        if (record->unchecked) {
+            record->rows++;
+            continue;
+        }
+        double* values = record->values + (size_t)record->rows * record->count;
+        for (int k = 0; k < record->count; k++) {
+            values[k] = (record->arrays[k] != -1)
+                    ? arrayValues[record->arrays[k]][j]
+                    : *record->addresses[k];
+        }
+        record->results[record->rows] = elements[j];
+        record->rows++;
+    }
+}
+
+/* Finishes recording the statement a context is evaluating, queueing the rows
+ * recorded for it
+ *
+ * UqContext* context: context evaluating the statement
+ */
+static void crosscheck_end(UqContext* context)
+{
+    CheckRecord* record = context->checking;
+    if (record == NULL) {
+        return;
+    }
+    context->checking = NULL;
+    if (record->rows == 0) {
+        crosscheck_free(record);
+        return;
+    }
+    crosscheck_submit(context->crosscheck, record);
+}
+
+/* Works out how many representable doubles apart two results are
+ *
+ * double a: one result
+ * double b: the other result
+ *
+ * Returns the distance in units in the last place, 0 if both are NaN and
+ * ULLONG_MAX if only one is
+ */
+static unsigned long long crosscheck_distance(double a, double b)
+{
+    if (isnan(a) || isnan(b)) {
+        return (isnan(a) && isnan(b)) ? 0 : ULLONG_MAX;
+    }
+    int64_t x;
+    int64_t y;
+    memcpy(&x, &a, sizeof(x));
+    memcpy(&y, &b, sizeof(y));
+    uint64_t first = (x < 0) ? (uint64_t)INT64_MIN - (uint64_t)x
+                             : (uint64_t)INT64_MIN + (uint64_t)x;
+    uint64_t second = (y < 0) ? (uint64_t)INT64_MIN - (uint64_t)y
+                              : (uint64_t)INT64_MIN + (uint64_t)y;
+    return (first > second) ? first - second : second - first;
+}
+
+/* Reports the first divergence a crosscheck finds, with the statement,
+ * quoted without the whitespace and newline around it, and the values of the
+ * variables it refers to
+ *
+ * UqCrosscheck* check: the crosscheck
+ * const CheckRecord* record: record holding the row that diverged
+ * int row: the row
+ * const te_expr* expr: the statement compiled by te_compile() or NULL if
+ * tinyexpr cannot compile it
+ * double reference: tinyexpr's result
+ * unsigned long long distance: units in the last place between the results,
+ * ULLONG_MAX if they are not comparable
+ */
+static void crosscheck_report(UqCrosscheck* check, const CheckRecord* record,
+        int row, const te_expr* expr, double reference,
+        unsigned long long distance)
+{
+    const char* engines[] = {"tree", "vector"};
+    const char* text = record->text;
+    int length = strlen(text);
+    while (length > 0 && isspace((unsigned char)text[length - 1])) {
+        length--;
+    }
+    while (length > 0 && isspace((unsigned char)*text)) {
+        text++;
+        length--;
+    }
+    fprintf(check->report, "uqexpr crosscheck: \"%.*s\" gave %.17g with the "
+                           "%s engine but ",
+            length, text, record->results[row], engines[record->engine]);
+    if (expr == NULL) {
+        fprintf(check->report, "tinyexpr cannot compile it");
+    } else if (distance == ULLONG_MAX) {
+        fprintf(check->report, "%.17g with tinyexpr", reference);
+    } else {
+        fprintf(check->report, "%.17g with tinyexpr, %llu ulp apart",
+                reference, distance);
+    }
+    const double* values = record->values + (size_t)row * record->count;
+    for (int k = 0; k < record->count; k++) {
+        fprintf(check->report, "%s %s = %.17g", (k == 0) ? " when" : ",",
+                record->names[k], values[k]);
+    }
+    fprintf(check->report, "\n");
+    fflush(check->report);
+}
+
+/* Evaluates every row of a record again with te_compile() and te_eval(),
+ * counting the rows whose results differ by more than the crosscheck allows
+ *
+ * UqCrosscheck* check: the crosscheck
+ * const CheckRecord* record: record to check
+ *
+ * Returns the number of rows that diverged
+ */
+static long long crosscheck_record_check(
+        UqCrosscheck* check, const CheckRecord* record)
+{
+    double* values = (double*)malloc((record->count + 1) * sizeof(double));
+    te_variable* tevars
+            = (te_variable*)malloc((record->count + 1) * sizeof(te_variable));
+    for (int k = 0; k < record->count; k++) {
+        te_variable var = {.name = record->names[k],
+                .address = &(values[k]),
+                .type = TE_VARIABLE,
+                .context = NULL};
+        tevars[k] = var;
+    }
+    int errPos;
+    te_expr* expr = te_compile(record->text, tevars, record->count, &errPos);
+    long long diverged = 0;
+    for (int row = 0; row < record->rows; row++) {
+        memcpy(values, record->values + (size_t)row * record->count,
+                record->count * sizeof(double));
+        double reference = (expr != NULL) ? te_eval(expr) : NAN;
+        unsigned long long distance = (expr != NULL)
+                ? crosscheck_distance(record->results[row], reference)
+                : ULLONG_MAX;
+        if (distance > (unsigned long long)check->ulps) {
+            if (check->diverged + diverged == 0) {
+                crosscheck_report(
+                        check, record, row, expr, reference, distance);
+            }
+            diverged++;
+        }
+    }
+    te_free(expr);
+    free((void*)tevars);
+    free((void*)values);
+    return diverged;
+}
+
+/* Checks queued records until the crosscheck is closed and its queue is empty
+ *
+ * void* data: the UqCrosscheck
+ *
+ * Returns NULL
+ */
+static void* crosscheck_thread(void* data)
+{
+    UqCrosscheck* check = (UqCrosscheck*)data;
+    pthread_mutex_lock(&(check->lock));
+    while (1) {
+        while (check->head == NULL && !check->closing) {
+            pthread_cond_wait(&(check->queued), &(check->lock));
+        }
+        CheckRecord* record = check->head;
+        if (record == NULL) {
+            break;
+        }
+        check->head = record->next;
+        if (check->head == NULL) {
+            check->tail = NULL;
+        }
+        pthread_mutex_unlock(&(check->lock));
+        long long diverged = crosscheck_record_check(check, record);
+        pthread_mutex_lock(&(check->lock));
+        check->pending -= record->rows;
+        check->checked += record->rows;
+        check->diverged += diverged;
+        crosscheck_free(record);
+    }
+    pthread_mutex_unlock(&(check->lock));
+    return NULL;
+}
+
+/* Extends the Loops struct by adding a new loop by validating the loopString
+ * structure. Checks if variable name ahs already been used and if valid will
+ * append new loop to Loops structure.
+ *
+ * Loops* loops: Pointer to the Loops struct that if valid will have loop added
+ * to Variables* variables: pointer to the Variables struct, used to determine
+ * if duplicate name char* name: name of the loop char* startingValueString:
+ * String of the starting value of the loop char* incrementString: String of the
+ * increment of the loop char* endValueString: String of the end value of the
+ * loop int* duplicated: pointer to integer that flags if a duplicate name is
+ * being used
+ *
+ * Returns: 0 upon success of UQ_INVALID_VARIABLES_ERROR if loop form is invalid
+ */
+static int extend_loops(Loops* loops, Variables* variables, char* name,
+        char* startingValueString, char* incrementString, char* endValueString,
+        int* duplicated)
+{
+    if (name == NULL || startingValueString == NULL || incrementString == NULL
+            || endValueString == NULL) {
+        return UQ_INVALID_VARIABLES_ERROR;
+    }
+    int nameLength = strlen(name);
+    if (nameLength < 1 || nameLength > MAX_VARIABLE_LENGTH) {
+        return UQ_INVALID_VARIABLES_ERROR;
+    }
+    for (int k = 0; k < nameLength; k++) {
+        if (!isalpha((unsigned char)name[k])) {
+            return UQ_INVALID_VARIABLES_ERROR;
+        }
+    }
+    char* tempExcess;
+    double startValue, increment, endValue;
+    startValue = strtod(startingValueString, &tempExcess);
+    if (*tempExcess != '\0' || strlen(startingValueString) == 0) {
+        return UQ_INVALID_VARIABLES_ERROR;
+    }
+    increment = strtod(incrementString, &tempExcess);
+    if (*tempExcess != '\0' || strlen(incrementString) == 0) {
+        return UQ_INVALID_VARIABLES_ERROR;
+    }
+    endValue = strtod(endValueString, &tempExcess);
+    if (*tempExcess != '\0' || strlen(endValueString) == 0) {
+        return UQ_INVALID_VARIABLES_ERROR;
+    }
+    if ((startValue < endValue && increment < 0)
+            || (startValue > endValue && increment > 0) || (increment == 0)) {
+        return UQ_INVALID_VARIABLES_ERROR;
+    }
+    if (name_find(&(loops->index), loops->names, loops->size, name) != -1
+            || name_find(&(variables->index), variables->names,
+                       variables->size, name)
+                    != -1) {
+        *duplicated = 1;
+    }
+    reallocate_loops(loops, name, startValue, increment, endValue);
+    return 0;
+}
+
+/* Expands the Loops struct by reallocating memory to add a new entry
+ *
+ * Loops* loops: Pointer to the loops struct to be updated
+ * char* name: Name of the loop variable
+ * double startValue: start value of the loop variable
+ * double increment: increment of the loop variable
+ * double endValue: end value of the loop variable
+ *
+ * Return: 0 upon success
+ */
+static int reallocate_loops(Loops* loops, char* name, double startValue,
+        double increment, double endValue)
+{
+    loops->size++;
+    loops->names = (char**)realloc(
+            (void*)loops->names, (loops->size) * sizeof(char*));
+    loops->currentValue = (double*)realloc(
+            (void*)loops->currentValue, (loops->size) * sizeof(double));
+    loops->startingValue = (double*)realloc(
+            (void*)loops->startingValue, (loops->size) * sizeof(double));
+    loops->increment = (double*)realloc(
+            (void*)loops->increment, (loops->size) * sizeof(double));
+    loops->endValue = (double*)realloc(
+            (void*)loops->endValue, (loops->size) * sizeof(double));
+    loops->names[loops->size - 1] = strdup(name);
+    loops->nameBytes += strlen(name) + 1;
+    loops->currentValue[loops->size - 1] = startValue;
+    loops->startingValue[loops->size - 1] = startValue;
+    loops->increment[loops->size - 1] = increment;
+    loops->endValue[loops->size - 1] = endValue;
+    return 0;
+}
+
+/*Checks validity of variable name and its value e.g. making sure name consists
+ * of alphabetic characters and is appropriately sized, if valid appends to
+ * Variables struct. Also able to detect duplicate variables
+ *
+ * Variables* variables: Pointer to Variables struct where valid variables are
+ * stored char* key: Name of variable to be added char* valueString: String of
+ * the value of the variable int* duplicated: Pointer to integer that flags if a
+ * duplicate variable has been detected
+ *
+ * returns: 0 if success else UQ_INVALID_VARIABLES_ERROR if variable is invalid.
+ */
+static int extend_variables(
+        Variables* variables, char* key, char* valueString, int* duplicated)
+{
+    if (key == NULL || valueString == NULL) {
+        return UQ_INVALID_VARIABLES_ERROR;
+    }
+    int keyLength = strlen(key);
+    if (keyLength < 1 || keyLength > MAX_VARIABLE_LENGTH) {
+        return UQ_INVALID_VARIABLES_ERROR;
+    }
+    for (int k = 0; k < keyLength; k++) {
+        if (!isalpha((unsigned char)key[k])) {
+            return UQ_INVALID_VARIABLES_ERROR;
+        }
+    }
+    char* tempExcess;
+    double value = strtod(valueString, &tempExcess);
+    if (key != NULL && *tempExcess == '\0' && strlen(valueString) > 0) {
+        if (name_find(&(variables->index), variables->names, variables->size,
+                    key)
+                != -1) {
+            *duplicated = 1;
+        }
+        variables->size++;
+        variables->names = (char**)realloc(
+                (void*)variables->names, (variables->size) * sizeof(char*));
+        variables->values = (double*)realloc(
+                (void*)variables->values, (variables->size) * sizeof(double));
+        variables->names[variables->size - 1] = strdup(key);
+        variables->nameBytes += keyLength + 1;
+        variables->values[variables->size - 1] = value;
+    } else {
+        return UQ_INVALID_VARIABLES_ERROR;
+    }
+    return 0;
+}
+
+/* Parses a string expression from file or live command file and if valid
+ * initialises a new loop
+ *
+ * UqContext* context: context whose variables and loops are updated
+ * char* expression A string to be determined if valid loop
+ *
+ * Returns 0 if success otherwise UQ_INVALID_VARIABLES_ERROR if expression is
+ * invalid
+ */
+static int range(UqContext* context, char* expression)
+{
+    char* savePointer;
+    int countEquals = 0;
+    for (int m = 0; m < (int)strlen(expression); m++) {
+        if (expression[m] == ',') {
+            countEquals++;
+        }
+    }
+    if (countEquals != LOOP_COMMAS) {
+        return UQ_INVALID_VARIABLES_ERROR;
+    }
+    char* name = strtok_r(expression, ",", &savePointer);
+    char* startingValueString = strtok_r(NULL, ",", &savePointer);
+    char* incrementString = strtok_r(NULL, ",", &savePointer);
+    char* endValueString = strtok_r(NULL, ",", &savePointer);
+    if (name == NULL || startingValueString == NULL || incrementString == NULL
+            || endValueString == NULL) {
+        return UQ_INVALID_VARIABLES_ERROR;
+    }
+    int nameLength = strlen(name);
+    if (nameLength < 1 || nameLength > MAX_VARIABLE_LENGTH) {
+        return UQ_INVALID_VARIABLES_ERROR;
+    }
+    for (int k = 0; k < nameLength; k++) {
+        if (!isalpha((unsigned char)name[k])) {
+            return UQ_INVALID_VARIABLES_ERROR;
+        }
+    }
+    char* tempExcess;
+    double startValue, increment, endValue;
+    startValue = strtod(startingValueString, &tempExcess);
+    if (*tempExcess != '\0' || strlen(startingValueString) == 0) {
+        return UQ_INVALID_VARIABLES_ERROR;
+    }
+    increment = strtod(incrementString, &tempExcess);
+    if (*tempExcess != '\0' || strlen(incrementString) == 0) {
+        return UQ_INVALID_VARIABLES_ERROR;
+    }
+    endValue = strtod(endValueString, &tempExcess);
+    if (*tempExcess != '\n' || strlen(endValueString) == 0) {
+        return UQ_INVALID_VARIABLES_ERROR;
+    }
+    if ((startValue < endValue && increment < 0)
+            || (startValue > endValue && increment > 0) || (increment == 0)) {
+        return UQ_INVALID_VARIABLES_ERROR;
+    }
+    range_new_loop(context, name, startValue, increment, endValue);
+    return 0;
+}
+
+/* Checks whether loop with given name already exists and updates it otherwise
+ * calls for allocation of memory for new loop variable
+ *
+ * UqContext* context: context that holds the variables and loops
+ * char* name: name of the loop
+ * double startValue: Starting value of new loop
+ * double increment: Incremement of new loop
+ * double endvalue: End value of new loop
+ *
+ * Return 0 if success
+ */
+static int range_new_loop(UqContext* context, char* name, double startValue,
+        double increment, double endValue)
+{
+    Variables* variables = &(context->variables);
+    Loops* loops = &(context->loops);
+    for (int j = 0; j < loops->size; j++) {
+        if (!strcmp(loops->names[j], name)) {
+            loops->currentValue[j] = startValue;
+            loops->startingValue[j] = startValue;
+            loops->increment[j] = increment;
+            loops->endValue[j] = endValue;
+            char format[FORMAT_BUFFER_SIZE];
+            snprintf(format, sizeof(format), "%%.%dg", context->sigFigs);
+            // REF: Inspired by
+            // REF: https://www.geeksforgeeks.org/snprintf-c-library/
+            uq_printf(context, "%s = ", loops->names[j]);
+            uq_printf(context, format, loops->currentValue[j]);
+            uq_printf(context, " (");
+            uq_printf(context, format, loops->startingValue[j]);
+            uq_printf(context, ", ");
+            uq_printf(context, format, loops->increment[j]);
+            uq_printf(context, ", ");
+            uq_printf(context, format, loops->endValue[j]);
+            uq_printf(context, ")\n");
+            return 0;
+        }
+    }
+    for (int j = 0; j < variables->size; j++) {
+        if (!strcmp(variables->names[j], name)) {
+            variables->nameBytes -= strlen(variables->names[j]) - 1;
+            free(variables->names[j]);
+            variables->names[j] = strdup(" ");
+            variables->converted++;
+            break;
+        }
+    }
+    range_allocate_loop(context, name, startValue, increment, endValue);
+    return 0;
+}
+
+/* Allocates memory for new loop and initialises it with provided details
+ *
+ * UqContext* context: context whose loops the new loop will be added to
+ * char* name: name of new loop
+ * double startValue: starting value of new loop
+ * double increment: increment of new loop
+ * double endValue: end value of new loop
+ *
+ * Returns 0
+ */
+static int range_allocate_loop(UqContext* context, char* name,
+        double startValue, double increment, double endValue)
+{
+    Loops* loops = &(context->loops);
+    loops->size++;
+    loops->names = (char**)realloc(
+            (void*)loops->names, (loops->size) * sizeof(char*));
+    loops->currentValue = (double*)realloc(
+            (void*)loops->currentValue, (loops->size) * sizeof(double));
+    loops->startingValue = (double*)realloc(
+            (void*)loops->startingValue, (loops->size) * sizeof(double));
+    loops->increment = (double*)realloc(
+            loops->increment, (loops->size) * sizeof(double));
+    loops->endValue = (double*)realloc(
+            (void*)loops->endValue, (loops->size) * sizeof(double));
+    loops->names[loops->size - 1] = strdup(name);
+    loops->nameBytes += strlen(name) + 1;
+    loops->currentValue[loops->size - 1] = startValue;
+    loops->startingValue[loops->size - 1] = startValue;
+    loops->increment[loops->size - 1] = increment;
+    loops->endValue[loops->size - 1] = endValue;
+    char format[FORMAT_BUFFER_SIZE];
+    snprintf(format, sizeof(format), "%%.%dg", context->sigFigs);
+    uq_printf(context, "%s = ", loops->names[loops->size - 1]);
+    uq_printf(context, format, loops->currentValue[loops->size - 1]);
+    uq_printf(context, " (");
+    uq_printf(context, format, loops->startingValue[loops->size - 1]);
+    uq_printf(context, ", ");
+    uq_printf(context, format, loops->increment[loops->size - 1]);
+    uq_printf(context, ", ");
+    uq_printf(context, format, loops->endValue[loops->size - 1]);
+    uq_printf(context, ")\n");
+    return 0;
+}
+
+/* Writes an unsigned integer to the output as little-endian bytes
+ *
+ * UqContext* context: context whose output is written to
+ * unsigned long long value: value to write
+ * int bytes: number of bytes to write
+ *
+ * Returns 0
+ */
+static int output_binary_integer(
+        UqContext* context, unsigned long long value, int bytes)
+{
+    unsigned char buffer[sizeof(value)];
+    for (int i = 0; i < bytes; i++) {
+        buffer[i] = (value >> (BYTE_BITS * i)) & BYTE_MASK;
+    }
+    uq_write(context, buffer, bytes);
+    return 0;
+}
+
+/* Writes a double to the output as a raw little-endian IEEE 754 float64
+ *
+ * UqContext* context: context whose output is written to
+ * double value: value to write
+ *
+ * Returns 0
+ */
+static int output_binary_double(UqContext* context, double value)
+{
+    unsigned long long bits;
+    memcpy(&bits, &value, sizeof(bits));
+    output_binary_integer(context, bits, sizeof(bits));
+    return 0;
+}
+
+/* Writes the header that precedes the rows of one @loop in the tsv and binary
+ * output modes. The binary header is the magic "UQXB", then a uint32 version,
+ * a uint32 column count, a uint64 record count and for each column a uint32
+ * name length followed by the name, all little-endian. Each record that
+ * follows is one float64 per column. A @loop with a where clause does not
+ * know how many records it will write, and gives the count as all ones
+ *
+ * UqContext* context: context whose output mode and output are used
+ * char* loopName: name of the loop variable, the first column
+ * char* resultName: name of the result, the second column
+ * long long repetitions: number of rows that will follow or -1 if unknown
+ *
+ * Returns 0
+ */
+static int loop_header_print(UqContext* context, char* loopName,
+        char* resultName, long long repetitions)
+{
+    if (context->outputMode == UQ_OUTPUT_TSV) {
+        uq_printf(context, "%s\t%s\n", loopName, resultName);
+    } else if (context->outputMode == UQ_OUTPUT_BINARY) {
+        uq_write(context, "UQXB", strlen("UQXB"));
+        output_binary_integer(context, BINARY_VERSION, sizeof(int));
+        output_binary_integer(context, BINARY_COLUMNS, sizeof(int));
+        output_binary_integer(context, repetitions, sizeof(long long));
+        output_binary_integer(context, strlen(loopName), sizeof(int));
+        uq_write(context, loopName, strlen(loopName));
+        output_binary_integer(context, strlen(resultName), sizeof(int));
+        uq_write(context, resultName, strlen(resultName));
+    }
+    return 0;
+}
+
+/* Prints one row of @loop output in the tsv or binary output modes
+ *
+ * UqContext* context: context whose output mode and sig figs are used
+ * double loopValue: value of the loop variable
+ * double value: result for that value of the loop variable
+ *
+ * Returns 0
+ */
+static int loop_row_print(UqContext* context, double loopValue, double value)
+{
+    if (context->outputMode == UQ_OUTPUT_BINARY) {
+        output_binary_double(context, loopValue);
+        output_binary_double(context, value);
+    } else {
+        char format[FORMAT_BUFFER_SIZE];
+        snprintf(format, sizeof(format), "%%.%dg\t%%.%dg\n", context->sigFigs,
+                context->sigFigs);
+        uq_printf(context, format, loopValue, value);
+    }
+    return 0;
+}
+
+/* Works out the number of iterations a @loop over a loop variable runs. The
+ * count is 64-bit so that ranges of more than 2^31 steps do not overflow, and
+ * is capped at LOOP_MAX_REPETITIONS, past which start + i * increment no
+ * longer gives a distinct value for every i
+ *
+ * const Loops* loops: the loop variables
+ * int loopVarIndex: index of the loop variable iterated over
+ *
+ * Returns the number of iterations, 0 if the range is empty or not a number
+ */
+static long long loop_repetitions(const Loops* loops, int loopVarIndex)
+{
+    double steps = floor(
+            (loops->endValue[loopVarIndex] - loops->startingValue[loopVarIndex])
+            / loops->increment[loopVarIndex]);
+    if (!(steps >= 0)) {
+        return 0;
+    }
+    if (steps >= (double)(LOOP_MAX_REPETITIONS - 1)) {
+        return LOOP_MAX_REPETITIONS;
+    }
+    return 1 + (long long)steps;
+}
+
+/* Stops a @loop, as uq_interrupt() would, once its statement is past its
+ * time limit, reading the clock once every DEADLINE_STRIDE iterations. Then
+ * reports the progress of the @loop on the error stream once every
+ * context->progress iterations. Buffered results are passed on first so that
+ * reports fall between whole rows
+ *
+ * UqContext* context: context running the loop
+ * int loopVarIndex: index of the loop variable iterated over
+ * long long before: number of iterations finished before the latest step
+ * long long done: number of iterations finished after it
+ * long long repetitions: number of iterations the loop runs
+ */
+static void loop_progress(UqContext* context, int loopVarIndex,
+        long long before, long long done, long long repetitions)
+{
+    if (context->deadline != 0
+            && before / DEADLINE_STRIDE != done / DEADLINE_STRIDE
+            && clock_now() > context->deadline && !context->interrupted) {
+        const char* message = "uqexpr: @loop stopped at its time limit\n";
+        uq_flush(context);
+        uq_emit(context, UQ_STREAM_ERROR, message, strlen(message));
+        context->interrupted = 1;
+    }
+    if (context->progress == 0
+            || before / context->progress == done / context->progress) {
+        return;
+    }
+    char message[PRINT_BUFFER_SIZE];
+    snprintf(message, sizeof(message),
+            "uqexpr: @loop %s: %lld of %lld iterations (%.1f%%)\n",
+            context->loops.names[loopVarIndex], done, repetitions,
+            100.0 * done / repetitions);
+    uq_flush(context);
+    uq_emit(context, UQ_STREAM_ERROR, message, strlen(message));
+}
+
+/* Prints result of expression evaluation with current loop variable's value
+ *
+ * UqContext* context: context holding the loops, sig figs and output mode
+ * double value: evaluated expression
+ * int loopVarIndex Index of the loop variable whose name and current value
+ * should be printed
+ */
+static int loop_expression_print(
+        UqContext* context, double value, int loopVarIndex)
+{
+    Loops* loops = &(context->loops);
+    if (context->outputMode != UQ_OUTPUT_TEXT) {
+        return loop_row_print(
+                context, loops->currentValue[loopVarIndex], value);
+    }
+    char format[FORMAT_BUFFER_SIZE];
+    snprintf(format, sizeof(format), "%%.%dg", context->sigFigs);
+    uq_printf(context, "Result = ");
+    uq_printf(context, format, value);
+    uq_printf(context, " when %s = ", loops->names[loopVarIndex]);
+    uq_printf(context, format, loops->currentValue[loopVarIndex]);
+    uq_printf(context, "\n");
+    return 0;
+}
+
+/* Compiles a @loop statement or predicate once against the storage of the
+ * names it refers to, so every iteration reads the new value of the loop
+ * variable without binding or compiling again
+ *
+ * UqContext* context: context holding the variables and loops
+ * const char* text: expression to compile
+ * int check: 1 to begin recording the statement for crosscheck, otherwise 0
+ *
+ * Returns the compiled expression, held in the arena, or NULL if it is invalid
+ */
+static te_expr* loop_compile(UqContext* context, const char* text, int check)
+{
+    Bindings bindings;
+    bind_referenced(context, text, 0, &bindings);
+    te_expr* expr = compile_uncached(context, text, bindings.tevars,
+            bindings.count, work_clock(context));
+    if (expr != NULL && check) {
+        crosscheck_begin(context, text, &bindings, expr);
+    }
+    bindings_free(&bindings);
+    return expr;
+}
+
+/* Decides whether the row of the current @loop iteration is printed
+ *
+ * UqContext* context: context the evaluation is counted in
+ * te_expr* predicate: compiled where clause or NULL if there is none
+ *
+ * Returns 1 if there is no predicate or it is greater than zero, otherwise 0
+ */
+static int loop_keep(UqContext* context, te_expr* predicate)
+{
+    if (predicate == NULL) {
+        return 1;
+    }
+    STATS_ADD(context, evaluations, 1);
+    return expression_eval(predicate) > 0;
+}
+
+/* Works out the number of rows a @loop prints, as given in the binary header
+ *
+ * long long repetitions: number of iterations the loop runs
+ * const LoopClauses* clauses: the loop's where and every clauses
+ *
+ * Returns the number of rows or -1 if a where clause leaves it unknown until
+ * the loop has run
+ */
+static long long loop_rows(long long repetitions, const LoopClauses* clauses)
+{
+    if (clauses->predicate != NULL) {
+        return -1;
+    }
+    return (repetitions + clauses->every - 1) / clauses->every;
+}
+
+/* Runs an expression @loop with a where or every clause a block of
+ * LOOP_BLOCK_ROWS sampled iterations at a time. The predicate is evaluated as
+ * a vector program over the block, the values of the loop variable it keeps
+ * are packed together and the expression is evaluated over only those, so
+ * evaluation, formatting and output all skip the rows that are dropped. Both
+ * are evaluated with the C library in double precision, giving the same
+ * results te_eval() would, unless the context uses the vector engine, whose
+ * math and precision apply
+ *
+ * UqContext* context: context holding the variables and loops
+ * te_expr* expr: compiled expression
+ * te_expr* predicate: compiled where clause or NULL if there is none
+ * int loopVarIndex: index of the loop variable iterated over
+ * long long every: number of iterations between sampled ones
+ * long long repetitions: number of iterations the loop runs
+ *
+ * Returns 0 or 1 if either expression cannot be evaluated as a vector, in
+ * which case nothing has been printed
+ */
+static int loop_expression_blocks(UqContext* context, te_expr* expr,
+        te_expr* predicate, int loopVarIndex, long long every,
+        long long repetitions)
+{
+    Loops* loops = &(context->loops);
+    double* slot = &(loops->currentValue[loopVarIndex]);
+    int vector = (context->engine == UQ_ENGINE_VECTOR);
+    int math = vector ? context->math : UQ_MATH_EXACT;
+    int precision = vector ? vector_precision(context) : UQ_PRECISION_DOUBLE;
+    VectorProgram program;
+    VectorProgram test;
+    if (vector_compile(expr, &program, slot, NULL, 1, math)) {
+        return 1;
+    }
+    if (predicate != NULL
+            && vector_compile(predicate, &test, slot, NULL, 1, math)) {
+        vector_free(&program);
+        return 1;
+    }
+    double* values = vector_allocate(LOOP_BLOCK_ROWS);
+    double* results = vector_allocate(LOOP_BLOCK_ROWS);
+    double start = loops->startingValue[loopVarIndex];
+    double increment = loops->increment[loopVarIndex];
+    long long rows = (repetitions + every - 1) / every;
+    for (long long row = 0; row < rows && !context->interrupted;
+            row += LOOP_BLOCK_ROWS) {
+        int count = (rows - row < LOOP_BLOCK_ROWS) ? (int)(rows - row)
+                                                   : LOOP_BLOCK_ROWS;
+        for (int j = 0; j < count; j++) {
+            values[j] = start + (row + j) * every * increment;
+        }
+        int kept = count;
+        if (predicate != NULL) {
+            vector_evaluate(&test, &values, count, results, precision);
+            kept = 0;
+            for (int j = 0; j < count; j++) {
+                values[kept] = values[j];
+                kept += results[j] > 0;
+            }
+            STATS_ADD(context, evaluations, count);
+        }
+        vector_evaluate(&program, &values, kept, results, precision);
+        STATS_ADD(context, evaluations, kept);
+        STATS_ADD(context, loopIterations, count);
+        for (int j = 0; j < kept; j++) {
+            loops->currentValue[loopVarIndex] = values[j];
+            crosscheck_row(context, results[j]);
+            loop_expression_print(context, results[j], loopVarIndex);
+        }
+        for (int j = 0; j < count; j++) {
+            trace_loop_step(context);
+        }
+        long long done = (row + count) * every;
+        loop_progress(context, loopVarIndex, row * every,
+                (done < repetitions) ? done : repetitions, repetitions);
+    }
+    loops->currentValue[loopVarIndex] = start + (rows - 1) * every * increment;
+    free((void*)results);
+    free((void*)values);
+    if (predicate != NULL) {
+        vector_free(&test);
+    }
+    vector_free(&program);
+    return 0;
+}
+
+/* Evaluates expression for @loop calls. The expression is compiled once, and
+ * with a where clause so is the predicate. Only every clauses->every-th
+ * iteration is run, and of those only the ones whose predicate is greater
+ * than zero are evaluated and printed. The vector engine runs every loop a
+ * block of iterations at a time
+ *
+ * UqContext* context: context holding the variables and loops
+ * char* expression A string representation of maths expression to be converted
+ * int loopVarIndex: index of loop variable used in expression
+ * const LoopClauses* clauses: the loop's where and every clauses
+ *
+ * returns 1 if successful or 1 if error
+ */
+static int loop_expression(UqContext* context, char* expression,
+        int loopVarIndex, const LoopClauses* clauses)
+{
+    Loops* loops = &(context->loops);
+    te_expr* expr = loop_compile(context, expression, 1);
+    if (!expr) {
+        return 1;
+    }
+    te_expr* predicate = NULL;
+    if (clauses->predicate != NULL) {
+        predicate = loop_compile(context, clauses->predicate, 0);
+        if (!predicate) {
+            crosscheck_end(context);
+            arena_release(context, expr);
+            return 1;
+        }
+    }
+    long long repetitions = loop_repetitions(loops, loopVarIndex);
+    if (repetitions > 0) {
+        loop_header_print(context, loops->names[loopVarIndex], "Result",
+                loop_rows(repetitions, clauses));
+    }
+    if ((predicate == NULL && clauses->every == 1
+                && context->engine == UQ_ENGINE_TREE)
+            || loop_expression_blocks(context, expr, predicate, loopVarIndex,
+                    clauses->every, repetitions)) {
+        for (long long i = 0; i < repetitions && !context->interrupted;
+                i += clauses->every) {
+            loops->currentValue[loopVarIndex]
+                    = loops->startingValue[loopVarIndex]
+                    + i * loops->increment[loopVarIndex];
+            STATS_ADD(context, loopIterations, 1);
+            if (loop_keep(context, predicate)) {
+                double value = expression_eval(expr);
+                STATS_ADD(context, evaluations, 1);
+                crosscheck_row(context, value);
+                loop_expression_print(context, value, loopVarIndex);
+            }
+            trace_loop_step(context);
+            long long done = i + clauses->every;
+            loop_progress(context, loopVarIndex, i,
+                    (done < repetitions) ? done : repetitions, repetitions);
+        }
+    }
+    crosscheck_end(context);
+    if (predicate != NULL) {
+        arena_release(context, predicate);
+    }
+    arena_release(context, expr);
+    return 0;
+}
+
+/* Sets up assigment for given variable or loop in @loop by cehcking if variable
+ * exists if it doesnt it creates it, starting from the value of a shared base
+ * variable of the same name if there is one
+ *
+ * UqContext* context: context holding the variables and loops
+ * char* expressionVariable: name of varaible to be made or found
+ * int* varaibleIndex: A pointer to the index of the variable to be found or
+ * created int* loopIndex: A pointer to index of loop to be found
+ *
+ * Return 0 if successful or 1 if expressionVariable is empty
+ */
+static int loop_assignment_setup(UqContext* context, char* expressionVariable,
+        int* variableIndex, int* loopIndex)
+{
+    Variables* variables = &(context->variables);
+    Loops* loops = &(context->loops);
+    if (!strcmp(" ", expressionVariable)) {
+        return 1;
+    }
+    *variableIndex = name_find(&(variables->index), variables->names,
+            variables->size, expressionVariable);
+    *loopIndex = name_find(
+            &(loops->index), loops->names, loops->size, expressionVariable);
+    if (*variableIndex == -1 && *loopIndex == -1) {
+        int baseIndex = base_find(context, expressionVariable);
+        variables->size++;
+        variables->names = (char**)realloc(
+                (void*)variables->names, (variables->size) * sizeof(char*));
+        variables->values = (double*)realloc(
+                (void*)variables->values, (variables->size) * sizeof(double));
+        variables->names[variables->size - 1] = strdup(expressionVariable);
+        variables->nameBytes += strlen(expressionVariable) + 1;
+        variables->values[variables->size - 1]
+                = (baseIndex != -1) ? context->base->values[baseIndex] : 0;
+        *variableIndex = variables->size - 1;
+    }
+    return 0;
+}
+
+/* Stores the value assigned by one iteration of a @loop in the variable or
+ * loop variable being assigned
+ *
+ * UqContext* context: context holding the variables and loops
+ * double value: Computed value thats assigned
+ * int loopIndex: index of loop where assignment takes place or -1 if not in
+ * loop int variableIndex: index of variables where assignment takes place or -1
+ * if not in variables
+ *
+ * Returns 0
+ */
+static int loop_assign(
+        UqContext* context, double value, int loopIndex, int variableIndex)
+{
+    if (variableIndex == -1) {
+        context->loops.currentValue[loopIndex] = value;
+    } else {
+        context->variables.values[variableIndex] = value;
+    }
+    return 0;
+}
+
+/* prints result of assignment in loop for variable or loop
+ *
+ * UqContext* context: context holding the variables, loops and settings
+ * double value: Computed value thats assigned
+ * char* expressionVariable: Name of varaible or loop which is being assigned
+ * int loopVarIndex: Index of the loop variable being iterated over long long
+ * i: Current iteration of loop
+ *
+ * Returns 0 when successful
+ */
+static int loop_print_assignment(UqContext* context, double value,
+        char* expressionVariable, int loopVarIndex, long long i)
+{
+    Loops* loops = &(context->loops);
+    if (context->outputMode != UQ_OUTPUT_TEXT) {
+        return loop_row_print(context,
+                loops->startingValue[loopVarIndex]
+                        + i * loops->increment[loopVarIndex],
+                value);
+    }
+    char format[FORMAT_BUFFER_SIZE];
+    snprintf(format, sizeof(format), "%%.%dg", context->sigFigs);
+    uq_printf(context, "%s = ", expressionVariable);
+    uq_printf(context, format, value);
+    uq_printf(context, " when %s = ", loops->names[loopVarIndex]);
+    uq_printf(context, format,
+            loops->startingValue[loopVarIndex]
+                    + i * loops->increment[loopVarIndex]);
+    uq_printf(context, "\n");
+    return 0;
+}
+
+/* Executes the assignment within a loop evaluating expression and assigning its
+ * variable to a variable or loop. As in loop_expression() the expression is
+ * compiled once, and each iteration reads the value assigned by the one before.
+ * Every iteration assigns, since later ones depend on it, but only every
+ * clauses->every-th is printed, and with a where clause only if the predicate,
+ * evaluated after the assignment, is greater than zero. The vector engine
+ * runs the expression as a program of one element per iteration
+ *
+ * UqContext* context: context holding the variables, loops and settings
+ * int loopIndex: Index of the loop where the assignment is occuring
+ * int variableIndex: The index of variable to be assigned or -1 if its a loop
+ * char* expressionVariable: Name of variable or loop beibng assigned
+ * int loopVarIndex Index of the loop variable being iterated over
+ * char* expressionExpression The expression to be evaluated and assigned
+ * const LoopClauses* clauses: the loop's where and every clauses
+ *
+ * Returns 0 if successful or 1 if error
+ */
+static int loop_assignment(UqContext* context, int loopIndex,
+        int variableIndex, char* expressionVariable, int loopVarIndex,
+        char* expressionExpression, const LoopClauses* clauses)
+{
+    Loops* loops = &(context->loops);
+    te_expr* expr = loop_compile(context, expressionExpression, 1);
+    if (!expr) {
+        return 1;
+    }
+    te_expr* predicate = NULL;
+    if (clauses->predicate != NULL) {
+        predicate = loop_compile(context, clauses->predicate, 0);
+        if (!predicate) {
+            crosscheck_end(context);
+            arena_release(context, expr);
+            return 1;
+        }
+    }
+    VectorProgram storage;
+    VectorProgram* program = engine_prepare(context, expr, &storage);
+    long long repetitions = loop_repetitions(loops, loopVarIndex);
+    if (repetitions > 0) {
+        loop_header_print(context, loops->names[loopVarIndex],
+                expressionVariable, loop_rows(repetitions, clauses));
+    }
+    long long sample = 0;
+    for (long long i = 0; i < repetitions && !context->interrupted; i++) {
+        loops->currentValue[loopVarIndex] = loops->startingValue[loopVarIndex]
+                + i * loops->increment[loopVarIndex];
+        double value = engine_evaluate(context, expr, program);
+        STATS_ADD(context, evaluations, 1);
+        STATS_ADD(context, loopIterations, 1);
+        crosscheck_row(context, value);
+        loop_assign(context, value, loopIndex, variableIndex);
+        if (i == sample) {
+            sample += clauses->every;
+            if (loop_keep(context, predicate)) {
+                loop_print_assignment(
+                        context, value, expressionVariable, loopVarIndex, i);
+            }
+        }
+        trace_loop_step(context);
+        loop_progress(context, loopVarIndex, i, i + 1, repetitions);
+    }
+    crosscheck_end(context);
+    if (program != NULL) {
+        vector_free(program);
+    }
+    if (predicate != NULL) {
+        arena_release(context, predicate);
+    }
+    arena_release(context, expr);
+    return 0;
+}
+
+/* Finds the last occurrence of a clause keyword in a @loop or @montecarlo
+ * statement that stands as a word on its own after some text of the statement
+ *
+ * char* statement: the statement
+ * const char* keyword: where, every, with or seed
+ *
+ * Returns a pointer to the keyword or NULL if it does not occur
+ */
+static char* loop_keyword(char* statement, const char* keyword)
+{
+    size_t length = strlen(keyword);
+    while (isspace((unsigned char)*statement)) {
+        statement++;
+    }
+    char* found = NULL;
+    for (char* at = statement; *at != '\0'; at++) {
+        at = strstr(at + 1, keyword);
+        if (at == NULL) {
+            break;
+        }
+        if (isspace((unsigned char)at[-1])
+                && isspace((unsigned char)at[length])) {
+            found = at;
+        }
+    }
+    return found;
+}
+
+/* Splits the optional clauses off the end of a @loop statement, leaving it
+ * holding only the expression or assignment:
+ *
+ *     @loop name statement [where predicate] [every N]
+ *
+ * where keeps the rows whose predicate is greater than zero and every runs
+ * or prints only the first of each N iterations. The keywords are only
+ * recognised as words on their own after the statement, and every only when
+ * followed by nothing but an integer
+ *
+ * char* statement: the statement, modified in place
+ * LoopClauses* clauses: where the clauses are stored
+ *
+ * Returns 0 if successful or 1 if a clause is empty or N is less than 1
+ */
+static int loop_clauses(char* statement, LoopClauses* clauses)
+{
+    clauses->predicate = NULL;
+    clauses->every = 1;
+    char* every = loop_keyword(statement, "every");
+    if (every != NULL) {
+        char* number = every + strlen("every");
+        char* end;
+        long long stride = strtoll(number, &end, DECIMAL_BASE);
+        while (isspace((unsigned char)*end)) {
+            end++;
+        }
+        if (end != number && *end == '\0') {
+            if (stride < 1) {
+                return 1;
+            }
+            clauses->every = (stride < LOOP_MAX_REPETITIONS)
+                    ? stride
+                    : LOOP_MAX_REPETITIONS;
+            *every = '\0';
+        }
+    }
+    char* where = loop_keyword(statement, "where");
+    if (where != NULL) {
+        *where = '\0';
+        clauses->predicate = where + strlen("where");
+        char* text = clauses->predicate;
+        while (isspace((unsigned char)*text)) {
+            text++;
+        }
+        if (*text == '\0') {
+            return 1;
+        }
+    }
+    return 0;
+}
+/* Processes a @loop command executing a loop with expression or assigning a
+ * variable / loop with a value
+ *
+ * UqContext* context: context holding the variables, loops and settings
+ * char* line: the string representation of the entire loop command
+ *
+ * Return 0 uf succesyk or 1 if there is error in syntax
+ */
+static int loop(UqContext* context, char* line)
+{
+    Loops* loops = &(context->loops);
+    char* savePointer;
+    strtok_r(line, " ", &savePointer);
+    char* variableName = strtok_r(NULL, " ", &savePointer);
+    char* expression = strtok_r(NULL, "", &savePointer);
+    int loopVarIndex = -1;
+    for (int i = 0; i < loops->size; i++) {
+        if (!strcmp(loops->names[i], variableName)) {
+            loopVarIndex = i;
+            loops->currentValue[i] = loops->startingValue[i];
+        }
+    }
+    LoopClauses clauses;
+    if (loopVarIndex == -1 || loop_clauses(expression, &clauses)) {
+        return 1;
+    }
+    int numberEquals = 0;
+    for (int i = 0; i < (int)strlen(expression); i++) {
+        if (expression[i] == '=') {
+            numberEquals++;
+        }
+    }
+    if (numberEquals == 0) {
+        trace_loop_begin(context);
+        int result
+                = loop_expression(context, expression, loopVarIndex, &clauses);
+        trace_loop_end(context);
+        if (result != 0) {
+            return result;
+        }
+    } else if (numberEquals == 1) {
+        char* expressionVariable = strtok_r(expression, "=", &savePointer);
+        char* expressionExpression = strtok_r(NULL, "", &savePointer);
+        expressionVariable = strtok_r(expressionVariable, " ", &savePointer);
+        int variableIndex = -1;
+        int loopIndex = -1;
+        int result = loop_assignment_setup(
+                context, expressionVariable, &variableIndex, &loopIndex);
+        if (result != 0) {
+            return result;
+        }
+        trace_loop_begin(context);
+        result = loop_assignment(context, loopIndex, variableIndex,
+                expressionVariable, loopVarIndex, expressionExpression,
+                &clauses);
+        trace_loop_end(context);
+        if (result != 0) {
+            return result;
+        }
+    } else {
+        return 1;
+    }
+    return 0;
+}
+
+/* Evaluates a compiled expression with the loop variable set to a given value
+ *
+ * te_expr* expr: compiled expression to be evaluated
+ * double* slot: address the loop variable was bound to when compiling expr
+ * double x: value to give the loop variable
+ * int* evaluations: pointer to the number of evaluations performed so far
+ *
+ * Returns the value of the expression
+ */
+static double solve_evaluate(
+        te_expr* expr, double* slot, double x, int* evaluations)
+{
+    *slot = x;
+    (*evaluations)++;
+    return expression_eval(expr);
+}
+
+/* Finds a root of a compiled expression between two values of the loop
+ * variable. If the end points do not bracket a root the range is split into
+ * SOLVE_SEGMENTS pieces and the first one with a sign change is used, then
+ * Brent's method (bisection, secant and inverse quadratic interpolation) is
+ * applied to that bracket
+ *
+ * te_expr* expr: compiled expression to find the root of
+ * double* slot: address the loop variable was bound to when compiling expr
+ * double a: one end of the range to search
+ * double b: other end of the range to search
+ * double* root: pointer to where the root will be stored
+ * int* evaluations: pointer to the number of evaluations performed so far
+ *
+ * Returns 0 if a root was found or 1 if no sign change exists in the range
+ */
+static int solve_root(te_expr* expr, double* slot, double a, double b,
+        double* root, int* evaluations)
+{
+    double fa = solve_evaluate(expr, slot, a, evaluations);
+    double fb = solve_evaluate(expr, slot, b, evaluations);
+    if ((fa > 0) == (fb > 0) && fa != 0 && fb != 0) {
+        double step = (b - a) / SOLVE_SEGMENTS;
+        double left = a;
+        double fLeft = fa;
+        int found = 0;
+        for (int k = 1; k <= SOLVE_SEGMENTS && !found; k++) {
+            double right = (k == SOLVE_SEGMENTS) ? b : a + k * step;
+            double fRight = solve_evaluate(expr, slot, right, evaluations);
+            if ((fLeft > 0) != (fRight > 0) || fRight == 0) {
+                a = left;
+                fa = fLeft;
+                b = right;
+                fb = fRight;
+                found = 1;
+            }
+            left = right;
+            fLeft = fRight;
+        }
+        if (!found) {
+            return 1;
+        }
+    }
+    double c = a, fc = fa, d = b - a, e = d;
+    for (int i = 0; i < SOLVE_MAX_ITERATIONS; i++) {
+        if ((fb > 0) == (fc > 0)) {
+            c = a;
+            fc = fa;
+            d = b - a;
+            e = d;
+        }
+        if (fabs(fc) < fabs(fb)) {
+            a = b;
+            b = c;
+            c = a;
+            fa = fb;
+            fb = fc;
+            fc = fa;
+        }
+        double tolerance = 2 * DBL_EPSILON * fabs(b) + SOLVE_TOLERANCE;
+        double middle = (c - b) / 2;
+        if (fabs(middle) <= tolerance || fb == 0) {
+            break;
+        }
+        if (fabs(e) >= tolerance && fabs(fa) > fabs(fb)) {
+            double s = fb / fa, p, q;
+            if (a == c) {
+                p = 2 * middle * s;
+                q = 1 - s;
+            } else {
+                double r = fb / fc;
+                q = fa / fc;
+                p = s * (2 * middle * q * (q - r) - (b - a) * (r - 1));
+                q = (q - 1) * (r - 1) * (s - 1);
+            }
+            if (p > 0) {
+                q = -q;
+            } else {
+                p = -p;
+            }
+            if (2 * p < 3 * middle * q - fabs(tolerance * q)
+                    && p < fabs(e * q / 2)) {
+                e = d;
+                d = p / q;
+            } else {
+                d = middle;
+                e = middle;
+            }
+        } else {
+            d = middle;
+            e = middle;
+        }
+        a = b;
+        fa = fb;
+        if (fabs(d) > tolerance) {
+            b += d;
+        } else {
+            b += (middle > 0) ? tolerance : -tolerance;
+        }
+        fb = solve_evaluate(expr, slot, b, evaluations);
+    }
+    *root = b;
+    return 0;
+}
+
+/* Finds the minimum of a compiled expression between two values of the loop
+ * variable. The range is first sampled at SOLVE_SEGMENTS + 1 points and
+ * Brent's method (golden section search with parabolic interpolation) is then
+ * used on the segments either side of the smallest sample
+ *
+ * te_expr* expr: compiled expression to minimise
+ * double* slot: address the loop variable was bound to when compiling expr
+ * double a: lower end of the range to search
+ * double b: upper end of the range to search
+ * double* minimum: pointer to where the value of the loop variable at the
+ * minimum will be stored double* value: pointer to where the minimum value of
+ * the expression will be stored int* evaluations: pointer to the number of
+ * evaluations performed so far
+ *
+ * Returns 0
+ */
+static int solve_minimum(te_expr* expr, double* slot, double a, double b,
+        double* minimum, double* value, int* evaluations)
+{
+    double step = (b - a) / SOLVE_SEGMENTS;
+    double x = a;
+    double fx = solve_evaluate(expr, slot, a, evaluations);
+    for (int k = 1; k <= SOLVE_SEGMENTS; k++) {
+        double sample = (k == SOLVE_SEGMENTS) ? b : a + k * step;
+        double fSample = solve_evaluate(expr, slot, sample, evaluations);
+        if (fSample < fx) {
+            x = sample;
+            fx = fSample;
+        }
+    }
+    double lower = (x - step > a) ? x - step : a;
+    double upper = (x + step < b) ? x + step : b;
+    double w = x, v = x, fw = fx, fv = fx, d = 0, e = 0;
+    for (int i = 0; i < SOLVE_MAX_ITERATIONS; i++) {
+        double middle = (lower + upper) / 2;
+        double tolerance = sqrt(DBL_EPSILON) * fabs(x) + SOLVE_TOLERANCE;
+        if (fabs(x - middle) <= 2 * tolerance - (upper - lower) / 2) {
+            break;
+        }
+        int golden = 1;
+        if (fabs(e) > tolerance) {
+            double r = (x - w) * (fx - fv);
+            double q = (x - v) * (fx - fw);
+            double p = (x - v) * q - (x - w) * r;
+            q = 2 * (q - r);
+            if (q > 0) {
+                p = -p;
+            } else {
+                q = -q;
+            }
+            double previous = e;
+            e = d;
+            if (fabs(p) < fabs(q * previous / 2) && p > q * (lower - x)
+                    && p < q * (upper - x)) {
+                d = p / q;
+                double u = x + d;
+                if (u - lower < 2 * tolerance || upper - u < 2 * tolerance) {
+                    d = (middle >= x) ? tolerance : -tolerance;
+                }
+                golden = 0;
+            }
+        }
+        if (golden) {
+            e = (x >= middle) ? lower - x : upper - x;
+            d = GOLDEN_SECTION * e;
+        }
+        double u = x + d;
+        if (fabs(d) < tolerance) {
+            u = x + ((d > 0) ? tolerance : -tolerance);
+        }
+        double fu = solve_evaluate(expr, slot, u, evaluations);
+        if (fu <= fx) {
+            if (u >= x) {
+                lower = x;
+            } else {
+                upper = x;
+            }
+            v = w;
+            fv = fw;
+            w = x;
+            fw = fx;
+            x = u;
+            fx = fu;
+        } else {
+            if (u < x) {
+                lower = u;
+            } else {
+                upper = u;
+            }
+            if (fu <= fw || w == x) {
+                v = w;
+                fv = fw;
+                w = u;
+                fw = fu;
+            } else if (fu <= fv || v == x || v == w) {
+                v = u;
+                fv = fu;
+            }
+        }
+    }
+    *minimum = x;
+    *value = fx;
+    return 0;
+}
+
+/* Processes a @solve or @minimize command, compiling the expression once and
+ * searching between the start and end values of the given loop variable. The
+ * expression reads the loop variable itself, which is left at the value found
+ * or restored if no root is found
+ *
+ * UqContext* context: context holding the variables, loops and settings
+ * char* line: the string representation of the entire command
+ * int minimize: 1 if the minimum should be found, 0 if a root should be found
+ *
+ * Return 0 if successful or 1 if there is an error in syntax or no root exists
+ */
+static int solve(UqContext* context, char* line, int minimize)
+{
+    Loops* loops = &(context->loops);
+    char* savePointer;
+    strtok_r(line, " ", &savePointer);
+    char* variableName = strtok_r(NULL, " ", &savePointer);
+    char* expression = strtok_r(NULL, "", &savePointer);
+    if (variableName == NULL || expression == NULL
+            || strchr(expression, '=') != NULL) {
+        return 1;
+    }
+    int loopVarIndex = name_find(
+            &(loops->index), loops->names, loops->size, variableName);
+    if (loopVarIndex == -1) {
+        return 1;
+    }
+    Bindings bindings;
+    bind_referenced(context, expression, 0, &bindings);
+    long long start = work_clock(context);
+    te_expr* expr = compile_uncached(
+            context, expression, bindings.tevars, bindings.count, start);
+    bindings_free(&bindings);
+    if (!expr) {
+        return 1;
+    }
+    double* slot = &(loops->currentValue[loopVarIndex]);
+    double current = *slot;
+    double a = loops->startingValue[loopVarIndex];
+    double b = loops->endValue[loopVarIndex];
+    if (a > b) {
+        double temp = a;
+        a = b;
+        b = temp;
+    }
+    int evaluations = 0;
+    double x, value;
+    char format[FORMAT_BUFFER_SIZE];
+    snprintf(format, sizeof(format), "%%.%dg", context->sigFigs);
+    start = work_clock(context);
+    if (minimize) {
+        solve_minimum(expr, slot, a, b, &x, &value, &evaluations);
+        trace_span(context, "evaluate", start);
+        uq_printf(context, "Minimum = ");
+        uq_printf(context, format, value);
+        uq_printf(context, " when %s = ", variableName);
+    } else if (solve_root(expr, slot, a, b, &x, &evaluations) == 0) {
+        trace_span(context, "evaluate", start);
+        uq_printf(context, "Root found when %s = ", variableName);
+    } else {
+        STATS_ADD(context, evaluations, evaluations);
+        trace_span(context, "evaluate", start);
+        *slot = current;
+        arena_release(context, expr);
+        return 1;
+    }
+    STATS_ADD(context, evaluations, evaluations);
+    uq_printf(context, format, x);
+    uq_printf(context, " (%d evaluations)\n", evaluations);
+    loops->currentValue[loopVarIndex] = x;
+    arena_release(context, expr);
+    return 0;
+}
+
+/* Names of the MONTECARLO_ distributions as written after with
+ */
+static const char* montecarloKinds[] = {"uniform", "normal"};
+
+/* Fractions of the samples below each quantile a @montecarlo reports, and
+ * the label each is printed with
+ */
+static const double montecarloFractions[MONTECARLO_QUANTILES]
+        = {0, 0.05, 0.25, 0.5, 0.75, 0.95, 1};
+static const char* montecarloLabels[MONTECARLO_QUANTILES]
+        = {"Min", "5%", "25%", "Median", "75%", "95%", "Max"};
+
+/* Runs the Philox4x32-10 counter-based generator, replacing a counter with
+ * the four random words it maps to under a key. Each output depends only on
+ * its counter and key, so samples can be drawn on any thread in any order
+ *
+ * uint32_t counter[4]: counter, replaced by the random words
+ * uint64_t key: key of the stream
+ */
+static void philox(uint32_t counter[4], uint64_t key)
+{
+    uint32_t key0 = (uint32_t)key;
+    uint32_t key1 = (uint32_t)(key >> PHILOX_WORD_BITS);
+    for (int round = 0; round < PHILOX_ROUNDS; round++) {
+        uint64_t product0 = (uint64_t)PHILOX_M0 * counter[0];
+        uint64_t product1 = (uint64_t)PHILOX_M1 * counter[2];
+        counter[0] = (uint32_t)(product1 >> PHILOX_WORD_BITS) ^ counter[1]
+                ^ key0;
+        counter[1] = (uint32_t)product1;
+        counter[2] = (uint32_t)(product0 >> PHILOX_WORD_BITS) ^ counter[3]
+                ^ key1;
+        counter[3] = (uint32_t)product0;
+        key0 += PHILOX_W0;
+        key1 += PHILOX_W1;
+    }
+}
+
+/* Draws the value of a distribution for one sample. The counter is made of
+ * the sample and the distribution's index, so the value is the same however
+ * the samples are shared between threads. A normal is drawn by the Box-Muller
+ * transform
+ *
+ * const Distribution* distribution: distribution to draw from
+ * int k: index of the distribution in its statement
+ * long long i: index of the sample
+ * uint64_t seed: key of the random streams
+ *
+ * Returns the value
+ */
+static double montecarlo_sample(
+        const Distribution* distribution, int k, long long i, uint64_t seed)
+{
+    uint32_t counter[4] = {(uint32_t)i,
+            (uint32_t)((uint64_t)i >> PHILOX_WORD_BITS), (uint32_t)k, 0};
+    philox(counter, seed);
+    double u = (double)((((uint64_t)counter[0] << PHILOX_WORD_BITS)
+                                | counter[1])
+                       >> PHILOX_DOUBLE_SHIFT)
+            * PHILOX_UNIT;
+    if (distribution->kind == MONTECARLO_UNIFORM) {
+        return distribution->first
+                + (distribution->second - distribution->first) * u;
+    }
+    double v = (double)((((uint64_t)counter[2] << PHILOX_WORD_BITS)
+                                | counter[3])
+                       >> PHILOX_DOUBLE_SHIFT)
+            * PHILOX_UNIT;
+    return distribution->first
+            + distribution->second * sqrt(-2.0 * log(u + PHILOX_UNIT))
+            * cos(MATH_TWO_PI * v);
+}
+
+/* Takes blocks of a @montecarlo run until none are left, drawing the
+ * distributions of each block's samples into columns and evaluating the
+ * program over them
+ *
+ * void* data: the MonteCarloRun
+ *
+ * Returns NULL
+ */
+static void* montecarlo_worker(void* data)
+{
+    MonteCarloRun* run = (MonteCarloRun*)data;
+    int numberColumns = run->numberDistributions;
+    double** columns = (double**)malloc((numberColumns + 1) * sizeof(double*));
+    for (int k = 0; k < numberColumns; k++) {
+        columns[k] = vector_allocate(MONTECARLO_BLOCK);
+    }
+    long long block;
+    while ((block = __atomic_fetch_add(&(run->next), 1, __ATOMIC_SEQ_CST))
+            < run->numberBlocks) {
+        long long start = block * MONTECARLO_BLOCK;
+        int count = (run->samples - start < MONTECARLO_BLOCK)
+                ? (int)(run->samples - start)
+                : MONTECARLO_BLOCK;
+        for (int k = 0; k < numberColumns; k++) {
+            for (int j = 0; j < count; j++) {
+                columns[k][j] = montecarlo_sample(
+                        &(run->distributions[k]), k, start + j, run->seed);
+            }
+        }
+        vector_evaluate(run->program, columns, count, run->results + start,
+                run->precision);
+    }
+    for (int k = 0; k < numberColumns; k++) {
+        free((void*)columns[k]);
+    }
+    free((void*)columns);
+    return NULL;
+}
+
+/* Evaluates the samples of a @montecarlo run on one thread per online
+ * processor, at most MONTECARLO_MAX_THREADS, or on the calling thread if
+ * none can be started
+ *
+ * MonteCarloRun* run: the run, whose results are filled in
+ */
+static void montecarlo_parallel(MonteCarloRun* run)
+{
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    int numberThreads = (processors > 0 && processors < MONTECARLO_MAX_THREADS)
+            ? (int)processors
+            : MONTECARLO_MAX_THREADS;
+    if (numberThreads > run->numberBlocks) {
+        numberThreads = (int)run->numberBlocks;
+    }
+    pthread_t threads[MONTECARLO_MAX_THREADS];
+    int started = 0;
+    while (started < numberThreads
+            && pthread_create(&(threads[started]), NULL, montecarlo_worker, run)
+                    == 0) {
+        started++;
+    }
+    if (started == 0) {
+        montecarlo_worker(run);
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+}
+
+/* Evaluates the samples of a @montecarlo run one at a time on the calling
+ * thread, used when the expression cannot be run as a vector program
+ *
+ * MonteCarloRun* run: the run, whose results are filled in
+ * const te_expr* expr: the expression, compiled with distribution k bound to
+ * slots[k]
+ * double* slots: storage the distributions are drawn into
+ */
+static void montecarlo_serial(
+        MonteCarloRun* run, const te_expr* expr, double* slots)
+{
+    for (long long i = 0; i < run->samples; i++) {
+        for (int k = 0; k < run->numberDistributions; k++) {
+            slots[k] = montecarlo_sample(
+                    &(run->distributions[k]), k, i, run->seed);
+        }
+        run->results[i] = expression_eval(expr);
+    }
+}
+
+/* Moves the value that belongs at a position of the sorted order there, with
+ * no greater value before it and no smaller one after it
+ *
+ * double* values: values to reorder, none of them NaN
+ * long long left: first index that may need to move
+ * long long right: last index that may need to move
+ * long long position: the position, between left and right
+ *
+ * Returns the value at position
+ */
+static double montecarlo_select(
+        double* values, long long left, long long right, long long position)
+{
+    while (left < right) {
+        double pivot = values[left + (right - left) / 2];
+        long long i = left;
+        long long j = right;
+        while (i <= j) {
+            while (values[i] < pivot) {
+                i++;
+            }
+            while (values[j] > pivot) {
+                j--;
+            }
+            if (i <= j) {
+                double temp = values[i];
+                values[i] = values[j];
+                values[j] = temp;
+                i++;
+                j--;
+            }
+        }
+        if (position <= j) {
+            right = j;
+        } else if (position >= i) {
+            left = i;
+        } else {
+            break;
+        }
+    }
+    return values[position];
+}
+
+/* Moves the values that belong at several positions of the sorted order
+ * there, selecting the middle position first and then the positions either
+ * side of it among only the values on that side
+ *
+ * double* values: values to reorder, none of them NaN
+ * long long left: first index that may need to move
+ * long long right: last index that may need to move
+ * const long long* positions: the positions in increasing order, each between
+ * left and right
+ * int numberPositions: number of positions
+ */
+static void montecarlo_select_all(double* values, long long left,
+        long long right, const long long* positions, int numberPositions)
+{
+    if (numberPositions == 0) {
+        return;
+    }
+    int middle = numberPositions / 2;
+    long long position = positions[middle];
+    montecarlo_select(values, left, right, position);
+    montecarlo_select_all(values, left, position - 1, positions, middle);
+    montecarlo_select_all(values, position + 1, right, positions + middle + 1,
+            numberPositions - middle - 1);
+}
+
+/* Works out the quantiles a @montecarlo reports, interpolating between the
+ * two samples either side of each
+ *
+ * double* values: the samples, none of them NaN, reordered
+ * long long count: number of samples
+ * double* quantiles: storage for MONTECARLO_QUANTILES quantiles
+ */
+static void montecarlo_quantiles(
+        double* values, long long count, double* quantiles)
+{
+    long long positions[2 * MONTECARLO_QUANTILES];
+    int numberPositions = 0;
+    for (int q = 0; q < MONTECARLO_QUANTILES && count > 0; q++) {
+        long long below = (long long)(montecarloFractions[q] * (count - 1));
+        for (long long p = below; p <= below + 1 && p < count; p++) {
+            if (numberPositions == 0 || positions[numberPositions - 1] < p) {
+                positions[numberPositions] = p;
+                numberPositions++;
+            }
+        }
+    }
+    montecarlo_select_all(values, 0, count - 1, positions, numberPositions);
+    for (int q = 0; q < MONTECARLO_QUANTILES; q++) {
+        if (count == 0) {
+            quantiles[q] = NAN;
+            continue;
+        }
+        double position = montecarloFractions[q] * (count - 1);
+        long long below = (long long)position;
+        double low = values[below];
+        double high = (below + 1 < count) ? values[below + 1] : low;
+        quantiles[q] = low + (position - below) * (high - low);
+    }
+}
+
+/* Prints the mean, sample variance and quantiles of the results of a
+ * @montecarlo run. Samples whose result is NaN are left out and counted.
+ * Sums are taken a block at a time in a fixed order, so the report does not
+ * depend on how the samples were shared between threads
+ *
+ * UqContext* context: context whose output and sig figs are used
+ * double* results: the results, reordered
+ * long long samples: number of results
+ */
+static void montecarlo_report(
+        UqContext* context, double* results, long long samples)
+{
+    long long count = 0;
+    for (long long i = 0; i < samples; i++) {
+        if (!isnan(results[i])) {
+            results[count] = results[i];
+            count++;
+        }
+    }
+    double total = 0;
+    for (long long start = 0; start < count; start += MONTECARLO_BLOCK) {
+        double block = 0;
+        for (long long i = start; i < count && i < start + MONTECARLO_BLOCK;
+                i++) {
+            block += results[i];
+        }
+        total += block;
+    }
+    double mean = (count > 0) ? total / count : NAN;
+    double squares = 0;
+    for (long long start = 0; start < count; start += MONTECARLO_BLOCK) {
+        double block = 0;
+        for (long long i = start; i < count && i < start + MONTECARLO_BLOCK;
+                i++) {
+            block += (results[i] - mean) * (results[i] - mean);
+        }
+        squares += block;
+    }
+    double variance = (count > 1) ? squares / (count - 1) : 0;
+    double quantiles[MONTECARLO_QUANTILES];
+    montecarlo_quantiles(results, count, quantiles);
+    char format[FORMAT_BUFFER_SIZE];
+    snprintf(format, sizeof(format), "%%.%dg", context->sigFigs);
+    uq_printf(context, "Mean = ");
+    uq_printf(context, format, mean);
+    uq_printf(context, ", Variance = ");
+    uq_printf(context, format, variance);
+    uq_printf(context, " (%lld samples", samples);
+    if (count < samples) {
+        uq_printf(context, ", %lld NaN", samples - count);
+    }
+    uq_printf(context, ")\n");
+    for (int q = 0; q < MONTECARLO_QUANTILES; q++) {
+        uq_printf(context, "%s%s = ", (q == 0) ? "" : ", ",
+                montecarloLabels[q]);
+        uq_printf(context, format, quantiles[q]);
+    }
+    uq_printf(context, "\n");
+}
+
+/* Parses the distributions following with in a @montecarlo statement,
+ * separated by commas, each one of
+ *
+ *     name uniform(lower, upper)
+ *     name normal(mean, deviation)
+ *
+ * The parameters are expressions of the context's variables, evaluated once
+ *
+ * UqContext* context: context the parameters are evaluated in
+ * char* text: the text following with, modified in place
+ * Distribution* distributions: storage for the distributions, at least one
+ * more than the number of commas in text
+ * int* count: pointer to where the number of distributions will be stored
+ *
+ * Returns 0 if successful or 1 if a declaration is invalid, a name is given
+ * twice, a parameter is not finite, a uniform's upper bound is below its
+ * lower bound or a normal's deviation is negative
+ */
+static int montecarlo_distributions(UqContext* context, char* text,
+        Distribution* distributions, int* count)
+{
+    *count = 0;
+    char* at = text;
+    while (1) {
+        while (isspace((unsigned char)*at)) {
+            at++;
+        }
+        char* name = at;
+        while (isalpha((unsigned char)*at)) {
+            at++;
+        }
+        char* nameEnd = at;
+        while (isspace((unsigned char)*at)) {
+            at++;
+        }
+        char* kindText = at;
+        while (isalpha((unsigned char)*at)) {
+            at++;
+        }
+        int kind = -1;
+        for (int m = 0; m < 2; m++) {
+            if ((size_t)(at - kindText) == strlen(montecarloKinds[m])
+                    && !strncmp(kindText, montecarloKinds[m], at - kindText)) {
+                kind = m;
+            }
+        }
+        if (kind == -1 || *at != '(' || kindText == nameEnd
+                || nameEnd - name < 1
+                || nameEnd - name > MAX_VARIABLE_LENGTH) {
+            return 1;
+        }
+        *nameEnd = '\0';
+        char* parameters[2] = {at + 1, NULL};
+        int depth = 0;
+        for (at++; *at != '\0' && (depth > 0 || *at != ')'); at++) {
+            if (*at == '(') {
+                depth++;
+            } else if (*at == ')') {
+                depth--;
+            } else if (*at == ',' && depth == 0) {
+                if (parameters[1] != NULL) {
+                    return 1;
+                }
+                *at = '\0';
+                parameters[1] = at + 1;
+            }
+        }
+        if (*at != ')' || parameters[1] == NULL) {
+            return 1;
+        }
+        *at = '\0';
+        at++;
+        Distribution* distribution = &(distributions[*count]);
+        distribution->name = name;
+        distribution->kind = kind;
+        if (evaluate_quietly(context, parameters[0], &(distribution->first))
+                || evaluate_quietly(
+                        context, parameters[1], &(distribution->second))) {
+            return 1;
+        }
+        double least = (kind == MONTECARLO_UNIFORM) ? distribution->first : 0;
+        if (!isfinite(distribution->first) || !isfinite(distribution->second)
+                || distribution->second < least) {
+            return 1;
+        }
+        for (int k = 0; k < *count; k++) {
+            if (!strcmp(distributions[k].name, name)) {
+                return 1;
+            }
+        }
+        (*count)++;
+        while (isspace((unsigned char)*at)) {
+            at++;
+        }
+        if (*at == '\0') {
+            return 0;
+        }
+        if (*at != ',') {
+            return 1;
+        }
+        at++;
+    }
+}
+
+/* Processes a @montecarlo command:
+ *
+ *     @montecarlo N expression with declarations [seed S]
+ *
+ * The expression is evaluated for N samples of the declared distributions
+ * and the distribution of its value reported, without printing the samples.
+ * Sample i of distribution k is drawn from the Philox stream keyed by S, 0 by
+ * default, at counter (i, k), and the samples are evaluated a block at a time
+ * as a vector program on several threads, so the report is the same whatever
+ * the number of threads. A distribution hides a variable of the same name
+ *
+ * UqContext* context: context holding the variables, loops and settings
+ * char* line: the string representation of the entire command
+ *
+ * Return 0 if successful or 1 if there is an error in syntax, N is outside
+ * 1..MONTECARLO_MAX_SAMPLES, the expression is invalid or holding the N
+ * results would take the context over its memory limit
+ */
+static int montecarlo(UqContext* context, char* line)
+{
+    char* text = line + MONTECARLO_LENGTH;
+    char* end;
+    long long samples = strtoll(text, &end, DECIMAL_BASE);
+    if (end == text || !isspace((unsigned char)*end) || samples < 1
+            || samples > MONTECARLO_MAX_SAMPLES) {
+        return 1;
+    }
+    uint64_t seed = 0;
+    char* seedClause = loop_keyword(end, "seed");
+    if (seedClause != NULL) {
+        char* number = seedClause + strlen("seed");
+        char* after;
+        long long value = strtoll(number, &after, DECIMAL_BASE);
+        while (isspace((unsigned char)*after)) {
+            after++;
+        }
+        if (after != number && *after == '\0') {
+            if (value < 0) {
+                return 1;
+            }
+            seed = (uint64_t)value;
+            *seedClause = '\0';
+        }
+    }
+    char* with = loop_keyword(end, "with");
+    if (with == NULL) {
+        return 1;
+    }
+    *with = '\0';
+    char* expression = end;
+    char* declarations = with + strlen("with");
+    int capacity = 1;
+    for (char* at = declarations; *at != '\0'; at++) {
+        capacity += (*at == ',');
+    }
+    Distribution* distributions
+            = (Distribution*)malloc(capacity * sizeof(Distribution));
+    int numberDistributions;
+    if (montecarlo_distributions(
+                context, declarations, distributions, &numberDistributions)) {
+        free((void*)distributions);
+        return 1;
+    }
+    Bindings bindings;
+    bind_referenced(context, expression, 0, &bindings);
+    double* slots = (double*)malloc(numberDistributions * sizeof(double));
+    te_variable* tevars = (te_variable*)malloc(
+            (numberDistributions + bindings.count) * sizeof(te_variable));
+    int count = 0;
+    for (int k = 0; k < numberDistributions; k++) {
+        slots[k] = NAN;
+        te_variable var = {.name = distributions[k].name,
+                .address = &(slots[k]),
+                .type = TE_VARIABLE,
+                .context = NULL};
+        tevars[count] = var;
+        count++;
+    }
+    for (int j = 0; j < bindings.count; j++) {
+        int hidden = 0;
+        for (int k = 0; k < numberDistributions; k++) {
+            hidden |= !strcmp(bindings.tevars[j].name, distributions[k].name);
+        }
+        if (!hidden) {
+            tevars[count] = bindings.tevars[j];
+            count++;
+        }
+    }
+    long long start = work_clock(context);
+    te_expr* expr = compile_uncached(context, expression, tevars, count, start);
+    free((void*)tevars);
+    bindings_free(&bindings);
+    long long bytes = samples * (long long)sizeof(double);
+    memory_add(context, UQ_MEMORY_BUFFERS, bytes);
+    double* results = (expr != NULL && !memory_over(context))
+            ? (double*)malloc(samples * sizeof(double))
+            : NULL;
+    if (results == NULL) {
+        memory_add(context, UQ_MEMORY_BUFFERS, -bytes);
+        if (expr != NULL) {
+            arena_release(context, expr);
+        }
+        free((void*)slots);
+        free((void*)distributions);
+        return 1;
+    }
+    int vector = (context->engine == UQ_ENGINE_VECTOR);
+    VectorProgram program;
+    MonteCarloRun run = {.program = &program,
+            .distributions = distributions,
+            .numberDistributions = numberDistributions,
+            .seed = seed,
+            .samples = samples,
+            .numberBlocks = (samples + MONTECARLO_BLOCK - 1) / MONTECARLO_BLOCK,
+            .next = 0,
+            .precision = vector ? vector_precision(context)
+                                : UQ_PRECISION_DOUBLE,
+            .results = results};
+    start = work_clock(context);
+    if (vector_compile(expr, &program, slots, NULL, numberDistributions,
+                vector ? context->math : UQ_MATH_EXACT)) {
+        montecarlo_serial(&run, expr, slots);
+    } else {
+        montecarlo_parallel(&run);
+        vector_free(&program);
+    }
+    STATS_ADD(context, evaluations, samples);
+    trace_span(context, "evaluate", start);
+    montecarlo_report(context, results, samples);
+    memory_add(context, UQ_MEMORY_BUFFERS, -bytes);
+    free((void*)results);
+    arena_release(context, expr);
+    free((void*)slots);
+    free((void*)distributions);
+    return 0;
+}
+
+/* Detects and process a @range, @print or @publish in given line, executing
+ * appriopriuate operatio9n
+ *
+ * UqContext* context: context holding the variables, loops and settings
+ * char* line: The string containing the command to process
+ *
+ * Returns 0 if succesful else 1
+ */
+static int detect_range_print(UqContext* context, char* line)
+{
+    char* savePointer;
+    char* testString = strdup(line);
+    int testStart = 0;
+    int testEnd = strlen(testString);
+    while (isspace((unsigned char)testString[testStart])
+            && testStart < testEnd) {
+        testStart++;
+    }
+    while (isspace((unsigned char)testString[testEnd]) && testEnd > testStart) {
+        testEnd--;
+    }
+    memmove(testString, testString + testStart, testEnd - testStart + 1);
+    // REF: Inspired by https://www.geeksforgeeks.org/memmove-in-cc/
+    if (!strcmp(testString, "@print\n")) {
+        if (print_variables(context)) {
+            command_error(context);
+        }
+        free(testString);
+        return 1;
+    }
+    if (!strcmp(testString, "@publish\n")) {
+        if (base_publish(context)) {
+            command_error(context);
+        }
+        free(testString);
+        return 1;
+    }
+    int spaceCounter = 0;
+    for (int i = 0; i < (int)strlen(testString); i++) {
+        if (testString[i] == ' ') {
+            spaceCounter++;
+        }
+    }
+    char* rangeTest = strtok_r(testString, " ", &savePointer);
+    char* rangeExpression = strtok_r(NULL, " ", &savePointer);
+    if (!strcmp(rangeTest, "@range") && spaceCounter == 1 && line[0] == '@') {
+        int res = range(context, rangeExpression);
+        if (res != 0) {
+            command_error(context);
+        }
+        free(testString);
+        return 1;
+    }
+    free(testString);
+    return 0;
+}
+
+/* Detects and procces a loop command on given line executing necessary
+ * operations if valid loop command is found
+ *
+ * UqContext* context: context holding the variables, loops and settings
+ * char* line: the String containing the command to process
+ *
+ * Return 0 if succesful otherwise 1
+ */
+static int detect_loops(UqContext* context, char* line)
+{
+    char* testString = strdup(line);
+    if ((int)strlen(testString) > LOOP_LENGTH && testString[0] == '@'
+            && testString[1] == 'l' && testString[2] == 'o'
+            && testString[THIRD_INDEX] == 'o' && testString[FOURTH_INDEX] == 'p'
+            && testString[FIFTH_INDEX] == ' '
+            && isalpha((unsigned char)testString[LOOP_LENGTH])) {
+        int res = loop(context, testString);
+        if (res != 0) {
+            command_error(context);
+        }
+        free(testString);
+        return 1;
+    }
+    free(testString);
+    return 0;
+}
+
+/* Detects and processes a @solve or @minimize command on given line
+ *
+ * UqContext* context: context holding the variables, loops and settings
+ * char* line: the String containing the command to process
+ *
+ * Return 1 if a @solve or @minimize command was found otherwise 0
+ */
+static int detect_solve(UqContext* context, char* line)
+{
+    int minimize;
+    if (!strncmp(line, "@solve ", SOLVE_LENGTH)) {
+        minimize = 0;
+    } else if (!strncmp(line, "@minimize ", MINIMIZE_LENGTH)) {
+        minimize = 1;
+    } else {
+        return 0;
+    }
+    char* testString = strdup(line);
+    int res = solve(context, testString, minimize);
+    if (res != 0) {
+        command_error(context);
+    }
+    free(testString);
+    return 1;
+}
+
+/* Detects and processes a @montecarlo command on given line
+ *
+ * UqContext* context: context holding the variables, loops and settings
+ * char* line: the String containing the command to process
+ *
+ * Return 1 if a @montecarlo command was found otherwise 0
+ */
+static int detect_montecarlo(UqContext* context, char* line)
+{
+    if (strncmp(line, "@montecarlo ", MONTECARLO_LENGTH)) {
+        return 0;
+    }
+    char* testString = strdup(line);
+    int res = montecarlo(context, testString);
+    if (res != 0) {
+        command_error(context);
+    }
+    free(testString);
+    return 1;
+}
+
+/* Works out which vector operation a tinyexpr function node performs. The
+ * arithmetic operators are static functions inside tinyexpr so they cannot be
+ * compared by address; instead pure nodes are identified by evaluating their
+ * function at fixed probe values. Anything not recognised is applied one
+ * element at a time through VECTOR_CALL
+ *
+ * const te_expr* n: function node to classify
+ *
+ * Returns one of VECTOR_NEGATE, VECTOR_ADD, VECTOR_SUBTRACT, VECTOR_MULTIPLY,
+ * VECTOR_DIVIDE or VECTOR_CALL
+ */
+static int vector_classify(const te_expr* n)
+{
+    int arity = n->type & TE_ARITY_MASK;
+    if (!(n->type & TE_FLAG_PURE)) {
+        return VECTOR_CALL;
+    }
+    double a = PROBE_FIRST, b = PROBE_SECOND, c = PROBE_THIRD;
+    if (arity == 1) {
+        double (*function)(double);
+        memcpy(&function, &n->function, sizeof(function));
+        if (function(a) == -a && function(c) == -c) {
+            return VECTOR_NEGATE;
+        }
+    } else if (arity == 2) {
+        double (*function)(double, double);
+        memcpy(&function, &n->function, sizeof(function));
+        double first = function(a, b);
+        double second = function(b, c);
+        if (first == a + b && second == b + c) {
+            return VECTOR_ADD;
+        }
+        if (first == a - b && second == b - c) {
+            return VECTOR_SUBTRACT;
+        }
+        if (first == a * b && second == b * c) {
+            return VECTOR_MULTIPLY;
+        }
+        if (first == a / b && second == b / c) {
+            return VECTOR_DIVIDE;
+        }
+    }
+    return VECTOR_CALL;
+}
+
+/* Works out which math kernel can stand in for a tinyexpr function node, by
+ * comparing its function with the C library functions tinyexpr binds sin,
+ * cos, exp, ln, log, log10 and pow to
+ *
+ * const te_expr* n: function node
+ *
+ * Returns one of VECTOR_SIN, VECTOR_COS, VECTOR_EXP, VECTOR_LN, VECTOR_LOG10
+ * or VECTOR_POW, or VECTOR_CALL if there is no kernel for the function
+ */
+static int vector_kernel(const te_expr* n)
+{
+    int arity = n->type & TE_ARITY_MASK;
+    if (arity == 1) {
+        double (*function)(double);
+        memcpy(&function, &n->function, sizeof(function));
+        if (function == sin) {
+            return VECTOR_SIN;
+        }
+        if (function == cos) {
+            return VECTOR_COS;
+        }
+        if (function == exp) {
+            return VECTOR_EXP;
+        }
+        if (function == log) {
+            return VECTOR_LN;
+        }
+        if (function == log10) {
+            return VECTOR_LOG10;
+        }
+    } else if (arity == 2) {
+        double (*function)(double, double);
+        memcpy(&function, &n->function, sizeof(function));
+        if (function == pow) {
+            return VECTOR_POW;
+        }
+    }
+    return VECTOR_CALL;
+}
+
+/* Appends the operation for a tinyexpr node to a program, once the
+ * operations for its children have been appended, so the program is in
+ * postfix order. Constants use TE_CONSTANT_TYPE, the type tinyexpr gives them
+ * internally
+ *
+ * const te_expr* n: node to flatten
+ * void* data: the VectorEmitter
+ *
+ * Returns 0 if successful or 1 if the node cannot be evaluated as a vector
+ */
+static int vector_emit(const te_expr* n, void* data)
+{
+    VectorEmitter* emitter = (VectorEmitter*)data;
+    VectorProgram* program = emitter->program;
+    VectorInstruction instruction = {.opcode = VECTOR_CALL,
+            .arity = 0,
+            .value = 0,
+            .address = NULL,
+            .array = -1,
+            .function = NULL};
+    int type = n->type & TE_TYPE_MASK;
+    if (type == TE_CONSTANT_TYPE) {
+        instruction.opcode = VECTOR_CONSTANT;
+        instruction.value = n->value;
+    } else if (type == TE_VARIABLE) {
+        instruction.opcode = VECTOR_SCALAR;
+        instruction.address = n->bound;
+        for (int k = 0; k < emitter->numberSlots; k++) {
+            if (n->bound == &(emitter->slots[k])) {
+                instruction.opcode = VECTOR_ARRAY;
+                instruction.array
+                        = (emitter->arrays != NULL) ? emitter->arrays[k] : k;
+                program->usesArrays = 1;
+            }
+        }
+    } else if ((type & TE_FUNCTION0) && !(type & TE_CLOSURE0)) {
+        instruction.arity = type & TE_ARITY_MASK;
+        if (instruction.arity > VECTOR_MAX_ARITY) {
+            return 1;
+        }
+        instruction.opcode = vector_classify(n);
+        if (instruction.opcode == VECTOR_CALL && emitter->math == UQ_MATH_FAST
+                && (n->type & TE_FLAG_PURE)) {
+            instruction.opcode = vector_kernel(n);
+        }
+        instruction.function = n->function;
+        emitter->depth -= instruction.arity;
+    } else {
+        return 1;
+    }
+    emitter->depth++;
+    if (emitter->depth > program->depth) {
+        program->depth = emitter->depth;
+    }
+    program->instructions[program->size] = instruction;
+    program->size++;
+    return 0;
+}
+
+/* Counts one node of a compiled tinyexpr expression
+ *
+ * const te_expr* n: node being counted
+ * void* data: pointer to the number of nodes counted so far
+ *
+ * Returns 0
+ */
+static int vector_count(const te_expr* n, void* data)
+{
+    (void)n;
+    (*(int*)data)++;
+    return 0;
+}
+
+/* Flattens a compiled tinyexpr expression into a VectorProgram
+ *
+ * const te_expr* expr: compiled expression
+ * VectorProgram* program: program to be filled in
+ * double* slots: addresses array variables were bound to when compiling
+ * const int* arrays: index of the array variable each slot stands for, or
+ * NULL if slot k stands for array k
+ * int numberSlots: number of entries in slots
+ * int math: UQ_MATH_EXACT or UQ_MATH_FAST
+ *
+ * Returns 0 if successful or 1 if the expression cannot be evaluated as a
+ * vector
+ */
+static int vector_compile(const te_expr* expr, VectorProgram* program,
+        double* slots, const int* arrays, int numberSlots, int math)
+{
+    int count = 0;
+    expression_walk(expr, vector_count, &count);
+    program->instructions
+            = (VectorInstruction*)malloc(count * sizeof(VectorInstruction));
+    program->size = 0;
+    program->depth = 0;
+    program->usesArrays = 0;
+    VectorEmitter emitter = {.program = program,
+            .slots = slots,
+            .arrays = arrays,
+            .numberSlots = numberSlots,
+            .math = math,
+            .depth = 0};
+    if (expression_walk(expr, vector_emit, &emitter)) {
+        free((void*)program->instructions);
+        program->instructions = NULL;
+        return 1;
+    }
+    return 0;
+}
+
+/* Frees the operations of a VectorProgram
+ *
+ * VectorProgram* program: program to be freed
+ *
+ * Returns 0
+ */
+static int vector_free(VectorProgram* program)
+{
+    free((void*)program->instructions);
+    program->instructions = NULL;
+    return 0;
+}
+
+/* Applies a function one element at a time to the argument blocks on top of
+ * the evaluation stack, leaving the result in place of the first argument
+ *
+ * const VectorInstruction* instruction: the VECTOR_CALL operation
+ * double* first: block holding the first argument
+ * int count: number of elements in each block
+ *
+ * Returns 0
+ */
+static int vector_call(
+        const VectorInstruction* instruction, double* first, int count)
+{
+    double* second = first + VECTOR_BLOCK;
+    double* third = second + VECTOR_BLOCK;
+    if (instruction->arity == 0) {
+        double (*function)(void);
+        memcpy(&function, &instruction->function, sizeof(function));
+        double value = function();
+        for (int j = 0; j < count; j++) {
+            first[j] = value;
+        }
+    } else if (instruction->arity == 1) {
+        double (*function)(double);
+        memcpy(&function, &instruction->function, sizeof(function));
+        for (int j = 0; j < count; j++) {
+            first[j] = function(first[j]);
+        }
+    } else if (instruction->arity == 2) {
+        double (*function)(double, double);
+        memcpy(&function, &instruction->function, sizeof(function));
+        for (int j = 0; j < count; j++) {
+            first[j] = function(first[j], second[j]);
+        }
+    } else {
+        double (*function)(double, double, double);
+        memcpy(&function, &instruction->function, sizeof(function));
+        for (int j = 0; j < count; j++) {
+            first[j] = function(first[j], second[j], third[j]);
+        }
+    }
+    return 0;
+}
+
+/* Reinterprets the bits of an unsigned 64 bit integer as a double
+ */
+static inline double math_double(uint64_t bits)
+{
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/* Reinterprets the bits of a double as an unsigned 64 bit integer
+ */
+static inline uint64_t math_bits(double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+/* Chooses between two values with bit masks rather than a branch. A ?:
+ * between the results of floating point operations is turned into a branch
+ * around them, which stops the loops of the kernels from being vectorized
+ *
+ * uint64_t condition: 1 to choose yes or 0 to choose no
+ * double yes: value chosen if condition is 1
+ * double no: value chosen if condition is 0
+ *
+ * Returns yes or no
+ */
+static inline double math_select(uint64_t condition, double yes, double no)
+{
+    uint64_t mask = (uint64_t)0 - condition;
+    return math_double((math_bits(yes) & mask) | (math_bits(no) & ~mask));
+}
+
+/* Computes e^x by reducing x to r = x - k ln 2 with |r| <= ln 2 / 2, summing
+ * the Taylor series of e^r to r^13 and scaling by 2^k in two halves so that
+ * overflow to infinity and underflow to zero happen in the final multiplies
+ *
+ * double value: x
+ *
+ * Returns e^x
+ */
+static inline double math_exp_one(double value)
+{
+    double x = math_select(value > MATH_EXP_HIGH, MATH_EXP_HIGH, value);
+    x = math_select(x < MATH_EXP_LOW, MATH_EXP_LOW, x);
+    double k = (x * MATH_LOG2E + MATH_ROUND) - MATH_ROUND;
+    double r = (x - k * MATH_LN2_HIGH) - k * MATH_LN2_LOW;
+    double sum = 1.0 / 6227020800.0;
+    sum = 1.0 / 479001600.0 + r * sum;
+    sum = 1.0 / 39916800.0 + r * sum;
+    sum = 1.0 / 3628800.0 + r * sum;
+    sum = 1.0 / 362880.0 + r * sum;
+    sum = 1.0 / 40320.0 + r * sum;
+    sum = 1.0 / 5040.0 + r * sum;
+    sum = 1.0 / 720.0 + r * sum;
+    sum = 1.0 / 120.0 + r * sum;
+    sum = 1.0 / 24.0 + r * sum;
+    sum = 1.0 / 6.0 + r * sum;
+    sum = 0.5 + r * sum;
+    sum = 1.0 + r * sum;
+    sum = 1.0 + r * sum;
+    double half = (k * 0.5 + MATH_ROUND) - MATH_ROUND;
+    double low = math_double((math_bits(half + MATH_ROUND + MATH_EXPONENT_BIAS)
+                                     - math_bits(MATH_ROUND))
+            << MATH_MANTISSA_BITS);
+    double high = math_double(
+            (math_bits(k - half + MATH_ROUND + MATH_EXPONENT_BIAS)
+                    - math_bits(MATH_ROUND))
+            << MATH_MANTISSA_BITS);
+    return sum * low * high;
+}
+
+/* Computes ln x by splitting x into 2^k m with sqrt(2) / 2 < m <= sqrt(2)
+ * and evaluating ln m = 2 atanh((m - 1) / (m + 1)) with the minimax
+ * polynomial of fdlibm's log
+ *
+ * double value: x
+ *
+ * Returns ln x, -infinity if x is 0 or NaN if x is negative, the NaN an
+ * invalid operation produces so that it prints as the C library's does
+ */
+static inline double math_ln_one(double value)
+{
+    double scaled = value * MATH_SUBNORMAL_SCALE;
+    double x = math_select(value < DBL_MIN, scaled, value);
+    uint64_t bits = math_bits(x);
+    double m = math_double((bits & MATH_MANTISSA_MASK) | MATH_ONE_BITS);
+    double k = math_double(MATH_INTEGER_BITS
+                       | ((bits >> MATH_MANTISSA_BITS) & MATH_EXPONENT_MASK))
+            - (MATH_INTEGER_OFFSET + MATH_EXPONENT_BIAS);
+    double adjusted = k - MATH_SUBNORMAL_BITS;
+    k = math_select(value < DBL_MIN, adjusted, k);
+    double next = k + 1.0;
+    double halved = m * 0.5;
+    k = math_select(m > MATH_SQRT2, next, k);
+    m = math_select(m > MATH_SQRT2, halved, m);
+    double f = m - 1.0;
+    double s = f / (2.0 + f);
+    double z = s * s;
+    double w = z * z;
+    double odd = w * (3.999999999940941908e-01
+            + w * (2.222219843214978396e-01 + w * 1.531383769920937332e-01));
+    double even = z * (6.666666666666735130e-01
+            + w * (2.857142874366239149e-01
+                    + w * (1.818357216161805012e-01
+                            + w * 1.479819860511658591e-01)));
+    double square = 0.5 * f * f;
+    double result = k * MATH_LN2_HIGH
+            - ((square - (s * (square + even + odd) + k * MATH_LN2_LOW)) - f);
+    result = math_select(value == HUGE_VAL, value, result);
+    result = math_select(value == 0.0, -HUGE_VAL, result);
+    double invalid = (value - value) / (value - value);
+    result = math_select(value < 0.0, invalid, result);
+    return math_select(value != value, value, result);
+}
+
+/* Computes sin r for |r| <= pi / 4 with the polynomial of fdlibm's
+ * __kernel_sin
+ *
+ * double r: argument
+ * double z: r * r
+ *
+ * Returns sin r
+ */
+static inline double math_sin_kernel(double r, double z)
+{
+    double sum = 2.75573137070700676789e-06
+            + z * (-2.50507602534068634195e-08
+                    + z * 1.58969099521155010221e-10);
+    sum = 8.33333333332248946124e-03
+            + z * (-1.98412698298579493134e-04 + z * sum);
+    return r + z * r * (-1.66666666666666324348e-01 + z * sum);
+}
+
+/* Computes cos r for |r| <= pi / 4 with the polynomial of fdlibm's
+ * __kernel_cos
+ *
+ * double z: r * r
+ *
+ * Returns cos r
+ */
+static inline double math_cos_kernel(double z)
+{
+    double sum = 2.48015872894767294178e-05
+            + z * (-2.75573143513906633035e-07
+                    + z * (2.08757232129817482790e-09
+                            + z * -1.13596475577881948265e-11));
+    sum = z * (4.16666666666666019037e-02
+            + z * (-1.38888888888741095749e-03 + z * sum));
+    double half = 0.5 * z;
+    double w = 1.0 - half;
+    return w + (((1.0 - w) - half) + z * sum);
+}
+
+/* Replaces each element of a block with e^x
+ *
+ * double* block: elements, replaced by their results
+ * int count: number of elements
+ */
+MATH_DISPATCH static void math_exp(double* block, int count)
+{
+    for (int j = 0; j < count; j++) {
+        block[j] = math_exp_one(block[j]);
+    }
+}
+
+/* Replaces each element of a block with its logarithm, ln x times scale
+ *
+ * double* block: elements, replaced by their results
+ * int count: number of elements
+ * double scale: 1 for ln or 1 / ln 10 for log10
+ */
+MATH_DISPATCH static void math_log(double* block, int count, double scale)
+{
+    for (int j = 0; j < count; j++) {
+        block[j] = math_ln_one(block[j]) * scale;
+    }
+}
+
+/* Replaces each element of a block with its sine or cosine. The argument is
+ * reduced by the nearest multiple n of pi / 2, with pi / 2 split into four
+ * parts and the rounding error of each subtraction carried, so the reduced
+ * argument is accurate even close to a multiple of pi / 2; n selects the
+ * kernel and sign. Elements beyond MATH_TRIG_LIMIT, infinities and NaN are
+ * left in place by the vector loop and passed to the C library afterwards
+ *
+ * double* block: elements, replaced by their results
+ * int count: number of elements
+ * int cosine: 1 for cos or 0 for sin
+ */
+MATH_DISPATCH static void math_trig(double* block, int count, int cosine)
+{
+    for (int j = 0; j < count; j++) {
+        double x = block[j];
+        double shifted = x * MATH_TWO_OVER_PI + MATH_ROUND;
+        double n = shifted - MATH_ROUND;
+        double high = x - n * MATH_PIO2_1;
+        double part = n * MATH_PIO2_2;
+        double middle = high - part;
+        double error = (high - (middle + (high - middle)))
+                + ((high - middle) - part);
+        part = n * MATH_PIO2_3;
+        double low = middle - part;
+        error += (middle - (low + (middle - low))) + ((middle - low) - part);
+        double r = low + (error - n * MATH_PIO2_3T);
+        double z = r * r;
+        uint64_t quadrant = math_bits(shifted) + (uint64_t)cosine;
+        double result = math_select(quadrant & 1, math_cos_kernel(z),
+                math_sin_kernel(r, z));
+        result = math_double(
+                math_bits(result) ^ ((quadrant & 2) << MATH_SIGN_SHIFT));
+        block[j] = math_select(fabs(x) <= MATH_TRIG_LIMIT, result, x);
+    }
+    for (int j = 0; j < count; j++) {
+        if (!(fabs(block[j]) <= MATH_TRIG_LIMIT)) {
+            block[j] = cosine ? cos(block[j]) : sin(block[j]);
+        }
+    }
+}
+
+/* Replaces each element x of a block with x^y as e^(y ln x). Elements where
+ * |y ln x| > MATH_POW_LIMIT, whose error grows with y ln x, and those where x
+ * is not positive and finite are passed to the C library afterwards
+ *
+ * double* block: elements x, replaced by their results
+ * const double* exponents: exponent y of each element
+ * int count: number of elements
+ */
+MATH_DISPATCH static void math_pow(
+        double* block, const double* exponents, int count)
+{
+    double slow[VECTOR_BLOCK];
+    for (int j = 0; j < count; j++) {
+        double x = block[j];
+        double product = exponents[j] * math_ln_one(x);
+        double result = math_exp_one(product);
+        slow[j] = math_select(fabs(product) <= MATH_POW_LIMIT, 0.0, 1.0);
+        block[j] = math_select(fabs(product) <= MATH_POW_LIMIT, result, x);
+    }
+    for (int j = 0; j < count; j++) {
+        if (slow[j] != 0.0) {
+            block[j] = pow(block[j], exponents[j]);
+        }
+    }
+}
+
+/* Applies a math kernel to the argument blocks on top of the evaluation
+ * stack, leaving the result in place of the first argument
+ *
+ * int opcode: VECTOR_SIN, VECTOR_COS, VECTOR_EXP, VECTOR_LN, VECTOR_LOG10 or
+ * VECTOR_POW
+ * double* first: block holding the first argument
+ * int count: number of elements in each block
+ *
+ * Returns 0
+ */
+static int math_run(int opcode, double* first, int count)
+{
+    if (opcode == VECTOR_SIN || opcode == VECTOR_COS) {
+        math_trig(first, count, opcode == VECTOR_COS);
+    } else if (opcode == VECTOR_EXP) {
+        math_exp(first, count);
+    } else if (opcode == VECTOR_LN || opcode == VECTOR_LOG10) {
+        math_log(first, count, (opcode == VECTOR_LN) ? 1.0 : MATH_INV_LN10);
+    } else {
+        math_pow(first, first + VECTOR_BLOCK, count);
+    }
+    return 0;
+}
+
+/* Runs a VectorProgram over one block of elements. Each entry of the stack is
+ * a block of VECTOR_BLOCK doubles so every operation is a straight loop over
+ * the block that the compiler can turn into SIMD instructions
+ *
+ * const VectorProgram* program: program to run
+ * double** arrays: element storage of each array variable
+ * int start: index of the first element of the block
+ * int count: number of elements in the block, at most VECTOR_BLOCK
+ * double* stack: VECTOR_ALIGNMENT aligned storage for program->depth blocks
+ *
+ * Returns 0, the result is left in the first block of stack
+ */
+static int vector_run(const VectorProgram* program, double** arrays, int start,
+        int count, double* stack)
+{
+    int top = -1;
+    for (int i = 0; i < program->size; i++) {
+        const VectorInstruction* instruction = &(program->instructions[i]);
+        int opcode = instruction->opcode;
+        if (opcode == VECTOR_CONSTANT || opcode == VECTOR_SCALAR) {
+            top++;
+            double* restrict block = stack + top * VECTOR_BLOCK;
+            double value = (opcode == VECTOR_CONSTANT) ? instruction->value
+                                                        : *instruction->address;
+            for (int j = 0; j < count; j++) {
+                block[j] = value;
+            }
+        } else if (opcode == VECTOR_ARRAY) {
+            top++;
+            memcpy(stack + top * VECTOR_BLOCK,
+                    arrays[instruction->array] + start,
+                    count * sizeof(double));
+        } else if (opcode == VECTOR_NEGATE) {
+            double* restrict block = stack + top * VECTOR_BLOCK;
+            for (int j = 0; j < count; j++) {
+                block[j] = -block[j];
+            }
+        } else if (opcode == VECTOR_CALL) {
+            top -= instruction->arity - 1;
+            vector_call(instruction, stack + top * VECTOR_BLOCK, count);
+        } else if (opcode >= VECTOR_SIN) {
+            top -= instruction->arity - 1;
+            math_run(opcode, stack + top * VECTOR_BLOCK, count);
+        } else {
+            top--;
+            double* restrict left = stack + top * VECTOR_BLOCK;
+            double* restrict right = left + VECTOR_BLOCK;
+            if (opcode == VECTOR_ADD) {
+                for (int j = 0; j < count; j++) {
+                    left[j] = left[j] + right[j];
+                }
+            } else if (opcode == VECTOR_SUBTRACT) {
+                for (int j = 0; j < count; j++) {
+                    left[j] = left[j] - right[j];
+                }
+            } else if (opcode == VECTOR_MULTIPLY) {
+                for (int j = 0; j < count; j++) {
+                    left[j] = left[j] * right[j];
+                }
+            } else {
+                for (int j = 0; j < count; j++) {
+                    left[j] = left[j] / right[j];
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+/* Runs a VectorProgram over one block of elements in single precision. It
+ * follows vector_run() but each block holds floats, so a SIMD register holds
+ * twice as many elements. Arrays, scalars and constants are rounded to float
+ * as they are pushed, and function calls and math kernels widen their
+ * arguments to double and round their results back
+ *
+ * const VectorProgram* program: program to run
+ * double** arrays: element storage of each array variable
+ * int start: index of the first element of the block
+ * int count: number of elements in the block, at most VECTOR_BLOCK
+ * float* stack: VECTOR_ALIGNMENT aligned storage for program->depth blocks
+ * double* wide: VECTOR_ALIGNMENT aligned storage for VECTOR_MAX_ARITY double
+ * blocks
+ *
+ * Returns 0, the result is left in the first block of stack
+ */
+static int vector_run_float(const VectorProgram* program, double** arrays,
+        int start, int count, float* stack, double* wide)
+{
+    int top = -1;
+    for (int i = 0; i < program->size; i++) {
+        const VectorInstruction* instruction = &(program->instructions[i]);
+        int opcode = instruction->opcode;
+        if (opcode == VECTOR_CONSTANT || opcode == VECTOR_SCALAR) {
+            top++;
+            float* restrict block = stack + top * VECTOR_BLOCK;
+            float value = (float)((opcode == VECTOR_CONSTANT)
+                            ? instruction->value
+                            : *instruction->address);
+            for (int j = 0; j < count; j++) {
+                block[j] = value;
+            }
+        } else if (opcode == VECTOR_ARRAY) {
+            top++;
+            float* restrict block = stack + top * VECTOR_BLOCK;
+            const double* restrict elements
+                    = arrays[instruction->array] + start;
+            for (int j = 0; j < count; j++) {
+                block[j] = (float)elements[j];
+            }
+        } else if (opcode == VECTOR_NEGATE) {
+            float* restrict block = stack + top * VECTOR_BLOCK;
+            for (int j = 0; j < count; j++) {
+                block[j] = -block[j];
+            }
+        } else if (opcode == VECTOR_CALL || opcode >= VECTOR_SIN) {
+            top -= instruction->arity - 1;
+            float* first = stack + top * VECTOR_BLOCK;
+            for (int a = 0; a < instruction->arity; a++) {
+                for (int j = 0; j < count; j++) {
+                    wide[a * VECTOR_BLOCK + j]
+                            = (double)first[a * VECTOR_BLOCK + j];
+                }
+            }
+            if (opcode == VECTOR_CALL) {
+                vector_call(instruction, wide, count);
+            } else {
+                math_run(opcode, wide, count);
+            }
+            for (int j = 0; j < count; j++) {
+                first[j] = (float)wide[j];
+            }
+        } else {
+            top--;
+            float* restrict left = stack + top * VECTOR_BLOCK;
+            float* restrict right = left + VECTOR_BLOCK;
+            if (opcode == VECTOR_ADD) {
+                for (int j = 0; j < count; j++) {
+                    left[j] = left[j] + right[j];
+                }
+            } else if (opcode == VECTOR_SUBTRACT) {
+                for (int j = 0; j < count; j++) {
+                    left[j] = left[j] - right[j];
+                }
+            } else if (opcode == VECTOR_MULTIPLY) {
+                for (int j = 0; j < count; j++) {
+                    left[j] = left[j] * right[j];
+                }
+            } else {
+                for (int j = 0; j < count; j++) {
+                    left[j] = left[j] / right[j];
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+/* Allocates contiguous element storage aligned to VECTOR_ALIGNMENT
+ *
+ * int length: number of doubles to allocate room for
+ *
+ * Returns pointer to the storage or NULL if it could not be allocated
+ */
+static double* vector_allocate(int length)
+{
+    void* storage = NULL;
+    size_t bytes = (length > 0 ? length : 1) * sizeof(double);
+    if (posix_memalign(&storage, VECTOR_ALIGNMENT, bytes) != 0) {
+        return NULL;
+    }
+    return (double*)storage;
+}
+
+/* Evaluates a VectorProgram over length elements a block at a time
+ *
+ * const VectorProgram* program: program to run
+ * double** arrays: element storage of each array variable
+ * int length: number of elements to evaluate
+ * double* result: storage for length results
+ * int precision: UQ_PRECISION_DOUBLE or UQ_PRECISION_FLOAT
+ *
+ * Returns 0
+ */
+static int vector_evaluate(const VectorProgram* program, double** arrays,
+        int length, double* result, int precision)
+{
+    if (precision == UQ_PRECISION_FLOAT) {
+        float* stack
+                = (float*)vector_allocate(program->depth * VECTOR_BLOCK / 2);
+        double* wide = vector_allocate(VECTOR_MAX_ARITY * VECTOR_BLOCK);
+        for (int start = 0; start < length; start += VECTOR_BLOCK) {
+            int count = (length - start < VECTOR_BLOCK) ? length - start
+                                                        : VECTOR_BLOCK;
+            vector_run_float(program, arrays, start, count, stack, wide);
+            for (int j = 0; j < count; j++) {
+                result[start + j] = (double)stack[j];
+            }
+        }
+        free((void*)wide);
+        free((void*)stack);
+        return 0;
+    }
+    double* stack = vector_allocate(program->depth * VECTOR_BLOCK);
+    for (int start = 0; start < length; start += VECTOR_BLOCK) {
+        int count = (length - start < VECTOR_BLOCK) ? length - start
+                                                    : VECTOR_BLOCK;
+        vector_run(program, arrays, start, count, stack);
+        memcpy(result + start, stack, count * sizeof(double));
+    }
+    free((void*)stack);
+    return 0;
+}
+
+/* Builds the cache key for an expression compiled against a set of bindings
+ *
+ * const char* expression: expression being compiled
+ * const te_variable* tevars: bindings the expression is compiled against
+ * int count: number of bindings
+ * size_t* keyLength: pointer to where the length of the key will be stored
+ *
+ * Returns the newly allocated key
+ */
+static char* cache_key(const char* expression, const te_variable* tevars,
+        int count, size_t* keyLength)
+{
+    *keyLength = strlen(expression) + 1;
+    for (int i = 0; i < count; i++) {
+        *keyLength += strlen(tevars[i].name) + 1;
+    }
+    char* key = (char*)malloc(*keyLength);
+    size_t position = 0;
+    strcpy(key, expression);
+    position += strlen(expression) + 1;
+    for (int i = 0; i < count; i++) {
+        strcpy(key + position, tevars[i].name);
+        position += strlen(tevars[i].name) + 1;
+    }
+    return key;
+}
+
+/* Returns the number of children of a node of a compiled tinyexpr expression
+ *
+ * const te_expr* n: node to count the children of
+ */
+static int expression_arity(const te_expr* n)
+{
+    int type = n->type & TE_TYPE_MASK;
+    return (type & (TE_FUNCTION0 | TE_CLOSURE0)) ? (type & TE_ARITY_MASK) : 0;
+}
+
+/* Returns the number of bytes tinyexpr allocates for a node: the type and
+ * value followed by one pointer per child and, for a closure, its context
+ *
+ * const te_expr* n: node to measure
+ */
+static size_t expression_node_bytes(const te_expr* n)
+{
+    int closure = (n->type & TE_CLOSURE0) ? 1 : 0;
+    return offsetof(te_expr, parameters)
+            + (expression_arity(n) + closure) * sizeof(void*);
+}
+
+/* Applies the function of a node to the values of its children, as
+ * te_eval() does
+ *
+ * int type: tinyexpr type of the node
+ * const void* function: function of the node
+ * void* context: context of a closure
+ * const double* arguments: values of the children in order
+ *
+ * Returns the value of the node, NaN for arities te_eval() does not call
+ */
+static double expression_apply(
+        int type, const void* function, void* context, const double* arguments)
+{
+    int arity = type & TE_ARITY_MASK;
+    if (type & TE_CLOSURE0) {
+        double (*closure0)(void*);
+        double (*closure1)(void*, double);
+        double (*closure2)(void*, double, double);
+        switch (arity) {
+        case 0:
+            memcpy(&closure0, &function, sizeof(closure0));
+            return closure0(context);
+        case 1:
+            memcpy(&closure1, &function, sizeof(closure1));
+            return closure1(context, arguments[0]);
+        case 2:
+            memcpy(&closure2, &function, sizeof(closure2));
+            return closure2(context, arguments[0], arguments[1]);
+        default:
+            return NAN;
+        }
+    }
+    double (*function0)(void);
+    double (*function1)(double);
+    double (*function2)(double, double);
+    double (*function3)(double, double, double);
+    switch (arity) {
+    case 0:
+        memcpy(&function0, &function, sizeof(function0));
+        return function0();
+    case 1:
+        memcpy(&function1, &function, sizeof(function1));
+        return function1(arguments[0]);
+    case 2:
+        memcpy(&function2, &function, sizeof(function2));
+        return function2(arguments[0], arguments[1]);
+    case 3:
+        memcpy(&function3, &function, sizeof(function3));
+        return function3(arguments[0], arguments[1], arguments[2]);
+    default:
+        return NAN;
+    }
+}
+
+/* Visits the nodes of a compiled expression children first, keeping its own
+ * stack so that no depth of nesting can overflow the call stack
+ *
+ * const te_expr* root: root of the expression
+ * int (*visit)(const te_expr*, void*): called for each node once all its
+ * children have been visited; a nonzero return ends the walk
+ * void* data: pointer passed to visit
+ *
+ * Returns 0 or the nonzero value visit returned
+ */
+static int expression_walk(const te_expr* root,
+        int (*visit)(const te_expr*, void*), void* data)
+{
+    int capacity = EXPRESSION_WALK_FRAMES;
+    ExpressionFrame* frames
+            = (ExpressionFrame*)malloc(capacity * sizeof(ExpressionFrame));
+    int top = 0;
+    frames[0].node = root;
+    frames[0].next = 0;
+    int result = 0;
+    while (top >= 0 && result == 0) {
+        const te_expr* node = frames[top].node;
+        if (frames[top].next < expression_arity(node)) {
+            const te_expr* child = node->parameters[frames[top].next];
+            frames[top].next++;
+            if (top + 1 == capacity) {
+                capacity *= 2;
+                frames = (ExpressionFrame*)realloc(
+                        (void*)frames, capacity * sizeof(ExpressionFrame));
+            }
+            top++;
+            frames[top].node = child;
+            frames[top].next = 0;
+        } else {
+            result = visit(node, data);
+            top--;
+        }
+    }
+    free((void*)frames);
+    return result;
+}
+
+/* Values computed so far while evaluating an expression without recursion
+ *
+ * double* values: stack of the values of visited subtrees
+ * int size: number of values on the stack
+ * int capacity: number of values allocated
+ */
+typedef struct {
+    double* values;
+    int size;
+    int capacity;
+} EvaluationStack;
+
+/* Evaluates one node for expression_eval_deep(), replacing the values of its
+ * children on the stack with its own
+ *
+ * const te_expr* n: node whose children have been evaluated
+ * void* data: the EvaluationStack
+ *
+ * Returns 0
+ */
+static int expression_eval_node(const te_expr* n, void* data)
+{
+    EvaluationStack* stack = (EvaluationStack*)data;
+    int type = n->type & TE_TYPE_MASK;
+    int arity = expression_arity(n);
+    double value;
+    if (type == TE_CONSTANT_TYPE) {
+        value = n->value;
+    } else if (type == TE_VARIABLE) {
+        value = *n->bound;
+    } else {
+        stack->size -= arity;
+        void* closure = (type & TE_CLOSURE0) ? n->parameters[arity] : NULL;
+        value = expression_apply(
+                type, n->function, closure, stack->values + stack->size);
+    }
+    if (stack->size == stack->capacity) {
+        stack->capacity *= 2;
+        stack->values = (double*)realloc(
+                (void*)stack->values, stack->capacity * sizeof(double));
+    }
+    stack->values[stack->size] = value;
+    stack->size++;
+    return 0;
+}
+
+/* Evaluates an expression too deep for te_eval(), which recurses once per
+ * level
+ *
+ * const te_expr* expr: expression marked EXPRESSION_DEEP
+ *
+ * Returns the value of the expression
+ */
+static double expression_eval_deep(const te_expr* expr)
+{
+    EvaluationStack stack;
+    stack.capacity = EXPRESSION_WALK_FRAMES;
+    stack.size = 0;
+    stack.values = (double*)malloc(stack.capacity * sizeof(double));
+    expression_walk(expr, expression_eval_node, &stack);
+    double value = stack.values[0];
+    free((void*)stack.values);
+    return value;
+}
+
+/* Evaluates a compiled expression, with te_eval() unless it is nested too
+ * deeply for te_eval()'s recursion
+ *
+ * const te_expr* expr: expression returned by expression_parse()
+ *
+ * Returns the value of the expression
+ */
+static double expression_eval(const te_expr* expr)
+{
+    if (expr->type & EXPRESSION_DEEP) {
+        return expression_eval_deep(expr);
+    }
+    return te_eval(expr);
+}
+
+/* Recovers the functions tinyexpr builds expressions from the first time a
+ * context parses an expression
+ *
+ * UqContext* context: context the grammar is kept in
+ *
+ * Returns the grammar
+ */
+static const ParseGrammar* parse_grammar(UqContext* context)
+{
+    ParseGrammar* grammar = &(context->grammar);
+    if (context->grammarReady) {
+        return grammar;
+    }
+    double x = 0, y = 0;
+    te_variable tevars[] = {
+            {.name = "x", .address = &x, .type = TE_VARIABLE, .context = NULL},
+            {.name = "y", .address = &y, .type = TE_VARIABLE, .context = NULL}};
+    int errPos;
+    for (int i = 0; i < PARSE_OPERATORS; i++) {
+        te_expr* expr = te_compile(parseProbes[i], tevars, 2, &errPos);
+        grammar->operators[i] = expr->function;
+        te_free(expr);
+    }
+    for (int i = 0; i < SCRIPT_BUILTINS; i++) {
+        const char* name = scriptBuiltins[i];
+        char probe[PRINT_BUFFER_SIZE];
+        snprintf(probe, sizeof(probe), "%s(x)", name);
+        te_expr* expr = te_compile(probe, tevars, 2, &errPos);
+        if (expr == NULL) {
+            snprintf(probe, sizeof(probe), "%s(x,y)", name);
+            expr = te_compile(probe, tevars, 2, &errPos);
+        }
+        if (expr == NULL) {
+            expr = te_compile(name, tevars, 2, &errPos);
+        }
+        grammar->builtins[i].name = name;
+        grammar->builtins[i].type = expr->type;
+        grammar->builtins[i].function = NULL;
+        grammar->builtins[i].value = 0;
+        if ((expr->type & TE_TYPE_MASK) == TE_CONSTANT_TYPE) {
+            grammar->builtins[i].value = expr->value;
+        } else {
+            grammar->builtins[i].function = expr->function;
+        }
+        te_free(expr);
+    }
+    context->grammarReady = 1;
+    return grammar;
+}
+
+/* Looks up a name among the bindings of a parse, as tinyexpr does taking the
+ * first binding of the name if there are several
+ *
+ * const ExpressionParser* parser: the parse
+ * const char* name: start of the name
+ * int length: number of characters in the name
+ *
+ * Returns the binding or NULL if the name is not bound
+ */
+static const te_variable* parse_lookup(
+        const ExpressionParser* parser, const char* name, int length)
+{
+    if (parser->table == NULL) {
+        for (int i = 0; i < parser->tableSize; i++) {
+            const te_variable* variable = &(parser->variables[i]);
+            if (!strncmp(name, variable->name, length)
+                    && variable->name[length] == '\0') {
+                return variable;
+            }
+        }
+        return NULL;
+    }
+    int mask = parser->tableSize - 1;
+    int slot = hash_bytes(name, length, FNV_OFFSET) & mask;
+    while (parser->table[slot] != -1) {
+        const te_variable* variable = &(parser->variables[parser->table[slot]]);
+        if (!strncmp(name, variable->name, length)
+                && variable->name[length] == '\0') {
+            return variable;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return NULL;
+}
+
+/* Reads the next token of an expression, splitting it up the same way
+ * tinyexpr does
+ *
+ * ExpressionParser* parser: the parse, whose token fields are set
+ */
+static void parse_token(ExpressionParser* parser)
+{
+    const char* next = parser->next;
+    while (*next == ' ' || *next == '\t' || *next == '\n' || *next == '\r') {
+        next++;
+    }
+    parser->token = PARSE_TOKEN_ERROR;
+    if (*next == '\0') {
+        parser->token = PARSE_TOKEN_END;
+    } else if ((*next >= '0' && *next <= '9') || *next == '.') {
+        char* end;
+        parser->value = strtod(next, &end);
+        parser->token = (end != next) ? PARSE_TOKEN_NUMBER : PARSE_TOKEN_ERROR;
+        next = end;
+    } else if (*next >= 'a' && *next <= 'z') {
+        const char* start = next;
+        while ((*next >= 'a' && *next <= 'z') || (*next >= '0' && *next <= '9')
+                || *next == '_') {
+            next++;
+        }
+        int length = next - start;
+        const te_variable* variable = parse_lookup(parser, start, length);
+        if (variable != NULL) {
+            parser->type = variable->type;
+            parser->pointer = variable->address;
+            parser->context = variable->context;
+            parser->token = ((variable->type & TE_TYPE_MASK) == TE_VARIABLE)
+                    ? PARSE_TOKEN_VARIABLE
+                    : PARSE_TOKEN_FUNCTION;
+        }
+        for (int i = 0; variable == NULL && i < SCRIPT_BUILTINS; i++) {
+            const ParseBuiltin* builtin = &(parser->grammar->builtins[i]);
+            if (!strncmp(start, builtin->name, length)
+                    && builtin->name[length] == '\0') {
+                parser->type = builtin->type;
+                parser->pointer = builtin->function;
+                parser->value = builtin->value;
+                parser->context = NULL;
+                parser->token = PARSE_TOKEN_FUNCTION;
+                break;
+            }
+        }
+    } else {
+        const char* symbols = PARSE_SYMBOLS;
+        const char* symbol = strchr(symbols, *next);
+        if (symbol != NULL) {
+            parser->operator = symbol - symbols;
+            parser->token = PARSE_TOKEN_INFIX;
+        } else if (*next == '(') {
+            parser->token = PARSE_TOKEN_OPEN;
+        } else if (*next == ')') {
+            parser->token = PARSE_TOKEN_CLOSE;
+        } else if (*next == ',') {
+            parser->token = PARSE_TOKEN_SEPARATOR;
+        }
+        next++;
+    }
+    parser->next = next;
+}
+
+/* Makes a node from the operands on top of the operand stack and pushes it in
+ * their place. A pure node whose children are all constants is folded into a
+ * constant, as te_compile() does
+ *
+ * ExpressionParser* parser: the parse
+ * int type: tinyexpr type of the node
+ * const void* pointer: address a variable is bound to or function called
+ * void* context: context of a closure
+ * double value: value of a constant
+ *
+ * Returns 0
+ */
+static int parse_node(ExpressionParser* parser, int type, const void* pointer,
+        void* context, double value)
+{
+    int kind = type & TE_TYPE_MASK;
+    int arity = (kind & (TE_FUNCTION0 | TE_CLOSURE0)) ? (kind & TE_ARITY_MASK)
+                                                      : 0;
+    int closure = (kind & TE_CLOSURE0) ? 1 : 0;
+    ParseNode* node = &(parser->nodes[parser->numberNodes]);
+    node->type = type;
+    node->value = value;
+    node->pointer = pointer;
+    node->context = context;
+    node->child = parser->numberChildren;
+    node->depth = 1;
+    node->bytes = offsetof(te_expr, parameters)
+            + (arity + closure) * sizeof(void*);
+    parser->numberOperands -= arity;
+    int known = (type & TE_FLAG_PURE) != 0;
+    double arguments[TE_ARITY_MASK + 1];
+    for (int i = 0; i < arity; i++) {
+        int operand = parser->operands[parser->numberOperands + i];
+        const ParseNode* child = &(parser->nodes[operand]);
+        parser->children[parser->numberChildren + i] = operand;
+        node->bytes += child->bytes;
+        if (child->depth + 1 > node->depth) {
+            node->depth = child->depth + 1;
+        }
+        arguments[i] = child->value;
+        known = known && child->type == TE_CONSTANT_TYPE;
+    }
+    parser->numberChildren += arity;
+    if (known) {
+        node->value = expression_apply(type, pointer, context, arguments);
+        node->type = TE_CONSTANT_TYPE;
+        node->pointer = NULL;
+        node->context = NULL;
+        node->depth = 1;
+        node->bytes = offsetof(te_expr, parameters);
+    }
+    parser->operands[parser->numberOperands] = parser->numberNodes;
+    parser->numberOperands++;
+    parser->numberNodes++;
+    return 0;
+}
+
+/* Applies the prefix operators waiting on top of the operator stack to the
+ * operand just finished; signs and functions of one argument bind more
+ * tightly than any infix operator, as in tinyexpr
+ *
+ * ExpressionParser* parser: the parse
+ */
+static void parse_prefixes(ExpressionParser* parser)
+{
+    while (parser->numberOperators > 0
+            && parser->operators[parser->numberOperators - 1].kind
+                    == PARSE_PREFIX) {
+        parser->numberOperators--;
+        const ParseOperator* op = &(parser->operators[parser->numberOperators]);
+        parse_node(parser, op->type, op->function, op->context, 0);
+    }
+}
+
+/* Applies the infix operators on top of the operator stack that bind at
+ * least as tightly as a given precedence, all of which are left associative
+ *
+ * ExpressionParser* parser: the parse
+ * int precedence: precedence of the operator about to be pushed, or 0 to
+ * apply every infix operator down to the innermost bracket
+ */
+static void parse_reduce(ExpressionParser* parser, int precedence)
+{
+    while (parser->numberOperators > 0
+            && parser->operators[parser->numberOperators - 1].kind
+                    == PARSE_BINARY
+            && parser->operators[parser->numberOperators - 1].precedence
+                    >= precedence) {
+        parser->numberOperators--;
+        const ParseOperator* op = &(parser->operators[parser->numberOperators]);
+        parse_node(parser, op->type, op->function, NULL, 0);
+    }
+}
+
+/* Pushes an operator onto the operator stack
+ *
+ * ExpressionParser* parser: the parse
+ * int kind: PARSE_BINARY, PARSE_PREFIX, PARSE_GROUP or PARSE_CALL
+ * int precedence: binding strength of a PARSE_BINARY operator
+ * int type: tinyexpr type of the node the operator makes
+ * const void* function: function of the node
+ * void* context: context of a closure
+ */
+static void parse_push(ExpressionParser* parser, int kind, int precedence,
+        int type, const void* function, void* context)
+{
+    ParseOperator* op = &(parser->operators[parser->numberOperators]);
+    op->kind = kind;
+    op->precedence = precedence;
+    op->type = type;
+    op->function = function;
+    op->context = context;
+    op->arguments = 1;
+    parser->numberOperators++;
+}
+
+/* Reads one token where an operand is expected
+ *
+ * ExpressionParser* parser: the parse
+ * int* sign: pointer to the sign of the run of + and - read so far
+ *
+ * Returns 1 if an operand was finished, 0 if one is still expected or -1 if
+ * the expression is invalid
+ */
+static int parse_operand(ExpressionParser* parser, int* sign)
+{
+    const ParseGrammar* grammar = parser->grammar;
+    int pure = TE_FUNCTION1 | TE_FLAG_PURE;
+    if (parser->token == PARSE_TOKEN_INFIX
+            && (parser->operator == PARSE_ADD
+                    || parser->operator == PARSE_SUBTRACT)) {
+        *sign = (parser->operator == PARSE_SUBTRACT) ? -*sign : *sign;
+        return 0;
+    }
+    if (*sign < 0) {
+        parse_push(parser, PARSE_PREFIX, 0, pure,
+                grammar->operators[PARSE_NEGATE], NULL);
+    }
+    *sign = 1;
+    int kind = parser->type & TE_TYPE_MASK;
+    int arity = (kind & (TE_FUNCTION0 | TE_CLOSURE0)) ? (kind & TE_ARITY_MASK)
+                                                      : 0;
+    const char* after;
+    switch (parser->token) {
+    case PARSE_TOKEN_NUMBER:
+        parse_node(parser, TE_CONSTANT_TYPE, NULL, NULL, parser->value);
+        break;
+    case PARSE_TOKEN_VARIABLE:
+        parse_node(parser, TE_VARIABLE, parser->pointer, NULL, 0);
+        break;
+    case PARSE_TOKEN_FUNCTION:
+        if (arity == 1) {
+            parse_push(parser, PARSE_PREFIX, 0, parser->type, parser->pointer,
+                    parser->context);
+            return 0;
+        }
+        if (arity > 1) {
+            int type = parser->type;
+            const void* function = parser->pointer;
+            void* context = parser->context;
+            parse_token(parser);
+            if (parser->token != PARSE_TOKEN_OPEN) {
+                return -1;
+            }
+            parse_push(parser, PARSE_CALL, 0, type, function, context);
+            return 0;
+        }
+        parse_node(parser, parser->type, parser->pointer, parser->context,
+                parser->value);
+        after = parser->next;
+        parse_token(parser);
+        if (parser->token == PARSE_TOKEN_OPEN) {
+            parse_token(parser);
+            if (parser->token != PARSE_TOKEN_CLOSE) {
+                return -1;
+            }
+        } else {
+            parser->next = after;
+        }
+        break;
+    case PARSE_TOKEN_OPEN:
+        parse_push(parser, PARSE_GROUP, 0, 0, NULL, NULL);
+        return 0;
+    default:
+        return -1;
+    }
+    parse_prefixes(parser);
+    return 1;
+}
+
+/* Reads one token where an infix operator, separator, closing bracket or the
+ * end is expected
+ *
+ * ExpressionParser* parser: the parse
+ *
+ * Returns 0 if an operand is expected next, 1 if an operator is still
+ * expected, 2 at the end of the expression or -1 if the expression is invalid
+ */
+static int parse_operator(ExpressionParser* parser)
+{
+    const ParseGrammar* grammar = parser->grammar;
+    int binary = TE_FUNCTION2 | TE_FLAG_PURE;
+    ParseOperator* frame = NULL;
+    switch (parser->token) {
+    case PARSE_TOKEN_INFIX:
+        parse_reduce(parser, parsePrecedence[parser->operator]);
+        parse_push(parser, PARSE_BINARY, parsePrecedence[parser->operator],
+                binary, grammar->operators[parser->operator], NULL);
+        return 0;
+    case PARSE_TOKEN_SEPARATOR:
+        parse_reduce(parser, 0);
+        frame = (parser->numberOperators > 0)
+                ? &(parser->operators[parser->numberOperators - 1])
+                : NULL;
+        if (frame != NULL && frame->kind == PARSE_CALL) {
+            frame->arguments++;
+            return (frame->arguments > (frame->type & TE_ARITY_MASK)) ? -1 : 0;
+        }
+        parse_push(parser, PARSE_BINARY, 0, binary,
+                grammar->operators[PARSE_COMMA], NULL);
+        return 0;
+    case PARSE_TOKEN_CLOSE:
+        parse_reduce(parser, 0);
+        if (parser->numberOperators == 0) {
+            return -1;
+        }
+        parser->numberOperators--;
+        frame = &(parser->operators[parser->numberOperators]);
+        if (frame->kind == PARSE_CALL) {
+            if (frame->arguments != (frame->type & TE_ARITY_MASK)) {
+                return -1;
+            }
+            parse_node(parser, frame->type, frame->function, frame->context, 0);
+        }
+        parse_prefixes(parser);
+        return 1;
+    case PARSE_TOKEN_END:
+        parse_reduce(parser, 0);
+        return (parser->numberOperators == 0) ? 2 : -1;
+    default:
+        return -1;
+    }
+}
+
+/* Lays a parsed expression out in one block with every node before its
+ * children, as expression blocks and the arena hold them
+ *
+ * const ExpressionParser* parser: the finished parse
+ * int root: index of the root node
+ *
+ * Returns the block, freed with free()
+ */
+static te_expr* parse_layout(const ExpressionParser* parser, int root)
+{
+    const ParseNode* nodes = parser->nodes;
+    char* block = (char*)malloc(nodes[root].bytes);
+    int* pending = (int*)malloc((parser->numberNodes + 1) * sizeof(int));
+    void*** slots = (void***)malloc((parser->numberNodes + 1) * sizeof(void**));
+    void* top = NULL;
+    int size = 1;
+    pending[0] = root;
+    slots[0] = &top;
+    char* next = block;
+    while (size > 0) {
+        size--;
+        const ParseNode* node = &(nodes[pending[size]]);
+        void** slot = slots[size];
+        te_expr* copy = (te_expr*)next;
+        int kind = node->type & TE_TYPE_MASK;
+        int arity = (kind & (TE_FUNCTION0 | TE_CLOSURE0))
+                ? (kind & TE_ARITY_MASK)
+                : 0;
+        copy->type = node->type;
+        if (kind == TE_CONSTANT_TYPE) {
+            copy->value = node->value;
+        } else if (kind == TE_VARIABLE) {
+            copy->bound = (const double*)node->pointer;
+        } else {
+            copy->function = node->pointer;
+        }
+        if (kind & TE_CLOSURE0) {
+            copy->parameters[arity] = node->context;
+        }
+        next += offsetof(te_expr, parameters)
+                + (arity + ((kind & TE_CLOSURE0) ? 1 : 0)) * sizeof(void*);
+        *slot = copy;
+        for (int i = arity - 1; i >= 0; i--) {
+            pending[size] = parser->children[node->child + i];
+            slots[size] = &(copy->parameters[i]);
+            size++;
+        }
+    }
+    free((void*)slots);
+    free((void*)pending);
+    return (te_expr*)top;
+}
+
+/* Compiles an expression into the same tree te_compile() builds, but without
+ * recursion: operators wait on an explicit stack (the shunting-yard method),
+ * so there is no limit on nesting and time is linear in the length of the
+ * expression. Names are looked up in the bindings first and then among
+ * tinyexpr's builtins, the tree calls tinyexpr's own functions and constant
+ * subtrees are folded, so evaluating it gives the same value te_compile()'s
+ * tree would. The tree is laid out in one block, and its root is marked
+ * EXPRESSION_DEEP if it is nested too deeply for te_eval()
+ *
+ * UqContext* context: context whose grammar is used
+ * const char* expression: expression to compile
+ * const te_variable* variables: bindings to compile against
+ * int count: number of bindings
+ * size_t* bytes: pointer to where the size of the block is stored
+ *
+ * Returns the compiled expression, freed with free(), or NULL if it is invalid
+ */
+static te_expr* expression_parse(UqContext* context, const char* expression,
+        const te_variable* variables, int count, size_t* bytes)
+{
+    ExpressionParser parser;
+    int capacity = strlen(expression) + 2;
+    parser.next = expression;
+    parser.variables = variables;
+    parser.table = NULL;
+    parser.tableSize = count;
+    parser.grammar = parse_grammar(context);
+    if (count > PARSE_INDEX_MIN) {
+        parser.tableSize = PARSE_INDEX_MIN;
+        while (parser.tableSize < 2 * count) {
+            parser.tableSize *= 2;
+        }
+        parser.table = (int*)malloc(parser.tableSize * sizeof(int));
+        memset(parser.table, -1, parser.tableSize * sizeof(int));
+        for (int i = 0; i < count; i++) {
+            const char* name = variables[i].name;
+            if (parse_lookup(&parser, name, strlen(name)) == NULL) {
+                int mask = parser.tableSize - 1;
+                int slot = hash_bytes(name, strlen(name), FNV_OFFSET) & mask;
+                while (parser.table[slot] != -1) {
+                    slot = (slot + 1) & mask;
+                }
+                parser.table[slot] = i;
+            }
+        }
+    }
+    parser.nodes = (ParseNode*)malloc(capacity * sizeof(ParseNode));
+    parser.numberNodes = 0;
+    parser.children = (int*)malloc(capacity * sizeof(int));
+    parser.numberChildren = 0;
+    parser.operands = (int*)malloc(capacity * sizeof(int));
+    parser.numberOperands = 0;
+    parser.operators
+            = (ParseOperator*)malloc(capacity * sizeof(ParseOperator));
+    parser.numberOperators = 0;
+    int sign = 1;
+    int state = 0;
+    while (state == 0 || state == 1) {
+        parse_token(&parser);
+        state = (state == 0) ? parse_operand(&parser, &sign)
+                             : parse_operator(&parser);
+    }
+    te_expr* expr = NULL;
+    if (state == 2 && parser.numberOperands == 1) {
+        int root = parser.operands[0];
+        *bytes = parser.nodes[root].bytes;
+        expr = parse_layout(&parser, root);
+        if (parser.nodes[root].depth > EXPRESSION_MAX_RECURSION) {
+            expr->type |= EXPRESSION_DEEP;
+        }
+    }
+    free((void*)parser.operators);
+    free((void*)parser.operands);
+    free((void*)parser.children);
+    free((void*)parser.nodes);
+    free((void*)parser.table);
+    return expr;
+}
+
+/* Moves a parsed expression into the arena of a context. An empty arena grows
+ * to fit the expression unless the context is over its memory limit; an
+ * expression that does not fit behind the ones already in the arena keeps the
+ * block it was parsed into
+ *
+ * UqContext* context: context whose arena is used
+ * te_expr* block: expression returned by expression_parse()
+ * size_t bytes: size of block
+ *
+ * Returns the moved expression, released with arena_release(), or NULL if
+ * block is NULL
+ */
+static te_expr* arena_store(UqContext* context, te_expr* block, size_t bytes)
+{
+    if (block == NULL) {
+        return NULL;
+    }
+    if (context->arenaUsed == 0 && bytes > context->arenaSize
+            && !memory_over(context)) {
+        size_t size = (context->arenaSize == 0) ? ARENA_MIN_BYTES
+                                                : context->arenaSize;
+        while (size < bytes) {
+            size *= 2;
+        }
+        free((void*)context->arena);
+        context->arena = (char*)malloc(size);
+        memory_add(context, UQ_MEMORY_EXPRESSIONS,
+                (long long)size - (long long)context->arenaSize);
+        context->arenaSize = size;
+    }
+    if (context->arenaUsed + bytes > context->arenaSize) {
+        memory_add(context, UQ_MEMORY_EXPRESSIONS, bytes);
+        memory_add(context, UQ_MEMORY_EXPRESSIONS, -(long long)bytes);
+        return block;
+    }
+    char* from = (char*)block;
+    char* to = context->arena + context->arenaUsed;
+    memcpy((void*)to, (const void*)block, bytes);
+    for (size_t offset = 0; offset < bytes;) {
+        te_expr* node = (te_expr*)(to + offset);
+        for (int i = 0; i < expression_arity(node); i++) {
+            node->parameters[i] = to + ((char*)node->parameters[i] - from);
+        }
+        offset += expression_node_bytes(node);
+    }
+    context->arenaUsed += bytes;
+    free((void*)block);
+    return (te_expr*)to;
+}
+
+/* Releases an expression returned by arena_store(), together with any stored
+ * after it
+ *
+ * UqContext* context: context whose arena holds the expression
+ * te_expr* expr: expression to release, may be NULL
+ */
+static void arena_release(UqContext* context, te_expr* expr)
+{
+    char* start = (char*)expr;
+    if (context->arena != NULL && start >= context->arena
+            && start < context->arena + context->arenaSize) {
+        context->arenaUsed = start - context->arena;
+    } else {
+        free((void*)expr);
+    }
+}
+
+/* Frees every entry of the cache a context uses, taking the bytes they held
+ * off the context's expression memory
+ *
+ * UqContext* context: context whose cache is emptied
+ */
+static void cache_evict(UqContext* context)
+{
+    for (int i = 0; i < CACHE_SIZE; i++) {
+        CacheEntry* entry = &(context->cache->entries[i]);
+        if (entry->key != NULL) {
+            free((void*)entry->key);
+            free((void*)entry->values);
+            free((void*)entry->expr);
+            memory_add(context, UQ_MEMORY_EXPRESSIONS, -entry->bytes);
+            memset(entry, 0, sizeof(CacheEntry));
+        }
+    }
+}
+
+/* Compiles an expression without the cache into the arena of the context
+ *
+ * UqContext* context: context the expression is compiled for
+ * const char* expression: expression to compile
+ * te_variable* tevars: bindings to compile against
+ * int count: number of bindings
+ * long long start: time returned by work_clock() when compiling began
+ *
+ * Returns the compiled expression, released with arena_release(), or NULL if
+ * it is invalid
+ */
+static te_expr* compile_uncached(UqContext* context, const char* expression,
+        te_variable* tevars, int count, long long start)
+{
+    size_t bytes;
+    te_expr* block
+            = expression_parse(context, expression, tevars, count, &bytes);
+    te_expr* expr = arena_store(context, block, bytes);
+    STATS_ADD(context, compiles, 1);
+    STATS_ADD(context, compileNanoseconds, work_clock(context) - start);
+    trace_span(context, "compile", start);
+    return expr;
+}
+
+/* Compiles an expression, reusing a compiled tree from the context's cache
+ * when the same expression has been compiled against the same names before.
+ * The current value of every binding is copied into the cached tree, so the
+ * bindings must not include array slots, which trees are matched against by
+ * address. A context over its memory limit empties the cache before adding to
+ * it, and compiles without it if that is not enough
+ *
+ * UqContext* context: context whose cache is used
+ * const char* expression: expression to compile
+ * te_variable* tevars: bindings to compile against, all TE_VARIABLE
+ * int count: number of bindings
+ * int* cached: pointer to where 1 is stored if the tree belongs to the cache
+ * and must not be freed, otherwise 0
+ *
+ * Returns the compiled expression or NULL if it is invalid
+ */
+static te_expr* compile_cached(UqContext* context, const char* expression,
+        te_variable* tevars, int count, int* cached)
+{
+    *cached = 0;
+    long long start = work_clock(context);
+    if (context->cache == NULL) {
+        return compile_uncached(context, expression, tevars, count, start);
+    }
+    size_t keyLength;
+    char* key = cache_key(expression, tevars, count, &keyLength);
+    unsigned long long hash = hash_bytes(key, keyLength, FNV_OFFSET);
+    CacheEntry* entry = &(context->cache->entries[hash % CACHE_SIZE]);
+    if (entry->key != NULL && entry->keyLength == keyLength
+            && !memcmp(entry->key, key, keyLength)) {
+        free((void*)key);
+        for (int i = 0; i < count; i++) {
+            entry->values[i] = *(const double*)tevars[i].address;
+        }
+        context->cache->hits++;
+        *cached = 1;
+        return entry->expr;
+    }
+    context->cache->misses++;
+    if (memory_over(context)) {
+        cache_evict(context);
+        if (memory_over(context)) {
+            free((void*)key);
+            return compile_uncached(context, expression, tevars, count, start);
+        }
+    }
+    double* values = (double*)malloc((count + 1) * sizeof(double));
+    te_variable bound[count + 1];
+    for (int i = 0; i < count; i++) {
+        values[i] = *(const double*)tevars[i].address;
+        bound[i] = tevars[i];
+        bound[i].address = &(values[i]);
+    }
+    size_t bytes;
+    te_expr* expr = expression_parse(context, expression, bound, count, &bytes);
+    STATS_ADD(context, compiles, 1);
+    STATS_ADD(context, compileNanoseconds, work_clock(context) - start);
+    trace_span(context, "compile", start);
+    if (expr == NULL) {
+        free((void*)values);
+        free((void*)key);
+        return NULL;
+    }
+    free((void*)entry->key);
+    free((void*)entry->values);
+    free((void*)entry->expr);
+    memory_add(context, UQ_MEMORY_EXPRESSIONS, -entry->bytes);
+    entry->key = key;
+    entry->keyLength = keyLength;
+    entry->expr = expr;
+    entry->values = values;
+    entry->numberValues = count;
+    entry->bytes = keyLength + (count + 1) * sizeof(double) + bytes;
+    memory_add(context, UQ_MEMORY_EXPRESSIONS, entry->bytes);
+    *cached = 1;
+    return expr;
+}
+
+/* Compiles an expression against the bindings of the names it refers to,
+ * bypassing the cache if any of them is an array variable
+ *
+ * UqContext* context: context whose cache is used
+ * const char* expression: expression to compile
+ * Bindings* bindings: bindings made by bind_referenced()
+ * int* cached: pointer to where 1 is stored if the tree belongs to the cache
+ * and must not be freed, otherwise 0
+ *
+ * Returns the compiled expression or NULL if it is invalid
+ */
+static te_expr* compile_bound(UqContext* context, const char* expression,
+        Bindings* bindings, int* cached)
+{
+    if (bindings->numberSlots > 0) {
+        *cached = 0;
+        return compile_uncached(context, expression, bindings->tevars,
+                bindings->count, work_clock(context));
+    }
+    return compile_cached(
+            context, expression, bindings->tevars, bindings->count, cached);
+}
+
+/* Releases an expression returned by compile_cached() unless the cache owns
+ * it
+ *
+ * UqContext* context: context the expression was compiled for
+ * te_expr* expr: expression to release, may be NULL
+ * int cached: value stored by compile_cached()
+ */
+static void compile_release(UqContext* context, te_expr* expr, int cached)
+{
+    if (!cached) {
+        arena_release(context, expr);
+    }
+}
+
+/* Works out the precision vector programs of a context are evaluated in.
+ * Single precision is only used while the significant figures printed are
+ * ones a float can honour
+ *
+ * const UqContext* context: context whose settings are used
+ *
+ * Returns UQ_PRECISION_DOUBLE or UQ_PRECISION_FLOAT
+ */
+static int vector_precision(const UqContext* context)
+{
+    if (context->precision == UQ_PRECISION_FLOAT
+            && context->sigFigs <= UQ_FLOAT_SIG_FIGS) {
+        return UQ_PRECISION_FLOAT;
+    }
+    return UQ_PRECISION_DOUBLE;
+}
+
+/* Prepares a compiled scalar expression for the engine a context uses
+ *
+ * UqContext* context: context whose engine and math are used
+ * const te_expr* expr: compiled expression
+ * VectorProgram* program: program to fill in for the vector engine
+ *
+ * Returns program, freed with vector_free(), or NULL if the expression is
+ * evaluated as a tree, either by the tree engine or because it cannot be
+ * evaluated as a vector
+ */
+static VectorProgram* engine_prepare(
+        UqContext* context, const te_expr* expr, VectorProgram* program)
+{
+    if (context->engine != UQ_ENGINE_VECTOR
+            || vector_compile(expr, program, NULL, NULL, 0, context->math)) {
+        return NULL;
+    }
+    return program;
+}
+
+/* Evaluates a compiled scalar expression once with the engine it was
+ * prepared for
+ *
+ * UqContext* context: context whose precision is used
+ * const te_expr* expr: compiled expression
+ * const VectorProgram* program: program returned by engine_prepare()
+ *
+ * Returns the value of the expression
+ */
+static double engine_evaluate(
+        UqContext* context, const te_expr* expr, const VectorProgram* program)
+{
+    if (program == NULL) {
+        return expression_eval(expr);
+    }
+    double value;
+    vector_evaluate(program, NULL, 1, &value, vector_precision(context));
+    return value;
+}
+
+/* Evaluates a compiled scalar expression once with the engine a context uses
+ *
+ * UqContext* context: context whose engine and settings are used
+ * const te_expr* expr: compiled expression
+ *
+ * Returns the value of the expression
+ */
+static double engine_eval(UqContext* context, const te_expr* expr)
+{
+    VectorProgram storage;
+    VectorProgram* program = engine_prepare(context, expr, &storage);
+    double value = engine_evaluate(context, expr, program);
+    if (program != NULL) {
+        vector_free(program);
+    }
+    return value;
+}
+
+/* Evaluates a compiled expression element-wise over the arrays it references
+ *
+ * UqContext* context: context holding the arrays and vector settings
+ * te_expr* expr: compiled expression
+ * Bindings* bindings: bindings expr was compiled against
+ * double** result: pointer to where newly allocated results will be stored
+ * int* length: pointer to where the number of results will be stored
+ *
+ * Returns 0 if an array result was produced, 1 if the expression references no
+ * arrays and -1 if the referenced arrays have different lengths
+ */
+static int array_evaluate(UqContext* context, te_expr* expr,
+        Bindings* bindings, double** result, int* length)
+{
+    Variables* variables = &(context->variables);
+    VectorProgram program;
+    if (bindings->numberSlots == 0
+            || vector_compile(expr, &program, bindings->slots,
+                    bindings->arrays, bindings->numberSlots, context->math)) {
+        return 1;
+    }
+    if (!program.usesArrays) {
+        vector_free(&program);
+        return 1;
+    }
+    *length = -1;
+    for (int i = 0; i < program.size; i++) {
+        if (program.instructions[i].opcode == VECTOR_ARRAY) {
+            int arrayLength
+                    = variables->arrayLengths[program.instructions[i].array];
+            if (*length != -1 && *length != arrayLength) {
+                vector_free(&program);
+                return -1;
+            }
+            *length = arrayLength;
+        }
+    }
+    *result = vector_allocate(*length);
+    vector_evaluate(&program, variables->arrayValues, *length, *result,
+            vector_precision(context));
+    vector_free(&program);
+    return 0;
+}
+
+/* Prints an array as a single block in the form name = [a, b, c]
+ *
+ * UqContext* context: context whose output and sig figs are used
+ * char* name: name to print before the elements
+ * double* elements: array of elements to print
+ * int length: number of elements
+ *
+ * Returns 0
+ */
+static int array_print(
+        UqContext* context, char* name, double* elements, int length)
+{
+    char format[FORMAT_BUFFER_SIZE];
+    snprintf(format, sizeof(format), "%%.%dg", context->sigFigs);
+    uq_printf(context, "%s = [", name);
+    for (int i = 0; i < length; i++) {
+        if (i > 0) {
+            uq_printf(context, ", ");
+        }
+        uq_printf(context, format, elements[i]);
+    }
+    uq_printf(context, "]\n");
+    return 0;
+}
+
+/* Finds the index of an array variable
+ *
+ * Variables* variables: Pointer to variables struct containing the arrays
+ * char* name: name of the array to find
+ *
+ * Returns the index of the array or -1 if no array has that name
+ */
+static int array_find(Variables* variables, char* name)
+{
+    return name_find(&(variables->arrayIndex), variables->arrayNames,
+            variables->arraySize, name);
+}
+
+/* Stores elements as an array variable, replacing the elements of an existing
+ * array with the same name, and prints the array. The elements are owned by
+ * the array afterwards
+ *
+ * UqContext* context: context holding the variables, arrays and loops
+ * char* name: name of the array
+ * double* elements: VECTOR_ALIGNMENT aligned storage holding the elements
+ * int length: number of elements
+ *
+ * Returns 0 if successful or 1 if name is already a variable or loop
+ */
+static int array_assign(
+        UqContext* context, char* name, double* elements, int length)
+{
+    Variables* variables = &(context->variables);
+    Loops* loops = &(context->loops);
+    if (name_find(&(variables->index), variables->names, variables->size,
+                name)
+                    != -1
+            || name_find(&(loops->index), loops->names, loops->size, name)
+                    != -1
+            || base_find(context, name) != -1) {
+        free((void*)elements);
+        return 1;
+    }
+    int k = array_find(variables, name);
+    if (k == -1) {
+        variables->arraySize++;
+        variables->arrayNames = (char**)realloc((void*)variables->arrayNames,
+                variables->arraySize * sizeof(char*));
+        variables->arrayValues = (double**)realloc(
+                (void*)variables->arrayValues,
+                variables->arraySize * sizeof(double*));
+        variables->arrayLengths = (int*)realloc((void*)variables->arrayLengths,
+                variables->arraySize * sizeof(int));
+        k = variables->arraySize - 1;
+        variables->arrayNames[k] = strdup(name);
+        variables->nameBytes += strlen(name) + 1;
+    } else {
+        free((void*)variables->arrayValues[k]);
+        variables->elements -= variables->arrayLengths[k];
+    }
+    variables->arrayValues[k] = elements;
+    variables->arrayLengths[k] = length;
+    variables->elements += length;
+    array_print(context, variables->arrayNames[k], elements, length);
+    return 0;
+}
+
+/* Parses the elements of an @array command, either a range specification
+ * name,start,increment,end or a literal list name [a, b, c]. Every item of a
+ * list must be a number, nothing but whitespace may follow the list and a
+ * range may have at most ARRAY_MAX_ELEMENTS elements
+ *
+ * char* specification: the text following @array
+ * char** name: pointer to where the array name will be stored
+ * double** elements: pointer to where newly allocated elements will be stored
+ * int* length: pointer to where the number of elements will be stored
+ *
+ * Returns 0 if successful or UQ_INVALID_VARIABLES_ERROR if the format is
+ * invalid
+ */
+static int array_parse(char* specification, char** name, double** elements,
+        int* length)
+{
+    char* savePointer;
+    char* tempExcess;
+    char* list = strchr(specification, '[');
+    if (list != NULL) {
+        char* close = strchr(list, ']');
+        *name = strtok_r(specification, " [", &savePointer);
+        if (close == NULL || *name == NULL || *name > list) {
+            return UQ_INVALID_VARIABLES_ERROR;
+        }
+        for (char* rest = close + 1; *rest != '\0'; rest++) {
+            if (!isspace((unsigned char)*rest)) {
+                return UQ_INVALID_VARIABLES_ERROR;
+            }
+        }
+        *close = '\0';
+        int items = 1;
+        for (char* c = list + 1; *c != '\0'; c++) {
+            items += (*c == ',');
+        }
+        *elements = vector_allocate(items);
+        if (*elements == NULL) {
+            return UQ_INVALID_VARIABLES_ERROR;
+        }
+        *length = 0;
+        char* item = list + 1;
+        while (item != NULL) {
+            char* comma = strchr(item, ',');
+            if (comma != NULL) {
+                *comma = '\0';
+            }
+            (*elements)[*length] = strtod(item, &tempExcess);
+            int empty = tempExcess == item;
+            while (isspace((unsigned char)*tempExcess)) {
+                tempExcess++;
+            }
+            if (empty || *tempExcess != '\0') {
+                free((void*)*elements);
+                return UQ_INVALID_VARIABLES_ERROR;
+            }
+            (*length)++;
+            item = (comma != NULL) ? comma + 1 : NULL;
+        }
+    } else {
+        int countCommas = 0;
+        for (int m = 0; m < (int)strlen(specification); m++) {
+            if (specification[m] == ',') {
+                countCommas++;
+            }
+        }
+        *name = strtok_r(specification, ",", &savePointer);
+        char* startString = strtok_r(NULL, ",", &savePointer);
+        char* incrementString = strtok_r(NULL, ",", &savePointer);
+        char* endString = strtok_r(NULL, " \n", &savePointer);
+        if (countCommas != LOOP_COMMAS || startString == NULL
+                || incrementString == NULL || endString == NULL) {
+            return UQ_INVALID_VARIABLES_ERROR;
+        }
+        double start = strtod(startString, &tempExcess);
+        if (*tempExcess != '\0') {
+            return UQ_INVALID_VARIABLES_ERROR;
+        }
+        double increment = strtod(incrementString, &tempExcess);
+        if (*tempExcess != '\0') {
+            return UQ_INVALID_VARIABLES_ERROR;
+        }
+        double end = strtod(endString, &tempExcess);
+        if (*tempExcess != '\0' || (start < end && increment < 0)
+                || (start > end && increment > 0) || increment == 0) {
+            return UQ_INVALID_VARIABLES_ERROR;
+        }
+        double steps = floor((end - start) / increment);
+        if (!isfinite(start) || !isfinite(end) || !isfinite(steps)
+                || steps >= (double)ARRAY_MAX_ELEMENTS) {
+            return UQ_INVALID_VARIABLES_ERROR;
+        }
+        long long count = 1 + (long long)steps;
+        *length = (int)count;
+        *elements = vector_allocate(*length);
+        if (*elements == NULL) {
+            return UQ_INVALID_VARIABLES_ERROR;
+        }
+        for (int i = 0; i < *length; i++) {
+            (*elements)[i] = start + i * increment;
+        }
+    }
+    int nameLength = strlen(*name);
+    int invalid = nameLength < 1 || nameLength > MAX_VARIABLE_LENGTH;
+    for (int k = 0; k < nameLength; k++) {
+        if (!isalpha((unsigned char)(*name)[k])) {
+            invalid = 1;
+        }
+    }
+    if (invalid) {
+        free((void*)*elements);
+        return UQ_INVALID_VARIABLES_ERROR;
+    }
+    return 0;
+}
+
+/* Detects and processes an @array command on given line, creating or
+ * replacing an array variable
+ *
+ * UqContext* context: context holding the variables, loops and settings
+ * char* line: the String containing the command to process
+ *
+ * Return 1 if an @array command was found otherwise 0
+ */
+static int detect_array(UqContext* context, char* line)
+{
+    if (strncmp(line, "@array ", ARRAY_LENGTH)) {
+        return 0;
+    }
+    char* testString = strdup(line + ARRAY_LENGTH);
+    char* name;
+    double* elements;
+    int length;
+    int res = array_parse(testString, &name, &elements, &length);
+    if (res == 0) {
+        res = array_assign(context, name, elements, length);
+    }
+    if (res != 0) {
+        command_error(context);
+    }
+    free(testString);
+    return 1;
+}
+
+/* Assigns a value to variable or loop and prints the result
+ *
+ * UqContext* context: context holding the variables, loops and settings
+ * char* variableName: the name of the variable or loop to be assigned the value
+ * int* finished: A pointer to an integer that will be set to 1 once assignment
+ * is complete double value: The value to be assigned to the variabl;e or loop
+ *
+ * Return 0
+ */
+static int download_assignment_print(UqContext* context, char* variableName,
+        int* finished, double value)
+{
+    Variables* variables = &(context->variables);
+    Loops* loops = &(context->loops);
+    char format[FORMAT_BUFFER_SIZE];
+    snprintf(format, sizeof(format), "%%.%dg", context->sigFigs);
+    int i = name_find(&(variables->index), variables->names, variables->size,
+            variableName);
+    if (i != -1) {
+        variables->values[i] = value;
+        uq_printf(context, "%s = ", variables->names[i]);
+        uq_printf(context, format, variables->values[i]);
+        uq_printf(context, "\n");
+        *finished = 1;
+    }
+    i = name_find(&(loops->index), loops->names, loops->size, variableName);
+    if (i != -1) {
+        loops->currentValue[i] = value;
+        uq_printf(context, "%s = ", loops->names[i]);
+        uq_printf(context, format, loops->currentValue[i]);
+        uq_printf(context, "\n");
+        *finished = 1;
+    }
+    return 0;
+}
+
+/* Assigns a value to a variable and prints the result
+ *
+ * UqContext* context: context holding the variables and settings
+ * char* variablename: Name of varaible or loop to be assigned
+ * double value: The value to be assigned to the varaible or loop
+ *
+ * Returns 0
+ */
+static int download_allocate_variable(
+        UqContext* context, char* variableName, double value)
+{
+    Variables* variables = &(context->variables);
+    variables->size++;
+    variables->names = (char**)realloc(
+            (void*)variables->names, variables->size * sizeof(char*));
+    variables->values = (double*)realloc(
+            (void*)variables->values, variables->size * sizeof(double));
+    variables->names[variables->size - 1] = strdup(variableName);
+    variables->nameBytes += strlen(variableName) + 1;
+    variables->values[variables->size - 1] = value;
+    char format[FORMAT_BUFFER_SIZE];
+    snprintf(format, sizeof(format), "%%.%dg", context->sigFigs);
+    uq_printf(context, "%s = ", variables->names[variables->size - 1]);
+    uq_printf(context, format, variables->values[variables->size - 1]);
+    uq_printf(context, "\n");
+    return 0;
+}
+
+/* Evaluated an expression and assigns its result to a variable or loop
+ *
+ * UqContext* context: context holding the variables, loops and settings
+ * char* expression: A string containing the expression to be evaluated
+ * char* variableName: The same of the variatable to which the expression's
+ * result will be assigned
+ *
+ * Return 0 if succesful else 1
+ */
+static int download_assignment(
+        UqContext* context, char* expression, char* variableName)
+{
+    Variables* variables = &(context->variables);
+    Bindings bindings;
+    bind_referenced(context, expression, 1, &bindings);
+    int cached;
+    te_expr* expr = compile_bound(context, expression, &bindings, &cached);
+    int finished = 0;
+    double* elements;
+    int length;
+    long long start = work_clock(context);
+    if (expr != NULL) {
+        crosscheck_begin(context, expression, &bindings, expr);
+    }
+    int arrayResult = expr
+            ? array_evaluate(context, expr, &bindings, &elements, &length)
+            : -1;
+    if (arrayResult == 0) {
+        bindings_free(&bindings);
+        STATS_ADD(context, evaluations, length);
+        trace_span(context, "evaluate", start);
+        compile_release(context, expr, cached);
+        crosscheck_array(context, elements, length);
+        crosscheck_end(context);
+        if (array_assign(context, variableName, elements, length)) {
+            command_error(context);
+            return 1;
+        }
+    } else if (arrayResult == 1) {
+        double value = engine_eval(context, expr);
+        bindings_free(&bindings);
+        STATS_ADD(context, evaluations, 1);
+        trace_span(context, "evaluate", start);
+        compile_release(context, expr, cached);
+        crosscheck_row(context, value);
+        crosscheck_end(context);
+        int k = array_find(variables, variableName);
+        if (k != -1) {
+            for (int i = 0; i < variables->arrayLengths[k]; i++) {
+                variables->arrayValues[k][i] = value;
+            }
+            array_print(context, variableName, variables->arrayValues[k],
+                    variables->arrayLengths[k]);
+            return 0;
+        }
+        download_assignment_print(context, variableName, &finished, value);
+        if (!finished) {
+            download_allocate_variable(context, variableName, value);
+        }
+    } else {
+        bindings_free(&bindings);
+        compile_release(context, expr, cached);
+        crosscheck_end(context);
+        command_error(context);
+        return 1;
+    }
+    return 0;
+}
+
+/* Evaluated a mathematical expression using current values of varaibles and
+ * loops
+ *
+ * UqContext* context: context holding the variables, loops and settings
+ * char* line: A string representation of expression to be evaluated
+ *
+ * return 0
+ */
+static int download_expression(UqContext* context, char* line)
+{
+    Bindings bindings;
+    bind_referenced(context, line, 1, &bindings);
+    int cached;
+    te_expr* expr = compile_bound(context, line, &bindings, &cached);
+    double* elements;
+    int length;
+    long long start = work_clock(context);
+    if (expr != NULL) {
+        crosscheck_begin(context, line, &bindings, expr);
+    }
+    int arrayResult = expr
+            ? array_evaluate(context, expr, &bindings, &elements, &length)
+            : -1;
+    if (arrayResult == 0) {
+        bindings_free(&bindings);
+        STATS_ADD(context, evaluations, length);
+        trace_span(context, "evaluate", start);
+        crosscheck_array(context, elements, length);
+        array_print(context, "Result", elements, length);
+        free((void*)elements);
+        compile_release(context, expr, cached);
+    } else if (arrayResult == 1) {
+        double res = engine_eval(context, expr);
+        bindings_free(&bindings);
+        STATS_ADD(context, evaluations, 1);
+        trace_span(context, "evaluate", start);
+        crosscheck_row(context, res);
+        char format[FORMAT_BUFFER_SIZE];
+        snprintf(format, sizeof(format), "%%.%dg", context->sigFigs);
+        uq_printf(context, "Result = ");
+        uq_printf(context, format, res);
+        uq_printf(context, "\n");
+        compile_release(context, expr, cached);
+    } else {
+        bindings_free(&bindings);
+        compile_release(context, expr, cached);
+        command_error(context);
+    }
+    crosscheck_end(context);
+    return 0;
+}
+
+/* Counts number of equals and # chaarcters in a line to disregard comments and
+ * determine validity
+ *
+ * char* line A string representration of input to analyse
+ * int* numberEquals: A pointer that stores number of equals signs
+ *
+ * Return 0 if succesful, 1 if line has a comment
+ */
+static int download_setup(char* line, int* numberEquals)
+{
+    int length = strlen(line);
+    for (int i = 0; i < length; i++) {
+        if (line[i] == '=') {
+            (*numberEquals)++;
+        }
+    }
+    int numberHash = 0;
+    for (int i = 0; i < length; i++) {
+        if (line[i] == '#') {
+            numberHash++;
+        }
+    }
+    if (numberHash > 0) {
+        return 1;
+    }
+    return 0;
+}
+
+/* Checks if given variable name is valid
+ *
+ * char* variableName: String representation of name of variable to check
+ *
+ * Return 0 if valid, else 1
+ */
+static int download_assignment_check_valid(char* variableName)
+{
+    int length = strlen(variableName);
+    int check = 0;
+    for (int i = 0; i < length; i++) {
+        if (!isalpha((unsigned char)variableName[i])) {
+            check = 1;
+        }
+    }
+    if (strlen(variableName) < 1
+            || strlen(variableName) > MAX_VARIABLE_LENGTH) {
+        check = 1;
+    }
+    return check;
+}
+
+/* Executes @print command printing all defined variables and loop variables
+ *
+ * UqContext* context: context holding the variables, loops and settings
+ *
+ * Return 0 or 1 if there is not enough memory to gather the variables
+ */
+static int print_variables(UqContext* context)
+{
+    Variables* variables = &(context->variables);
+    Loops* loops = &(context->loops);
+    te_variable* tevars = (te_variable*)malloc(
+            (scalar_capacity(context) + 1) * sizeof(te_variable));
+    double* values
+            = (double*)malloc((scalar_capacity(context) + 1) * sizeof(double));
+    if (tevars == NULL || values == NULL) {
+        free((void*)tevars);
+        free((void*)values);
+        return 1;
+    }
+    int size = bind_scalars(context, tevars, values);
+    if (size == 0) {
+        uq_printf(context, "No variables were defined.\n");
+    } else {
+        uq_printf(context, "Variables:\n");
+        for (int j = 0; j < size; j++) {
+            char format[FORMAT_BUFFER_SIZE];
+            snprintf(format, sizeof(format), "%%.%dg", context->sigFigs);
+            uq_printf(context, "%s = ", tevars[j].name);
+            uq_printf(context, format, values[j]);
+            uq_printf(context, "\n");
+        }
+    }
+    free((void*)tevars);
+    free((void*)values);
+    if (loops->size == 0) {
+        uq_printf(context, "No loop variables were defined.\n");
+    } else {
+        uq_printf(context, "Loop variables:\n");
+        for (int j = 0; j < loops->size; j++) {
+            char format[FORMAT_BUFFER_SIZE];
+            snprintf(format, sizeof(format), "%%.%dg", context->sigFigs);
+            uq_printf(context, "%s = ", loops->names[j]);
+            uq_printf(context, format, loops->currentValue[j]);
+            uq_printf(context, " (");
+            uq_printf(context, format, loops->startingValue[j]);
+            uq_printf(context, ", ");
+            uq_printf(context, format, loops->increment[j]);
+            uq_printf(context, ", ");
+            uq_printf(context, format, loops->endValue[j]);
+            uq_printf(context, ")\n");
+        }
+    }
+    if (variables->arraySize > 0) {
+        uq_printf(context, "Array variables:\n");
+        for (int j = 0; j < variables->arraySize; j++) {
+            array_print(context, variables->arrayNames[j],
+                    variables->arrayValues[j], variables->arrayLengths[j]);
+        }
+    }
+    return 0;
+}
+
+/* Splits the header line of a CSV/TSV file into column names, trimming any
+ * surrounding whitespace from each name
+ *
+ * char* header: header line without its newline, modified in place
+ * char delimiter: character separating the columns
+ * char*** names: pointer to where a newly allocated array of names pointing
+ * into header will be stored
+ *
+ * Returns the number of columns
+ */
+static int columns_header(char* header, char delimiter, char*** names)
+{
+    int numberColumns = 1;
+    for (int m = 0; m < (int)strlen(header); m++) {
+        if (header[m] == delimiter) {
+            numberColumns++;
+        }
+    }
+    *names = (char**)malloc(numberColumns * sizeof(char*));
+    char* cell = header;
+    for (int c = 0; c < numberColumns; c++) {
+        char* next = strchr(cell, delimiter);
+        if (next != NULL) {
+            *next = '\0';
+        }
+        while (isspace((unsigned char)*cell)) {
+            cell++;
+        }
+        int end = strlen(cell);
+        while (end > 0 && isspace((unsigned char)cell[end - 1])) {
+            end--;
+        }
+        cell[end] = '\0';
+        (*names)[c] = cell;
+        cell = (next != NULL) ? next + 1 : cell + end;
+    }
+    return numberColumns;
+}
+
+/* Checks that no two columns of a CSV/TSV header have the same name
+ *
+ * char** names: names of the columns
+ * int numberColumns: number of columns
+ *
+ * Returns 1 if every name is different, otherwise 0
+ */
+static int columns_unique(char** names, int numberColumns)
+{
+    NameIndex index;
+    memset(&index, 0, sizeof(index));
+    int unique = 1;
+    for (int c = 0; c < numberColumns && unique; c++) {
+        unique = name_find(&index, names, numberColumns, names[c]) == c;
+    }
+    name_index_reset(&index);
+    return unique;
+}
+
+/* Parses one data row of a CSV/TSV file into the column buffers. Cells that
+ * are missing or not numeric are stored as NAN
+ *
+ * char* row: data row without its newline
+ * char delimiter: character separating the columns
+ * int numberColumns: number of columns named in the header
+ * double** columns: array of column buffers
+ * int r: index of the row within the column buffers
+ *
+ * Returns the number of cells missing from the end of the row
+ */
+static int columns_row(char* row, char delimiter, int numberColumns,
+        double** columns, int r)
+{
+    char* cell = row;
+    int missing = 0;
+    for (int c = 0; c < numberColumns; c++) {
+        if (cell == NULL) {
+            columns[c][r] = NAN;
+            continue;
+        }
+        char* tempExcess;
+        double value = strtod(cell, &tempExcess);
+        while (*tempExcess == ' ') {
+            tempExcess++;
+        }
+        if (tempExcess == cell
+                || (*tempExcess != delimiter && *tempExcess != '\0')) {
+            value = NAN;
+        }
+        columns[c][r] = value;
+        cell = strchr(cell, delimiter);
+        if (cell != NULL) {
+            cell++;
+        } else {
+            missing = numberColumns - c - 1;
+        }
+    }
+    return missing;
+}
+
+/* Records a span of work on a block of rows of a CSV/TSV file
+ *
+ * UqContext* context: context the rows were processed in
+ * const char* name: phase the span covers, a string literal
+ * long long start: time returned by work_clock() when the work began
+ * long long first: index of the first row of the block
+ * int count: number of rows in the block
+ */
+static void columns_trace(UqContext* context, const char* name,
+        long long start, long long first, int count)
+{
+    if (start != 0 && TRACE_ENABLED(context)) {
+        trace_record(context->trace, name, start, clock_now(), first, count);
+    }
+}
+
+/* Evaluates the --eval expression over every row of the --columns file. Each
+ * column is bound to the variable named in the header, rows are read into
+ * column buffers COLUMN_BLOCK_ROWS at a time (fewer once the context is over
+ * its memory limit) and every block is evaluated with the vector path, so
+ * memory use does not depend on the size of the file.
+ * Each row is written back out with the result appended as a new column,
+ * after empty cells for any columns missing from the end of the row. Nothing
+ * is written if the header repeats a name or the expression is invalid
+ */
+int uq_columns(UqContext* context, FILE* file, const char* expression)
+{
+    Loops* loops = &(context->loops);
+    base_refresh(context);
+    char* header = NULL;
+    size_t headerSize = 0;
+    ssize_t headerLength = getline(&header, &headerSize, file);
+    if (headerLength < 0) {
+        free((void*)header);
+        return 0;
+    }
+    STATS_ADD(context, linesRead, 1);
+    STATS_ADD(context, bytesRead, headerLength);
+    header[strcspn(header, "\r\n")] = '\0';
+    char delimiter = (strchr(header, '\t') != NULL) ? '\t' : ',';
+    char* cells = strdup(header);
+    char** names;
+    int numberColumns = columns_header(cells, delimiter, &names);
+    int capacity = numberColumns + scalar_capacity(context) + loops->size + 1;
+    te_variable* tevars
+            = (te_variable*)malloc(capacity * sizeof(te_variable));
+    double* values = (double*)malloc(capacity * sizeof(double));
+    double* slots = (double*)malloc(numberColumns * sizeof(double));
+    if (tevars == NULL || values == NULL || slots == NULL
+            || !columns_unique(names, numberColumns)) {
+        command_error(context);
+        free((void*)tevars);
+        free((void*)values);
+        free((void*)slots);
+        free((void*)names);
+        free((void*)cells);
+        free((void*)header);
+        return UQ_INVALID_EXPRESSION_ERROR;
+    }
+    int index = 0;
+    for (int c = 0; c < numberColumns; c++) {
+        slots[c] = NAN;
+        te_variable var = {.name = names[c],
+                .address = &(slots[c]),
+                .type = TE_VARIABLE,
+                .context = NULL};
+        tevars[index] = var;
+        index++;
+    }
+    int scalars = bind_scalars(context, tevars + index, values);
+    index += scalars;
+    for (int i = 0; i < loops->size; i++) {
+        values[scalars] = loops->currentValue[i];
+        te_variable var = {.name = loops->names[i],
+                .address = &(values[scalars]),
+                .type = TE_VARIABLE,
+                .context = NULL};
+        tevars[index] = var;
+        index++;
+        scalars++;
+    }
+    te_expr* expr = compile_uncached(
+            context, expression, tevars, index, work_clock(context));
+    free((void*)tevars);
+    VectorProgram program;
+    if (!expr
+            || vector_compile(expr, &program, slots, NULL, numberColumns,
+                    context->math)) {
+        command_error(context);
+        arena_release(context, expr);
+        free((void*)values);
+        free((void*)slots);
+        free((void*)names);
+        free((void*)cells);
+        free((void*)header);
+        return UQ_INVALID_EXPRESSION_ERROR;
+    }
+    uq_write(context, header, strlen(header));
+    uq_write(context, &delimiter, 1);
+    uq_write(context, "Result\n", strlen("Result\n"));
+    double** columns = (double**)malloc(numberColumns * sizeof(double*));
+    for (int c = 0; c < numberColumns; c++) {
+        columns[c] = vector_allocate(COLUMN_BLOCK_ROWS);
+    }
+    double* result = vector_allocate(COLUMN_BLOCK_ROWS);
+    char** rows = (char**)calloc(COLUMN_BLOCK_ROWS, sizeof(char*));
+    size_t* rowSizes = (size_t*)calloc(COLUMN_BLOCK_ROWS, sizeof(size_t));
+    int* missing = (int*)calloc(COLUMN_BLOCK_ROWS, sizeof(int));
+    char format[FORMAT_BUFFER_SIZE];
+    snprintf(format, sizeof(format), "%%.%dg", context->sigFigs);
+    long long blockBytes = (numberColumns + 1) * COLUMN_BLOCK_ROWS
+                    * sizeof(double)
+            + COLUMN_BLOCK_ROWS * (sizeof(char*) + sizeof(size_t)
+                    + sizeof(int));
+    memory_add(context, UQ_MEMORY_BUFFERS, blockBytes);
+    long long first = 0;
+    int more = 1;
+    while (more) {
+        int count = 0;
+        long long blockStart = work_clock(context);
+        while (count < COLUMN_BLOCK_ROWS
+                && !(count > 0 && memory_over(context))) {
+            size_t rowSize = rowSizes[count];
+            ssize_t rowLength
+                    = getline(&(rows[count]), &(rowSizes[count]), file);
+            memory_add(context, UQ_MEMORY_BUFFERS, rowSizes[count] - rowSize);
+            blockBytes += rowSizes[count] - rowSize;
+            if (rowLength < 0) {
+                more = 0;
+                break;
+            }
+            STATS_ADD(context, linesRead, 1);
+            STATS_ADD(context, bytesRead, rowLength);
+            rows[count][strcspn(rows[count], "\r\n")] = '\0';
+            if (rows[count][0] != '\0') {
+                missing[count] = columns_row(rows[count], delimiter,
+                        numberColumns, columns, count);
+                count++;
+            }
+        }
+        columns_trace(context, "read", blockStart, first, count);
+        blockStart = work_clock(context);
+        vector_evaluate(
+                &program, columns, count, result, vector_precision(context));
+        STATS_ADD(context, evaluations, count);
+        columns_trace(context, "evaluate", blockStart, first, count);
+        blockStart = work_clock(context);
+        trace_quiet(context, 1);
+        for (int r = 0; r < count; r++) {
+            uq_write(context, rows[r], strlen(rows[r]));
+            for (int m = 0; m <= missing[r]; m++) {
+                uq_write(context, &delimiter, 1);
+            }
+            char number[PRINT_BUFFER_SIZE];
+            int length = snprintf(number, sizeof(number), format, result[r]);
+            uq_write(context, number, length);
+            uq_write(context, "\n", 1);
+        }
+        trace_quiet(context, 0);
+        columns_trace(context, "format", blockStart, first, count);
+        first += count;
+    }
+    for (int r = 0; r < COLUMN_BLOCK_ROWS; r++) {
+        free((void*)rows[r]);
+    }
+    for (int c = 0; c < numberColumns; c++) {
+        free((void*)columns[c]);
+    }
+    free((void*)rows);
+    free((void*)rowSizes);
+    free((void*)missing);
+    free((void*)columns);
+    free((void*)result);
+    free((void*)values);
+    free((void*)slots);
+    free((void*)names);
+    free((void*)cells);
+    free((void*)header);
+    memory_add(context, UQ_MEMORY_BUFFERS, -blockBytes);
+    vector_free(&program);
+    arena_release(context, expr);
+    uq_flush(context);
+    return 0;
+}
+
+/* Creates a context with no variables, 3 significant figures, text output and
+ * output written to stdout and stderr
+ */
+UqContext* uq_create(void)
+{
+    UqContext* context = (UqContext*)malloc(sizeof(UqContext));
+    if (context == NULL) {
+        return NULL;
+    }
+    context->variables.size = 0;
+    context->variables.converted = 0;
+    context->variables.names = (char**)malloc(sizeof(char*));
+    context->variables.values = (double*)malloc(sizeof(double));
+    context->variables.arraySize = 0;
+    context->variables.arrayNames = (char**)malloc(sizeof(char*));
+    context->variables.arrayValues = (double**)malloc(sizeof(double*));
+    context->variables.arrayLengths = (int*)malloc(sizeof(int));
+    context->variables.nameBytes = 0;
+    context->variables.elements = 0;
+    memset(&(context->variables.index), 0, sizeof(NameIndex));
+    memset(&(context->variables.arrayIndex), 0, sizeof(NameIndex));
+    context->loops.size = 0;
+    context->loops.nameBytes = 0;
+    memset(&(context->loops.index), 0, sizeof(NameIndex));
+    context->loops.names = (char**)malloc(sizeof(char*));
+    context->loops.currentValue = (double*)malloc(sizeof(double));
+    context->loops.startingValue = (double*)malloc(sizeof(double));
+    context->loops.increment = (double*)malloc(sizeof(double));
+    context->loops.endValue = (double*)malloc(sizeof(double));
+    context->sigFigs = DEFAULT_SIG_FIGS;
+    context->outputMode = UQ_OUTPUT_TEXT;
+    context->math = UQ_MATH_EXACT;
+    context->precision = UQ_PRECISION_DOUBLE;
+    context->output = default_output;
+    context->outputData = NULL;
+    context->buffer = (char*)malloc(OUTPUT_BUFFER_SIZE);
+    context->bufferLength = 0;
+    context->errors = 0;
+    context->cache = NULL;
+    context->slot = NULL;
+    context->base = NULL;
+    context->stats = NULL;
+    context->trace = NULL;
+    memset(context->memory, 0, sizeof(context->memory));
+    context->memoryLimit = 0;
+    context->progress = 0;
+    context->arena = NULL;
+    context->arenaSize = 0;
+    context->arenaUsed = 0;
+    context->grammarReady = 0;
+    context->engine = UQ_ENGINE_TREE;
+    context->crosscheck = NULL;
+    context->checking = NULL;
+    context->interrupted = 0;
+    context->timeLimit = 0;
+    context->deadline = 0;
+    memory_add(context, UQ_MEMORY_BUFFERS, OUTPUT_BUFFER_SIZE);
+    return context;
+}
+
+/* Copies a list of names
+ *
+ * char** names: names to copy
+ * int size: number of names
+ *
+ * Returns a newly allocated array of newly allocated names
+ */
+static char** copy_names(char** names, int size)
+{
+    char** copy = (char**)malloc((size + 1) * sizeof(char*));
+    for (int i = 0; i < size; i++) {
+        copy[i] = strdup(names[i]);
+    }
+    return copy;
+}
+
+/* Copies an array of doubles
+ *
+ * const double* values: doubles to copy
+ * int size: number of doubles
+ *
+ * Returns a newly allocated copy
+ */
+static double* copy_values(const double* values, int size)
+{
+    double* copy = (double*)malloc((size + 1) * sizeof(double));
+    memcpy(copy, values, size * sizeof(double));
+    return copy;
+}
+
+/* Creates a context holding copies of the variables, loop variables, arrays
+ * and settings of another. The copy shares the original's cache and shared
+ * base but writes to stdout and stderr until uq_set_output() is called
+ */
+UqContext* uq_clone(const UqContext* original)
+{
+    UqContext* context = (UqContext*)malloc(sizeof(UqContext));
+    if (context == NULL) {
+        return NULL;
+    }
+    const Variables* variables = &(original->variables);
+    const Loops* loops = &(original->loops);
+    context->variables.size = variables->size;
+    context->variables.converted = variables->converted;
+    context->variables.names = copy_names(variables->names, variables->size);
+    context->variables.values = copy_values(variables->values, variables->size);
+    context->variables.arraySize = variables->arraySize;
+    context->variables.arrayNames
+            = copy_names(variables->arrayNames, variables->arraySize);
+    context->variables.arrayValues = (double**)malloc(
+            (variables->arraySize + 1) * sizeof(double*));
+    context->variables.arrayLengths
+            = (int*)malloc((variables->arraySize + 1) * sizeof(int));
+    context->variables.nameBytes = variables->nameBytes;
+    context->variables.elements = variables->elements;
+    memset(&(context->variables.index), 0, sizeof(NameIndex));
+    memset(&(context->variables.arrayIndex), 0, sizeof(NameIndex));
+    for (int k = 0; k < variables->arraySize; k++) {
+        int length = variables->arrayLengths[k];
+        context->variables.arrayLengths[k] = length;
+        context->variables.arrayValues[k] = vector_allocate(length);
+        memcpy(context->variables.arrayValues[k], variables->arrayValues[k],
+                length * sizeof(double));
+    }
+    context->loops.size = loops->size;
+    context->loops.names = copy_names(loops->names, loops->size);
+    context->loops.nameBytes = loops->nameBytes;
+    memset(&(context->loops.index), 0, sizeof(NameIndex));
+    context->loops.currentValue = copy_values(loops->currentValue, loops->size);
+    context->loops.startingValue
+            = copy_values(loops->startingValue, loops->size);
+    context->loops.increment = copy_values(loops->increment, loops->size);
+    context->loops.endValue = copy_values(loops->endValue, loops->size);
+    context->sigFigs = original->sigFigs;
+    context->outputMode = original->outputMode;
+    context->math = original->math;
+    context->precision = original->precision;
+    context->output = default_output;
+    context->outputData = NULL;
+    context->buffer = (char*)malloc(OUTPUT_BUFFER_SIZE);
+    context->bufferLength = 0;
+    context->errors = 0;
+    context->cache = original->cache;
+    context->slot = original->slot;
+    context->base = NULL;
+    context->stats = NULL;
+    context->trace = NULL;
+    memset(context->memory, 0, sizeof(context->memory));
+    context->memoryLimit = original->memoryLimit;
+    context->progress = original->progress;
+    context->arena = NULL;
+    context->arenaSize = 0;
+    context->arenaUsed = 0;
+    context->grammar = original->grammar;
+    context->grammarReady = original->grammarReady;
+    context->engine = original->engine;
+    context->crosscheck = original->crosscheck;
+    context->checking = NULL;
+    context->interrupted = 0;
+    context->timeLimit = original->timeLimit;
+    context->deadline = 0;
+    memory_add(context, UQ_MEMORY_BUFFERS, OUTPUT_BUFFER_SIZE);
+    memory_sync(context);
+    if (context->slot != NULL) {
+        __atomic_add_fetch(&(context->slot->references), 1, __ATOMIC_SEQ_CST);
+        base_refresh(context);
+    }
+    return context;
+}
+
+/* Frees a context and everything it holds, passing on any buffered output
+ * first
+ */
+void uq_destroy(UqContext* context)
+{
+    if (context == NULL) {
+        return;
+    }
+    uq_flush(context);
+    uq_set_stats(context, NULL);
+    crosscheck_end(context);
+    Variables* variables = &(context->variables);
+    Loops* loops = &(context->loops);
+    for (int i = 0; i < variables->size; i++) {
+        free((void*)variables->names[i]);
+    }
+    free((void*)variables->names);
+    free((void*)variables->values);
+    for (int i = 0; i < variables->arraySize; i++) {
+        free((void*)variables->arrayNames[i]);
+        free((void*)variables->arrayValues[i]);
+    }
+    free((void*)variables->arrayNames);
+    free((void*)variables->arrayValues);
+    free((void*)variables->arrayLengths);
+    name_index_reset(&(variables->index));
+    name_index_reset(&(variables->arrayIndex));
+    for (int i = 0; i < loops->size; i++) {
+        free((void*)loops->names[i]);
+    }
+    free((void*)loops->names);
+    name_index_reset(&(loops->index));
+    free((void*)loops->startingValue);
+    free((void*)loops->currentValue);
+    free((void*)loops->increment);
+    free((void*)loops->endValue);
+    base_release(context->base);
+    if (context->slot != NULL
+            && __atomic_sub_fetch(
+                       &(context->slot->references), 1, __ATOMIC_SEQ_CST)
+                    == 0) {
+        base_release(context->slot->current);
+        free((void*)context->slot);
+    }
+    free((void*)context->buffer);
+    free((void*)context->arena);
+    free((void*)context);
+}
+
+/* Moves the scalar variables of a context into a new shared base that every
+ * later copy of the context reads without copying
+ */
+int uq_share(UqContext* context)
+{
+    if (context->slot != NULL) {
+        return 0;
+    }
+    BaseSlot* slot = (BaseSlot*)malloc(sizeof(BaseSlot));
+    if (slot == NULL) {
+        return UQ_STATEMENT_ERROR;
+    }
+    slot->current = NULL;
+    slot->readers = 0;
+    slot->references = 1;
+    context->slot = slot;
+    return base_publish(context);
+}
+
+/* Sets the number of significant figures results are printed to
+ */
+int uq_set_sig_figs(UqContext* context, int sigFigs)
+{
+    if (sigFigs < 1 || sigFigs > MAX_SIG_FIGS) {
+        return UQ_INVALID_VARIABLES_ERROR;
+    }
+    context->sigFigs = sigFigs;
+    return 0;
+}
+
+/* Sets how @loop results are written
+ */
+int uq_set_output_mode(UqContext* context, int outputMode)
+{
+    if (outputMode != UQ_OUTPUT_TEXT && outputMode != UQ_OUTPUT_TSV
+            && outputMode != UQ_OUTPUT_BINARY) {
+        return UQ_INVALID_VARIABLES_ERROR;
+    }
+    context->outputMode = outputMode;
+    return 0;
+}
+
+/* Returns the output mode of a context
+ */
+int uq_output_mode(const UqContext* context)
+{
+    return context->outputMode;
+}
+
+/* Sets how vector programs evaluate transcendental functions
+ */
+int uq_set_math(UqContext* context, int math)
+{
+    if (math != UQ_MATH_EXACT && math != UQ_MATH_FAST) {
+        return UQ_INVALID_VARIABLES_ERROR;
+    }
+    context->math = math;
+    return 0;
+}
+
+/* Sets the precision vector programs are evaluated in
+ */
+int uq_set_precision(UqContext* context, int precision)
+{
+    if (precision != UQ_PRECISION_DOUBLE && precision != UQ_PRECISION_FLOAT) {
+        return UQ_INVALID_VARIABLES_ERROR;
+    }
+    context->precision = precision;
+    return 0;
+}
+
+/* Sets the number of @loop iterations between progress reports
+ */
+int uq_set_progress(UqContext* context, long long interval)
+{
+    if (interval < 0) {
+        return UQ_INVALID_VARIABLES_ERROR;
+    }
+    context->progress = interval;
+    return 0;
+}
+
+/* Sets the function all output is passed to. Output already buffered is
+ * passed to the previous function first
+ */
+void uq_set_output(UqContext* context, UqOutputFunction function, void* data)
+{
+    uq_flush(context);
+    context->output = (function != NULL) ? function : default_output;
+    context->outputData = (function != NULL) ? data : NULL;
+}
+
+/* Asks the statement a context is running to stop
+ */
+void uq_interrupt(UqContext* context)
+{
+    context->interrupted = 1;
+}
+
+/* Sets the time each @loop may run for
+ */
+int uq_set_time_limit(UqContext* context, long long milliseconds)
+{
+    if (milliseconds < 0
+            || milliseconds > LLONG_MAX / 2 / NANOSECONDS_PER_MILLISECOND) {
+        return UQ_INVALID_VARIABLES_ERROR;
+    }
+    context->timeLimit = milliseconds * NANOSECONDS_PER_MILLISECOND;
+    return 0;
+}
+
+/* Sets the counters a context adds its work to
+ */
+void uq_set_stats(UqContext* context, UqStats* stats)
+{
+    memory_sync(context);
+    long long memory[UQ_MEMORY_KINDS];
+    for (int kind = 0; kind < UQ_MEMORY_KINDS; kind++) {
+        memory[kind] = context->memory[kind];
+        memory_add(context, kind, -memory[kind]);
+    }
+    context->stats = stats;
+    for (int kind = 0; kind < UQ_MEMORY_KINDS; kind++) {
+        memory_add(context, kind, memory[kind]);
+    }
+}
+
+/* Sets the number of bytes a context tries to stay within
+ */
+void uq_set_memory_limit(UqContext* context, long long bytes)
+{
+    context->memoryLimit = (bytes > 0) ? bytes : 0;
+}
+
+/* Creates an empty trace for the calling thread
+ */
+UqTrace* uq_trace_create(void)
+{
+    UqTrace* trace = (UqTrace*)calloc(1, sizeof(UqTrace));
+    if (trace == NULL) {
+        return NULL;
+    }
+    trace->events
+            = (TraceEvent*)malloc(TRACE_INITIAL_EVENTS * sizeof(TraceEvent));
+    if (trace->events == NULL) {
+        free((void*)trace);
+        return NULL;
+    }
+    trace->capacity = TRACE_INITIAL_EVENTS;
+    trace->thread = (long long)syscall(SYS_gettid);
+    trace->origin = clock_now();
+    return trace;
+}
+
+/* Frees a trace and the spans it holds
+ */
+void uq_trace_destroy(UqTrace* trace)
+{
+    if (trace == NULL) {
+        return;
+    }
+    free((void*)trace->events);
+    free((void*)trace);
+}
+
+/* Sets the trace a context records spans in
+ */
+void uq_set_trace(UqContext* context, UqTrace* trace)
+{
+    context->trace = trace;
+}
+
+/* Sets how scalar statements and @loop are evaluated
+ */
+int uq_set_engine(UqContext* context, int engine)
+{
+    if (engine != UQ_ENGINE_TREE && engine != UQ_ENGINE_VECTOR) {
+        return UQ_INVALID_VARIABLES_ERROR;
+    }
+    context->engine = engine;
+    return 0;
+}
+
+/* Creates a crosscheck and starts its thread
+ */
+UqCrosscheck* uq_crosscheck_create(long long ulps, FILE* report)
+{
+    if (ulps < 0) {
+        return NULL;
+    }
+    UqCrosscheck* check = (UqCrosscheck*)calloc(1, sizeof(UqCrosscheck));
+    if (check == NULL) {
+        return NULL;
+    }
+    check->ulps = ulps;
+    check->report = report;
+    pthread_mutex_init(&(check->lock), NULL);
+    pthread_cond_init(&(check->queued), NULL);
+    if (pthread_create(&(check->thread), NULL, crosscheck_thread, check)) {
+        pthread_cond_destroy(&(check->queued));
+        pthread_mutex_destroy(&(check->lock));
+        free((void*)check);
+        return NULL;
+    }
+    return check;
+}
+
+/* Waits for a crosscheck to check everything queued, writes its summary and
+ * frees it
+ */
+int uq_crosscheck_destroy(UqCrosscheck* check)
+{
+    if (check == NULL) {
+        return 0;
+    }
+    pthread_mutex_lock(&(check->lock));
+    check->closing = 1;
+    pthread_cond_signal(&(check->queued));
+    pthread_mutex_unlock(&(check->lock));
+    pthread_join(check->thread, NULL);
+    fprintf(check->report,
+            "uqexpr crosscheck: %lld results checked, %lld differed by more "
+            "than %lld ulp, %lld unchecked\n",
+            check->checked, check->diverged, check->ulps, check->skipped);
+    fflush(check->report);
+    int result = (check->diverged > 0) ? UQ_CROSSCHECK_ERROR : 0;
+    pthread_cond_destroy(&(check->queued));
+    pthread_mutex_destroy(&(check->lock));
+    free((void*)check);
+    return result;
+}
+
+/* Sets the crosscheck a context queues its statements on
+ */
+void uq_set_crosscheck(UqContext* context, UqCrosscheck* check)
+{
+    crosscheck_end(context);
+    context->crosscheck = check;
+}
+
+/* Records a span timed by the caller
+ */
+void uq_trace_span(
+        UqTrace* trace, const char* name, long long start, long long end)
+{
+    trace_record(trace, name, start, end, -1, -1);
+}
+
+/* Writes one span as a trace event object
+ *
+ * FILE* file: file to write to
+ * const TraceEvent* event: span to write
+ * long long thread: thread id the span was recorded by
+ * long long origin: time that is written as timestamp 0
+ */
+static void trace_write_event(FILE* file, const TraceEvent* event,
+        long long thread, long long origin)
+{
+    long long start = event->start - origin;
+    fprintf(file,
+            ",\n{\"name\":\"%s\",\"cat\":\"uqexpr\",\"ph\":\"X\","
+            "\"pid\":%ld,\"tid\":%lld,\"ts\":%lld.%03lld,"
+            "\"dur\":%lld.%03lld",
+            event->name, (long)getpid(), thread,
+            start / NANOSECONDS_PER_MICROSECOND,
+            start % NANOSECONDS_PER_MICROSECOND,
+            event->duration / NANOSECONDS_PER_MICROSECOND,
+            event->duration % NANOSECONDS_PER_MICROSECOND);
+    if (event->first >= 0) {
+        fprintf(file, ",\"args\":{\"first\":%lld,\"count\":%lld}",
+                event->first, event->count);
+    }
+    fprintf(file, "}");
+}
+
+/* Writes traces as one Chrome trace event file, timed from the earliest
+ * trace's creation
+ */
+int uq_trace_write(UqTrace* const* traces, int count, FILE* file)
+{
+    long long origin = 0;
+    for (int t = 0; t < count; t++) {
+        if (t == 0 || traces[t]->origin < origin) {
+            origin = traces[t]->origin;
+        }
+    }
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    fprintf(file,
+            "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%ld,"
+            "\"args\":{\"name\":\"uqexpr\"}}",
+            (long)getpid());
+    for (int t = 0; t < count; t++) {
+        const UqTrace* trace = traces[t];
+        fprintf(file,
+                ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%ld,"
+                "\"tid\":%lld,\"args\":{\"name\":\"thread %d\","
+                "\"dropped\":%lld}}",
+                (long)getpid(), trace->thread, t, trace->dropped);
+        for (size_t i = 0; i < trace->size; i++) {
+            trace_write_event(file, &(trace->events[i]), trace->thread, origin);
+        }
+    }
+    fprintf(file, "\n]}\n");
+    return (fflush(file) || ferror(file)) ? UQ_TRACE_ERROR : 0;
+}
+
+/* Creates an empty compiled expression cache
+ */
+UqCache* uq_cache_create(void)
+{
+    return (UqCache*)calloc(1, sizeof(UqCache));
+}
+
+/* Frees a compiled expression cache and every tree it holds
+ */
+void uq_cache_destroy(UqCache* cache)
+{
+    if (cache == NULL) {
+        return;
+    }
+    for (int i = 0; i < CACHE_SIZE; i++) {
+        free((void*)cache->entries[i].key);
+        free((void*)cache->entries[i].values);
+        free((void*)cache->entries[i].expr);
+    }
+    free((void*)cache);
+}
+
+/* Sets the compiled expression cache used by a context
+ */
+void uq_set_cache(UqContext* context, UqCache* cache)
+{
+    context->cache = cache;
+}
+
+/* Reports how many lookups a compiled expression cache has answered and how
+ * many had to compile
+ */
+void uq_cache_stats(const UqCache* cache, long* hits, long* misses)
+{
+    *hits = cache->hits;
+    *misses = cache->misses;
+}
+
+/* Checks whether a name is already used by a variable, loop variable or array
+ * variable of a context
+ *
+ * UqContext* context: context to search
+ * char* name: name to look for
+ *
+ * Returns 1 if the name is in use otherwise 0
+ */
+static int name_in_use(UqContext* context, char* name)
+{
+    Variables* variables = &(context->variables);
+    Loops* loops = &(context->loops);
+    return name_find(&(variables->index), variables->names, variables->size,
+                   name)
+            != -1
+            || name_find(&(loops->index), loops->names, loops->size, name)
+                    != -1
+            || array_find(variables, name) != -1
+            || base_find(context, name) != -1;
+}
+
+/* Defines a variable from a string of the form name=value. A duplicated name
+ * is reported without the variable being added
+ */
+int uq_define(UqContext* context, const char* definition)
+{
+    int countEquals = 0;
+    for (int m = 0; m < (int)strlen(definition); m++) {
+        if (definition[m] == '=') {
+            countEquals++;
+        }
+    }
+    if (countEquals != 1) {
+        return UQ_INVALID_VARIABLES_ERROR;
+    }
+    char* copy = strdup(definition);
+    char* savePointer;
+    char* key = strtok_r(copy, "=", &savePointer);
+    char* valueString = strtok_r(NULL, "=", &savePointer);
+    int duplicated = (key != NULL) && name_in_use(context, key);
+    int result = extend_variables(
+            &(context->variables), key, valueString, &duplicated);
+    if (result == 0 && duplicated) {
+        context->variables.size--;
+        context->variables.nameBytes -= strlen(key) + 1;
+        free((void*)context->variables.names[context->variables.size]);
+        name_index_reset(&(context->variables.index));
+        result = UQ_DUPLICATE_VARIABLES_ERROR;
+    }
+    free((void*)copy);
+    memory_sync(context);
+    return result;
+}
+
+/* Defines a loop variable from a string of the form name,start,increment,end.
+ * A duplicated name is reported without the loop variable being added
+ */
+int uq_loopable(UqContext* context, const char* definition)
+{
+    int countCommas = 0;
+    for (int m = 0; m < (int)strlen(definition); m++) {
+        if (definition[m] == ',') {
+            countCommas++;
+        }
+    }
+    if (countCommas != LOOP_COMMAS) {
+        return UQ_INVALID_VARIABLES_ERROR;
+    }
+    char* copy = strdup(definition);
+    char* savePointer;
+    char* name = strtok_r(copy, ",", &savePointer);
+    char* startingValueString = strtok_r(NULL, ",", &savePointer);
+    char* incrementString = strtok_r(NULL, ",", &savePointer);
+    char* endValueString = strtok_r(NULL, ",", &savePointer);
+    int duplicated = (name != NULL) && name_in_use(context, name);
+    int result = extend_loops(&(context->loops), &(context->variables), name,
+            startingValueString, incrementString, endValueString,
+            &duplicated);
+    if (result == 0 && duplicated) {
+        context->loops.size--;
+        context->loops.nameBytes -= strlen(name) + 1;
+        free((void*)context->loops.names[context->loops.size]);
+        name_index_reset(&(context->loops.index));
+        result = UQ_DUPLICATE_VARIABLES_ERROR;
+    }
+    free((void*)copy);
+    memory_sync(context);
+    return result;
+}
+
+/* Frees the tables uq_save() gathers a snapshot in
+ *
+ * te_variable* tevars: bindings of the scalar variables
+ * double* values: values of the scalar variables
+ * const char** names: name of every symbol
+ * uint64_t* nameOffsets: offset of every name in the image
+ * SnapshotArray* arrays: offset and length of every array
+ */
+static void snapshot_free(te_variable* tevars, double* values,
+        const char** names, uint64_t* nameOffsets, SnapshotArray* arrays)
+{
+    free((void*)tevars);
+    free((void*)values);
+    free((void*)names);
+    free((void*)nameOffsets);
+    free((void*)arrays);
+}
+
+/* Writes a snapshot image of the visible variables, loop variables, arrays and
+ * significant figures of a context. Compiled expressions are not saved since
+ * tinyexpr trees hold the addresses of functions and variables
+ */
+int uq_save(UqContext* context, const char* path)
+{
+    Variables* variables = &(context->variables);
+    Loops* loops = &(context->loops);
+    int capacity = scalar_capacity(context) + loops->size
+            + variables->arraySize + 1;
+    te_variable* tevars
+            = (te_variable*)malloc(capacity * sizeof(te_variable));
+    double* values = (double*)malloc(capacity * sizeof(double));
+    const char** names = (const char**)malloc(capacity * sizeof(char*));
+    uint64_t* nameOffsets = (uint64_t*)malloc(capacity * sizeof(uint64_t));
+    SnapshotArray* arrays = (SnapshotArray*)malloc(
+            (variables->arraySize + 1) * sizeof(SnapshotArray));
+    if (tevars == NULL || values == NULL || names == NULL
+            || nameOffsets == NULL || arrays == NULL) {
+        snapshot_free(tevars, values, names, nameOffsets, arrays);
+        return UQ_SNAPSHOT_ERROR;
+    }
+    int numberVariables = bind_scalars(context, tevars, values);
+    int numberSymbols = numberVariables + loops->size + variables->arraySize;
+    for (int i = 0; i < numberVariables; i++) {
+        names[i] = tevars[i].name;
+    }
+    for (int i = 0; i < loops->size; i++) {
+        names[numberVariables + i] = loops->names[i];
+    }
+    for (int i = 0; i < variables->arraySize; i++) {
+        names[numberVariables + loops->size + i] = variables->arrayNames[i];
+    }
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_LENGTH);
+    header.version = SNAPSHOT_VERSION;
+    header.byteOrder = SNAPSHOT_BYTE_ORDER;
+    header.sigFigs = context->sigFigs;
+    header.numberVariables = numberVariables;
+    header.numberLoops = loops->size;
+    header.numberArrays = variables->arraySize;
+    uint64_t offset = sizeof(header);
+    header.valuesOffset = offset;
+    offset += (numberVariables + SNAPSHOT_LOOP_FIELDS * loops->size)
+            * sizeof(double);
+    header.arraysOffset = offset;
+    offset += variables->arraySize * sizeof(SnapshotArray);
+    for (int k = 0; k < variables->arraySize; k++) {
+        arrays[k].offset = offset;
+        arrays[k].length = variables->arrayLengths[k];
+        offset += arrays[k].length * sizeof(double);
+    }
+    header.namesOffset = offset;
+    offset += numberSymbols * sizeof(uint64_t);
+    for (int i = 0; i < numberSymbols; i++) {
+        nameOffsets[i] = offset;
+        offset += strlen(names[i]) + 1;
+    }
+    header.size = offset;
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        snapshot_free(tevars, values, names, nameOffsets, arrays);
+        return UQ_SNAPSHOT_ERROR;
+    }
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(values, sizeof(double), numberVariables, file);
+    fwrite(loops->currentValue, sizeof(double), loops->size, file);
+    fwrite(loops->startingValue, sizeof(double), loops->size, file);
+    fwrite(loops->increment, sizeof(double), loops->size, file);
+    fwrite(loops->endValue, sizeof(double), loops->size, file);
+    fwrite(arrays, sizeof(SnapshotArray), variables->arraySize, file);
+    for (int k = 0; k < variables->arraySize; k++) {
+        fwrite(variables->arrayValues[k], sizeof(double),
+                variables->arrayLengths[k], file);
+    }
+    fwrite(nameOffsets, sizeof(uint64_t), numberSymbols, file);
+    for (int i = 0; i < numberSymbols; i++) {
+        fwrite(names[i], 1, strlen(names[i]) + 1, file);
+    }
+    int failed = ferror(file);
+    if (fclose(file) != 0) {
+        failed = 1;
+    }
+    snapshot_free(tevars, values, names, nameOffsets, arrays);
+    return failed ? UQ_SNAPSHOT_ERROR : 0;
+}
+
+/* Checks that a mapped snapshot image is complete and that none of its names
+ * are already in use by a context
+ *
+ * UqContext* context: context the image will be loaded into
+ * const char* image: the mapped image
+ * size_t size: size of the mapping in bytes
+ *
+ * Returns 0 if the image can be loaded, UQ_SNAPSHOT_ERROR if it is not a valid
+ * image or UQ_DUPLICATE_VARIABLES_ERROR if one of its names is in use
+ */
+static int snapshot_check(UqContext* context, const char* image, size_t size)
+{
+    const SnapshotHeader* header = (const SnapshotHeader*)image;
+    if (size < sizeof(SnapshotHeader)
+            || memcmp(header->magic, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_LENGTH)
+            || header->version != SNAPSHOT_VERSION
+            || header->byteOrder != SNAPSHOT_BYTE_ORDER
+            || header->size != size || header->sigFigs < 1
+            || header->sigFigs > MAX_SIG_FIGS
+            || header->valuesOffset % sizeof(double)
+            || header->arraysOffset % sizeof(double)
+            || header->namesOffset % sizeof(double)
+            || header->valuesOffset > size || header->arraysOffset > size
+            || header->namesOffset > size) {
+        return UQ_SNAPSHOT_ERROR;
+    }
+    uint64_t numberSymbols = (uint64_t)header->numberVariables
+            + header->numberLoops + header->numberArrays;
+    if ((size - header->valuesOffset) / sizeof(double)
+                    < header->numberVariables
+                            + (uint64_t)SNAPSHOT_LOOP_FIELDS
+                                    * header->numberLoops
+            || (size - header->arraysOffset) / sizeof(SnapshotArray)
+                    < header->numberArrays
+            || (size - header->namesOffset) / sizeof(uint64_t)
+                    < numberSymbols) {
+        return UQ_SNAPSHOT_ERROR;
+    }
+    const SnapshotArray* arrays
+            = (const SnapshotArray*)(image + header->arraysOffset);
+    for (uint32_t k = 0; k < header->numberArrays; k++) {
+        if (arrays[k].offset % sizeof(double) || arrays[k].offset > size
+                || (size - arrays[k].offset) / sizeof(double)
+                        < arrays[k].length
+                || arrays[k].length > INT32_MAX) {
+            return UQ_SNAPSHOT_ERROR;
+        }
+    }
+    const uint64_t* nameOffsets
+            = (const uint64_t*)(image + header->namesOffset);
+    for (uint64_t i = 0; i < numberSymbols; i++) {
+        if (nameOffsets[i] >= size) {
+            return UQ_SNAPSHOT_ERROR;
+        }
+        const char* name = image + nameOffsets[i];
+        const char* end = memchr(name, '\0', size - nameOffsets[i]);
+        if (end == NULL || end == name || end - name > MAX_VARIABLE_LENGTH) {
+            return UQ_SNAPSHOT_ERROR;
+        }
+    }
+    for (uint64_t i = 0; i < numberSymbols; i++) {
+        if (name_in_use(context, (char*)(image + nameOffsets[i]))) {
+            return UQ_DUPLICATE_VARIABLES_ERROR;
+        }
+    }
+    return 0;
+}
+
+/* Adds the variables, loop variables and arrays of a checked snapshot image to
+ * a context and applies its significant figures. Values are copied from the
+ * image a section at a time
+ *
+ * UqContext* context: context to add to
+ * const char* image: the mapped image
+ *
+ * Returns 0
+ */
+static int snapshot_load(UqContext* context, const char* image)
+{
+    Variables* variables = &(context->variables);
+    Loops* loops = &(context->loops);
+    const SnapshotHeader* header = (const SnapshotHeader*)image;
+    const double* values = (const double*)(image + header->valuesOffset);
+    const SnapshotArray* arrays
+            = (const SnapshotArray*)(image + header->arraysOffset);
+    const uint64_t* nameOffsets
+            = (const uint64_t*)(image + header->namesOffset);
+    int numberVariables = header->numberVariables;
+    int numberLoops = header->numberLoops;
+    int numberArrays = header->numberArrays;
+    context->sigFigs = header->sigFigs;
+    variables->names = (char**)realloc((void*)variables->names,
+            (variables->size + numberVariables + 1) * sizeof(char*));
+    variables->values = (double*)realloc((void*)variables->values,
+            (variables->size + numberVariables + 1) * sizeof(double));
+    memcpy(variables->values + variables->size, values,
+            numberVariables * sizeof(double));
+    for (int i = 0; i < numberVariables; i++) {
+        variables->names[variables->size + i]
+                = strdup(image + nameOffsets[i]);
+        variables->nameBytes += strlen(image + nameOffsets[i]) + 1;
+    }
+    variables->size += numberVariables;
+    values += numberVariables;
+    nameOffsets += numberVariables;
+    int size = loops->size + numberLoops + 1;
+    loops->names = (char**)realloc((void*)loops->names, size * sizeof(char*));
+    loops->currentValue = (double*)realloc(
+            (void*)loops->currentValue, size * sizeof(double));
+    loops->startingValue = (double*)realloc(
+            (void*)loops->startingValue, size * sizeof(double));
+    loops->increment
+            = (double*)realloc((void*)loops->increment, size * sizeof(double));
+    loops->endValue
+            = (double*)realloc((void*)loops->endValue, size * sizeof(double));
+    memcpy(loops->currentValue + loops->size, values,
+            numberLoops * sizeof(double));
+    memcpy(loops->startingValue + loops->size, values + numberLoops,
+            numberLoops * sizeof(double));
+    memcpy(loops->increment + loops->size, values + 2 * numberLoops,
+            numberLoops * sizeof(double));
+    memcpy(loops->endValue + loops->size, values + THIRD_INDEX * numberLoops,
+            numberLoops * sizeof(double));
+    for (int i = 0; i < numberLoops; i++) {
+        loops->names[loops->size + i] = strdup(image + nameOffsets[i]);
+        loops->nameBytes += strlen(image + nameOffsets[i]) + 1;
+    }
+    loops->size += numberLoops;
+    nameOffsets += numberLoops;
+    size = variables->arraySize + numberArrays + 1;
+    variables->arrayNames = (char**)realloc(
+            (void*)variables->arrayNames, size * sizeof(char*));
+    variables->arrayValues = (double**)realloc(
+            (void*)variables->arrayValues, size * sizeof(double*));
+    variables->arrayLengths = (int*)realloc(
+            (void*)variables->arrayLengths, size * sizeof(int));
+    for (int k = 0; k < numberArrays; k++) {
+        int length = arrays[k].length;
+        int j = variables->arraySize + k;
+        variables->arrayNames[j] = strdup(image + nameOffsets[k]);
+        variables->nameBytes += strlen(image + nameOffsets[k]) + 1;
+        variables->arrayLengths[j] = length;
+        variables->elements += length;
+        variables->arrayValues[j] = vector_allocate(length);
+        memcpy(variables->arrayValues[j], image + arrays[k].offset,
+                length * sizeof(double));
+    }
+    variables->arraySize += numberArrays;
+    memory_sync(context);
+    return 0;
+}
+
+/* Adds the contents of a snapshot image written by uq_save() to a context.
+ * The image is mapped rather than read and is only checked, not parsed
+ */
+int uq_restore(UqContext* context, const char* path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return UQ_SNAPSHOT_ERROR;
+    }
+    struct stat information;
+    if (fstat(fd, &information) == -1
+            || (size_t)information.st_size < sizeof(SnapshotHeader)) {
+        close(fd);
+        return UQ_SNAPSHOT_ERROR;
+    }
+    size_t size = information.st_size;
+    void* image = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED) {
+        return UQ_SNAPSHOT_ERROR;
+    }
+    base_refresh(context);
+    int result = snapshot_check(context, (const char*)image, size);
+    if (result == 0) {
+        snapshot_load(context, (const char*)image);
+    }
+    munmap(image, size);
+    return result;
+}
+
+/* Detects and processes a @save command on given line, writing a snapshot of
+ * the context to the named file
+ *
+ * UqContext* context: context to save
+ * char* line: the String containing the command to process
+ *
+ * Return 1 if a @save command was found otherwise 0
+ */
+static int detect_save(UqContext* context, char* line)
+{
+    if (strncmp(line, "@save ", SAVE_LENGTH)) {
+        return 0;
+    }
+    char* savePointer;
+    char* testString = strdup(line + SAVE_LENGTH);
+    char* path = strtok_r(testString, " \t\r\n", &savePointer);
+    if (path == NULL || strtok_r(NULL, " \t\r\n", &savePointer) != NULL
+            || uq_save(context, path) != 0) {
+        command_error(context);
+    }
+    free(testString);
+    return 1;
+}
+
+/* Executes one line of the uqexpr language. A newline is added to the end of
+ * the line if it does not already have one
+ */
+int uq_execute(UqContext* context, const char* line)
+{
+    base_refresh(context);
+    statement_begin(context);
+    long long spanStart = work_clock(context);
+    int errors = context->errors;
+    int length = strlen(line);
+    STATS_ADD(context, linesRead, 1);
+    STATS_ADD(context, bytesRead, length);
+    char* copy = (char*)malloc(length + 2);
+    strcpy(copy, line);
+    if (length == 0 || copy[length - 1] != '\n') {
+        strcpy(copy + length, "\n");
+    }
+    int numberEquals = 0;
+    long long lexStart = work_clock(context);
+    int commented = download_setup(copy, &numberEquals);
+    trace_span(context, "lex", lexStart);
+    if (commented == 0 && detect_range_print(context, copy) == 0
+            && detect_loops(context, copy) == 0
+            && detect_solve(context, copy) == 0
+            && detect_montecarlo(context, copy) == 0
+            && detect_array(context, copy) == 0
+            && detect_save(context, copy) == 0) {
+        if (numberEquals == 1) {
+            char* savePointer;
+            char* variableName = strtok_r(copy, "=", &savePointer);
+            char* expression = strtok_r(NULL, "=", &savePointer);
+            int start = 0;
+            int end = strlen(variableName) - 1;
+            while (isspace((unsigned char)variableName[start]) && start < end) {
+                start++;
+            }
+            while (isspace((unsigned char)variableName[end]) && end > start) {
+                end--;
+            }
+            memmove(variableName, variableName + start, end - start + 1);
+            variableName[end - start + 1] = '\0';
+            if (download_assignment_check_valid(variableName)) {
+                command_error(context);
+            } else {
+                download_assignment(context, expression, variableName);
+            }
+        } else if (numberEquals == 0) {
+            download_expression(context, copy);
+        }
+    }
+    statement_interrupted(context);
+    free((void*)copy);
+    uq_flush(context);
+    memory_sync(context);
+    trace_span(context, "statement", spanStart);
+    return (context->errors != errors) ? UQ_STATEMENT_ERROR : 0;
+}
+
+/* Writes the variables and loop variables of a context as @print does, without
+ * counting a line read
+ */
+int uq_print(UqContext* context)
+{
+    base_refresh(context);
+    int result = 0;
+    if (print_variables(context)) {
+        command_error(context);
+        result = UQ_STATEMENT_ERROR;
+    }
+    uq_flush(context);
+    memory_sync(context);
+    return result;
+}
+
+/* Compiles and evaluates a scalar expression against the variables of a
+ * context without producing any output
+ *
+ * UqContext* context: context holding the variables, loops and arrays
+ * const char* expression: expression to evaluate
+ * double* result: pointer to where the value will be stored
+ *
+ * Returns 0 or UQ_INVALID_EXPRESSION_ERROR if the expression is invalid or
+ * references array variables
+ */
+static int evaluate_quietly(
+        UqContext* context, const char* expression, double* result)
+{
+    Bindings bindings;
+    bind_referenced(context, expression, 1, &bindings);
+    int cached;
+    te_expr* expr = compile_bound(context, expression, &bindings, &cached);
+    if (!expr) {
+        bindings_free(&bindings);
+        return UQ_INVALID_EXPRESSION_ERROR;
+    }
+    double* elements;
+    int length;
+    long long start = work_clock(context);
+    int arrayResult
+            = array_evaluate(context, expr, &bindings, &elements, &length);
+    if (arrayResult == 0) {
+        free((void*)elements);
+    }
+    if (arrayResult != 1) {
+        bindings_free(&bindings);
+        compile_release(context, expr, cached);
+        return UQ_INVALID_EXPRESSION_ERROR;
+    }
+    crosscheck_begin(context, expression, &bindings, expr);
+    *result = engine_eval(context, expr);
+    bindings_free(&bindings);
+    STATS_ADD(context, evaluations, 1);
+    trace_span(context, "evaluate", start);
+    compile_release(context, expr, cached);
+    crosscheck_row(context, *result);
+    crosscheck_end(context);
+    return 0;
+}
+
+/* Evaluates a scalar expression without producing any output
+ */
+int uq_eval(UqContext* context, const char* expression, double* result)
+{
+    base_refresh(context);
+    return evaluate_quietly(context, expression, result);
+}
+
+/* Evaluates a scalar expression and assigns it without producing any output.
+ * Assigning to an array variable sets every element
+ */
+int uq_assign(UqContext* context, const char* name, const char* expression,
+        double* result)
+{
+    Variables* variables = &(context->variables);
+    Loops* loops = &(context->loops);
+    base_refresh(context);
+    char* variableName = strdup(name);
+    if (download_assignment_check_valid(variableName)) {
+        free((void*)variableName);
+        return UQ_INVALID_VARIABLES_ERROR;
+    }
+    double value;
+    if (evaluate_quietly(context, expression, &value)) {
+        free((void*)variableName);
+        return UQ_INVALID_EXPRESSION_ERROR;
+    }
+    int variableIndex = -1;
+    int loopIndex = -1;
+    int k = array_find(variables, variableName);
+    if (k != -1) {
+        for (int i = 0; i < variables->arrayLengths[k]; i++) {
+            variables->arrayValues[k][i] = value;
+        }
+    } else {
+        loop_assignment_setup(
+                context, variableName, &variableIndex, &loopIndex);
+        if (variableIndex == -1) {
+            loops->currentValue[loopIndex] = value;
+        } else {
+            variables->values[variableIndex] = value;
+        }
+    }
+    if (result != NULL) {
+        *result = value;
+    }
+    free((void*)variableName);
+    memory_sync(context);
+    return 0;
+}
+
+/* Runs a statement for every value of a loop variable, as @loop does
+ */
+int uq_loop(UqContext* context, const char* loopName, const char* statement)
+{
+    int length = strlen("@loop ") + strlen(loopName) + strlen(statement) + 2;
+    char* line = (char*)malloc(length + 1);
+    snprintf(line, length + 1, "@loop %s %s\n", loopName, statement);
+    int result = uq_execute(context, line);
+    free((void*)line);
+    return result;
+}
+
+/* Recovers the function pointers a compiled script may call by compiling each
+ * of scriptProbes
+ *
+ * const void** functions: array of SCRIPT_FUNCTIONS entries to fill in, NULL
+ * for an expression that does not compile to a function
+ * int* arities: array of SCRIPT_FUNCTIONS entries to fill in with the number
+ * of arguments of each function
+ *
+ * Returns 0
+ */
+static int script_functions(const void** functions, int* arities)
+{
+    double x = 0, y = 0;
+    te_variable tevars[] = {
+            {.name = "x", .address = &x, .type = TE_VARIABLE, .context = NULL},
+            {.name = "y", .address = &y, .type = TE_VARIABLE, .context = NULL}};
+    for (int i = 0; i < SCRIPT_FUNCTIONS; i++) {
+        int errPos;
+        te_expr* expr = te_compile(scriptProbes[i], tevars, 2, &errPos);
+        functions[i] = NULL;
+        arities[i] = 0;
+        int type = expr ? (expr->type & TE_TYPE_MASK) : 0;
+        if ((type & TE_FUNCTION0) && !(type & TE_CLOSURE0)) {
+            functions[i] = expr->function;
+            arities[i] = type & TE_ARITY_MASK;
+        }
+        te_free(expr);
+    }
+    return 0;
+}
+
+/* Computes the FNV-1a hash of the contents of a file
+ *
+ * const char* path: file to hash
+ * unsigned long long* hash: pointer to where the hash will be stored
+ *
+ * Returns 0 or 1 if the file cannot be read
+ */
+static int script_hash_file(const char* path, unsigned long long* hash)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        return 1;
+    }
+    char buffer[OUTPUT_BUFFER_SIZE];
+    size_t length;
+    *hash = FNV_OFFSET;
+    while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        *hash = hash_bytes(buffer, length, *hash);
+    }
+    int failed = ferror(file);
+    fclose(file);
+    return failed;
+}
+
+/* Finds the symbol for a name in a script being built, adding it if needed
+ *
+ * ScriptBuilder* builder: script being built
+ * const char* name: name of the symbol
+ * int builtin: 1 if the name is a tinyexpr builtin otherwise 0
+ *
+ * Returns the index of the symbol
+ */
+static int script_symbol(ScriptBuilder* builder, const char* name, int builtin)
+{
+    unsigned long long hash = hash_bytes(name, strlen(name), FNV_OFFSET);
+    int slot = hash & (builder->indexSize - 1);
+    while (builder->index[slot] != -1) {
+        if (!strcmp(builder->names[builder->index[slot]], name)) {
+            return builder->index[slot];
+        }
+        slot = (slot + 1) & (builder->indexSize - 1);
+    }
+    int symbol = builder->numberSymbols;
+    builder->numberSymbols++;
+    builder->names = (char**)realloc(
+            (void*)builder->names, builder->numberSymbols * sizeof(char*));
+    builder->builtins = (uint32_t*)realloc((void*)builder->builtins,
+            builder->numberSymbols * sizeof(uint32_t));
+    builder->names[symbol] = strdup(name);
+    builder->builtins[symbol] = builtin;
+    builder->index[slot] = symbol;
+    if (2 * builder->numberSymbols > builder->indexSize) {
+        builder->indexSize *= 2;
+        builder->index = (int*)realloc(
+                (void*)builder->index, builder->indexSize * sizeof(int));
+        for (int i = 0; i < builder->indexSize; i++) {
+            builder->index[i] = -1;
+        }
+        for (int i = 0; i < builder->numberSymbols; i++) {
+            hash = hash_bytes(
+                    builder->names[i], strlen(builder->names[i]), FNV_OFFSET);
+            slot = hash & (builder->indexSize - 1);
+            while (builder->index[slot] != -1) {
+                slot = (slot + 1) & (builder->indexSize - 1);
+            }
+            builder->index[slot] = i;
+        }
+    }
+    return symbol;
+}
+
+/* Appends the instruction for a tinyexpr node to a script being built. It is
+ * called by expression_walk(), which visits children first, so the
+ * instructions come out in postfix order
+ *
+ * const te_expr* n: node to flatten, whose children have been flattened
+ * void* data: the ScriptEmitter
+ *
+ * Returns 0 if successful or 1 if the node cannot be compiled
+ */
+static int script_emit(const te_expr* n, void* data)
+{
+    ScriptEmitter* emitter = (ScriptEmitter*)data;
+    ScriptBuilder* builder = emitter->builder;
+    ScriptInstruction instruction = {
+            .opcode = SCRIPT_CONSTANT, .operand = 0, .value = 0};
+    int type = n->type & TE_TYPE_MASK;
+    if (type == TE_CONSTANT_TYPE) {
+        instruction.value = n->value;
+        emitter->depth++;
+    } else if (type == TE_VARIABLE) {
+        instruction.opcode = SCRIPT_SYMBOL;
+        int k = 0;
+        while (k < emitter->numberSlots && n->bound != &(emitter->slots[k])) {
+            k++;
+        }
+        if (k == emitter->numberSlots) {
+            return 1;
+        }
+        instruction.operand = emitter->symbols[k];
+        emitter->depth++;
+    } else if ((type & TE_FUNCTION0) && !(type & TE_CLOSURE0)) {
+        int arity = type & TE_ARITY_MASK;
+        int j = 0;
+        while (j < SCRIPT_FUNCTIONS && emitter->functions[j] != n->function) {
+            j++;
+        }
+        if (j == SCRIPT_FUNCTIONS || arity == 0) {
+            return 1;
+        }
+        instruction.opcode = SCRIPT_CALL;
+        instruction.operand = j;
+        emitter->depth -= arity - 1;
+    } else {
+        return 1;
+    }
+    if (emitter->depth > emitter->maximum) {
+        emitter->maximum = emitter->depth;
+    }
+    builder->numberInstructions++;
+    builder->instructions = (ScriptInstruction*)realloc(
+            (void*)builder->instructions,
+            builder->numberInstructions * sizeof(ScriptInstruction));
+    builder->instructions[builder->numberInstructions - 1] = instruction;
+    return 0;
+}
+
+/* Compiles an expression into instructions and symbol references. Every name
+ * in the expression other than a builtin is bound as a variable, using the
+ * same tokenising rules as tinyexpr
+ *
+ * ScriptBuilder* builder: script being built
+ * const char* expression: expression to compile
+ * ScriptStatement* statement: statement whose instructions and references are
+ * filled in
+ * const void** functions: functions found by script_functions()
+ *
+ * Returns 0 if successful or 1 if the expression cannot be compiled
+ */
+static int script_compile_expression(ScriptBuilder* builder,
+        const char* expression, ScriptStatement* statement,
+        const void** functions)
+{
+    int length = strlen(expression);
+    char** names = (char**)malloc((length + 1) * sizeof(char*));
+    int numberNames = 0;
+    int i = 0;
+    while (i < length) {
+        char c = expression[i];
+        if ((c >= '0' && c <= '9') || c == '.') {
+            char* end;
+            strtod(expression + i, &end);
+            i = (end > expression + i) ? end - expression : i + 1;
+        } else if (c >= 'a' && c <= 'z') {
+            int start = i;
+            while (i < length
+                    && ((expression[i] >= 'a' && expression[i] <= 'z')
+                            || (expression[i] >= '0' && expression[i] <= '9')
+                            || expression[i] == '_')) {
+                i++;
+            }
+            char* name = strndup(expression + start, i - start);
+            int k = 0;
+            while (k < numberNames && strcmp(names[k], name)) {
+                k++;
+            }
+            if (k < numberNames) {
+                free((void*)name);
+            } else {
+                names[numberNames] = name;
+                numberNames++;
+            }
+        } else {
+            i++;
+        }
+    }
+    te_variable* tevars
+            = (te_variable*)malloc((numberNames + 1) * sizeof(te_variable));
+    double* slots = (double*)malloc((numberNames + 1) * sizeof(double));
+    int* symbols = (int*)malloc((numberNames + 1) * sizeof(int));
+    int bound = 0;
+    for (int k = 0; k < numberNames; k++) {
+        int builtin = 0;
+        for (int j = 0; j < SCRIPT_BUILTINS; j++) {
+            if (!strcmp(names[k], scriptBuiltins[j])) {
+                builtin = 1;
+            }
+        }
+        slots[k] = 0;
+        symbols[k] = script_symbol(builder, names[k], builtin);
+        if (!builtin) {
+            te_variable var = {.name = names[k],
+                    .address = &(slots[k]),
+                    .type = TE_VARIABLE,
+                    .context = NULL};
+            tevars[bound] = var;
+            bound++;
+        }
+    }
+    size_t bytes;
+    te_expr* expr = expression_parse(
+            builder->context, expression, tevars, bound, &bytes);
+    ScriptEmitter emitter = {.builder = builder,
+            .slots = slots,
+            .symbols = symbols,
+            .numberSlots = numberNames,
+            .functions = functions,
+            .depth = 0,
+            .maximum = 0};
+    statement->firstInstruction = builder->numberInstructions;
+    int failed
+            = expr == NULL || expression_walk(expr, script_emit, &emitter);
+    free((void*)expr);
+    for (int k = 0; k < numberNames; k++) {
+        free((void*)names[k]);
+    }
+    free((void*)names);
+    free((void*)tevars);
+    free((void*)slots);
+    if (failed) {
+        free((void*)symbols);
+        builder->numberInstructions = statement->firstInstruction;
+        return 1;
+    }
+    statement->numberInstructions
+            = builder->numberInstructions - statement->firstInstruction;
+    statement->depth = emitter.maximum;
+    statement->firstReference = builder->numberReferences;
+    statement->numberReferences = numberNames;
+    builder->numberReferences += numberNames;
+    builder->references = (uint32_t*)realloc((void*)builder->references,
+            builder->numberReferences * sizeof(uint32_t));
+    for (int k = 0; k < numberNames; k++) {
+        builder->references[statement->firstReference + k] = symbols[k];
+    }
+    free((void*)symbols);
+    return 0;
+}
+
+/* Compiles a @loop command into a statement, splitting it the same way loop()
+ * does
+ *
+ * ScriptBuilder* builder: script being built
+ * char* line: the command, modified in place
+ * ScriptStatement* statement: statement to fill in
+ * const void** functions: functions found by script_functions()
+ *
+ * Returns 0 if successful or 1 if the command is kept as text
+ */
+static int script_compile_loop(ScriptBuilder* builder, char* line,
+        ScriptStatement* statement, const void** functions)
+{
+    char* savePointer;
+    strtok_r(line, " ", &savePointer);
+    char* loopName = strtok_r(NULL, " ", &savePointer);
+    char* expression = strtok_r(NULL, "", &savePointer);
+    LoopClauses clauses;
+    if (loopName == NULL || expression == NULL
+            || loop_clauses(expression, &clauses)
+            || clauses.predicate != NULL || clauses.every != 1) {
+        return 1;
+    }
+    int numberEquals = 0;
+    for (int i = 0; i < (int)strlen(expression); i++) {
+        if (expression[i] == '=') {
+            numberEquals++;
+        }
+    }
+    char* target = NULL;
+    if (numberEquals == 1) {
+        target = strtok_r(expression, "=", &savePointer);
+        expression = strtok_r(NULL, "", &savePointer);
+        target = (target != NULL) ? strtok_r(target, " ", &savePointer) : NULL;
+        if (target == NULL || expression == NULL || !strcmp(target, " ")) {
+            return 1;
+        }
+    } else if (numberEquals != 0) {
+        return 1;
+    }
+    if (script_compile_expression(builder, expression, statement, functions)) {
+        return 1;
+    }
+    statement->kind = SCRIPT_LOOP_EXPRESSION;
+    statement->loop = script_symbol(builder, loopName, 0);
+    if (target != NULL) {
+        statement->kind = SCRIPT_LOOP_ASSIGNMENT;
+        statement->target = script_symbol(builder, target, 0);
+    }
+    return 0;
+}
+
+/* Compiles one line of a script into a statement. Lines are classified the
+ * same way uq_execute() classifies them; anything other than a plain
+ * expression, an assignment of a valid name or a @loop is kept as text
+ *
+ * ScriptBuilder* builder: script being built
+ * const char* line: the line, as read by download_file()
+ * const void** functions: functions found by script_functions()
+ *
+ * Returns 0
+ */
+static int script_compile_line(
+        ScriptBuilder* builder, const char* line, const void** functions)
+{
+    ScriptStatement statement;
+    memset(&statement, 0, sizeof(statement));
+    statement.kind = SCRIPT_TEXT;
+    statement.text = builder->numberStatements;
+    int length = strlen(line);
+    char* copy = (char*)malloc(length + 2);
+    strcpy(copy, line);
+    if (length == 0 || copy[length - 1] != '\n') {
+        strcpy(copy + length, "\n");
+    }
+    int numberEquals = 0;
+    int commented = download_setup(copy, &numberEquals);
+    if (!commented && (int)strlen(copy) > LOOP_LENGTH
+            && !strncmp(copy, "@loop ", LOOP_LENGTH)
+            && isalpha((unsigned char)copy[LOOP_LENGTH])) {
+        script_compile_loop(builder, copy, &statement, functions);
+    } else if (!commented && strchr(copy, '@') == NULL && numberEquals <= 1) {
+        char* expression = copy;
+        char* variableName = NULL;
+        if (numberEquals == 1) {
+            char* savePointer;
+            variableName = strtok_r(copy, "=", &savePointer);
+            expression = strtok_r(NULL, "=", &savePointer);
+            int start = 0;
+            int end = strlen(variableName) - 1;
+            while (isspace((unsigned char)variableName[start]) && start < end) {
+                start++;
+            }
+            while (isspace((unsigned char)variableName[end]) && end > start) {
+                end--;
+            }
+            memmove(variableName, variableName + start, end - start + 1);
+            variableName[end - start + 1] = '\0';
+        }
+        if ((variableName == NULL
+                    || (!download_assignment_check_valid(variableName)
+                            && expression != NULL))
+                && !script_compile_expression(
+                        builder, expression, &statement, functions)) {
+            statement.kind = SCRIPT_EXPRESSION;
+            if (variableName != NULL) {
+                statement.kind = SCRIPT_ASSIGNMENT;
+                statement.target = script_symbol(builder, variableName, 0);
+            }
+        }
+    }
+    free((void*)copy);
+    builder->numberStatements++;
+    builder->statements = (ScriptStatement*)realloc(
+            (void*)builder->statements,
+            builder->numberStatements * sizeof(ScriptStatement));
+    builder->statements[builder->numberStatements - 1] = statement;
+    builder->texts = (char**)realloc(
+            (void*)builder->texts, builder->numberStatements * sizeof(char*));
+    builder->texts[builder->numberStatements - 1] = strdup(line);
+    return 0;
+}
+
+/* Writes a compiled script image
+ *
+ * const ScriptBuilder* builder: compiled script
+ * unsigned long long hash: hash of the source
+ * const char* source: absolute path of the source
+ * const char* imagePath: file to write
+ *
+ * Returns 0 or UQ_SCRIPT_ERROR if the file cannot be written
+ */
+static int script_write(const ScriptBuilder* builder, unsigned long long hash,
+        const char* source, const char* imagePath)
+{
+    ScriptHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SCRIPT_MAGIC, SCRIPT_MAGIC_LENGTH);
+    header.version = SCRIPT_VERSION;
+    header.byteOrder = SNAPSHOT_BYTE_ORDER;
+    header.hash = hash;
+    header.numberStatements = builder->numberStatements;
+    header.numberInstructions = builder->numberInstructions;
+    header.numberReferences = builder->numberReferences;
+    header.numberSymbols = builder->numberSymbols;
+    header.numberFunctions = SCRIPT_FUNCTIONS;
+    uint64_t offset = sizeof(header);
+    header.statementsOffset = offset;
+    offset += builder->numberStatements * sizeof(ScriptStatement);
+    header.instructionsOffset = offset;
+    offset += builder->numberInstructions * sizeof(ScriptInstruction);
+    header.symbolsOffset = offset;
+    offset += builder->numberSymbols * sizeof(ScriptSymbol);
+    header.referencesOffset = offset;
+    offset += builder->numberReferences * sizeof(uint32_t);
+    FILE* file = fopen(imagePath, "wb");
+    if (file == NULL) {
+        return UQ_SCRIPT_ERROR;
+    }
+    uint64_t textOffset = offset;
+    for (int i = 0; i < builder->numberStatements; i++) {
+        textOffset += strlen(builder->texts[i]) + 1;
+    }
+    header.sourceOffset = textOffset;
+    textOffset += strlen(source) + 1;
+    for (int i = 0; i < builder->numberSymbols; i++) {
+        textOffset += strlen(builder->names[i]) + 1;
+    }
+    header.size = textOffset;
+    fwrite(&header, sizeof(header), 1, file);
+    textOffset = offset;
+    for (int i = 0; i < builder->numberStatements; i++) {
+        ScriptStatement statement = builder->statements[i];
+        statement.text = textOffset;
+        textOffset += strlen(builder->texts[i]) + 1;
+        fwrite(&statement, sizeof(statement), 1, file);
+    }
+    fwrite(builder->instructions, sizeof(ScriptInstruction),
+            builder->numberInstructions, file);
+    textOffset += strlen(source) + 1;
+    for (int i = 0; i < builder->numberSymbols; i++) {
+        ScriptSymbol symbol = {.name = textOffset,
+                .builtin = builder->builtins[i],
+                .reserved = 0};
+        textOffset += strlen(builder->names[i]) + 1;
+        fwrite(&symbol, sizeof(symbol), 1, file);
+    }
+    fwrite(builder->references, sizeof(uint32_t), builder->numberReferences,
+            file);
+    for (int i = 0; i < builder->numberStatements; i++) {
+        fwrite(builder->texts[i], 1, strlen(builder->texts[i]) + 1, file);
+    }
+    fwrite(source, 1, strlen(source) + 1, file);
+    for (int i = 0; i < builder->numberSymbols; i++) {
+        fwrite(builder->names[i], 1, strlen(builder->names[i]) + 1, file);
+    }
+    int failed = ferror(file);
+    if (fclose(file) != 0) {
+        failed = 1;
+    }
+    return failed ? UQ_SCRIPT_ERROR : 0;
+}
+
+/* Compiles a script into an image that uq_run_compiled() maps and runs. Each
+ * line is compiled once, with the names it uses resolved to symbol slots
+ */
+int uq_compile_script(const char* sourcePath, const char* imagePath)
+{
+    unsigned long long hash;
+    char* source = realpath(sourcePath, NULL);
+    FILE* file = fopen(sourcePath, "r");
+    if (source == NULL || file == NULL
+            || script_hash_file(sourcePath, &hash)) {
+        free((void*)source);
+        if (file != NULL) {
+            fclose(file);
+        }
+        return UQ_SCRIPT_ERROR;
+    }
+    const void* functions[SCRIPT_FUNCTIONS];
+    int arities[SCRIPT_FUNCTIONS];
+    script_functions(functions, arities);
+    ScriptBuilder builder;
+    memset(&builder, 0, sizeof(builder));
+    builder.indexSize = SCRIPT_INDEX_SIZE;
+    builder.index = (int*)malloc(builder.indexSize * sizeof(int));
+    for (int i = 0; i < builder.indexSize; i++) {
+        builder.index[i] = -1;
+    }
+    builder.context = uq_create();
+    char* line = NULL;
+    size_t lineSize = 0;
+    while (getline(&line, &lineSize, file) >= 0) {
+        script_compile_line(&builder, line, functions);
+    }
+    free((void*)line);
+    fclose(file);
+    uq_destroy(builder.context);
+    int result = script_write(&builder, hash, source, imagePath);
+    for (int i = 0; i < builder.numberSymbols; i++) {
+        free((void*)builder.names[i]);
+    }
+    for (int i = 0; i < builder.numberStatements; i++) {
+        free((void*)builder.texts[i]);
+    }
+    free((void*)builder.statements);
+    free((void*)builder.instructions);
+    free((void*)builder.references);
+    free((void*)builder.names);
+    free((void*)builder.builtins);
+    free((void*)builder.index);
+    free((void*)builder.texts);
+    free((void*)source);
+    return result;
+}
+
+/* Checks that an offset into an image is the start of a nul terminated string
+ * inside the image
+ *
+ * const char* image: the mapped image
+ * size_t size: size of the image
+ * uint64_t offset: offset to check
+ *
+ * Returns 1 if the string is valid otherwise 0
+ */
+static int script_string(const char* image, size_t size, uint64_t offset)
+{
+    return offset < size && memchr(image + offset, '\0', size - offset);
+}
+
+/* Checks that a section of count records of the given size lies inside an
+ * image and is aligned for its fields
+ *
+ * size_t size: size of the image
+ * uint64_t offset: offset of the section
+ * uint64_t count: number of records
+ * size_t record: size of one record
+ *
+ * Returns 1 if the section is valid otherwise 0
+ */
+static int script_section(
+        size_t size, uint64_t offset, uint64_t count, size_t record)
+{
+    return offset % sizeof(uint32_t) == 0 && offset <= size
+            && (size - offset) / record >= count;
+}
+
+/* Checks that a mapped image is a complete compiled script whose instructions
+ * reach exactly the stack depth stored for each statement, which sizes the
+ * stack the statement is run on
+ *
+ * const char* image: the mapped image
+ * size_t size: size of the image
+ * const int* arities: argument counts found by script_functions()
+ *
+ * Returns 0 if the image is valid or UQ_SCRIPT_ERROR
+ */
+static int script_check(const char* image, size_t size, const int* arities)
+{
+    const ScriptHeader* header = (const ScriptHeader*)image;
+    if (size < sizeof(ScriptHeader)
+            || memcmp(header->magic, SCRIPT_MAGIC, SCRIPT_MAGIC_LENGTH)
+            || header->version != SCRIPT_VERSION
+            || header->byteOrder != SNAPSHOT_BYTE_ORDER
+            || header->size != size
+            || header->statementsOffset % sizeof(double)
+            || header->instructionsOffset % sizeof(double)
+            || header->symbolsOffset % sizeof(double)
+            || !script_section(size, header->statementsOffset,
+                    header->numberStatements, sizeof(ScriptStatement))
+            || !script_section(size, header->instructionsOffset,
+                    header->numberInstructions, sizeof(ScriptInstruction))
+            || !script_section(size, header->referencesOffset,
+                    header->numberReferences, sizeof(uint32_t))
+            || !script_section(size, header->symbolsOffset,
+                    header->numberSymbols, sizeof(ScriptSymbol))
+            || !script_string(image, size, header->sourceOffset)) {
+        return UQ_SCRIPT_ERROR;
+    }
+    const ScriptSymbol* symbols
+            = (const ScriptSymbol*)(image + header->symbolsOffset);
+    for (uint32_t i = 0; i < header->numberSymbols; i++) {
+        if (!script_string(image, size, symbols[i].name)) {
+            return UQ_SCRIPT_ERROR;
+        }
+    }
+    const uint32_t* references
+            = (const uint32_t*)(image + header->referencesOffset);
+    for (uint32_t i = 0; i < header->numberReferences; i++) {
+        if (references[i] >= header->numberSymbols) {
+            return UQ_SCRIPT_ERROR;
+        }
+    }
+    const ScriptStatement* statements
+            = (const ScriptStatement*)(image + header->statementsOffset);
+    const ScriptInstruction* instructions
+            = (const ScriptInstruction*)(image + header->instructionsOffset);
+    for (uint32_t i = 0; i < header->numberStatements; i++) {
+        const ScriptStatement* statement = &(statements[i]);
+        if (!script_string(image, size, statement->text)
+                || statement->kind > SCRIPT_LOOP_ASSIGNMENT) {
+            return UQ_SCRIPT_ERROR;
+        }
+        if (statement->kind == SCRIPT_TEXT) {
+            continue;
+        }
+        if (statement->target >= header->numberSymbols
+                || statement->loop >= header->numberSymbols
+                || statement->firstInstruction > header->numberInstructions
+                || header->numberInstructions - statement->firstInstruction
+                        < statement->numberInstructions
+                || statement->firstReference > header->numberReferences
+                || header->numberReferences - statement->firstReference
+                        < statement->numberReferences) {
+            return UQ_SCRIPT_ERROR;
+        }
+        int64_t depth = 0;
+        int64_t deepest = 0;
+        for (uint32_t j = 0; j < statement->numberInstructions; j++) {
+            const ScriptInstruction* instruction
+                    = &(instructions[statement->firstInstruction + j]);
+            if (instruction->opcode == SCRIPT_CONSTANT) {
+                depth++;
+            } else if (instruction->opcode == SCRIPT_SYMBOL
+                    && instruction->operand < header->numberSymbols) {
+                depth++;
+            } else if (instruction->opcode == SCRIPT_CALL
+                    && instruction->operand < SCRIPT_FUNCTIONS
+                    && arities[instruction->operand] > 0
+                    && depth >= arities[instruction->operand]) {
+                depth -= arities[instruction->operand] - 1;
+            } else {
+                return UQ_SCRIPT_ERROR;
+            }
+            if (depth > deepest) {
+                deepest = depth;
+            }
+        }
+        if (depth != 1 || deepest != statement->depth) {
+            return UQ_SCRIPT_ERROR;
+        }
+    }
+    return 0;
+}
+
+/* Maps a compiled script image and checks it
+ *
+ * const char* path: image to map
+ * size_t* size: pointer to where the size of the mapping will be stored
+ * const int* arities: argument counts found by script_functions()
+ * int* stale: pointer to where 1 is stored if the image was compiled from a
+ * different version of its source or by a program with different functions
+ *
+ * Returns the mapped image or NULL if it cannot be mapped or is not valid
+ */
+static const char* script_map(
+        const char* path, size_t* size, const int* arities, int* stale)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return NULL;
+    }
+    struct stat information;
+    if (fstat(fd, &information) == -1
+            || (size_t)information.st_size < sizeof(ScriptHeader)) {
+        close(fd);
+        return NULL;
+    }
+    *size = information.st_size;
+    void* image = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED) {
+        return NULL;
+    }
+    const ScriptHeader* header = (const ScriptHeader*)image;
+    if (*size >= sizeof(ScriptHeader)
+            && !memcmp(header->magic, SCRIPT_MAGIC, SCRIPT_MAGIC_LENGTH)
+            && (header->version != SCRIPT_VERSION
+                    || header->numberFunctions != SCRIPT_FUNCTIONS)
+            && script_string(image, *size, header->sourceOffset)) {
+        *stale = 1;
+        return (const char*)image;
+    }
+    if (script_check((const char*)image, *size, arities)) {
+        munmap(image, *size);
+        return NULL;
+    }
+    unsigned long long hash;
+    *stale = !script_hash_file((const char*)image + header->sourceOffset, &hash)
+            && hash != header->hash;
+    return (const char*)image;
+}
+
+/* Finds the current value of a scalar variable or loop variable by name,
+ * trying the variable the name was last found at first
+ *
+ * UqContext* context: context holding the variables and loops
+ * const char* name: name to find
+ * int* hint: pointer to the index of the variable the name was last found at,
+ * updated when the name is found at another
+ * double* value: pointer to where the value will be stored
+ *
+ * Returns 0 or 1 if the name is not a scalar variable or loop variable
+ */
+static int script_resolve(
+        UqContext* context, const char* name, int* hint, double* value)
+{
+    Variables* variables = &(context->variables);
+    Loops* loops = &(context->loops);
+    if (*hint >= 0 && *hint < variables->size
+            && !strcmp(variables->names[*hint], name)) {
+        *value = variables->values[*hint];
+        return 0;
+    }
+    int i = name_find(
+            &(variables->index), variables->names, variables->size, name);
+    if (i != -1) {
+        *hint = i;
+        *value = variables->values[i];
+        return 0;
+    }
+    i = name_find(&(loops->index), loops->names, loops->size, name);
+    if (i != -1) {
+        *value = loops->currentValue[i];
+        return 0;
+    }
+    i = base_find(context, name);
+    if (i != -1) {
+        *value = context->base->values[i];
+        return 0;
+    }
+    return 1;
+}
+
+/* Finds the current value of every name a compiled statement uses
+ *
+ * UqContext* context: context the statement is run in
+ * const char* image: the mapped image
+ * const ScriptStatement* statement: statement being run
+ * ScriptRun* run: state of the script, whose symbolValues are filled in
+ * int checkBuiltins: 1 to also check that no builtin name it uses is defined
+ *
+ * Returns 0 or 1 if a name is not currently a scalar variable or loop variable
+ */
+static int script_references(UqContext* context, const char* image,
+        const ScriptStatement* statement, ScriptRun* run, int checkBuiltins)
+{
+    const ScriptHeader* header = (const ScriptHeader*)image;
+    const ScriptSymbol* symbols
+            = (const ScriptSymbol*)(image + header->symbolsOffset);
+    const uint32_t* references = (const uint32_t*)(image
+            + header->referencesOffset
+            + statement->firstReference * sizeof(uint32_t));
+    for (uint32_t i = 0; i < statement->numberReferences; i++) {
+        uint32_t k = references[i];
+        char* name = (char*)(image + symbols[k].name);
+        if (symbols[k].builtin) {
+            if (checkBuiltins && name_in_use(context, name)) {
+                return 1;
+            }
+        } else if ((checkBuiltins
+                           && array_find(&(context->variables), name) != -1)
+                || script_resolve(context, name, &(run->hints[k]),
+                        &(run->symbolValues[k]))) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Interprets the bytecode of a compiled statement
+ *
+ * const char* image: the mapped image
+ * const ScriptStatement* statement: statement to evaluate
+ * const ScriptRun* run: state of the script holding the symbol values
+ *
+ * Returns the value of the statement's expression
+ */
+static double script_interpret(const char* image,
+        const ScriptStatement* statement, const ScriptRun* run)
+{
+    const ScriptHeader* header = (const ScriptHeader*)image;
+    const ScriptInstruction* instructions
+            = (const ScriptInstruction*)(image + header->instructionsOffset)
+            + statement->firstInstruction;
+    double values[SCRIPT_STACK_VALUES];
+    double* stack = values;
+    if (statement->depth >= SCRIPT_STACK_VALUES) {
+        stack = (double*)malloc((statement->depth + 1) * sizeof(double));
+    }
+    stack[0] = NAN;
+    int top = -1;
+    for (uint32_t i = 0; i < statement->numberInstructions; i++) {
+        const ScriptInstruction* instruction = &(instructions[i]);
+        if (instruction->opcode == SCRIPT_CONSTANT) {
+            stack[++top] = instruction->value;
+        } else if (instruction->opcode == SCRIPT_SYMBOL) {
+            stack[++top] = run->symbolValues[instruction->operand];
+        } else if (run->arities[instruction->operand] == 1) {
+            double (*function)(double);
+            memcpy(&function, &(run->functions[instruction->operand]),
+                    sizeof(function));
+            stack[top] = function(stack[top]);
+        } else {
+            double (*function)(double, double);
+            memcpy(&function, &(run->functions[instruction->operand]),
+                    sizeof(function));
+            top--;
+            stack[top] = function(stack[top], stack[top + 1]);
+        }
+    }
+    double value = stack[0];
+    if (stack != values) {
+        free((void*)stack);
+    }
+    return value;
+}
+
+/* Evaluates a compiled statement with native code if there is any for it,
+ * otherwise by interpreting its bytecode. When verifying, a native result that
+ * is not bit for bit the interpreted one is reported and replaced
+ *
+ * UqContext* context: context errors are reported through
+ * const char* image: the mapped image
+ * uint32_t index: index of the statement
+ * ScriptRun* run: state of the script
+ *
+ * Returns the value of the statement's expression
+ */
+static double script_value(
+        UqContext* context, const char* image, uint32_t index, ScriptRun* run)
+{
+    const ScriptHeader* header = (const ScriptHeader*)image;
+    const ScriptStatement* statement
+            = (const ScriptStatement*)(image + header->statementsOffset)
+            + index;
+    STATS_ADD(context, evaluations, 1);
+    long long start = work_clock(context);
+    if (run->natives == NULL || run->natives[index] == NULL) {
+        double value = script_interpret(image, statement, run);
+        trace_span(context, "evaluate", start);
+        return value;
+    }
+    double value = run->natives[index](run->symbolValues, run->functions);
+    trace_span(context, "evaluate", start);
+    if (run->verify) {
+        double check = script_interpret(image, statement, run);
+        if (memcmp(&value, &check, sizeof(double))) {
+            char message[PRINT_BUFFER_SIZE];
+            snprintf(message, sizeof(message),
+                    "uqexpr: native result differs from interpreter on line "
+                    "%u\n",
+                    index + 1);
+            uq_flush(context);
+            uq_emit(context, UQ_STREAM_ERROR, message, strlen(message));
+            run->mismatches++;
+            value = check;
+        }
+    }
+    return value;
+}
+
+/* Runs a compiled @loop, producing the same output loop() would
+ *
+ * UqContext* context: context the statement is run in
+ * const char* image: the mapped image
+ * uint32_t index: index of the statement
+ * ScriptRun* run: state of the script
+ *
+ * Returns 0 or 1 if the loop must be executed from its text
+ */
+static int script_loop(
+        UqContext* context, const char* image, uint32_t index, ScriptRun* run)
+{
+    Loops* loops = &(context->loops);
+    const ScriptHeader* header = (const ScriptHeader*)image;
+    const ScriptStatement* statement
+            = (const ScriptStatement*)(image + header->statementsOffset)
+            + index;
+    const ScriptSymbol* symbols
+            = (const ScriptSymbol*)(image + header->symbolsOffset);
+    char* loopName = (char*)(image + symbols[statement->loop].name);
+    char* target = (char*)(image + symbols[statement->target].name);
+    int assignment = statement->kind == SCRIPT_LOOP_ASSIGNMENT;
+    int loopVarIndex
+            = name_find(&(loops->index), loops->names, loops->size, loopName);
+    if (loopVarIndex == -1
+            || (assignment
+                    && array_find(&(context->variables), target) != -1)) {
+        return 1;
+    }
+    loops->currentValue[loopVarIndex] = loops->startingValue[loopVarIndex];
+    int variableIndex = -1;
+    int loopIndex = -1;
+    if (assignment) {
+        loop_assignment_setup(context, target, &variableIndex, &loopIndex);
+    }
+    if (script_references(context, image, statement, run, 1)) {
+        return 1;
+    }
+    long long repetitions = loop_repetitions(loops, loopVarIndex);
+    trace_loop_begin(context);
+    for (long long i = 0; i < repetitions && !context->interrupted; i++) {
+        loops->currentValue[loopVarIndex] = loops->startingValue[loopVarIndex]
+                + i * loops->increment[loopVarIndex];
+        script_references(context, image, statement, run, 0);
+        double value = script_value(context, image, index, run);
+        STATS_ADD(context, loopIterations, 1);
+        if (i == 0) {
+            loop_header_print(context, loops->names[loopVarIndex],
+                    assignment ? target : "Result", repetitions);
+        }
+        if (assignment) {
+            loop_assign(context, value, loopIndex, variableIndex);
+            loop_print_assignment(context, value, target, loopVarIndex, i);
+        } else {
+            loop_expression_print(context, value, loopVarIndex);
+        }
+        trace_loop_step(context);
+        loop_progress(context, loopVarIndex, i, i + 1, repetitions);
+    }
+    trace_loop_end(context);
+    return 0;
+}
+
+/* Runs one statement of a compiled script, producing the same output
+ * uq_execute() would for its text. A statement that uses a name which is not
+ * currently a scalar, or that assigns to an array, is executed from its text
+ *
+ * UqContext* context: context the statement is run in
+ * const char* image: the mapped image
+ * uint32_t index: index of the statement to run
+ * ScriptRun* run: state of the script
+ *
+ * Returns 0 or UQ_STATEMENT_ERROR if an error was reported
+ */
+static int script_statement(
+        UqContext* context, const char* image, uint32_t index, ScriptRun* run)
+{
+    const ScriptHeader* header = (const ScriptHeader*)image;
+    const ScriptStatement* statement
+            = (const ScriptStatement*)(image + header->statementsOffset)
+            + index;
+    const ScriptSymbol* symbols
+            = (const ScriptSymbol*)(image + header->symbolsOffset);
+    const char* text = image + statement->text;
+    if (statement->kind == SCRIPT_TEXT) {
+        return uq_execute(context, text);
+    }
+    base_refresh(context);
+    long long start = work_clock(context);
+    if (statement->kind >= SCRIPT_LOOP_EXPRESSION) {
+        statement_begin(context);
+        if (script_loop(context, image, index, run)) {
+            return uq_execute(context, text);
+        }
+        STATS_ADD(context, linesRead, 1);
+        STATS_ADD(context, bytesRead, strlen(text));
+        int stopped = statement_interrupted(context);
+        uq_flush(context);
+        memory_sync(context);
+        trace_span(context, "statement", start);
+        return stopped ? UQ_STATEMENT_ERROR : 0;
+    }
+    char* target = (char*)(image + symbols[statement->target].name);
+    if (script_references(context, image, statement, run, 1)
+            || (statement->kind == SCRIPT_ASSIGNMENT
+                    && array_find(&(context->variables), target) != -1)) {
+        return uq_execute(context, text);
+    }
+    STATS_ADD(context, linesRead, 1);
+    STATS_ADD(context, bytesRead, strlen(text));
+    double value = script_value(context, image, index, run);
+    if (statement->kind == SCRIPT_EXPRESSION) {
+        char format[FORMAT_BUFFER_SIZE];
+        snprintf(format, sizeof(format), "%%.%dg", context->sigFigs);
+        uq_printf(context, "Result = ");
+        uq_printf(context, format, value);
+        uq_printf(context, "\n");
+    } else {
+        int finished = 0;
+        download_assignment_print(context, target, &finished, value);
+        if (!finished) {
+            download_allocate_variable(context, target, value);
+        }
+    }
+    uq_flush(context);
+    memory_sync(context);
+    trace_span(context, "statement", start);
+    return 0;
+}
+
+/* Executes every line of a script from its text, as download_file() does
+ *
+ * UqContext* context: context the script is run in
+ * const char* path: script to run
+ *
+ * Returns 0 or UQ_SCRIPT_ERROR if the script cannot be read
+ */
+static int script_run_source(UqContext* context, const char* path)
+{
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return UQ_SCRIPT_ERROR;
+    }
+    char* line = NULL;
+    size_t lineSize = 0;
+    while (getline(&line, &lineSize, file) >= 0) {
+        uq_execute(context, line);
+    }
+    free((void*)line);
+    fclose(file);
+    return 0;
+}
+
+/* Maps a compiled script, recompiling it first if its source has changed
+ * since it was compiled
+ *
+ * const char* imagePath: compiled script to map
+ * size_t* size: pointer to where the size of the mapping will be stored
+ * const int* arities: argument counts found by script_functions()
+ * char** source: pointer to where a copy of the path of the source is stored
+ * if the image is stale and cannot be rebuilt, otherwise set to NULL
+ *
+ * Returns the image or NULL if it cannot be used
+ */
+static const char* script_open(const char* imagePath, size_t* size,
+        const int* arities, char** source)
+{
+    int stale = 0;
+    *source = NULL;
+    const char* image = script_map(imagePath, size, arities, &stale);
+    if (image == NULL || !stale) {
+        return image;
+    }
+    const ScriptHeader* header = (const ScriptHeader*)image;
+    char* path = strdup(image + header->sourceOffset);
+    munmap((void*)image, *size);
+    image = NULL;
+    if (uq_compile_script(path, imagePath) == 0) {
+        image = script_map(imagePath, size, arities, &stale);
+    }
+    if (image != NULL && stale) {
+        munmap((void*)image, *size);
+        image = NULL;
+    }
+    if (image == NULL) {
+        *source = path;
+    } else {
+        free((void*)path);
+    }
+    return image;
+}
+
+/* Runs every statement of a mapped compiled script
+ *
+ * UqContext* context: context the script is run in
+ * const char* image: the mapped image
+ * ScriptRun* run: state of the script with its functions, natives and
+ * verify set
+ *
+ * Returns 0 or UQ_SCRIPT_ERROR if a native result differed from the
+ * interpreter
+ */
+static int script_run(UqContext* context, const char* image, ScriptRun* run)
+{
+    const ScriptHeader* header = (const ScriptHeader*)image;
+    run->hints = (int*)malloc((header->numberSymbols + 1) * sizeof(int));
+    run->symbolValues
+            = (double*)malloc((header->numberSymbols + 1) * sizeof(double));
+    run->mismatches = 0;
+    for (uint32_t i = 0; i < header->numberSymbols; i++) {
+        run->hints[i] = -1;
+    }
+    for (uint32_t i = 0; i < header->numberStatements; i++) {
+        script_statement(context, image, i, run);
+    }
+    free((void*)run->hints);
+    free((void*)run->symbolValues);
+    return run->mismatches ? UQ_SCRIPT_ERROR : 0;
+}
+
+/* Maps a compiled script and runs it in place, recompiling it first if its
+ * source has changed since it was compiled
+ */
+int uq_run_compiled(UqContext* context, const char* imagePath)
+{
+    ScriptRun run;
+    memset(&run, 0, sizeof(run));
+    script_functions(run.functions, run.arities);
+    size_t size;
+    char* source;
+    const char* image = script_open(imagePath, &size, run.arities, &source);
+    if (source != NULL) {
+        int result = script_run_source(context, source);
+        free((void*)source);
+        return result;
+    }
+    if (image == NULL) {
+        return UQ_SCRIPT_ERROR;
+    }
+    int result = script_run(context, image, &run);
+    munmap((void*)image, size);
+    return result;
+}
+
+/* Computes the FNV-1a hash native code for an image is keyed by, covering the
+ * whole image so that any change to how its script compiled is detected
+ *
+ * const char* image: the mapped image
+ *
+ * Returns the hash
+ */
+static unsigned long long native_hash(const char* image)
+{
+    const ScriptHeader* header = (const ScriptHeader*)image;
+    return hash_bytes(image, header->size, FNV_OFFSET);
+}
+
+/* Writes the C function evaluating one compiled statement. Each instruction
+ * becomes one temporary; constants are written as their bit patterns and the
+ * arithmetic operators inline, so that the compiled function computes exactly
+ * what script_interpret() does
+ *
+ * FILE* file: C source being written
+ * const char* image: the mapped image
+ * uint32_t index: index of the statement
+ * const int* arities: argument counts found by script_functions()
+ */
+static void native_statement(
+        FILE* file, const char* image, uint32_t index, const int* arities)
+{
+    const ScriptHeader* header = (const ScriptHeader*)image;
+    const ScriptStatement* statement
+            = (const ScriptStatement*)(image + header->statementsOffset)
+            + index;
+    const ScriptInstruction* instructions
+            = (const ScriptInstruction*)(image + header->instructionsOffset)
+            + statement->firstInstruction;
+    static const char* const operators[] = {"-", "+", "-", "*", "/"};
+    uint32_t* stack
+            = (uint32_t*)malloc((statement->depth + 1) * sizeof(uint32_t));
+    int top = -1;
+    fprintf(file,
+            "static double s%u(const double* v, const void* const* f)\n{\n",
+            index);
+    for (uint32_t i = 0; i < statement->numberInstructions; i++) {
+        const ScriptInstruction* instruction = &(instructions[i]);
+        uint32_t j = instruction->operand;
+        fprintf(file, "    double t%u = ", i);
+        if (instruction->opcode == SCRIPT_CONSTANT) {
+            unsigned long long bits;
+            memcpy(&bits, &(instruction->value), sizeof(bits));
+            fprintf(file, "c(0x%016llxULL);\n", bits);
+            stack[++top] = i;
+        } else if (instruction->opcode == SCRIPT_SYMBOL) {
+            fprintf(file, "v[%u];\n", j);
+            stack[++top] = i;
+        } else if (arities[j] == 1) {
+            if (j == 0) {
+                fprintf(file, "-t%u;\n", stack[top]);
+            } else {
+                fprintf(file, "((f1)f[%u])(t%u);\n", j, stack[top]);
+            }
+            stack[top] = i;
+        } else {
+            top--;
+            if (j < sizeof(operators) / sizeof(operators[0])) {
+                fprintf(file, "t%u %s t%u;\n", stack[top], operators[j],
+                        stack[top + 1]);
+            } else {
+                fprintf(file, "((f2)f[%u])(t%u, t%u);\n", j, stack[top],
+                        stack[top + 1]);
+            }
+            stack[top] = i;
+        }
+    }
+    fprintf(file, "    return t%u;\n}\n\n", stack[0]);
+    free((void*)stack);
+}
+
+/* Writes C source with a function for every compiled statement of an image
+ * and the table native_load() looks them up through
+ *
+ * const char* image: the mapped image
+ * const int* arities: argument counts found by script_functions()
+ * const char* path: file to write
+ *
+ * Returns 0 or 1 if the file cannot be written
+ */
+static int native_write(const char* image, const int* arities, const char* path)
+{
+    const ScriptHeader* header = (const ScriptHeader*)image;
+    const ScriptStatement* statements
+            = (const ScriptStatement*)(image + header->statementsOffset);
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        return 1;
+    }
+    fprintf(file,
+            "#include <string.h>\n\n"
+            "typedef double (*f1)(double);\n"
+            "typedef double (*f2)(double, double);\n\n"
+            "static inline double c(unsigned long long bits)\n{\n"
+            "    double value;\n"
+            "    memcpy(&value, &bits, sizeof(value));\n"
+            "    return value;\n}\n\n");
+    for (uint32_t i = 0; i < header->numberStatements; i++) {
+        if (statements[i].kind != SCRIPT_TEXT) {
+            native_statement(file, image, i, arities);
+        }
+    }
+    fprintf(file,
+            "const unsigned long long uq_aot_hash = 0x%016llxULL;\n"
+            "const unsigned int uq_aot_statements = %u;\n"
+            "double (*const uq_aot_table[])(const double*, const void* const*)"
+            " = {\n",
+            native_hash(image), header->numberStatements);
+    for (uint32_t i = 0; i < header->numberStatements; i++) {
+        if (statements[i].kind != SCRIPT_TEXT) {
+            fprintf(file, "        s%u,\n", i);
+        } else {
+            fprintf(file, "        0,\n");
+        }
+    }
+    fprintf(file, "        0};\n");
+    return (fclose(file) != 0) ? 1 : 0;
+}
+
+/* Builds a shared object from C source with the system C compiler, named by
+ * the CC environment variable or cc. CC is split into words at whitespace, so
+ * it may carry options of its own. The object is built under a temporary
+ * name and renamed into place so that a partly written object is never loaded
+ *
+ * const char* sourcePath: C source to build
+ * const char* objectPath: shared object to build
+ *
+ * Returns 0 or 1 if the compiler cannot be run or fails
+ */
+static int native_build(const char* sourcePath, const char* objectPath)
+{
+    const char* variable = getenv("CC");
+    char* compiler = strdup((variable != NULL) ? variable : "");
+    int words = 0;
+    for (int i = 0; compiler[i] != '\0'; i++) {
+        words += !isspace((unsigned char)compiler[i])
+                && (i == 0 || isspace((unsigned char)compiler[i - 1]));
+    }
+    char** arguments
+            = (char**)malloc((words + NATIVE_ARGUMENTS + 2) * sizeof(char*));
+    int count = 0;
+    char* savePointer;
+    for (char* word = strtok_r(compiler, " \t\n\v\f\r", &savePointer);
+            word != NULL;
+            word = strtok_r(NULL, " \t\n\v\f\r", &savePointer)) {
+        arguments[count++] = word;
+    }
+    if (count == 0) {
+        arguments[count++] = "cc";
+    }
+    size_t length = strlen(objectPath) + PRINT_BUFFER_SIZE;
+    char* temporary = (char*)malloc(length);
+    snprintf(temporary, length, "%s.%ld.tmp", objectPath, (long)getpid());
+    const char* options[NATIVE_ARGUMENTS] = {"-O3", "-march=native",
+            "-ffp-contract=off", "-fPIC", "-shared", "-o", temporary,
+            sourcePath, NULL};
+    for (int i = 0; i < NATIVE_ARGUMENTS; i++) {
+        arguments[count++] = (char*)options[i];
+    }
+    pid_t child = fork();
+    if (child == -1) {
+        free((void*)arguments);
+        free((void*)compiler);
+        free((void*)temporary);
+        return 1;
+    }
+    if (child == 0) {
+        int null = open("/dev/null", O_WRONLY);
+        if (null != -1) {
+            dup2(null, STDOUT_FILENO);
+            dup2(null, STDERR_FILENO);
+            close(null);
+        }
+        execvp(arguments[0], arguments);
+        _exit(1);
+    }
+    free((void*)arguments);
+    free((void*)compiler);
+    int status = 0;
+    int result = 0;
+    while (waitpid(child, &status, 0) == -1) {
+        if (errno != EINTR) {
+            result = 1;
+            break;
+        }
+    }
+    if (result || !WIFEXITED(status) || WEXITSTATUS(status) != 0
+            || rename(temporary, objectPath) == -1) {
+        unlink(temporary);
+        result = 1;
+    }
+    free((void*)temporary);
+    return result;
+}
+
+/* Computes the FNV-1a hash of the contents of an open file
+ *
+ * int fd: file to hash, read from its current offset to its end
+ * unsigned long long* hash: pointer to where the hash will be stored
+ *
+ * Returns 0 or 1 if the file cannot be read
+ */
+static int native_file_hash(int fd, unsigned long long* hash)
+{
+    char* buffer = (char*)malloc(NATIVE_READ_BUFFER);
+    *hash = FNV_OFFSET;
+    ssize_t count;
+    while ((count = read(fd, buffer, NATIVE_READ_BUFFER)) != 0) {
+        if (count < 0 && errno != EINTR) {
+            free((void*)buffer);
+            return 1;
+        }
+        if (count > 0) {
+            *hash = hash_bytes(buffer, count, *hash);
+        }
+    }
+    free((void*)buffer);
+    return 0;
+}
+
+/* Records which image a newly built object belongs to, writing the hash of
+ * the image and of the object's bytes to the object's sum file. The sum file
+ * is written under a temporary name and renamed into place
+ *
+ * const char* image: the mapped image the object was built from
+ * const char* objectPath: the object
+ * const char* sumPath: sum file to write
+ *
+ * Returns 0 or 1 if the object cannot be read or the sum file written
+ */
+static int native_record(
+        const char* image, const char* objectPath, const char* sumPath)
+{
+    int fd = open(objectPath, O_RDONLY | O_CLOEXEC);
+    unsigned long long objectHash;
+    if (fd == -1) {
+        return 1;
+    }
+    int failed = native_file_hash(fd, &objectHash);
+    close(fd);
+    size_t length = strlen(sumPath) + PRINT_BUFFER_SIZE;
+    char* temporary = (char*)malloc(length);
+    snprintf(temporary, length, "%s.%ld.tmp", sumPath, (long)getpid());
+    FILE* file = failed ? NULL : fopen(temporary, "w");
+    if (file != NULL) {
+        fprintf(file, "%016llx %016llx\n", native_hash(image), objectHash);
+        failed = fclose(file) != 0 || rename(temporary, sumPath) == -1;
+    } else {
+        failed = 1;
+    }
+    if (failed) {
+        unlink(temporary);
+    }
+    free((void*)temporary);
+    return failed;
+}
+
+/* Loads the native code built for an image. Loading an object runs code from
+ * it, so before it is loaded the object must belong to the user running the
+ * script, be writable by no one else, and hash to the value its sum file
+ * records for exactly this image. The object is hashed and loaded through one
+ * open descriptor, so it cannot be replaced in between. The object's own
+ * record of the image is checked again once loaded
+ *
+ * const char* image: the mapped image
+ * const char* objectPath: shared object to load
+ * const char* sumPath: sum file written by native_record()
+ * void** handle: pointer to where the handle of the object will be stored
+ *
+ * Returns the table of native statements or NULL if the object is missing,
+ * cannot be trusted or was built for another image
+ */
+static ScriptNative const* native_load(const char* image,
+        const char* objectPath, const char* sumPath, void** handle)
+{
+    const ScriptHeader* header = (const ScriptHeader*)image;
+    *handle = NULL;
+    unsigned long long imageHash = 0;
+    unsigned long long objectHash = 0;
+    FILE* sums = fopen(sumPath, "r");
+    int recorded = sums != NULL
+            && fscanf(sums, "%llx %llx", &imageHash, &objectHash) == 2
+            && imageHash == native_hash(image);
+    if (sums != NULL) {
+        fclose(sums);
+    }
+    int fd = recorded ? open(objectPath, O_RDONLY | O_CLOEXEC) : -1;
+    if (fd == -1) {
+        return NULL;
+    }
+    struct stat status;
+    unsigned long long contents;
+    if (fstat(fd, &status) == -1 || !S_ISREG(status.st_mode)
+            || status.st_uid != geteuid()
+            || (status.st_mode & (S_IWGRP | S_IWOTH))
+            || native_file_hash(fd, &contents) || contents != objectHash) {
+        close(fd);
+        return NULL;
+    }
+    char descriptorPath[PRINT_BUFFER_SIZE];
+    snprintf(descriptorPath, sizeof(descriptorPath), "/proc/self/fd/%d", fd);
+    *handle = dlopen(descriptorPath, RTLD_NOW | RTLD_LOCAL);
+    close(fd);
+    if (*handle == NULL) {
+        return NULL;
+    }
+    const unsigned long long* hash
+            = (const unsigned long long*)dlsym(*handle, "uq_aot_hash");
+    const unsigned int* statements
+            = (const unsigned int*)dlsym(*handle, "uq_aot_statements");
+    ScriptNative const* table
+            = (ScriptNative const*)dlsym(*handle, "uq_aot_table");
+    if (hash == NULL || statements == NULL || table == NULL
+            || *hash != native_hash(image)
+            || *statements != header->numberStatements) {
+        dlclose(*handle);
+        *handle = NULL;
+        return NULL;
+    }
+    return table;
+}
+
+/* Runs a script through native code, compiling it to an image and building
+ * the image's statements into a shared object first if the cached ones are
+ * missing or stale
+ */
+int uq_run_native(UqContext* context, const char* sourcePath, int verify)
+{
+    char* source = realpath(sourcePath, NULL);
+    if (source == NULL) {
+        return UQ_SCRIPT_ERROR;
+    }
+    size_t length = strlen(source) + PRINT_BUFFER_SIZE;
+    char* imagePath = (char*)malloc(length);
+    char* codePath = (char*)malloc(length);
+    char* objectPath = (char*)malloc(length);
+    char* sumPath = (char*)malloc(length);
+    snprintf(imagePath, length, "%s.aot.uqc", source);
+    snprintf(codePath, length, "%s.aot.c", source);
+    snprintf(objectPath, length, "%s.aot.so", source);
+    snprintf(sumPath, length, "%s.aot.sum", source);
+    ScriptRun run;
+    memset(&run, 0, sizeof(run));
+    script_functions(run.functions, run.arities);
+    run.verify = verify;
+    size_t size;
+    char* stalePath;
+    const char* image = script_open(imagePath, &size, run.arities, &stalePath);
+    free((void*)stalePath);
+    if (image == NULL && uq_compile_script(source, imagePath) == 0) {
+        image = script_open(imagePath, &size, run.arities, &stalePath);
+        free((void*)stalePath);
+    }
+    int result;
+    if (image == NULL) {
+        result = script_run_source(context, source);
+    } else {
+        void* handle;
+        run.natives = native_load(image, objectPath, sumPath, &handle);
+        if (run.natives == NULL) {
+            if (!native_write(image, run.arities, codePath)
+                    && !native_build(codePath, objectPath)
+                    && !native_record(image, objectPath, sumPath)) {
+                run.natives = native_load(image, objectPath, sumPath, &handle);
+            }
+            if (run.natives == NULL) {
+                char message[PRINT_BUFFER_SIZE];
+                snprintf(message, sizeof(message),
+                        "uqexpr: can't build native code for \"%.*s\", "
+                        "interpreting it\n",
+                        PRINT_BUFFER_SIZE / 2, sourcePath);
+                uq_flush(context);
+                uq_emit(context, UQ_STREAM_ERROR, message, strlen(message));
+            }
+        }
+        result = script_run(context, image, &run);
+        if (handle != NULL) {
+            dlclose(handle);
+        }
+        munmap((void*)image, size);
+    }
+    free((void*)source);
+    free((void*)imagePath);
+    free((void*)codePath);
+    free((void*)objectPath);
+    free((void*)sumPath);
+    return result;
+}
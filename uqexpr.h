@@ -0,0 +1,482 @@
+#ifndef UQEXPR_H
+#define UQEXPR_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#define UQ_STATEMENT_ERROR 1
+#define UQ_DUPLICATE_VARIABLES_ERROR 6
+#define UQ_INVALID_EXPRESSION_ERROR 9
+#define UQ_SNAPSHOT_ERROR 10
+#define UQ_SCRIPT_ERROR 11
+#define UQ_INVALID_VARIABLES_ERROR 12
+#define UQ_TRACE_ERROR 13
+#define UQ_CROSSCHECK_ERROR 14
+#define UQ_OUTPUT_TEXT 0
+#define UQ_OUTPUT_TSV 1
+#define UQ_OUTPUT_BINARY 2
+#define UQ_MATH_EXACT 0
+#define UQ_MATH_FAST 1
+#define UQ_PRECISION_DOUBLE 0
+#define UQ_PRECISION_FLOAT 1
+#define UQ_ENGINE_TREE 0
+#define UQ_ENGINE_VECTOR 1
+#define UQ_FLOAT_SIG_FIGS 6
+#define UQ_STREAM_OUTPUT 0
+#define UQ_STREAM_ERROR 1
+#define UQ_MEMORY_SYMBOLS 0
+#define UQ_MEMORY_NAMES 1
+#define UQ_MEMORY_EXPRESSIONS 2
+#define UQ_MEMORY_BUFFERS 3
+#define UQ_MEMORY_KINDS 4
+
+/* An evaluation context holding the variables, loop variables, arrays and
+ * settings of one session. Contexts share no mutable state with each other
+ * (see uq_share()), so different contexts may be used from different threads
+ * at the same time; a single context must only be used by one thread at a time
+ */
+typedef struct UqContext UqContext;
+
+/* A cache of compiled expressions that any number of contexts may share.
+ * Expressions are compiled once per distinct expression text and set of
+ * variable names and re-evaluated with each context's current values. A cache
+ * must only be used by one thread at a time
+ */
+typedef struct UqCache UqCache;
+
+/* Receives output produced by a context. Output is buffered and passed on in
+ * pieces no smaller than a whole statement's output (except for very large
+ * @loop output, which is passed on as it fills the buffer)
+ *
+ * void* data: the pointer given to uq_set_output()
+ * int stream: UQ_STREAM_OUTPUT for results or UQ_STREAM_ERROR for errors
+ * const char* text: output bytes, not nul terminated
+ * size_t length: number of bytes in text
+ */
+typedef void (*UqOutputFunction)(
+        void* data, int stream, const char* text, size_t length);
+
+/* Counts of the work done by the contexts a UqStats is attached to with
+ * uq_set_stats(). The counters are plain integers updated without locks by the
+ * thread using the context, so a UqStats must only be attached to contexts
+ * used by one thread. Times are in nanoseconds of the monotonic clock
+ *
+ * long long linesRead: lines executed, including @loop and compiled lines
+ * long long bytesRead: bytes in those lines
+ * long long compiles: expressions compiled by te_compile()
+ * long long compileNanoseconds: time spent compiling
+ * long long evaluations: values computed, one per array element or row
+ * long long loopIterations: @loop iterations run
+ * long long outputBytes: bytes passed to the output function
+ * long long outputNanoseconds: time spent in the output function
+ * long long memoryBytes[]: bytes currently held by the contexts, indexed by
+ * UQ_MEMORY_SYMBOLS (variable, loop and array storage), UQ_MEMORY_NAMES,
+ * UQ_MEMORY_EXPRESSIONS (compiled expression trees) and UQ_MEMORY_BUFFERS
+ * (output and --columns row buffers)
+ * long long memoryPeak[]: highest value each of memoryBytes has reached
+ */
+typedef struct {
+    long long linesRead;
+    long long bytesRead;
+    long long compiles;
+    long long compileNanoseconds;
+    long long evaluations;
+    long long loopIterations;
+    long long outputBytes;
+    long long outputNanoseconds;
+    long long memoryBytes[UQ_MEMORY_KINDS];
+    long long memoryPeak[UQ_MEMORY_KINDS];
+} UqStats;
+
+/* A buffer of timed spans of the work done by the contexts it is attached to
+ * with uq_set_trace(), written out in the Chrome trace event format that
+ * chrome://tracing and Perfetto load. Spans are appended without locks, so
+ * each thread needs its own trace and a trace must only be attached to
+ * contexts used by the thread that created it
+ */
+typedef struct UqTrace UqTrace;
+
+/* A background thread that evaluates again with tinyexpr (te_compile() and
+ * te_eval()) every statement the contexts attached to it with
+ * uq_set_crosscheck() evaluate, comparing the results. Contexts queue the
+ * values each result was computed from and carry on without waiting; if the
+ * thread falls behind by more than about a million results, further ones are
+ * left unchecked rather than slowing the contexts down. So are the results
+ * of statements nested too deeply for tinyexpr's recursive parser and
+ * evaluator. A crosscheck may be shared by contexts used from any number of
+ * threads
+ */
+typedef struct UqCrosscheck UqCrosscheck;
+
+/* Creates a context with no variables, 3 significant figures, text output and
+ * output written to stdout and stderr
+ *
+ * Returns the new context or NULL if memory could not be allocated
+ */
+UqContext* uq_create(void);
+
+/* Creates a context holding copies of the variables, loop variables, arrays
+ * and settings of another context. The copy shares the original's cache and
+ * writes to stdout and stderr until uq_set_output() is called
+ *
+ * Returns the new context or NULL if memory could not be allocated
+ */
+UqContext* uq_clone(const UqContext* original);
+
+/* Moves the scalar variables of a context into a shared base. The base is
+ * never modified in place: contexts created from the context with uq_clone()
+ * read it without copying it or taking a lock, and assigning to one of its
+ * variables gives that context its own copy of the variable. Executing
+ * "@publish" in any of these contexts atomically replaces the base with the
+ * context's current variables; the others see the new base from their next
+ * statement without ever waiting for it. Loop variables and arrays are not
+ * shared
+ *
+ * Returns 0 or UQ_STATEMENT_ERROR if memory could not be allocated
+ */
+int uq_share(UqContext* context);
+
+/* Frees a context and everything it holds
+ *
+ * UqContext* context: context to free, may be NULL
+ */
+void uq_destroy(UqContext* context);
+
+/* Sets the number of significant figures results are printed to
+ *
+ * Returns 0 or UQ_INVALID_VARIABLES_ERROR if sigFigs is outside 1..17
+ */
+int uq_set_sig_figs(UqContext* context, int sigFigs);
+
+/* Sets how @loop results are written: UQ_OUTPUT_TEXT, UQ_OUTPUT_TSV or
+ * UQ_OUTPUT_BINARY. In the binary mode the output stream holds only UQXB
+ * records, and all other text, such as assignments and scalar results, is
+ * written to the error stream. uq_columns() rows are text in every mode
+ *
+ * Returns 0 or UQ_INVALID_VARIABLES_ERROR if the mode is unknown
+ */
+int uq_set_output_mode(UqContext* context, int outputMode);
+
+/* Returns the output mode of a context
+ */
+int uq_output_mode(const UqContext* context);
+
+/* Sets how array statements and uq_columns() evaluate sin, cos, exp, ln,
+ * log10 and pow. UQ_MATH_EXACT, the default, calls the C library for every
+ * element. UQ_MATH_FAST uses branch-free polynomial kernels that run several
+ * elements per instruction, chosen at run time for AVX-512, AVX2 or baseline
+ * x86-64. Compared with glibc, fast results of exp, ln, sin and cos are within
+ * 1 ulp, log10 within 2 ulp and pow within 1 + 1.5 * |y * ln x| ulp, at most
+ * 25. Arguments the kernels do not cover (|x| > 1e6 for sin and cos,
+ * |y * ln x| > 16 or x <= 0 for pow) are passed to the C library, and results
+ * below DBL_MIN are not held to these bounds. Fast results may differ in the
+ * last bit between instruction sets. Scalar statements and @loop always use
+ * the C library
+ *
+ * Returns 0 or UQ_INVALID_VARIABLES_ERROR if the mode is unknown
+ */
+int uq_set_math(UqContext* context, int math);
+
+/* Sets the precision array statements and uq_columns() are evaluated in.
+ * UQ_PRECISION_FLOAT evaluates each block in floats, twice as many elements
+ * per SIMD instruction as UQ_PRECISION_DOUBLE, the default, and rounds the
+ * results back to double. Elements, variables and constants are rounded to
+ * float on the way in and functions are still called in double, so values
+ * beyond the range of a float become infinity or zero. Single precision only
+ * applies while the context prints at most UQ_FLOAT_SIG_FIGS significant
+ * figures; with more, evaluation falls back to double. Scalar statements and
+ * @loop always use double
+ *
+ * Returns 0 or UQ_INVALID_VARIABLES_ERROR if the precision is unknown
+ */
+int uq_set_precision(UqContext* context, int precision);
+
+/* Sets the number of @loop iterations between progress reports, or stops
+ * reporting if interval is 0. Each report is a line on the error stream
+ * giving the loop variable and the iterations finished out of the total, and
+ * is written after the results of those iterations have been passed on.
+ * Results leave a context through a fixed-size output buffer, so a loop of
+ * any length runs in constant memory. Loops run up to 2^53 iterations.
+ * Contexts created with uq_clone() inherit the interval
+ *
+ * Returns 0 or UQ_INVALID_VARIABLES_ERROR if interval is negative
+ */
+int uq_set_progress(UqContext* context, long long interval);
+
+/* Sets the engine scalar statements and @loop are evaluated with.
+ * UQ_ENGINE_TREE, the default, walks the compiled expression tree.
+ * UQ_ENGINE_VECTOR runs each statement as a vector program, with the math
+ * and precision set by uq_set_math() and uq_set_precision(), and @loop
+ * expressions a block of iterations at a time; expressions a vector program
+ * cannot hold are still evaluated as trees. Array statements always use
+ * vector programs, and so does @montecarlo, with exact math in double
+ * precision unless the engine is UQ_ENGINE_VECTOR. Contexts created with
+ * uq_clone() inherit the engine
+ *
+ * Returns 0 or UQ_INVALID_VARIABLES_ERROR if the engine is unknown
+ */
+int uq_set_engine(UqContext* context, int engine);
+
+/* Sets the function all output is passed to, or restores writing to stdout and
+ * stderr if function is NULL
+ */
+void uq_set_output(UqContext* context, UqOutputFunction function, void* data);
+
+/* Asks the statement a context is running to stop, typically from its output
+ * function when output cannot be kept up with. A @loop ends after the
+ * iteration in progress; other statements run to completion. Either way the
+ * statement then reports an error and the next one runs normally
+ */
+void uq_interrupt(UqContext* context);
+
+/* Sets how long each @loop may run, in milliseconds of wall time from the
+ * start of its statement, or removes the limit if milliseconds is 0. A @loop
+ * past the limit is stopped as uq_interrupt() would stop it, with a message
+ * on the error stream. Other statements are not limited; @montecarlo holds
+ * every sample in memory, so uq_set_memory_limit() is what bounds it.
+ * Contexts created with uq_clone() inherit the limit
+ *
+ * Returns 0 or UQ_INVALID_VARIABLES_ERROR if milliseconds is negative or
+ * too large to hold in nanoseconds
+ */
+int uq_set_time_limit(UqContext* context, long long milliseconds);
+
+/* Sets the counters a context adds its work to, or stops counting if stats
+ * is NULL. The memory the context already holds is moved from the old
+ * counters to the new ones. Counting is compiled out entirely when uqexpr.c is
+ * built with -DUQ_NO_STATS, and costs a pointer check per counter otherwise.
+ * Contexts created with uq_clone() start without counters
+ */
+void uq_set_stats(UqContext* context, UqStats* stats);
+
+/* Sets the number of bytes a context tries to hold no more than, counted as
+ * for UqStats memoryBytes, or removes the limit if bytes is 0. Over the limit
+ * the context empties its compiled expression cache before adding to it and
+ * compiles without the cache if it is still over, passes output on as soon as
+ * it is written rather than when the buffer fills, reads --columns rows in
+ * smaller blocks and refuses a @montecarlo whose results would not fit.
+ * Variables are never dropped, so the limit can be exceeded.
+ * Contexts created with uq_clone() inherit the limit
+ */
+void uq_set_memory_limit(UqContext* context, long long bytes);
+
+/* Creates an empty trace recording the id of the calling thread
+ *
+ * Returns the new trace or NULL if memory could not be allocated
+ */
+UqTrace* uq_trace_create(void);
+
+/* Frees a trace and every span it holds. No context may be using the trace
+ *
+ * UqTrace* trace: trace to free, may be NULL
+ */
+void uq_trace_destroy(UqTrace* trace);
+
+/* Sets the trace a context records spans in, or stops tracing if trace is
+ * NULL. A traced context records statement, lex, compile, evaluate, format
+ * and write spans. A lex span covers splitting a line into its comment,
+ * command or assignment; the expression parser tokenises as it parses, so
+ * that time is part of the compile span. @loop iterations and --columns rows
+ * are recorded in chunks rather than one span each. Tracing is compiled out
+ * when uqexpr.c is built with -DUQ_NO_TRACE. Contexts created with uq_clone()
+ * start untraced
+ */
+void uq_set_trace(UqContext* context, UqTrace* trace);
+
+/* Records a span of work done outside the library, such as reading input
+ *
+ * const char* name: name of the span, which must outlive the trace
+ * long long start: CLOCK_MONOTONIC time the work began at in nanoseconds
+ * long long end: CLOCK_MONOTONIC time the work ended at in nanoseconds
+ */
+void uq_trace_span(
+        UqTrace* trace, const char* name, long long start, long long end);
+
+/* Writes the spans of one or more traces to a file as a single Chrome trace
+ * event JSON document, with timestamps in microseconds from the creation of
+ * the earliest trace and each trace shown as its own thread
+ *
+ * Returns 0 or UQ_TRACE_ERROR if the file could not be written
+ */
+int uq_trace_write(UqTrace* const* traces, int count, FILE* file);
+
+/* Creates a crosscheck and starts its thread. The first result that differs
+ * from tinyexpr's by more than ulps units in the last place, or that tinyexpr
+ * cannot compute, is reported on one line of report with the statement, both
+ * results and the values of the variables it refers to. NaN matches NaN
+ *
+ * long long ulps: largest difference accepted, 0 to require identical results
+ * FILE* report: file divergences and the summary are written to
+ *
+ * Returns the new crosscheck or NULL if ulps is negative or the thread could
+ * not be started
+ */
+UqCrosscheck* uq_crosscheck_create(long long ulps, FILE* report);
+
+/* Waits for a crosscheck to check every result queued on it, writes a summary
+ * line of the results checked, differed and unchecked to its report file and
+ * frees it. No context may be using the crosscheck
+ *
+ * UqCrosscheck* check: crosscheck to free, may be NULL
+ *
+ * Returns 0 or UQ_CROSSCHECK_ERROR if any result differed
+ */
+int uq_crosscheck_destroy(UqCrosscheck* check);
+
+/* Sets the crosscheck a context queues the results of its expressions,
+ * assignments, array statements and @loop iterations on, or stops checking
+ * if check is NULL. Compiled and native scripts are not checked. Contexts
+ * created with uq_clone() share the original's crosscheck
+ */
+void uq_set_crosscheck(UqContext* context, UqCrosscheck* check);
+
+/* Creates an empty compiled expression cache
+ *
+ * Returns the new cache or NULL if memory could not be allocated
+ */
+UqCache* uq_cache_create(void);
+
+/* Frees a cache and every compiled expression it holds. No context may be
+ * using the cache
+ *
+ * UqCache* cache: cache to free, may be NULL
+ */
+void uq_cache_destroy(UqCache* cache);
+
+/* Sets the cache a context compiles expressions through, or stops caching if
+ * cache is NULL
+ */
+void uq_set_cache(UqContext* context, UqCache* cache);
+
+/* Reports the number of lookups a cache answered without compiling (hits) and
+ * the number that compiled (misses)
+ */
+void uq_cache_stats(const UqCache* cache, long* hits, long* misses);
+
+/* Defines a variable from a string of the form name=value as given to
+ * --define
+ *
+ * Returns 0, UQ_INVALID_VARIABLES_ERROR if the string is invalid or
+ * UQ_DUPLICATE_VARIABLES_ERROR if the name is already in use
+ */
+int uq_define(UqContext* context, const char* definition);
+
+/* Defines a loop variable from a string of the form name,start,increment,end
+ * as given to --loopable
+ *
+ * Returns 0, UQ_INVALID_VARIABLES_ERROR if the string is invalid or
+ * UQ_DUPLICATE_VARIABLES_ERROR if the name is already in use
+ */
+int uq_loopable(UqContext* context, const char* definition);
+
+/* Writes a snapshot of the variables, loop variables, arrays and significant
+ * figures of a context to a file, as "@save path" does. The snapshot is a
+ * position independent binary image that uq_restore() maps without parsing
+ *
+ * Returns 0 or UQ_SNAPSHOT_ERROR if the file cannot be written
+ */
+int uq_save(UqContext* context, const char* path);
+
+/* Adds the variables, loop variables and arrays of a snapshot written by
+ * uq_save() to a context and sets its significant figures
+ *
+ * Returns 0, UQ_SNAPSHOT_ERROR if the file cannot be read or is not a valid
+ * snapshot or UQ_DUPLICATE_VARIABLES_ERROR if a name is already in use, in
+ * which case the context is left unchanged
+ */
+int uq_restore(UqContext* context, const char* path);
+
+/* Executes one line of the uqexpr language (an expression, an assignment, a
+ * comment or an @ command) exactly as the live command line does, writing
+ * results and errors through the output function
+ *
+ * Returns 0 or UQ_STATEMENT_ERROR if an error was reported
+ */
+int uq_execute(UqContext* context, const char* line);
+
+/* Writes the variables and loop variables of a context as "@print" does,
+ * without counting it as a line read in UqStats, for banners printed by the
+ * program rather than read from its input
+ *
+ * Returns 0 or UQ_STATEMENT_ERROR if an error was reported
+ */
+int uq_print(UqContext* context);
+
+/* Evaluates a scalar expression without producing any output
+ *
+ * double* result: pointer to where the value will be stored
+ *
+ * Returns 0 or UQ_INVALID_EXPRESSION_ERROR if the expression is invalid
+ */
+int uq_eval(UqContext* context, const char* expression, double* result);
+
+/* Evaluates a scalar expression and assigns it to a variable or the current
+ * value of a loop variable, creating the variable if needed, without producing
+ * any output
+ *
+ * double* result: pointer to where the value will be stored, may be NULL
+ *
+ * Returns 0, UQ_INVALID_VARIABLES_ERROR if name is invalid or
+ * UQ_INVALID_EXPRESSION_ERROR if the expression is invalid
+ */
+int uq_assign(UqContext* context, const char* name, const char* expression,
+        double* result);
+
+/* Runs a statement (an expression or name = expression) for every value of a
+ * loop variable, as @loop does, writing one result per iteration through the
+ * output function
+ *
+ * Returns 0 or UQ_STATEMENT_ERROR if the loop or statement is invalid
+ */
+int uq_loop(UqContext* context, const char* loopName, const char* statement);
+
+/* Evaluates an expression over every row of a CSV/TSV file whose header names
+ * the columns, writing each row back out with the result appended
+ *
+ * FILE* file: file open for reading positioned at the header line
+ *
+ * Returns 0 or UQ_INVALID_EXPRESSION_ERROR if the expression is invalid or
+ * the header names a column twice
+ */
+int uq_columns(UqContext* context, FILE* file, const char* expression);
+
+/* Compiles a script into an image for uq_run_compiled(). Plain expressions,
+ * assignments and @loop commands are compiled to bytecode with the names they
+ * use resolved to symbol slots; other lines are kept as text. The image
+ * records a hash of the script so that a stale image is detected
+ *
+ * Returns 0 or UQ_SCRIPT_ERROR if the script cannot be read or the image
+ * cannot be written
+ */
+int uq_compile_script(const char* sourcePath, const char* imagePath);
+
+/* Maps an image written by uq_compile_script() and runs it, producing the
+ * same output as executing each line of its script with uq_execute(). If the
+ * script has changed since the image was compiled the image is rebuilt first,
+ * or the script is run from its text if the image cannot be rewritten
+ *
+ * Returns 0 or UQ_SCRIPT_ERROR if the image is not a valid compiled script
+ */
+int uq_run_compiled(UqContext* context, const char* imagePath);
+
+/* Runs a script ahead-of-time compiled to native code, producing the same
+ * output as uq_run_compiled(). The script is compiled to an image at
+ * "<script>.aot.uqc", whose statements are written out as C at
+ * "<script>.aot.c" and built with the system C compiler (CC or cc, at -O3
+ * -march=native) into "<script>.aot.so", which is loaded with dlopen(). CC
+ * may include options, such as CC="gcc -m64". The hash of the object and of
+ * the image it was built from are kept in "<script>.aot.sum", and the object
+ * is only loaded if it matches them, belongs to the user and is writable by
+ * no one else. Each is reused until the script changes. If the object cannot
+ * be built the image is interpreted after an error message, and if the image
+ * cannot be written the script is run from its text
+ *
+ * int verify: 1 to also interpret every natively computed statement, reporting
+ * any result that is not bit for bit the same and using the interpreted one
+ *
+ * Returns 0 or UQ_SCRIPT_ERROR if the script cannot be read or verify found a
+ * result that differed
+ */
+int uq_run_native(UqContext* context, const char* sourcePath, int verify);
+
+#endif
@@ -0,0 +1,445 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <tinyexpr.h>
+#include "uqexpr.h"
+
+#define INVALID_COMMAND_LINE_ERROR 4
+#define FILE_DOES_NOT_OPEN_ERROR 7
+#define DEFAULT_SAMPLES 31
+#define MAX_SAMPLES 10001
+#define NANOSECONDS 1e9
+#define NAME_BUFFER 32
+#define LINE_BUFFER 500
+#define LETTERS 26
+#define COMPILE_OPERATIONS 2000
+#define EVAL_OPERATIONS 200000
+#define FORMAT_OPERATIONS 200000
+#define FORMAT_SIG_FIGS 3
+#define LOOP_ROWS 2000
+#define LOOKUP_OPERATIONS 200000
+#define LOOKUP_SIZES 3
+#define FILE_LINES 1000
+#define PERCENTILE_MEDIAN 0.5
+#define PERCENTILE_NINETIETH 0.9
+#define PERCENTILE_NINETY_NINTH 0.99
+#define SWEEP_BODIES 8
+
+static const char* const benchExpression
+        = "a*b + sin(c)*0.5 - sqrt(a+b)/(c+1)";
+static const int lookupSizes[LOOKUP_SIZES] = {10, 1000, 100000};
+
+/* Represents the timings of one benchmark
+ *
+ * const char* name: name the benchmark is reported under
+ * const char* unit: what one operation is, e.g. "op", "row" or "line"
+ * long operations: number of operations timed in each sample
+ * double* samples: nanoseconds per operation of each sample
+ * int numberSamples: number of samples
+ */
+typedef struct {
+    const char* name;
+    const char* unit;
+    long operations;
+    double* samples;
+    int numberSamples;
+} Benchmark;
+
+/* Reads the monotonic clock
+ *
+ * Returns the time in nanoseconds
+ */
+static double bench_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * NANOSECONDS + now.tv_nsec;
+}
+
+/* Writes a variable name made only of letters, as variable names must be
+ *
+ * char* name: buffer of at least NAME_BUFFER bytes
+ * char prefix: letter the name starts with
+ * long index: number encoded by the rest of the name
+ */
+static void bench_name(char* name, char prefix, long index)
+{
+    int length = 0;
+    name[length++] = prefix;
+    do {
+        name[length++] = 'a' + index % LETTERS;
+        index /= LETTERS;
+    } while (index > 0 && length < NAME_BUFFER - 1);
+    name[length] = '\0';
+}
+
+/* Discards the output of a context, counting the bytes it produced
+ *
+ * void* data: pointer to a long holding the number of bytes so far
+ */
+static void bench_discard(
+        void* data, int stream, const char* text, size_t length)
+{
+    (void)stream;
+    (void)text;
+    *(long*)data += length;
+}
+
+/* Compares two samples for qsort()
+ *
+ * Returns -1, 0 or 1 as a is less than, equal to or greater than b
+ */
+static int bench_compare(const void* a, const void* b)
+{
+    double first = *(const double*)a;
+    double second = *(const double*)b;
+    return (first > second) - (first < second);
+}
+
+/* Finds a nearest rank percentile of sorted samples
+ *
+ * const double* samples: samples in ascending order
+ * int numberSamples: number of samples
+ * double fraction: percentile as a fraction between 0 and 1
+ *
+ * Returns the sample at that percentile
+ */
+static double bench_percentile(
+        const double* samples, int numberSamples, double fraction)
+{
+    int rank = (int)ceil(fraction * numberSamples);
+    if (rank < 1) {
+        rank = 1;
+    }
+    return samples[rank - 1];
+}
+
+/* Writes the results of one benchmark as a JSON object
+ *
+ * Benchmark* benchmark: benchmark whose samples are sorted and reported
+ * int last: 1 if this is the last result in the array
+ */
+static void bench_report(Benchmark* benchmark, int last)
+{
+    double* samples = benchmark->samples;
+    int n = benchmark->numberSamples;
+    qsort(samples, n, sizeof(double), bench_compare);
+    double mean = 0;
+    for (int i = 0; i < n; i++) {
+        mean += samples[i] / n;
+    }
+    printf("    {\"name\": \"%s\", \"unit\": \"ns/%s\", \"operations\": %ld, "
+           "\"samples\": %d, \"min\": %.1f, \"median\": %.1f, "
+           "\"mean\": %.1f, \"p90\": %.1f, \"p99\": %.1f, \"max\": %.1f}%s\n",
+            benchmark->name, benchmark->unit, benchmark->operations, n,
+            samples[0], bench_percentile(samples, n, PERCENTILE_MEDIAN), mean,
+            bench_percentile(samples, n, PERCENTILE_NINETIETH),
+            bench_percentile(samples, n, PERCENTILE_NINETY_NINTH),
+            samples[n - 1], last ? "" : ",");
+}
+
+/* Times te_compile() and te_free() of a typical expression
+ *
+ * Benchmark* benchmark: benchmark whose samples are filled in
+ */
+static void bench_compile(Benchmark* benchmark)
+{
+    double a = 1.5, b = 2.5, c = 3;
+    te_variable tevars[] = {
+            {.name = "a", .address = &a, .type = TE_VARIABLE, .context = NULL},
+            {.name = "b", .address = &b, .type = TE_VARIABLE, .context = NULL},
+            {.name = "c", .address = &c, .type = TE_VARIABLE, .context = NULL}};
+    for (int s = 0; s < benchmark->numberSamples; s++) {
+        double start = bench_now();
+        for (long i = 0; i < benchmark->operations; i++) {
+            int errPos;
+            te_free(te_compile(benchExpression, tevars, 3, &errPos));
+        }
+        benchmark->samples[s]
+                = (bench_now() - start) / benchmark->operations;
+    }
+}
+
+/* Times te_eval() of a compiled typical expression
+ *
+ * Benchmark* benchmark: benchmark whose samples are filled in
+ */
+static void bench_eval(Benchmark* benchmark)
+{
+    double a = 1.5, b = 2.5, c = 3;
+    te_variable tevars[] = {
+            {.name = "a", .address = &a, .type = TE_VARIABLE, .context = NULL},
+            {.name = "b", .address = &b, .type = TE_VARIABLE, .context = NULL},
+            {.name = "c", .address = &c, .type = TE_VARIABLE, .context = NULL}};
+    int errPos;
+    te_expr* expr = te_compile(benchExpression, tevars, 3, &errPos);
+    volatile double sink = 0;
+    for (int s = 0; s < benchmark->numberSamples; s++) {
+        double start = bench_now();
+        for (long i = 0; i < benchmark->operations; i++) {
+            c = i;
+            sink += te_eval(expr);
+        }
+        benchmark->samples[s]
+                = (bench_now() - start) / benchmark->operations;
+    }
+    te_free(expr);
+}
+
+/* Times formatting a result with the "%.Ng" format results are printed with
+ *
+ * Benchmark* benchmark: benchmark whose samples are filled in
+ */
+static void bench_format(Benchmark* benchmark)
+{
+    char format[NAME_BUFFER];
+    snprintf(format, sizeof(format), "%%.%dg", FORMAT_SIG_FIGS);
+    char buffer[LINE_BUFFER];
+    volatile int sink = 0;
+    for (int s = 0; s < benchmark->numberSamples; s++) {
+        double start = bench_now();
+        for (long i = 0; i < benchmark->operations; i++) {
+            sink += snprintf(buffer, sizeof(buffer), format, i * 0.37 - 5e3);
+        }
+        benchmark->samples[s]
+                = (bench_now() - start) / benchmark->operations;
+    }
+}
+
+/* Times printing @loop result rows in text mode, which formats two values per
+ * row through the context's output buffer
+ *
+ * Benchmark* benchmark: benchmark whose samples are filled in
+ */
+static void bench_loop_rows(Benchmark* benchmark)
+{
+    UqContext* context = uq_create();
+    long bytes = 0;
+    uq_set_output(context, bench_discard, &bytes);
+    char definition[LINE_BUFFER];
+    snprintf(definition, sizeof(definition), "x,0,0.37,%f",
+            (benchmark->operations - 0.5) * 0.37);
+    uq_loopable(context, definition);
+    for (int s = 0; s < benchmark->numberSamples; s++) {
+        double start = bench_now();
+        uq_loop(context, "x", "x * 2");
+        benchmark->samples[s]
+                = (bench_now() - start) / benchmark->operations;
+    }
+    uq_destroy(context);
+}
+
+/* Times uq_eval() of an expression that names one variable in a context
+ * holding a given number of variables. The context compiles through a cache
+ * warmed before timing, so each operation is the name lookup and binding, a
+ * cache hit and the evaluation, with no compile
+ *
+ * Benchmark* benchmark: benchmark whose samples are filled in
+ * int size: number of variables defined before timing
+ */
+static void bench_lookup(Benchmark* benchmark, int size)
+{
+    UqContext* context = uq_create();
+    UqCache* cache = uq_cache_create();
+    uq_set_cache(context, cache);
+    char name[NAME_BUFFER];
+    char definition[LINE_BUFFER];
+    for (int i = 0; i < size; i++) {
+        bench_name(name, 'v', i);
+        snprintf(definition, sizeof(definition), "%s=%d", name, i);
+        uq_define(context, definition);
+    }
+    bench_name(name, 'v', size / 2);
+    char expression[LINE_BUFFER];
+    snprintf(expression, sizeof(expression), "%s + 1", name);
+    double result;
+    uq_eval(context, expression, &result);
+    for (int s = 0; s < benchmark->numberSamples; s++) {
+        double start = bench_now();
+        for (long i = 0; i < benchmark->operations; i++) {
+            uq_eval(context, expression, &result);
+        }
+        benchmark->samples[s]
+                = (bench_now() - start) / benchmark->operations;
+    }
+    uq_destroy(context);
+    uq_cache_destroy(cache);
+}
+
+/* Writes a synthetic script
+ *
+ * FILE* file: file the script is written to
+ * const char* kind: "chain" for a chain of assignments each using the one
+ * before, "sweep" for many @loop sweeps over a wide range or "transcendental"
+ * for assignments and @loops with heavy transcendental bodies
+ * long lines: number of statements to write
+ *
+ * Returns 0 or 1 if the kind is unknown
+ */
+static int bench_generate(FILE* file, const char* kind, long lines)
+{
+    char name[NAME_BUFFER];
+    char previous[NAME_BUFFER];
+    if (!strcmp(kind, "chain")) {
+        bench_name(previous, 'a', 0);
+        fprintf(file, "%s = 1\n", previous);
+        for (long i = 1; i < lines; i++) {
+            bench_name(name, 'a', i);
+            fprintf(file, "%s = %s * 1.0001 + %ld\n", name, previous, i % 7);
+            strcpy(previous, name);
+        }
+    } else if (!strcmp(kind, "sweep")) {
+        fprintf(file, "@range x,0,0.001,1\n");
+        for (long i = 0; i < lines; i++) {
+            bench_name(name, 's', i % SWEEP_BODIES);
+            fprintf(file, "@loop x %s = %s + x * %ld\n", name, name, i + 1);
+        }
+    } else if (!strcmp(kind, "transcendental")) {
+        fprintf(file, "@range t,0.01,0.01,1\n");
+        for (long i = 0; i < lines; i++) {
+            bench_name(name, 'h', i);
+            if (i % 2) {
+                fprintf(file,
+                        "@loop t sin(t*%ld)*cos(t) + exp(-t)*log(t+%ld) "
+                        "- atan2(t, %ld)^2\n",
+                        i, i, i + 1);
+            } else {
+                fprintf(file,
+                        "%s = tanh(%ld.5) + sqrt(%ld) * asin(0.25) "
+                        "- pow(1.01, %ld) / cosh(0.5)\n",
+                        name, i % 5, i, i % 100);
+            }
+        }
+    } else {
+        return 1;
+    }
+    return 0;
+}
+
+/* Times the library's share of running a script file: reading each line of a
+ * generated chain of assignments with getline() and executing it with
+ * uq_execute(), with the output discarded. The script is a temporary file
+ * that stays in the page cache, and the CLI's own work (opening the file,
+ * --trace read spans and writing results to stdout) is not included, so this
+ * is not a timing of uqexpr's download_file()
+ *
+ * Benchmark* benchmark: benchmark whose samples are filled in
+ *
+ * Returns 0 or FILE_DOES_NOT_OPEN_ERROR if the script cannot be written
+ */
+static int bench_script(Benchmark* benchmark)
+{
+    FILE* file = tmpfile();
+    if (file == NULL) {
+        return FILE_DOES_NOT_OPEN_ERROR;
+    }
+    bench_generate(file, "chain", benchmark->operations);
+    for (int s = 0; s < benchmark->numberSamples; s++) {
+        UqContext* context = uq_create();
+        long bytes = 0;
+        uq_set_output(context, bench_discard, &bytes);
+        rewind(file);
+        char* line = NULL;
+        size_t size = 0;
+        double start = bench_now();
+        while (getline(&line, &size, file) >= 0) {
+            uq_execute(context, line);
+        }
+        benchmark->samples[s]
+                = (bench_now() - start) / benchmark->operations;
+        free((void*)line);
+        uq_destroy(context);
+    }
+    fclose(file);
+    return 0;
+}
+
+/* Runs every benchmark, writing the results to stdout as one JSON object
+ *
+ * int numberSamples: number of samples taken of each benchmark
+ *
+ * Returns 0 or FILE_DOES_NOT_OPEN_ERROR if a script cannot be written
+ */
+static int bench_run(int numberSamples)
+{
+    char names[LOOKUP_SIZES][NAME_BUFFER];
+    Benchmark benchmarks[] = {
+            {"te_compile", "op", COMPILE_OPERATIONS, NULL, 0},
+            {"te_eval", "op", EVAL_OPERATIONS, NULL, 0},
+            {"format", "op", FORMAT_OPERATIONS, NULL, 0},
+            {"loop_rows", "row", LOOP_ROWS, NULL, 0},
+            {names[0], "op", LOOKUP_OPERATIONS, NULL, 0},
+            {names[1], "op", LOOKUP_OPERATIONS, NULL, 0},
+            {names[2], "op", LOOKUP_OPERATIONS, NULL, 0},
+            {"execute_script", "line", FILE_LINES, NULL, 0}};
+    int numberBenchmarks = sizeof(benchmarks) / sizeof(benchmarks[0]);
+    for (int i = 0; i < numberBenchmarks; i++) {
+        benchmarks[i].samples
+                = (double*)malloc(numberSamples * sizeof(double));
+        benchmarks[i].numberSamples = numberSamples;
+    }
+    bench_compile(&benchmarks[0]);
+    bench_eval(&benchmarks[1]);
+    bench_format(&benchmarks[2]);
+    bench_loop_rows(&benchmarks[3]);
+    for (int i = 0; i < LOOKUP_SIZES; i++) {
+        snprintf(names[i], NAME_BUFFER, "cached_eval_%d", lookupSizes[i]);
+        bench_lookup(&benchmarks[4 + i], lookupSizes[i]);
+    }
+    int result = bench_script(&benchmarks[7]);
+    if (result == 0) {
+        printf("{\n  \"benchmark\": \"uqexpr\",\n  \"results\": [\n");
+        for (int i = 0; i < numberBenchmarks; i++) {
+            bench_report(&benchmarks[i], i == numberBenchmarks - 1);
+        }
+        printf("  ]\n}\n");
+    }
+    for (int i = 0; i < numberBenchmarks; i++) {
+        free((void*)benchmarks[i].samples);
+    }
+    return result;
+}
+
+/* Runs the microbenchmarks, or writes a synthetic script with --generate
+ *
+ * int argc: number of command line arguments
+ * char* argv[]: array of command line strings
+ *
+ * Returns 0, INVALID_COMMAND_LINE_ERROR if the command line is invalid or
+ * FILE_DOES_NOT_OPEN_ERROR if a script cannot be written
+ */
+int main(int argc, char* argv[])
+{
+    int numberSamples = DEFAULT_SAMPLES;
+    const char* kind = NULL;
+    long lines = 0;
+    int valid = 1;
+    for (int i = 1; i < argc && valid; i++) {
+        char* end = NULL;
+        if (!strcmp(argv[i], "--samples") && i + 1 < argc) {
+            numberSamples = (int)strtol(argv[++i], &end, 10);
+            valid = *end == '\0' && numberSamples > 0
+                    && numberSamples <= MAX_SAMPLES;
+        } else if (!strcmp(argv[i], "--generate") && i + 2 < argc
+                && kind == NULL) {
+            kind = argv[++i];
+            lines = strtol(argv[++i], &end, 10);
+            valid = *end == '\0' && lines > 0;
+        } else {
+            valid = 0;
+        }
+    }
+    if (!valid || (kind != NULL && bench_generate(stdout, kind, lines))) {
+        fprintf(stderr,
+                "Usage: ./uqexpr_bench [--samples 1..%d] "
+                "[--generate chain|sweep|transcendental lines]\n",
+                MAX_SAMPLES);
+        return INVALID_COMMAND_LINE_ERROR;
+    }
+    if (kind != NULL) {
+        return 0;
+    }
+    return bench_run(numberSamples);
+}
@@ -0,0 +1,551 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "uqexpr_server.h"
+
+#define MAX_EVENTS 64
+#define READ_BUFFER_SIZE 65536
+#define SESSION_OUTPUT_LIMIT 1048576
+#define SESSION_OUTPUT_CAP 16777216
+#define SESSION_LINE_LIMIT 65536
+#define SESSION_LENGTH 9
+#define LISTEN_BACKLOG 128
+
+/* Represents one client connection and its evaluation session
+ *
+ * int fd: the connection's socket
+ * UqContext* context: the session's variables and settings
+ * char* input: bytes received that have not been executed yet
+ * size_t inputLength: number of bytes in input
+ * size_t inputCapacity: number of bytes allocated for input
+ * char* output: bytes waiting to be sent
+ * size_t outputStart: index of the first unsent byte in output
+ * size_t outputLength: index one past the last unsent byte in output
+ * size_t outputCapacity: number of bytes allocated for output
+ * int greeted: 1 if the session asked for the banner with @session
+ * int closing: 1 once the client has finished sending
+ * int failed: 1 once the connection has failed or memory for the session could
+ * not be allocated, so the session must be closed
+ */
+typedef struct {
+    int fd;
+    UqContext* context;
+    char* input;
+    size_t inputLength;
+    size_t inputCapacity;
+    char* output;
+    size_t outputStart;
+    size_t outputLength;
+    size_t outputCapacity;
+    int greeted;
+    int closing;
+    int failed;
+} Session;
+
+static volatile sig_atomic_t serverStopping = 0;
+
+/* Asks the server loop to stop, installed for SIGINT and SIGTERM
+ *
+ * int signalNumber: unused
+ */
+static void server_stop(int signalNumber)
+{
+    (void)signalNumber;
+    serverStopping = 1;
+}
+
+/* Appends bytes to a growable buffer
+ *
+ * char** buffer: pointer to the buffer, reallocated as needed
+ * size_t* length: pointer to the number of bytes in the buffer
+ * size_t* capacity: pointer to the number of bytes allocated
+ * const char* bytes: bytes to append
+ * size_t count: number of bytes to append
+ *
+ * Returns 0 or -1 if memory cannot be allocated, leaving the buffer unchanged
+ */
+static int buffer_append(char** buffer, size_t* length, size_t* capacity,
+        const char* bytes, size_t count)
+{
+    if (*length + count > *capacity) {
+        size_t grown = *capacity;
+        while (*length + count > grown) {
+            grown = (grown == 0) ? READ_BUFFER_SIZE : grown * 2;
+        }
+        char* resized = (char*)realloc((void*)*buffer, grown);
+        if (resized == NULL) {
+            return -1;
+        }
+        *buffer = resized;
+        *capacity = grown;
+    }
+    memcpy(*buffer + *length, bytes, count);
+    *length += count;
+    return 0;
+}
+
+/* Sends as much queued output as the socket will take without blocking
+ *
+ * Session* session: session whose output is sent
+ *
+ * Returns 0 or -1 if the connection has failed
+ */
+static int session_send(Session* session)
+{
+    while (session->outputStart < session->outputLength) {
+        ssize_t sent = send(session->fd, session->output + session->outputStart,
+                session->outputLength - session->outputStart, MSG_NOSIGNAL);
+        if (sent < 0) {
+            return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                    ? 0
+                    : -1;
+        }
+        session->outputStart += sent;
+    }
+    return 0;
+}
+
+/* Receives a session's output and errors, queueing them to be sent. Errors
+ * are sent in the same stream as results; the client shim recognises them by
+ * their fixed text or their "uqexpr: " prefix. Queued output is sent as more
+ * arrives while over SESSION_OUTPUT_LIMIT, and a statement whose output would
+ * take more than SESSION_OUTPUT_CAP unsent is interrupted and the rest of its
+ * output dropped, so a client that stops reading cannot grow the server
+ * during one long @loop
+ *
+ * void* data: the Session the output belongs to
+ * int stream: UQ_STREAM_OUTPUT or UQ_STREAM_ERROR
+ * const char* text: bytes to send
+ * size_t length: number of bytes to send
+ */
+static void session_output(
+        void* data, int stream, const char* text, size_t length)
+{
+    Session* session = (Session*)data;
+    if (session->failed) {
+        return;
+    }
+    size_t pending = session->outputLength - session->outputStart;
+    if (pending + length > SESSION_OUTPUT_LIMIT && session_send(session)) {
+        session->failed = 1;
+        uq_interrupt(session->context);
+        return;
+    }
+    pending = session->outputLength - session->outputStart;
+    if (session->outputStart > 0 && session->outputStart >= pending) {
+        memmove(session->output, session->output + session->outputStart,
+                pending);
+        session->outputStart = 0;
+        session->outputLength = pending;
+    }
+    if (stream == UQ_STREAM_OUTPUT && pending + length > SESSION_OUTPUT_CAP) {
+        uq_interrupt(session->context);
+        return;
+    }
+    if (buffer_append(&(session->output), &(session->outputLength),
+                &(session->outputCapacity), text, length)) {
+        session->failed = 1;
+        uq_interrupt(session->context);
+    }
+}
+
+/* Executes one line received on a session, handling the @session greeting
+ * that is part of the protocol rather than the language. Sessions using the
+ * tsv or binary output modes are not greeted, as on the command line
+ *
+ * Session* session: session the line was received on
+ * char* line: nul terminated line including its newline
+ *
+ * Returns 0
+ */
+static int session_line(Session* session, char* line)
+{
+    if (!strncmp(line, "@session ", SESSION_LENGTH)) {
+        if (uq_output_mode(session->context) != UQ_OUTPUT_TEXT) {
+            return 0;
+        }
+        session->greeted = 1;
+        const char* banner = "Welcome to uqexpr!\nWritten by s4809233.\n";
+        session_output(session, UQ_STREAM_OUTPUT, banner, strlen(banner));
+        uq_print(session->context);
+        if (!strcmp(line + SESSION_LENGTH, "live\n")) {
+            const char* prompt = "Please enter your expressions and "
+                                 "assignment operations.\n";
+            session_output(session, UQ_STREAM_OUTPUT, prompt, strlen(prompt));
+        }
+        return 0;
+    }
+    uq_execute(session->context, line);
+    return 0;
+}
+
+/* Executes every complete line a session has received, stopping early if too
+ * much output is waiting to be sent so that a slow reader holds back its own
+ * session rather than growing the server, or if the session has failed
+ *
+ * Session* session: session whose input is executed
+ *
+ * Returns 0
+ */
+static int session_execute(Session* session)
+{
+    size_t start = 0;
+    while (start < session->inputLength && !session->failed
+            && session->outputLength - session->outputStart
+                    < SESSION_OUTPUT_LIMIT) {
+        char* newline = (char*)memchr(session->input + start, '\n',
+                session->inputLength - start);
+        size_t end;
+        if (newline != NULL) {
+            end = newline - session->input + 1;
+        } else if (session->inputLength - start >= SESSION_LINE_LIMIT
+                || (session->closing && session->inputLength > start)) {
+            end = session->inputLength;
+        } else {
+            break;
+        }
+        char* line = (char*)malloc(end - start + 1);
+        if (line == NULL) {
+            session->failed = 1;
+            break;
+        }
+        memcpy(line, session->input + start, end - start);
+        line[end - start] = '\0';
+        session_line(session, line);
+        free((void*)line);
+        start = end;
+    }
+    if (start > 0) {
+        memmove(session->input, session->input + start,
+                session->inputLength - start);
+        session->inputLength -= start;
+    }
+    return 0;
+}
+
+/* Frees a session and closes its connection
+ *
+ * Session* session: session to close
+ */
+static void session_close(Session* session)
+{
+    close(session->fd);
+    uq_destroy(session->context);
+    free((void*)session->input);
+    free((void*)session->output);
+    free((void*)session);
+}
+
+/* Brings a session up to date after its socket became readable or writable:
+ * reads what has arrived, executes complete lines, sends output and chooses
+ * which events to wait for next
+ *
+ * int epoll: the server's epoll instance
+ * Session* session: session to update
+ * int readable: 1 if the socket has data or end of file to read
+ *
+ * Returns 0 or -1 if the session has been closed
+ */
+static int session_update(int epoll, Session* session, int readable)
+{
+    char buffer[READ_BUFFER_SIZE];
+    while (readable && !session->closing) {
+        ssize_t received = recv(session->fd, buffer, sizeof(buffer), 0);
+        if (received > 0) {
+            if (buffer_append(&(session->input), &(session->inputLength),
+                        &(session->inputCapacity), buffer, received)) {
+                session_close(session);
+                return -1;
+            }
+            if ((size_t)received < sizeof(buffer)) {
+                break;
+            }
+        } else if (received == 0) {
+            session->closing = 1;
+        } else if (errno != EINTR) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                session_close(session);
+                return -1;
+            }
+            break;
+        }
+    }
+    session_execute(session);
+    int finished = session->closing && session->inputLength == 0;
+    if (finished && session->greeted == 1) {
+        const char* thanks = "Thank you for using uqexpr.\n";
+        session_output(session, UQ_STREAM_OUTPUT, thanks, strlen(thanks));
+        session->greeted = 2;
+    }
+    if (session->failed || session_send(session) != 0) {
+        session_close(session);
+        return -1;
+    }
+    int pending = session->outputStart < session->outputLength;
+    if (finished && !pending) {
+        session_close(session);
+        return -1;
+    }
+    struct epoll_event event;
+    event.events = pending ? EPOLLOUT : 0;
+    if (!session->closing
+            && session->outputLength - session->outputStart
+                    < SESSION_OUTPUT_LIMIT) {
+        event.events |= EPOLLIN;
+    }
+    event.data.ptr = session;
+    epoll_ctl(epoll, EPOLL_CTL_MOD, session->fd, &event);
+    return 0;
+}
+
+/* Accepts every pending connection, giving each a new session copied from the
+ * base context. A connection there is not enough memory for is closed
+ *
+ * int epoll: the server's epoll instance
+ * int listener: the listening socket
+ * const UqContext* base: context every session starts as a copy of
+ *
+ * Returns 0
+ */
+static int server_accept(int epoll, int listener, const UqContext* base)
+{
+    while (1) {
+        int fd = accept(listener, NULL, NULL);
+        if (fd < 0) {
+            return 0;
+        }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        Session* session = (Session*)calloc(1, sizeof(Session));
+        UqContext* context = (session != NULL) ? uq_clone(base) : NULL;
+        if (context == NULL) {
+            free((void*)session);
+            close(fd);
+            continue;
+        }
+        session->fd = fd;
+        session->context = context;
+        uq_set_output(session->context, session_output, session);
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.ptr = session;
+        epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event);
+    }
+}
+
+/* Creates a non-blocking socket listening on a path. A socket file left
+ * behind by a server that is no longer running is replaced
+ *
+ * const char* socketPath: path to listen on
+ *
+ * Returns the socket or -1 if it cannot be created
+ */
+static int server_listen(const char* socketPath)
+{
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(socketPath) >= sizeof(address.sun_path)) {
+        return -1;
+    }
+    strcpy(address.sun_path, socketPath);
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        return -1;
+    }
+    if (bind(listener, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        int stale = errno == EADDRINUSE
+                && connect(probe, (struct sockaddr*)&address, sizeof(address))
+                        < 0
+                && errno == ECONNREFUSED;
+        close(probe);
+        if (!stale || unlink(socketPath) < 0
+                || bind(listener, (struct sockaddr*)&address, sizeof(address))
+                        < 0) {
+            close(listener);
+            return -1;
+        }
+    }
+    if (listen(listener, LISTEN_BACKLOG) < 0) {
+        close(listener);
+        unlink(socketPath);
+        return -1;
+    }
+    fcntl(listener, F_SETFL, fcntl(listener, F_GETFL) | O_NONBLOCK);
+    return listener;
+}
+
+/* Serves sessions over a Unix domain socket until SIGINT or SIGTERM
+ */
+int uq_serve(const char* socketPath, const UqContext* base)
+{
+    int listener = server_listen(socketPath);
+    if (listener < 0) {
+        fprintf(stderr, "uqexpr: can't listen on socket \"%s\"\n", socketPath);
+        return UQ_SOCKET_ERROR;
+    }
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = server_stop;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    int epoll = epoll_create1(0);
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = NULL;
+    epoll_ctl(epoll, EPOLL_CTL_ADD, listener, &event);
+    struct epoll_event events[MAX_EVENTS];
+    while (!serverStopping) {
+        int count = epoll_wait(epoll, events, MAX_EVENTS, -1);
+        for (int i = 0; i < count; i++) {
+            Session* session = (Session*)events[i].data.ptr;
+            if (session == NULL) {
+                server_accept(epoll, listener, base);
+            } else {
+                session_update(epoll, session,
+                        (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                                != 0);
+            }
+        }
+    }
+    close(epoll);
+    close(listener);
+    unlink(socketPath);
+    return 0;
+}
+
+/* Writes output received from the server, sending each complete line that is
+ * exactly the error message or a diagnostic starting "uqexpr: ", such as a
+ * --progress report, to stderr and everything else to stdout
+ *
+ * char* pending: bytes received that have not been written yet
+ * size_t* length: pointer to the number of bytes in pending
+ * int finished: 1 if no more bytes will be received
+ *
+ * Returns 0
+ */
+static int client_write(char* pending, size_t* length, int finished)
+{
+    const char* error = "Error in command, expression or assignment "
+                        "operation\n";
+    const char* diagnostic = "uqexpr: ";
+    size_t start = 0;
+    while (start < *length) {
+        char* newline = (char*)memchr(pending + start, '\n', *length - start);
+        if (newline == NULL && !finished) {
+            break;
+        }
+        size_t end = (newline != NULL) ? (size_t)(newline - pending) + 1
+                                       : *length;
+        if ((end - start == strlen(error)
+                    && !memcmp(pending + start, error, end - start))
+                || (end - start > strlen(diagnostic)
+                        && !memcmp(pending + start, diagnostic,
+                                strlen(diagnostic)))) {
+            fflush(stdout);
+            fwrite(pending + start, 1, end - start, stderr);
+        } else {
+            fwrite(pending + start, 1, end - start, stdout);
+        }
+        start = end;
+    }
+    memmove(pending, pending + start, *length - start);
+    *length -= start;
+    return 0;
+}
+
+/* Connects to a server and relays a script or the live command line through
+ * it
+ */
+int uq_connect(const char* socketPath, int input, int live)
+{
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (strlen(socketPath) >= sizeof(address.sun_path) || fd < 0) {
+        fprintf(stderr, "uqexpr: can't connect to socket \"%s\"\n",
+                socketPath);
+        return UQ_SOCKET_ERROR;
+    }
+    strcpy(address.sun_path, socketPath);
+    if (connect(fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        close(fd);
+        fprintf(stderr, "uqexpr: can't connect to socket \"%s\"\n",
+                socketPath);
+        return UQ_SOCKET_ERROR;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    char* sending = NULL;
+    size_t sendingLength = 0, sendingCapacity = 0, sendingStart = 0;
+    char* received = NULL;
+    size_t receivedLength = 0, receivedCapacity = 0;
+    const char* greeting = live ? "@session live\n" : "@session file\n";
+    int failed = buffer_append(&sending, &sendingLength, &sendingCapacity,
+            greeting, strlen(greeting));
+    int inputOpen = 1;
+    char buffer[READ_BUFFER_SIZE];
+    while (!failed) {
+        int waiting = sendingStart < sendingLength;
+        struct pollfd fds[2];
+        fds[0].fd = fd;
+        fds[0].events = POLLIN | (waiting ? POLLOUT : 0);
+        fds[1].fd = input;
+        fds[1].events = POLLIN;
+        int polled = (inputOpen && !waiting) ? 2 : 1;
+        if (poll(fds, polled, -1) < 0) {
+            continue;
+        }
+        if (polled == 2 && (fds[1].revents & (POLLIN | POLLHUP))) {
+            ssize_t count = read(input, buffer, sizeof(buffer));
+            if (count > 0) {
+                sendingStart = 0;
+                sendingLength = 0;
+                failed = buffer_append(&sending, &sendingLength,
+                        &sendingCapacity, buffer, count);
+            } else if (count == 0) {
+                inputOpen = 0;
+                shutdown(fd, SHUT_WR);
+            }
+        }
+        if (fds[0].revents & POLLOUT) {
+            ssize_t sent = send(fd, sending + sendingStart,
+                    sendingLength - sendingStart, MSG_NOSIGNAL);
+            if (sent > 0) {
+                sendingStart += sent;
+            }
+        }
+        if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+            ssize_t count = recv(fd, buffer, sizeof(buffer), 0);
+            if (count <= 0 && !(count < 0 && errno == EAGAIN)) {
+                break;
+            }
+            if (count > 0) {
+                failed = buffer_append(&received, &receivedLength,
+                        &receivedCapacity, buffer, count);
+                client_write(received, &receivedLength, 0);
+                if (live) {
+                    fflush(stdout);
+                }
+            }
+        }
+    }
+    client_write(received, &receivedLength, 1);
+    fflush(stdout);
+    free((void*)sending);
+    free((void*)received);
+    close(fd);
+    if (failed) {
+        fprintf(stderr, "uqexpr: can't relay to socket \"%s\"\n", socketPath);
+        return UQ_SOCKET_ERROR;
+    }
+    return 0;
+}
@@ -0,0 +1,49 @@
+#ifndef UQEXPR_SERVER_H
+#define UQEXPR_SERVER_H
+
+#include "uqexpr.h"
+
+#define UQ_SOCKET_ERROR 8
+
+/* Serves sessions over a Unix domain socket until SIGINT or SIGTERM is
+ * received. Every connection gets its own session, a copy of base, and speaks
+ * the live command line protocol: each line received is executed and its
+ * output and errors are sent back on the connection. Sessions compile through
+ * base's cache, so an expression compiled by one session is reused by the
+ * others.
+ *
+ * A connection whose first line is "@session live" or "@session file" is
+ * greeted with the banner (and the prompt for live) and thanked when it
+ * closes, exactly as the command line program would in text mode.
+ *
+ * A session stops reading input while more than 1 MiB of its output is unsent.
+ * A statement that would leave more than 16 MiB unsent, such as a long @loop
+ * for a client that is not reading, is interrupted with an error, and a
+ * session that runs out of memory is closed.
+ *
+ * Sessions are served by one thread, which runs each statement to completion
+ * before serving any other session, so a slow statement delays every session.
+ * Give base a time limit with uq_set_time_limit() to bound how long a @loop
+ * can hold the server
+ *
+ * const char* socketPath: path of the socket to listen on
+ * const UqContext* base: context every session starts as a copy of
+ *
+ * Returns 0 once stopped or UQ_SOCKET_ERROR if the socket cannot be used
+ */
+int uq_serve(const char* socketPath, const UqContext* base);
+
+/* Connects to a server started with uq_serve() and relays a script or the
+ * live command line through it. Results are written to stdout and errors to
+ * stderr, so the output matches running the script locally
+ *
+ * const char* socketPath: path of the server's socket
+ * int input: file descriptor the script is read from
+ * int live: 1 if input is the live command line, 0 if it is a file
+ *
+ * Returns 0 or UQ_SOCKET_ERROR if the server cannot be reached or there is
+ * not enough memory to relay the output
+ */
+int uq_connect(const char* socketPath, int input, int live);
+
+#endif